@@ -0,0 +1,96 @@
+// include/raw_hid_protocol.h
+
+#ifndef _RAW_HID_PROTOCOL_H_
+#define _RAW_HID_PROTOCOL_H_
+
+#include <stdint.h>
+
+// Framed binary protocol on the vendor-defined raw HID reports. Every report
+// carries one frame; tools/raw_hid_client.py mirrors these definitions.
+//
+//   Request  (output report): cmd, seq, len, payload[len]
+//   Response (input report):  cmd, seq, status, len, payload[len]
+//
+// The response echoes cmd and seq. Streamed counters arrive unsolicited as
+// RAW_CMD_GET_COUNTERS responses with seq 0. Multi-byte fields are little-endian.
+
+#define RAW_HID_PROTOCOL_VERSION 1
+
+// Report payload after the report ID, 64 bytes on the wire
+#define RAW_HID_REPORT_SIZE 63
+#define RAW_HID_REQUEST_HEADER 3
+#define RAW_HID_RESPONSE_HEADER 4
+#define RAW_HID_REQUEST_PAYLOAD (RAW_HID_REPORT_SIZE - RAW_HID_REQUEST_HEADER)
+#define RAW_HID_RESPONSE_PAYLOAD (RAW_HID_REPORT_SIZE - RAW_HID_RESPONSE_HEADER)
+
+// Vendor usage page and usages of the raw HID collection
+#define RAW_HID_USAGE_PAGE 0xFF60
+#define RAW_HID_USAGE 0x61
+#define RAW_HID_USAGE_INPUT 0x62
+#define RAW_HID_USAGE_OUTPUT 0x63
+
+enum RawHidCommand : uint8_t {
+    RAW_CMD_PING = 0x01,            // -> RawDeviceInfo
+    RAW_CMD_GET_KEY = 0x10,         // layer, key -> layer, key, RawKeyAction
+    RAW_CMD_SET_KEY = 0x11,         // layer, key, RawKeyAction
+    RAW_CMD_GET_LED = 0x20,         // index -> index, RawLedColor
+    RAW_CMD_SET_LED = 0x21,         // index, RawLedColor
+    RAW_CMD_GET_MACRO = 0x30,       // macro, offset u16 -> macro, size u16, offset u16, bytecode
+    RAW_CMD_WRITE_MACRO = 0x31,     // offset u16, bytecode; staged, offset 0 starts over
+    RAW_CMD_COMMIT_MACRO = 0x32,    // macro, size u16; replaces or (macro == count) appends
+    RAW_CMD_GET_COUNTERS = 0x40,    // -> RawCounters
+    RAW_CMD_STREAM_COUNTERS = 0x41  // interval ms u16, 0 stops
+};
+
+enum RawHidStatus : uint8_t {
+    RAW_STATUS_OK = 0,
+    RAW_STATUS_UNKNOWN_COMMAND,
+    RAW_STATUS_BAD_LENGTH,
+    RAW_STATUS_OUT_OF_RANGE,
+    RAW_STATUS_INVALID,     // Rejected by validation, e.g. malformed bytecode
+    RAW_STATUS_BUSY         // Try again, e.g. a macro is playing
+};
+
+struct __attribute__((packed)) RawDeviceInfo {
+    uint8_t protocolVersion;
+    uint8_t numLayers;
+    uint8_t numKeys;
+    uint8_t numLeds;
+    uint8_t numMacros;
+    uint8_t maxMacros;
+    uint16_t macroStageSize;    // Largest macro RAW_CMD_WRITE_MACRO can stage
+};
+
+// A compiled KeyConfig. Tap-hold keys reference pooled actions and cannot be
+// written, they read back with their type only.
+struct __attribute__((packed)) RawKeyAction {
+    uint8_t type;               // ActionType
+    uint8_t hidReport[8];
+    uint8_t usageReport[2];
+    uint8_t macroIndex;
+    uint8_t mouseAction;
+    uint8_t targetLayer;
+    uint8_t layerMode;
+};
+
+struct __attribute__((packed)) RawLedColor {
+    uint8_t r, g, b;
+    uint8_t brightness;
+    uint8_t pressedR, pressedG, pressedB;
+};
+
+struct __attribute__((packed)) RawCounters {
+    uint32_t uptimeMs;
+    uint32_t hidSent;
+    uint32_t hidCoalesced;
+    uint32_t hidDuplicates;
+    uint32_t hidDropped;
+    uint32_t keyEvents;         // Reports attributed to a key press, see LATENCY_TOTAL
+    uint32_t latencyAvgUs;
+    uint32_t latencyMaxUs;
+    uint16_t scanRateHz;
+    uint8_t hidBacklog;
+    uint8_t activeLayer;
+};
+
+#endif /* _RAW_HID_PROTOCOL_H_ */
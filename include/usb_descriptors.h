@@ -6,6 +6,10 @@
 // Report IDs
 #define REPORT_ID_KEYBOARD    1
 #define REPORT_ID_MOUSE       2
+#define REPORT_ID_CONSUMER_CONTROL 4
+#define REPORT_ID_SYSTEM_CONTROL   5
+#define REPORT_ID_RAW         6
+#define REPORT_ID_NKRO        7
 
 // Interface numbers
 enum {
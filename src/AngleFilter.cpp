@@ -0,0 +1,64 @@
+// AngleFilter.cpp
+
+#include "AngleFilter.h"
+
+AngleFilter::AngleFilter()
+    : estimate(0), variance(0)
+{
+}
+
+void AngleFilter::configure(const AngleFilterConfig& newConfig) {
+    config = newConfig;
+    if (config.alpha == 0) config.alpha = 1;
+    if (config.alpha > 256) config.alpha = 256;
+    // Zero noise would freeze the Kalman gain at 0 or divide by zero
+    if (config.processNoise == 0) config.processNoise = 1;
+    if (config.measurementNoise == 0) config.measurementNoise = 1;
+    reset((int32_t)(estimate >> 8));
+}
+
+void AngleFilter::reset(int32_t position) {
+    estimate = (int64_t)position << 8;
+    variance = config.measurementNoise;
+}
+
+int64_t AngleFilter::update(int32_t position) {
+    int64_t measured = (int64_t)position << 8;
+
+    switch (config.type) {
+        case ANGLE_FILTER_IIR:
+            estimate += (measured - estimate) * config.alpha / 256;
+            break;
+
+        case ANGLE_FILTER_KALMAN: {
+            // Predict: the angle may have wandered by the process noise
+            uint32_t predicted = variance + config.processNoise;
+            if (predicted < variance) predicted = UINT32_MAX;
+            // Update: gain in Q16, how much of the innovation to trust
+            uint32_t gain = (uint32_t)(((uint64_t)predicted << 16) / ((uint64_t)predicted + config.measurementNoise));
+            estimate += (measured - estimate) * gain / 65536;
+            variance = (uint32_t)(((uint64_t)predicted * (65536 - gain)) >> 16);
+            break;
+        }
+
+        case ANGLE_FILTER_NONE:
+        default:
+            estimate = measured;
+            break;
+    }
+    return estimate;
+}
+
+AngleFilterType AngleFilter::typeFromString(const String& name) {
+    if (name == "none") return ANGLE_FILTER_NONE;
+    if (name == "kalman") return ANGLE_FILTER_KALMAN;
+    return ANGLE_FILTER_IIR;
+}
+
+const char* AngleFilter::typeName(AngleFilterType type) {
+    switch (type) {
+        case ANGLE_FILTER_NONE: return "none";
+        case ANGLE_FILTER_KALMAN: return "kalman";
+        default: return "iir";
+    }
+}
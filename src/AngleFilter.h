@@ -0,0 +1,44 @@
+// AngleFilter.h
+
+#ifndef ANGLE_FILTER_H
+#define ANGLE_FILTER_H
+
+#include <Arduino.h>
+
+enum AngleFilterType : uint8_t {
+    ANGLE_FILTER_NONE,
+    ANGLE_FILTER_IIR,     // First-order low pass, fixed weight per sample
+    ANGLE_FILTER_KALMAN   // Scalar Kalman, the weight follows the estimate's variance
+};
+
+// Filter settings, converted to fixed point at load so a sample needs no floats
+struct AngleFilterConfig {
+    AngleFilterType type = ANGLE_FILTER_IIR;
+    uint16_t alpha = 64;              // IIR weight of a new sample, Q8 (256 = unfiltered)
+    uint32_t processNoise = 16;       // Kalman Q, counts^2 per sample, Q8
+    uint32_t measurementNoise = 256;  // Kalman R, counts^2, Q8
+};
+
+// Smooths an unwrapped angle in sensor counts. The estimate is kept in Q8 so
+// movement smaller than one count is not lost between samples.
+class AngleFilter {
+public:
+    AngleFilter();
+
+    void configure(const AngleFilterConfig& config);
+    // Starts over at a position, without settling from the old estimate
+    void reset(int32_t position);
+    // Filtered position in Q8 counts
+    int64_t update(int32_t position);
+    int64_t getEstimate() const { return estimate; }
+
+    static AngleFilterType typeFromString(const String& name);
+    static const char* typeName(AngleFilterType type);
+
+private:
+    AngleFilterConfig config;
+    int64_t estimate;    // Q8 counts
+    uint32_t variance;   // Kalman P, Q8 counts^2
+};
+
+#endif // ANGLE_FILTER_H
@@ -0,0 +1,128 @@
+// As5600Encoder.cpp
+
+#include "As5600Encoder.h"
+#include "EncoderMath.h"
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+// CONF fields
+#define AS5600_CONF_HYST_SHIFT 2
+#define AS5600_CONF_SF_SHIFT 8
+#define AS5600_CONF_FTH_SHIFT 10
+#define AS5600_CONF_MASK ((3 << AS5600_CONF_HYST_SHIFT) | (3 << AS5600_CONF_SF_SHIFT) | (7 << AS5600_CONF_FTH_SHIFT))
+
+// Fast filter thresholds in LSBs, indexed by the FTH field
+static const uint8_t FAST_FILTER_THRESHOLDS[8] = {0, 6, 7, 9, 18, 21, 24, 10};
+
+As5600Encoder::As5600Encoder()
+    : bus(nullptr), connected(false), pointerOnAngle(false), status(0), lastStatusMs(0),
+      rawAngle(0), position(0), sampleCount(0), errorCount(0), busTimeUs(0)
+{
+}
+
+bool As5600Encoder::begin(I2CBus* i2c, const As5600Config& newConfig) {
+    bus = i2c;
+    config = newConfig;
+    device = I2CDevice(AS5600_ADDRESS, config.muxAddress, config.muxChannel);
+    filter.configure(config.filter);
+
+    uint8_t data[3];
+    if (!writeConf() || !bus->readRegisters(device, AS5600_REG_STATUS, data, 3)) {
+        USBSerial.println("AS5600 not responding");
+        connected = false;
+        return false;
+    }
+    connected = true;
+    status = data[0];
+    lastStatusMs = millis();
+    rawAngle = ((data[1] << 8) | data[2]) & 0x0FFF;
+    position = 0;
+    filter.reset(0);
+
+    if (config.muxAddress) {
+        USBSerial.printf("AS5600 behind multiplexer 0x%02X channel %d\n", config.muxAddress, config.muxChannel);
+    }
+    USBSerial.printf("AS5600 at %u Hz, slow filter %dx, fast filter %d LSB, hysteresis %d LSB, %s filter\n",
+                  config.i2cFrequency, config.slowFilter, config.fastFilterThreshold,
+                  config.hysteresis, AngleFilter::typeName(config.filter.type));
+    return true;
+}
+
+bool As5600Encoder::update() {
+    if (!bus) return false;
+
+    uint32_t start = micros();
+    uint16_t angle;
+    bool ok;
+    if (millis() - lastStatusMs >= AS5600_STATUS_INTERVAL_MS || !connected) {
+        // Status and angle in one burst, the pointer is left past RAW ANGLE
+        uint8_t data[3];
+        ok = bus->readRegisters(device, AS5600_REG_STATUS, data, 3);
+        if (ok) {
+            status = data[0];
+            lastStatusMs = millis();
+            angle = ((data[1] << 8) | data[2]) & 0x0FFF;
+        }
+        pointerOnAngle = false;
+    } else {
+        ok = readAngle(angle);
+    }
+    busTimeUs += micros() - start;
+    sampleCount++;
+
+    if (!ok) {
+        errorCount++;
+        connected = false;
+        pointerOnAngle = false;
+        return false;
+    }
+    if (!connected) {
+        // The chip may have lost power and its CONF with it
+        connected = writeConf();
+        if (!connected) return false;
+    }
+
+    // Unwrap across 4095 -> 0
+    position += EncoderMath::unwrapDelta(angle, rawAngle, AS5600_COUNTS);
+    rawAngle = angle;
+    filter.update(position);
+    return true;
+}
+
+// Chip filter and hysteresis, leaving power mode, output and watchdog alone
+bool As5600Encoder::writeConf() {
+    uint8_t data[2];
+    if (!bus->readRegisters(device, AS5600_REG_CONF, data, 2)) return false;
+    uint16_t conf = (data[0] << 8) | data[1];
+
+    uint8_t sf = config.slowFilter >= 16 ? 0 : config.slowFilter >= 8 ? 1 : config.slowFilter >= 4 ? 2 : 3;
+    uint8_t fth = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        if (FAST_FILTER_THRESHOLDS[i] == config.fastFilterThreshold) fth = i;
+    }
+    if (FAST_FILTER_THRESHOLDS[fth] != config.fastFilterThreshold) {
+        USBSerial.printf("AS5600 fast filter threshold %d not supported, slow filter only\n", config.fastFilterThreshold);
+    }
+
+    conf &= ~AS5600_CONF_MASK;
+    conf |= (min(config.hysteresis, (uint8_t)3) << AS5600_CONF_HYST_SHIFT)
+          | (sf << AS5600_CONF_SF_SHIFT)
+          | (fth << AS5600_CONF_FTH_SHIFT);
+
+    uint8_t frame[3] = {AS5600_REG_CONF, (uint8_t)(conf >> 8), (uint8_t)(conf & 0xFF)};
+    pointerOnAngle = false;
+    return bus->write(device, frame, 3);
+}
+
+bool As5600Encoder::readAngle(uint16_t& angle) {
+    uint8_t data[2];
+    if (pointerOnAngle) {
+        if (!bus->read(device, data, 2)) return false;
+    } else {
+        if (!bus->readRegisters(device, AS5600_REG_RAW_ANGLE, data, 2)) return false;
+        pointerOnAngle = true;
+    }
+    angle = ((data[0] << 8) | data[1]) & 0x0FFF;
+    return true;
+}
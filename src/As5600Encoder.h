@@ -0,0 +1,84 @@
+// As5600Encoder.h
+
+#ifndef AS5600_ENCODER_H
+#define AS5600_ENCODER_H
+
+#include <Arduino.h>
+#include "AngleFilter.h"
+#include "I2CBus.h"
+
+#define AS5600_ADDRESS 0x36
+#define AS5600_COUNTS 4096
+// Fast-mode plus, the fastest the AS5600 supports
+#define AS5600_DEFAULT_I2C_FREQUENCY 1000000
+// Magnet status is read this often rather than on every sample
+#define AS5600_STATUS_INTERVAL_MS 250
+
+#define AS5600_REG_CONF 0x07        // 0x07-0x08, 14 bits
+#define AS5600_REG_STATUS 0x0B
+#define AS5600_REG_RAW_ANGLE 0x0C   // 0x0C-0x0D, 12 bits
+
+// STATUS bits
+#define AS5600_STATUS_MH 0x08       // Magnet too strong
+#define AS5600_STATUS_ML 0x10       // Magnet too weak
+#define AS5600_STATUS_MD 0x20       // Magnet detected
+
+// components.json "as5600" settings
+struct As5600Config {
+    uint32_t i2cFrequency = AS5600_DEFAULT_I2C_FREQUENCY;
+    uint8_t muxAddress = 0;           // TCA9548A in front of the chip, 0 = none
+    uint8_t muxChannel = 0;
+    uint8_t slowFilter = 16;          // Samples the chip averages at rest: 16, 8, 4 or 2
+    uint8_t fastFilterThreshold = 6;  // LSBs of movement that switch the chip to its fast filter, 0 = never
+    uint8_t hysteresis = 1;           // Chip output hysteresis in LSBs, 0-3
+    AngleFilterConfig filter;
+};
+
+// AS5600 magnetic angle sensor. The chip's slow and fast filters and its
+// hysteresis are set once in CONF. The address pointer is then left on RAW
+// ANGLE, which the chip does not advance past, so each sample is a single
+// 2-byte read with no register write in front of it.
+class As5600Encoder {
+public:
+    As5600Encoder();
+
+    // The bus must already be started
+    bool begin(I2CBus* bus, const As5600Config& config);
+    // Reads one sample into the filter, from a single task. False on a bus error.
+    bool update();
+
+    // Filtered position in counts since begin(), 4096 per turn
+    int32_t getPosition() const { return (int32_t)(filter.getEstimate() >> 8); }
+    uint16_t getRawAngle() const { return rawAngle; }
+    bool isConnected() const { return connected; }
+    bool isMagnetDetected() const { return (status & AS5600_STATUS_MD) != 0; }
+    uint8_t getStatus() const { return status; }
+
+    uint32_t getSampleCount() const { return sampleCount; }
+    uint32_t getErrorCount() const { return errorCount; }
+    // Bus time per sample, including the occasional status read
+    uint32_t getAvgSampleUs() const { return sampleCount ? (uint32_t)(busTimeUs / sampleCount) : 0; }
+
+private:
+    bool writeConf();
+    bool readAngle(uint16_t& angle);
+
+    I2CBus* bus;
+    I2CDevice device;
+    As5600Config config;
+    AngleFilter filter;
+
+    bool connected;
+    bool pointerOnAngle;     // Next sample can skip the register write
+    uint8_t status;
+    uint32_t lastStatusMs;
+
+    uint16_t rawAngle;
+    int32_t position;        // Unwrapped raw counts
+
+    uint32_t sampleCount;
+    uint32_t errorCount;
+    uint64_t busTimeUs;
+};
+
+#endif // AS5600_ENCODER_H
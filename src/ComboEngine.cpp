@@ -0,0 +1,170 @@
+// ComboEngine.cpp
+
+#include "ComboEngine.h"
+
+ComboEngine::ComboEngine()
+    : windowUs(50000UL)
+{
+    clear();
+}
+
+void ComboEngine::clear() {
+    comboCount = 0;
+    memset(comboKeys, 0, sizeof(comboKeys));
+    memset(combosWithKey, 0, sizeof(combosWithKey));
+    memset(combosOfSize, 0, sizeof(combosOfSize));
+    memset(comboHeld, 0, sizeof(comboHeld));
+    memset(keyCombo, COMBO_NONE, sizeof(keyCombo));
+    pendingKeys = 0;
+    candidates = 0;
+    startUs = 0;
+    eventCount = 0;
+    lastCombo = COMBO_NONE;
+    fireCount = 0;
+}
+
+int8_t ComboEngine::addCombo(uint32_t keyMask) {
+    uint8_t size = __builtin_popcount(keyMask);
+    if (comboCount >= MAX_COMBOS || size < 2) return -1;
+
+    // Two combos on the same keys could never be told apart
+    for (uint8_t i = 0; i < comboCount; i++) {
+        if (comboKeys[i] == keyMask) return -1;
+    }
+
+    uint8_t combo = comboCount++;
+    uint64_t bit = 1ULL << combo;
+    comboKeys[combo] = keyMask;
+    combosOfSize[size] |= bit;
+    for (uint8_t key = 0; key < COMBO_MAX_KEYS; key++) {
+        if (keyMask & (1UL << key)) combosWithKey[key] |= bit;
+    }
+    return combo;
+}
+
+ComboResult ComboEngine::onEvent(const KeyEvent& event) {
+    uint8_t key = event.keyIndex;
+    if (key >= COMBO_MAX_KEYS) {
+        if (!isPending()) return COMBO_PASS;
+        events[eventCount++] = event;
+        return flush();
+    }
+    uint32_t keyBit = 1UL << key;
+
+    if (!event.pressed) {
+        // Keys of a fired combo: the first release ends the combo action
+        uint8_t combo = keyCombo[key];
+        if (combo != COMBO_NONE) {
+            keyCombo[key] = COMBO_NONE;
+            bool first = comboHeld[combo] == comboKeys[combo];
+            comboHeld[combo] &= ~keyBit;
+            if (first) {
+                lastCombo = combo;
+                return COMBO_RELEASE;
+            }
+            return COMBO_SUPPRESS;
+        }
+
+        if (!isPending()) return COMBO_PASS;
+
+        if (!(pendingKeys & keyBit)) {
+            // Key held from before the attempt, keep it in order with the rest
+            events[eventCount++] = event;
+            return eventCount < COMBO_MAX_KEYS ? COMBO_BUFFERED : flush();
+        }
+
+        // A held back key went up before the window closed
+        uint8_t match = exactMatch();
+        if (match != COMBO_NONE) {
+            // Fire first, the caller feeds the release again afterwards
+            return fire(match);
+        }
+        events[eventCount++] = event;
+        return flush();
+    }
+
+    if (!isPending()) {
+        if (!combosWithKey[key]) return COMBO_PASS;
+        pendingKeys = keyBit;
+        candidates = combosWithKey[key];
+        startUs = event.timestampUs;
+        eventCount = 0;
+        events[eventCount++] = event;
+        return COMBO_BUFFERED;
+    }
+
+    // Late presses and keys outside every candidate end the match attempt
+    uint64_t narrowed = candidates & combosWithKey[key];
+    if (event.timestampUs - startUs >= windowUs || !narrowed) {
+        events[eventCount++] = event;
+        return flush();
+    }
+
+    pendingKeys |= keyBit;
+    candidates = narrowed;
+    events[eventCount++] = event;
+    if (eventCount >= COMBO_MAX_KEYS) return flush();
+
+    // Fire as soon as the match can no longer grow into a larger combo
+    uint8_t match = exactMatch();
+    if (match != COMBO_NONE && candidates == (1ULL << match)) {
+        return fire(match);
+    }
+    return COMBO_BUFFERED;
+}
+
+ComboResult ComboEngine::onTimer(uint32_t nowUs) {
+    if (!isPending() || nowUs - startUs < windowUs) return COMBO_BUFFERED;
+
+    uint8_t match = exactMatch();
+    if (match != COMBO_NONE) return fire(match);
+    return flush();
+}
+
+uint32_t ComboEngine::timeUntilDeadline(uint32_t nowUs) const {
+    uint32_t elapsed = nowUs - startUs;
+    return elapsed >= windowUs ? 0 : windowUs - elapsed;
+}
+
+uint8_t ComboEngine::takeBuffered(KeyEvent* out) {
+    uint8_t count = eventCount;
+    memcpy(out, events, count * sizeof(KeyEvent));
+    eventCount = 0;
+    return count;
+}
+
+// Candidate whose keys are exactly the pending keys, found by key count
+uint8_t ComboEngine::exactMatch() const {
+    uint64_t sized = candidates & combosOfSize[__builtin_popcount(pendingKeys)];
+    if (!sized) return COMBO_NONE;
+    uint8_t combo = __builtin_ctzll(sized);
+    return comboKeys[combo] == pendingKeys ? combo : COMBO_NONE;
+}
+
+ComboResult ComboEngine::fire(uint8_t combo) {
+    uint32_t keys = comboKeys[combo];
+    comboHeld[combo] = keys;
+    for (uint8_t key = 0; key < COMBO_MAX_KEYS; key++) {
+        if (keys & (1UL << key)) keyCombo[key] = combo;
+    }
+
+    // The combo's own presses are consumed, anything else is left for replay
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < eventCount; i++) {
+        if (events[i].keyIndex < COMBO_MAX_KEYS && (keys & (1UL << events[i].keyIndex))) continue;
+        events[kept++] = events[i];
+    }
+    eventCount = kept;
+
+    pendingKeys = 0;
+    candidates = 0;
+    lastCombo = combo;
+    fireCount++;
+    return COMBO_FIRE;
+}
+
+ComboResult ComboEngine::flush() {
+    pendingKeys = 0;
+    candidates = 0;
+    return COMBO_FLUSH;
+}
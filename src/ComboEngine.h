@@ -0,0 +1,76 @@
+// ComboEngine.h
+
+#ifndef COMBO_ENGINE_H
+#define COMBO_ENGINE_H
+
+#include <Arduino.h>
+#include "KeyEventQueue.h"
+
+// Combos are tracked in a 64-bit mask, keys in a 32-bit mask
+#define MAX_COMBOS 64
+#define COMBO_MAX_KEYS 32
+#define COMBO_NONE 0xFF
+
+enum ComboResult {
+    COMBO_PASS,      // Not part of a combo, handle the event normally
+    COMBO_BUFFERED,  // Held back while a combo may still match
+    COMBO_FIRE,      // getCombo() matched, press its action
+    COMBO_FLUSH,     // No match, replay the held back events (including this one)
+    COMBO_RELEASE,   // First key of getCombo() released, release its action
+    COMBO_SUPPRESS   // Belongs to a combo that was already handled
+};
+
+// Matches simultaneous key presses against a compiled combo table. Every
+// event costs a fixed number of mask operations regardless of how many
+// combos are defined: the candidates are the AND of the per-key combo masks,
+// and an exact match is looked up by key count.
+class ComboEngine {
+public:
+    ComboEngine();
+
+    void clear();
+    void setWindow(uint16_t windowMs) { windowUs = (uint32_t)windowMs * 1000UL; }
+    // Returns the combo index, or -1 when the table is full or the mask is invalid
+    int8_t addCombo(uint32_t keyMask);
+    uint8_t getComboCount() const { return comboCount; }
+    uint32_t getKeyMask(uint8_t combo) const { return comboKeys[combo]; }
+
+    ComboResult onEvent(const KeyEvent& event);
+    ComboResult onTimer(uint32_t nowUs);
+    bool isPending() const { return pendingKeys != 0; }
+    uint32_t timeUntilDeadline(uint32_t nowUs) const;
+
+    // Combo of the last COMBO_FIRE / COMBO_RELEASE
+    uint8_t getCombo() const { return lastCombo; }
+    // Hands over the held back events after COMBO_FLUSH or COMBO_FIRE
+    uint8_t takeBuffered(KeyEvent* events);
+
+    uint32_t getFireCount() const { return fireCount; }
+
+private:
+    ComboResult fire(uint8_t combo);
+    ComboResult flush();
+    uint8_t exactMatch() const;
+
+    uint8_t comboCount;
+    uint32_t comboKeys[MAX_COMBOS];
+    uint64_t combosWithKey[COMBO_MAX_KEYS]; // Combos each key takes part in
+    uint64_t combosOfSize[COMBO_MAX_KEYS + 1]; // Combos by number of keys
+
+    // Match in progress
+    uint32_t pendingKeys;
+    uint64_t candidates;
+    uint32_t startUs;
+    uint32_t windowUs;   // All keys of a combo must go down within this time
+    KeyEvent events[COMBO_MAX_KEYS + 1];
+    uint8_t eventCount;
+
+    // Fired combos still held, per key
+    uint8_t keyCombo[COMBO_MAX_KEYS];
+    uint32_t comboHeld[MAX_COMBOS];
+
+    uint8_t lastCombo;
+    uint32_t fireCount;
+};
+
+#endif // COMBO_ENGINE_H
@@ -38,190 +38,490 @@ std::vector<Component> ConfigManager::loadComponents(const char* filePath) {
         c.startCol = comp["start_location"]["column"];
         if (c.type == "encoder" && comp.containsKey("with_button"))
             c.withButton = comp["with_button"];
+        if (comp.containsKey("debounceTime"))
+            c.debounceTime = comp["debounceTime"];
+        if (comp.containsKey("debounceMode"))
+            c.debounceMode = comp["debounceMode"].as<String>();
         components.push_back(c);
     }
     return components;
 }
 
+ModuleSettings ConfigManager::loadSettings(const char* filePath) {
+    ModuleSettings settings;
+    String jsonStr = readFile(filePath);
+    if (jsonStr.isEmpty()) return settings;
+    
+    DynamicJsonDocument doc(4096);
+    DeserializationError error = deserializeJson(doc, jsonStr);
+    if (error) {
+        Serial.printf("Error parsing %s: %s\n", filePath, error.c_str());
+        return settings;
+    }
+    
+    JsonObject button = doc["defaults"]["button"];
+    if (!button.isNull()) {
+        settings.debounceTime = button["debounceTime"] | settings.debounceTime;
+        settings.tappingTerm = button["tappingTerm"] | settings.tappingTerm;
+        settings.comboWindow = button["comboWindow"] | settings.comboWindow;
+        if (button.containsKey("debounceMode"))
+            settings.debounceMode = button["debounceMode"].as<String>();
+    }
+    
+    JsonObject moduleSettings = doc["settings"];
+    if (!moduleSettings.isNull()) {
+        settings.idleHoldoff = moduleSettings["scanIdleHoldoff"] | settings.idleHoldoff;
+        // Scan as often as the host polls unless a rate is given
+        settings.scanRate = moduleSettings["scanRate"] | (moduleSettings["usbPollingRate"] | settings.scanRate);
+        if (moduleSettings.containsKey("keyboardReportMode"))
+            settings.keyboardReportMode = moduleSettings["keyboardReportMode"].as<String>();
+        loadMouseCurve(moduleSettings["mouse"]["move"], settings.mouseMove);
+        loadMouseCurve(moduleSettings["mouse"]["wheel"], settings.mouseWheel);
+    }
+    
+    JsonObject encoder = doc["defaults"]["encoder"];
+    if (!encoder.isNull()) {
+        settings.encoderStepSize = encoder["stepSize"] | settings.encoderStepSize;
+        loadEncoderAcceleration(encoder["acceleration"], settings.encoderAcceleration);
+    }
+    
+    return settings;
+}
+
+void ConfigManager::loadMouseCurve(JsonObject config, MouseCurveConfig& curve) {
+    if (config.isNull()) return;
+    curve.speed = config["speed"] | curve.speed;
+    curve.maxSpeed = config["maxSpeed"] | curve.maxSpeed;
+    curve.accelTime = config["accelTime"] | curve.accelTime;
+    curve.step = config["step"] | curve.step;
+    if (config.containsKey("curve")) {
+        String shape = config["curve"].as<String>();
+        curve.curve = shape == "cubic" ? 3 : shape == "quadratic" ? 2 : 1;
+    }
+    if (curve.maxSpeed < curve.speed) curve.maxSpeed = curve.speed;
+}
+
+// true / false, or an object overriding the curve
+void ConfigManager::loadEncoderAcceleration(JsonVariant config, EncoderAccelConfig& accel) {
+    if (config.is<bool>()) {
+        accel.enabled = config.as<bool>();
+        return;
+    }
+    if (!config.is<JsonObject>()) return;
+    accel.enabled = config["enabled"] | true;
+    accel.startSpeed = config["startSpeed"] | accel.startSpeed;
+    accel.fullSpeed = config["fullSpeed"] | accel.fullSpeed;
+    accel.maxMultiplier = config["maxMultiplier"] | accel.maxMultiplier;
+    if (accel.fullSpeed <= accel.startSpeed) accel.fullSpeed = accel.startSpeed + 1;
+    if (accel.maxMultiplier < 1) accel.maxMultiplier = 1;
+}
+
+MatrixHardware ConfigManager::loadMatrixHardware(const char* filePath) {
+    MatrixHardware hardware;
+    String jsonStr = readFile(filePath);
+    if (jsonStr.isEmpty()) return hardware;
+    
+    DynamicJsonDocument doc(4096);
+    DeserializationError error = deserializeJson(doc, jsonStr);
+    if (error) {
+        Serial.printf("Error parsing %s: %s\n", filePath, error.c_str());
+        return hardware;
+    }
+    
+    JsonObject matrix = doc["hardware"]["matrix"];
+    if (matrix.isNull()) return hardware;
+    
+    if (matrix.containsKey("driver"))
+        hardware.driver = matrix["driver"].as<String>();
+    
+    // Rows and columns are pin lists for direct GPIO, counts otherwise
+    if (matrix["rows"].is<JsonArray>()) {
+        for (JsonVariant pin : matrix["rows"].as<JsonArray>()) {
+            hardware.rowPins.push_back(pin.as<uint8_t>());
+        }
+        hardware.rows = hardware.rowPins.size();
+    } else {
+        hardware.rows = matrix["rows"] | 0;
+    }
+    if (matrix["columns"].is<JsonArray>()) {
+        for (JsonVariant pin : matrix["columns"].as<JsonArray>()) {
+            hardware.colPins.push_back(pin.as<uint8_t>());
+        }
+        hardware.cols = hardware.colPins.size();
+    } else {
+        hardware.cols = matrix["columns"] | 0;
+    }
+    
+    hardware.settleTimeUs = matrix["settleTimeUs"] | hardware.settleTimeUs;
+    hardware.registers = matrix["registers"] | hardware.registers;
+    JsonObject pins = matrix["pins"];
+    if (!pins.isNull()) {
+        hardware.loadPin = pins["load"] | hardware.loadPin;
+        hardware.clockPin = pins["clock"] | hardware.clockPin;
+        hardware.dataPin = pins["data"] | hardware.dataPin;
+        hardware.sdaPin = pins["sda"] | hardware.sdaPin;
+        hardware.sclPin = pins["scl"] | hardware.sclPin;
+    }
+    hardware.spiFrequency = matrix["spiFrequency"] | hardware.spiFrequency;
+    hardware.i2cFrequency = matrix["i2cFrequency"] | hardware.i2cFrequency;
+    if (matrix.containsKey("address")) {
+        // Accepts 32 or "0x20"
+        hardware.i2cAddress = matrix["address"].is<const char*>()
+            ? strtoul(matrix["address"].as<const char*>(), nullptr, 0)
+            : matrix["address"].as<uint8_t>();
+    }
+    
+    // A shift register chain is one row of 8 keys per register
+    if (hardware.driver == "74hc165") {
+        hardware.rows = hardware.registers;
+        hardware.cols = 8;
+    }
+    
+    return hardware;
+}
+
+// The base layer: the legacy single "layer-config" object, or the first
+// entry of the "layers" array
 std::map<String, ActionConfig> ConfigManager::loadActions(const String &filePath) {
-    std::map<String, ActionConfig> actions;
+    std::vector<LayerConfig> layers = loadLayers(filePath);
+    if (layers.empty()) {
+        return std::map<String, ActionConfig>();
+    }
+    return layers[0].actions;
+}
+
+std::vector<LayerConfig> ConfigManager::loadLayers(const String &filePath) {
+    std::vector<LayerConfig> layers;
     
     // Use the readJsonFile function from ModuleSetup.cpp
     String jsonContent = readJsonFile(filePath.c_str());
     if (jsonContent.isEmpty()) {
         Serial.printf("Could not read file: %s\n", filePath.c_str());
-        return actions;
+        return layers;
     }
     
-    
     // Parse JSON
     DynamicJsonDocument doc(16384); // Increased size to handle larger files
     DeserializationError error = deserializeJson(doc, jsonContent);
     
     if (error) {
         Serial.printf("Error parsing JSON: %s\n", error.c_str());
-        return actions;
+        return layers;
     }
     
-    // Extract layer config
-    if (!doc.containsKey("actions") || 
-        !doc["actions"].containsKey("layer-config")) {
-        Serial.println("Invalid actions.json format: missing actions or layer-config");
-        return actions;
+    JsonObject actionsObj = doc["actions"];
+    if (actionsObj.isNull()) {
+        Serial.println("Invalid actions.json format: missing actions");
+        return layers;
     }
     
-    JsonObject layerConfig = doc["actions"]["layer-config"];
+    if (actionsObj.containsKey("layers")) {
+        // Layer stack, index 0 is the base layer
+        for (JsonObject layerObj : actionsObj["layers"].as<JsonArray>()) {
+            LayerConfig layer;
+            layer.name = layerObj["layer-name"].as<String>();
+            layer.actions = parseLayerConfig(layerObj["layer-config"]);
+            layers.push_back(layer);
+        }
+    } else if (actionsObj.containsKey("layer-config")) {
+        LayerConfig layer;
+        layer.name = actionsObj["layer-name"].as<String>();
+        layer.actions = parseLayerConfig(actionsObj["layer-config"]);
+        layers.push_back(layer);
+    } else {
+        Serial.println("Invalid actions.json format: missing layers or layer-config");
+    }
+    
+    Serial.printf("Loaded %d action layers\n", layers.size());
+    return layers;
+}
+
+std::vector<ComboConfig> ConfigManager::loadCombos(const String &filePath) {
+    std::vector<ComboConfig> combos;
+    
+    String jsonContent = readJsonFile(filePath.c_str());
+    if (jsonContent.isEmpty()) {
+        return combos;
+    }
+    
+    DynamicJsonDocument doc(16384);
+    DeserializationError error = deserializeJson(doc, jsonContent);
+    if (error) {
+        Serial.printf("Error parsing JSON: %s\n", error.c_str());
+        return combos;
+    }
+    
+    for (JsonObject comboObj : doc["actions"]["combos"].as<JsonArray>()) {
+        ComboConfig combo;
+        for (JsonVariant key : comboObj["keys"].as<JsonArray>()) {
+            combo.keys.push_back(key.as<String>());
+        }
+        combo.action = parseAction("combo", comboObj["action"]);
+        combos.push_back(combo);
+    }
+    
+    Serial.printf("Loaded %d combos\n", combos.size());
+    return combos;
+}
+
+// Each macro is either a plain array of steps or {"interval": ms, "steps": [...]}.
+// A step is an 8-byte report array (the reports.json format) or one of
+// {"press"|"release"|"tap"|"consumer": "0x.."}, {"text": "..."} and {"delay": ms}.
+std::vector<MacroConfig> ConfigManager::loadMacros(const String &filePath) {
+    std::vector<MacroConfig> macros;
+    
+    String jsonContent = readJsonFile(filePath.c_str());
+    if (jsonContent.isEmpty()) {
+        return macros;
+    }
+    
+    DynamicJsonDocument doc(16384);
+    DeserializationError error = deserializeJson(doc, jsonContent);
+    if (error) {
+        Serial.printf("Error parsing JSON: %s\n", error.c_str());
+        return macros;
+    }
+    
+    static const char* const stepOps[] = { "press", "release", "tap", "consumer" };
+    
+    for (JsonPair kv : doc["actions"]["macros"].as<JsonObject>()) {
+        MacroConfig macro;
+        macro.name = kv.key().c_str();
+        
+        JsonArray steps;
+        if (kv.value().is<JsonArray>()) {
+            steps = kv.value().as<JsonArray>();
+        } else {
+            macro.interval = kv.value()["interval"] | 0;
+            steps = kv.value()["steps"].as<JsonArray>();
+        }
+        
+        for (JsonVariant stepVar : steps) {
+            MacroStepConfig step;
+            if (stepVar.is<JsonArray>()) {
+                step.op = "report";
+                for (JsonVariant byte : stepVar.as<JsonArray>()) {
+                    step.report.push_back(byte.as<String>());
+                }
+            } else if (stepVar.containsKey("text")) {
+                step.op = "text";
+                step.text = stepVar["text"].as<String>();
+            } else if (stepVar.containsKey("delay")) {
+                step.op = "delay";
+                step.delayMs = stepVar["delay"] | 0;
+            } else {
+                for (const char* op : stepOps) {
+                    if (stepVar.containsKey(op)) {
+                        step.op = op;
+                        step.usage = stepVar[op].as<String>();
+                        break;
+                    }
+                }
+            }
+            
+            if (step.op.isEmpty()) {
+                Serial.printf("Macro %s: unknown step ignored\n", macro.name.c_str());
+                continue;
+            }
+            macro.steps.push_back(step);
+        }
+        macros.push_back(macro);
+    }
+    
+    Serial.printf("Loaded %d macros\n", macros.size());
+    return macros;
+}
+
+std::map<String, ActionConfig> ConfigManager::parseLayerConfig(JsonObject layerConfig) {
+    std::map<String, ActionConfig> actions;
     
     // Process each button configuration
     for (JsonPair kv : layerConfig) {
         String buttonId = kv.key().c_str();
-        JsonObject buttonConfig = kv.value();
-        
-        ActionConfig action;
-        action.type = buttonConfig["type"].as<String>();
-        
-        // Debug
-        Serial.printf("Loading action for %s, type: %s\n", buttonId.c_str(), action.type.c_str());
-        
-        if (action.type == "hid") {
-            // Check if buttonPress exists
-            if (buttonConfig.containsKey("buttonPress")) {
-                JsonVariant buttonPress = buttonConfig["buttonPress"];
+        actions[buttonId] = parseAction(buttonId, kv.value());
+    }
+    
+    Serial.printf("Loaded %d button actions successfully\n", actions.size());
+    return actions;
+}
+
+ActionConfig ConfigManager::parseAction(const String& buttonId, JsonObject buttonConfig) {
+    ActionConfig action;
+    action.type = buttonConfig["type"].as<String>();
+    
+    // Debug
+    Serial.printf("Loading action for %s, type: %s\n", buttonId.c_str(), action.type.c_str());
+    
+    if (action.type == "hid") {
+        // Check if buttonPress exists
+        if (buttonConfig.containsKey("buttonPress")) {
+            JsonVariant buttonPress = buttonConfig["buttonPress"];
+            
+            // Handle both array formats
+            if (buttonPress.is<JsonArray>()) {
+                JsonArray pressArray = buttonPress.as<JsonArray>();
                 
-                // Handle both array formats
-                if (buttonPress.is<JsonArray>()) {
-                    JsonArray pressArray = buttonPress.as<JsonArray>();
+                // Check if we have a nested array format [["0x00", "0x01", ...]]
+                if (pressArray.size() > 0 && pressArray[0].is<JsonArray>()) {
+                    // Handle nested array format
+                    JsonArray innerArray = pressArray[0].as<JsonArray>();
                     
-                    // Check if we have a nested array format [["0x00", "0x01", ...]]
-                    if (pressArray.size() > 0 && pressArray[0].is<JsonArray>()) {
-                        // Handle nested array format
-                        JsonArray innerArray = pressArray[0].as<JsonArray>();
-                        
-                        action.hidReport.clear();
-                        for (size_t i = 0; i < innerArray.size() && i < 8; i++) {
-                            action.hidReport.push_back(innerArray[i].as<String>());
-                        }
-                    } 
-                    else {
-                        // Handle flat array format ["0x00", "0x01", ...]
-                        action.hidReport.clear();
-                        for (size_t i = 0; i < pressArray.size() && i < 8; i++) {
-                            action.hidReport.push_back(pressArray[i].as<String>());
-                        }
+                    action.hidReport.clear();
+                    for (size_t i = 0; i < innerArray.size() && i < 8; i++) {
+                        action.hidReport.push_back(innerArray[i].as<String>());
+                    }
+                } 
+                else {
+                    // Handle flat array format ["0x00", "0x01", ...]
+                    action.hidReport.clear();
+                    for (size_t i = 0; i < pressArray.size() && i < 8; i++) {
+                        action.hidReport.push_back(pressArray[i].as<String>());
                     }
-                    
-                    Serial.printf("Loaded HID report with %d bytes for %s\n", 
-                                 action.hidReport.size(), buttonId.c_str());
                 }
+                
+                Serial.printf("Loaded HID report with %d bytes for %s\n", 
+                             action.hidReport.size(), buttonId.c_str());
             }
-            
-            // Check for encoder rotation actions (clockwise/counterclockwise)
-            if (buttonId.startsWith("encoder-")) {
-                // Clockwise action
-                if (buttonConfig.containsKey("clockwise")) {
-                    JsonVariant cwAction = buttonConfig["clockwise"];
-                    if (cwAction.is<JsonArray>()) {
-                        JsonArray cwArray = cwAction.as<JsonArray>();
-                        action.clockwise.clear();
-                        for (size_t i = 0; i < cwArray.size() && i < 8; i++) {
-                            action.clockwise.push_back(cwArray[i].as<String>());
-                        }
-                        Serial.printf("Loaded clockwise HID report with %d bytes for %s\n", 
-                                     action.clockwise.size(), buttonId.c_str());
+        }
+        
+        // Check for encoder rotation actions (clockwise/counterclockwise)
+        if (buttonId.startsWith("encoder-")) {
+            // Clockwise action
+            if (buttonConfig.containsKey("clockwise")) {
+                JsonVariant cwAction = buttonConfig["clockwise"];
+                if (cwAction.is<JsonArray>()) {
+                    JsonArray cwArray = cwAction.as<JsonArray>();
+                    action.clockwise.clear();
+                    for (size_t i = 0; i < cwArray.size() && i < 8; i++) {
+                        action.clockwise.push_back(cwArray[i].as<String>());
                     }
+                    Serial.printf("Loaded clockwise HID report with %d bytes for %s\n", 
+                                 action.clockwise.size(), buttonId.c_str());
                 }
-                
-                // Counterclockwise action
-                if (buttonConfig.containsKey("counterclockwise")) {
-                    JsonVariant ccwAction = buttonConfig["counterclockwise"];
-                    if (ccwAction.is<JsonArray>()) {
-                        JsonArray ccwArray = ccwAction.as<JsonArray>();
-                        action.counterclockwise.clear();
-                        for (size_t i = 0; i < ccwArray.size() && i < 8; i++) {
-                            action.counterclockwise.push_back(ccwArray[i].as<String>());
-                        }
-                        Serial.printf("Loaded counterclockwise HID report with %d bytes for %s\n", 
-                                     action.counterclockwise.size(), buttonId.c_str());
+            }
+            
+            // Counterclockwise action
+            if (buttonConfig.containsKey("counterclockwise")) {
+                JsonVariant ccwAction = buttonConfig["counterclockwise"];
+                if (ccwAction.is<JsonArray>()) {
+                    JsonArray ccwArray = ccwAction.as<JsonArray>();
+                    action.counterclockwise.clear();
+                    for (size_t i = 0; i < ccwArray.size() && i < 8; i++) {
+                        action.counterclockwise.push_back(ccwArray[i].as<String>());
                     }
+                    Serial.printf("Loaded counterclockwise HID report with %d bytes for %s\n", 
+                                 action.counterclockwise.size(), buttonId.c_str());
                 }
             }
         }
-        else if (action.type == "multimedia") {
-            // Similar processing for multimedia reports
-            if (buttonConfig.containsKey("consumerReport")) {
-                JsonVariant consumerReport = buttonConfig["consumerReport"];
+    }
+    else if (action.type == "multimedia" || action.type == "system") {
+        // A usage name from reports.json or a 16-bit number
+        if (buttonConfig.containsKey("usage")) {
+            action.usage = buttonConfig["usage"].as<String>();
+            Serial.printf("Loaded %s usage %s for %s\n", action.type.c_str(),
+                         action.usage.c_str(), buttonId.c_str());
+        }
+        
+        // Similar processing for multimedia reports
+        if (buttonConfig.containsKey("consumerReport")) {
+            JsonVariant consumerReport = buttonConfig["consumerReport"];
+            
+            if (consumerReport.is<JsonArray>()) {
+                JsonArray reportArray = consumerReport.as<JsonArray>();
                 
-                if (consumerReport.is<JsonArray>()) {
-                    JsonArray reportArray = consumerReport.as<JsonArray>();
+                // Check if we have nested array
+                if (reportArray.size() > 0 && reportArray[0].is<JsonArray>()) {
+                    JsonArray innerArray = reportArray[0].as<JsonArray>();
                     
-                    // Check if we have nested array
-                    if (reportArray.size() > 0 && reportArray[0].is<JsonArray>()) {
-                        JsonArray innerArray = reportArray[0].as<JsonArray>();
-                        
-                        action.consumerReport.clear();
-                        for (size_t i = 0; i < innerArray.size() && i < 4; i++) {
-                            action.consumerReport.push_back(innerArray[i].as<String>());
-                        }
-                    } 
-                    else {
-                        // Handle flat array format
-                        action.consumerReport.clear();
-                        for (size_t i = 0; i < reportArray.size() && i < 4; i++) {
-                            action.consumerReport.push_back(reportArray[i].as<String>());
-                        }
+                    action.consumerReport.clear();
+                    for (size_t i = 0; i < innerArray.size() && i < 4; i++) {
+                        action.consumerReport.push_back(innerArray[i].as<String>());
+                    }
+                } 
+                else {
+                    // Handle flat array format
+                    action.consumerReport.clear();
+                    for (size_t i = 0; i < reportArray.size() && i < 4; i++) {
+                        action.consumerReport.push_back(reportArray[i].as<String>());
                     }
-                    
-                    Serial.printf("Loaded Consumer report with %d bytes for %s\n", 
-                                 action.consumerReport.size(), buttonId.c_str());
                 }
+                
+                Serial.printf("Loaded Consumer report with %d bytes for %s\n", 
+                             action.consumerReport.size(), buttonId.c_str());
             }
-            
-            // Check for encoder rotation actions for multimedia type
-            if (buttonId.startsWith("encoder-")) {
-                // Clockwise action
-                if (buttonConfig.containsKey("clockwise")) {
-                    JsonVariant cwAction = buttonConfig["clockwise"];
-                    if (cwAction.is<JsonArray>()) {
-                        JsonArray cwArray = cwAction.as<JsonArray>();
-                        action.clockwise.clear();
-                        for (size_t i = 0; i < cwArray.size() && i < 4; i++) {
-                            action.clockwise.push_back(cwArray[i].as<String>());
-                        }
-                        Serial.printf("Loaded clockwise consumer report with %d bytes for %s\n", 
-                                     action.clockwise.size(), buttonId.c_str());
+        }
+        
+        // Check for encoder rotation actions for multimedia type
+        if (buttonId.startsWith("encoder-")) {
+            // Clockwise action
+            if (buttonConfig.containsKey("clockwise")) {
+                JsonVariant cwAction = buttonConfig["clockwise"];
+                if (cwAction.is<JsonArray>()) {
+                    JsonArray cwArray = cwAction.as<JsonArray>();
+                    action.clockwise.clear();
+                    for (size_t i = 0; i < cwArray.size() && i < 4; i++) {
+                        action.clockwise.push_back(cwArray[i].as<String>());
                     }
+                    Serial.printf("Loaded clockwise consumer report with %d bytes for %s\n", 
+                                 action.clockwise.size(), buttonId.c_str());
                 }
-                
-                // Counterclockwise action
-                if (buttonConfig.containsKey("counterclockwise")) {
-                    JsonVariant ccwAction = buttonConfig["counterclockwise"];
-                    if (ccwAction.is<JsonArray>()) {
-                        JsonArray ccwArray = ccwAction.as<JsonArray>();
-                        action.counterclockwise.clear();
-                        for (size_t i = 0; i < ccwArray.size() && i < 4; i++) {
-                            action.counterclockwise.push_back(ccwArray[i].as<String>());
-                        }
-                        Serial.printf("Loaded counterclockwise consumer report with %d bytes for %s\n", 
-                                     action.counterclockwise.size(), buttonId.c_str());
+            }
+            
+            // Counterclockwise action
+            if (buttonConfig.containsKey("counterclockwise")) {
+                JsonVariant ccwAction = buttonConfig["counterclockwise"];
+                if (ccwAction.is<JsonArray>()) {
+                    JsonArray ccwArray = ccwAction.as<JsonArray>();
+                    action.counterclockwise.clear();
+                    for (size_t i = 0; i < ccwArray.size() && i < 4; i++) {
+                        action.counterclockwise.push_back(ccwArray[i].as<String>());
                     }
+                    Serial.printf("Loaded counterclockwise consumer report with %d bytes for %s\n", 
+                                 action.counterclockwise.size(), buttonId.c_str());
                 }
             }
         }
-        else if (action.type == "macro") {
-            action.macroId = buttonConfig["macroId"].as<String>();
-            Serial.printf("Loaded macro ID: %s for %s\n", 
-                         action.macroId.c_str(), buttonId.c_str());
-        }
-        else if (action.type == "layer") {
-            action.targetLayer = buttonConfig["targetLayer"].as<String>();
-            Serial.printf("Loaded target layer: %s for %s\n", 
-                         action.targetLayer.c_str(), buttonId.c_str());
-        }
-        
-        // Store the action configuration
-        actions[buttonId] = action;
+    }
+    else if (action.type == "macro") {
+        action.macroId = buttonConfig["macroId"].as<String>();
+        Serial.printf("Loaded macro ID: %s for %s\n", 
+                     action.macroId.c_str(), buttonId.c_str());
+    }
+    else if (action.type == "text") {
+        action.text = buttonConfig["text"].as<String>();
+        Serial.printf("Loaded text (%d chars) for %s\n", 
+                     action.text.length(), buttonId.c_str());
+    }
+    else if (action.type == "mouse") {
+        action.mouseAction = buttonConfig["mouse"].as<String>();
+        Serial.printf("Loaded mouse action %s for %s\n", 
+                     action.mouseAction.c_str(), buttonId.c_str());
+    }
+    else if (action.type == "layer") {
+        action.targetLayer = buttonConfig["targetLayer"].as<String>();
+        action.layerMode = buttonConfig["layerMode"] | "momentary";
+        Serial.printf("Loaded target layer: %s (%s) for %s\n", 
+                     action.targetLayer.c_str(), action.layerMode.c_str(), buttonId.c_str());
+    }
+    else if (action.type == "tap-hold") {
+        // Dual-role key: subActions[0] on tap, subActions[1] on hold
+        action.tappingTerm = buttonConfig["tappingTerm"] | 0;
+        action.tapHoldPolicy = buttonConfig["policy"] | "tapping-term";
+        action.subActions.push_back(parseAction(buttonId, buttonConfig["tap"]));
+        action.subActions.push_back(parseAction(buttonId, buttonConfig["hold"]));
+        Serial.printf("Loaded tap-hold (%s, %s / %s) for %s\n", 
+                     action.tapHoldPolicy.c_str(), action.subActions[0].type.c_str(),
+                     action.subActions[1].type.c_str(), buttonId.c_str());
     }
     
-    Serial.printf("Loaded %d button actions successfully\n", actions.size());
-    return actions;
+    // Encoders may name one usage, mouse action, macro or layer per direction
+    if (buttonId.startsWith("encoder-")) {
+        if (action.clockwise.empty() && buttonConfig["clockwise"].is<const char*>())
+            action.clockwise.push_back(buttonConfig["clockwise"].as<String>());
+        if (action.counterclockwise.empty() && buttonConfig["counterclockwise"].is<const char*>())
+            action.counterclockwise.push_back(buttonConfig["counterclockwise"].as<String>());
+    }
+    
+    return action;
 }
\ No newline at end of file
@@ -18,6 +18,65 @@ struct Component {
   uint8_t rows;
   uint8_t cols;
   bool withButton = false; // for encoder with a button
+  uint16_t debounceTime = 0; // per-component override, 0 = use defaults
+  String debounceMode;       // per-component override, empty = use defaults
+};
+
+// Mouse key speed ramp from settings.mouse.move / settings.mouse.wheel
+struct MouseCurveConfig {
+  uint16_t speed;                  // Units per second on press (px, or wheel detents)
+  uint16_t maxSpeed;               // Units per second once fully accelerated
+  uint16_t accelTime;              // ms from speed to maxSpeed
+  uint8_t curve;                   // Ramp exponent: 1 "linear", 2 "quadratic", 3 "cubic"
+  uint16_t step;                   // Units per encoder detent
+
+  MouseCurveConfig(uint16_t speed, uint16_t maxSpeed, uint16_t accelTime, uint8_t curve, uint16_t step)
+    : speed(speed), maxSpeed(maxSpeed), accelTime(accelTime), curve(curve), step(step) {}
+};
+
+// Encoder acceleration from defaults.encoder.acceleration. Each detent sends
+// one step below startSpeed, rising linearly to maxMultiplier steps at fullSpeed.
+struct EncoderAccelConfig {
+  bool enabled = false;
+  uint16_t startSpeed = 8;         // Detents per second
+  uint16_t fullSpeed = 40;
+  uint8_t maxMultiplier = 8;
+};
+
+// Module-wide settings from info.json
+struct ModuleSettings {
+  uint16_t debounceTime = 50;        // defaults.button.debounceTime
+  String debounceMode = "eager";     // defaults.button.debounceMode
+  uint16_t tappingTerm = 200;        // defaults.button.tappingTerm, tap-hold decision time
+  uint16_t comboWindow = 50;         // defaults.button.comboWindow, ms for all combo keys to go down
+  uint16_t idleHoldoff = 2000;       // settings.scanIdleHoldoff, ms of active scanning after the last release
+  uint16_t scanRate = 1000;          // settings.scanRate (or usbPollingRate), matrix scans per second
+  String keyboardReportMode = "6kro"; // settings.keyboardReportMode, "6kro" or "nkro"
+  MouseCurveConfig mouseMove = MouseCurveConfig(250, 1600, 1000, 2, 16);
+  MouseCurveConfig mouseWheel = MouseCurveConfig(8, 40, 1500, 1, 1);
+  uint8_t encoderStepSize = 4;       // defaults.encoder.stepSize, quadrature edges per detent
+  EncoderAccelConfig encoderAcceleration; // defaults.encoder.acceleration
+};
+
+// Key matrix wiring from info.json hardware.matrix
+struct MatrixHardware {
+  String driver = "gpio";          // "gpio", "74hc165" or "mcp23017"
+  std::vector<uint8_t> rowPins;    // gpio: row and column GPIOs
+  std::vector<uint8_t> colPins;
+  uint16_t settleTimeUs = 10;      // gpio: row drive -> column sample delay
+  uint8_t rows = 0;                // Matrix size, from the pin lists for gpio
+  uint8_t cols = 0;
+  // 74hc165: one register per row of 8 keys
+  uint8_t registers = 1;
+  int8_t loadPin = -1;
+  int8_t clockPin = -1;
+  int8_t dataPin = -1;
+  uint32_t spiFrequency = 4000000;
+  // mcp23017
+  uint8_t i2cAddress = 0x20;
+  int8_t sdaPin = -1;
+  int8_t sclPin = -1;
+  uint32_t i2cFrequency = 400000;
 };
 
 struct ActionConfig {
@@ -26,20 +85,69 @@ struct ActionConfig {
   // For HID reports, consumer reports, macro info, etc.
   std::vector<String> hidReport; // Can store as hex strings for conversion later
   std::vector<String> consumerReport;
+  String usage;                  // "multimedia" / "system": usage name or number, instead of consumerReport
   String macroId;
+  String text;                   // "text" actions, typed as a macro
+  String mouseAction;            // "mouse" actions, e.g. "move_up", "wheel_down", "button_left"
   String targetLayer;
+  String layerMode;              // "momentary", "toggle", "oneshot" or "default"
+  uint16_t tappingTerm = 0;      // tap-hold, 0 = module default
+  String tapHoldPolicy;          // "tapping-term", "permissive-hold" or "hold-on-other-key-press"
+  std::vector<ActionConfig> subActions; // tap-hold: [0] tap, [1] hold
   std::vector<String> clockwise;
   std::vector<String> counterclockwise;
 };
 
+// One entry of the actions.json layer stack
+struct LayerConfig {
+  String name;
+  std::map<String, ActionConfig> actions;
+};
+
+// Action fired when all keys go down together
+struct ComboConfig {
+  std::vector<String> keys;
+  ActionConfig action;
+};
+
+// One step of an actions.json macro, compiled by the MacroEngine
+struct MacroStepConfig {
+  String op;                      // "report", "press", "release", "tap", "consumer", "text" or "delay"
+  String usage;                   // Key or consumer usage, e.g. "0x04"
+  std::vector<String> report;     // "report": 8-byte keyboard report as hex strings
+  String text;                    // "text": ASCII typed through the keymap
+  uint16_t delayMs = 0;           // "delay"
+};
+
+struct MacroConfig {
+  String name;
+  uint16_t interval = 0;          // ms inserted after every step
+  std::vector<MacroStepConfig> steps;
+};
+
 class ConfigManager {
 public:
     // Reads and parses components.json
     static std::vector<Component> loadComponents(const char* filePath);
     // Reads and parses actions.json and returns a mapping from button id to ActionConfig
     static std::map<String, ActionConfig> loadActions(const String& filePath);    
+    // Reads every layer of actions.json, the first one is the base layer
+    static std::vector<LayerConfig> loadLayers(const String& filePath);
+    // Reads the combos array of actions.json
+    static std::vector<ComboConfig> loadCombos(const String& filePath);
+    // Reads the macros object of actions.json
+    static std::vector<MacroConfig> loadMacros(const String& filePath);
     static String readFile(const char* filePath);
+    // Reads the defaults and settings sections of info.json
+    static ModuleSettings loadSettings(const char* filePath);
+    // Reads hardware.matrix of info.json
+    static MatrixHardware loadMatrixHardware(const char* filePath);
     
+private:
+    static std::map<String, ActionConfig> parseLayerConfig(JsonObject layerConfig);
+    static ActionConfig parseAction(const String& buttonId, JsonObject buttonConfig);
+    static void loadMouseCurve(JsonObject config, MouseCurveConfig& curve);
+    static void loadEncoderAcceleration(JsonVariant config, EncoderAccelConfig& accel);
 };
 
 #endif // CONFIG_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,170 @@
+// DebounceEngine.cpp
+
+#include "DebounceEngine.h"
+
+DebounceEngine::DebounceEngine()
+    : numKeys(0),
+      scanPeriodUs(1000),
+      modes(nullptr),
+      windowMs(nullptr),
+      lastEdgeUs(nullptr),
+      edgeStartUs(nullptr),
+      counters(nullptr),
+      thresholds(nullptr),
+      stableMask(0),
+      rawMask(0),
+      pendingMask(0)
+{
+}
+
+DebounceEngine::~DebounceEngine() {
+    cleanup();
+}
+
+void DebounceEngine::cleanup() {
+    delete[] modes;
+    delete[] windowMs;
+    delete[] lastEdgeUs;
+    delete[] edgeStartUs;
+    delete[] counters;
+    delete[] thresholds;
+    modes = nullptr;
+    windowMs = nullptr;
+    lastEdgeUs = nullptr;
+    edgeStartUs = nullptr;
+    counters = nullptr;
+    thresholds = nullptr;
+    numKeys = 0;
+}
+
+bool DebounceEngine::begin(uint8_t keys, uint32_t periodUs) {
+    cleanup();
+    if (keys > DEBOUNCE_MAX_KEYS) {
+        return false;
+    }
+
+    numKeys = keys;
+    scanPeriodUs = periodUs ? periodUs : 1;
+    modes = new uint8_t[numKeys]();
+    windowMs = new uint16_t[numKeys]();
+    lastEdgeUs = new uint32_t[numKeys]();
+    edgeStartUs = new uint32_t[numKeys]();
+    counters = new uint8_t[numKeys]();
+    thresholds = new uint8_t[numKeys]();
+
+    stableMask = 0;
+    rawMask = 0;
+    pendingMask = 0;
+
+    for (uint8_t i = 0; i < numKeys; i++) {
+        updateThreshold(i);
+    }
+    return true;
+}
+
+void DebounceEngine::setScanPeriod(uint32_t periodUs) {
+    scanPeriodUs = periodUs ? periodUs : 1;
+    for (uint8_t i = 0; i < numKeys; i++) {
+        updateThreshold(i);
+    }
+}
+
+void DebounceEngine::setKeyConfig(uint8_t key, DebounceMode mode, uint16_t debounceMs) {
+    if (key >= numKeys) return;
+    modes[key] = mode;
+    windowMs[key] = debounceMs;
+    updateThreshold(key);
+    counters[key] = (stableMask & (1UL << key)) ? thresholds[key] : 0;
+}
+
+// The integrator needs as many agreeing scans as fit in the debounce window
+void DebounceEngine::updateThreshold(uint8_t key) {
+    uint32_t samples = ((uint32_t)windowMs[key] * 1000 + scanPeriodUs - 1) / scanPeriodUs;
+    if (samples < 1) samples = 1;
+    if (samples > 255) samples = 255;
+    thresholds[key] = samples;
+    if (counters[key] > samples) {
+        counters[key] = samples;
+    }
+}
+
+bool DebounceEngine::update(uint8_t key, bool raw, uint32_t nowUs) {
+    if (key >= numKeys) return false;
+
+    const uint32_t bit = 1UL << key;
+    if (raw != ((rawMask & bit) != 0)) {
+        rawMask ^= bit;
+        lastEdgeUs[key] = nowUs;
+    }
+
+    const bool stable = (stableMask & bit) != 0;
+    if (raw != stable && !(pendingMask & bit)) {
+        edgeStartUs[key] = nowUs;
+    }
+
+    if (modes[key] == DEBOUNCE_INTEGRATOR) {
+        uint8_t& count = counters[key];
+        if (raw) {
+            if (count < thresholds[key]) count++;
+        } else {
+            if (count > 0) count--;
+        }
+
+        if (count == 0 || count == thresholds[key]) {
+            pendingMask &= ~bit;
+        } else {
+            pendingMask |= bit;
+        }
+
+        if (!stable && count == thresholds[key]) {
+            stableMask |= bit;
+            return true;
+        }
+        if (stable && count == 0) {
+            stableMask &= ~bit;
+            return true;
+        }
+        return false;
+    }
+
+    if (raw == stable) {
+        pendingMask &= ~bit;
+        return false;
+    }
+
+    // Eager mode reports a press on the very first edge
+    if (modes[key] == DEBOUNCE_EAGER && raw) {
+        stableMask |= bit;
+        pendingMask &= ~bit;
+        return true;
+    }
+
+    // Everything else waits until the input has been quiet for the window
+    if ((uint32_t)(nowUs - lastEdgeUs[key]) >= (uint32_t)windowMs[key] * 1000) {
+        stableMask ^= bit;
+        pendingMask &= ~bit;
+        return true;
+    }
+
+    pendingMask |= bit;
+    return false;
+}
+
+DebounceMode DebounceEngine::modeFromString(const char* name) {
+    if (!name) return DEBOUNCE_EAGER;
+    if (strcmp(name, "deferred") == 0) return DEBOUNCE_DEFERRED;
+    if (strcmp(name, "integrator") == 0) return DEBOUNCE_INTEGRATOR;
+    return DEBOUNCE_EAGER;
+}
+
+const char* DebounceEngine::modeName(DebounceMode mode) {
+    switch (mode) {
+        case DEBOUNCE_DEFERRED:
+            return "deferred";
+        case DEBOUNCE_INTEGRATOR:
+            return "integrator";
+        case DEBOUNCE_EAGER:
+        default:
+            return "eager";
+    }
+}
@@ -0,0 +1,63 @@
+// DebounceEngine.h
+
+#ifndef DEBOUNCE_ENGINE_H
+#define DEBOUNCE_ENGINE_H
+
+#include <Arduino.h>
+
+// Keys are tracked in 32-bit masks, one bit per key index
+#define DEBOUNCE_MAX_KEYS 32
+
+// Debounce algorithms, selectable per key
+enum DebounceMode : uint8_t {
+    DEBOUNCE_EAGER,      // Report press on the first edge, release once stable for the window
+    DEBOUNCE_DEFERRED,   // Report either edge only once stable for the window
+    DEBOUNCE_INTEGRATOR  // Saturating counter over consecutive scans
+};
+
+class DebounceEngine {
+public:
+    DebounceEngine();
+    ~DebounceEngine();
+
+    bool begin(uint8_t numKeys, uint32_t scanPeriodUs);
+    void setScanPeriod(uint32_t scanPeriodUs);
+    void setKeyConfig(uint8_t key, DebounceMode mode, uint16_t debounceMs);
+
+    // Feed one raw sample for a key. Returns true when the accepted state changed.
+    bool update(uint8_t key, bool raw, uint32_t nowUs);
+
+    bool isPressed(uint8_t key) const { return stableMask & (1UL << key); }
+    uint32_t pressedKeys() const { return stableMask; }
+    // Keys that still need samples even though their raw input did not change
+    uint32_t pendingKeys() const { return pendingMask; }
+
+    DebounceMode getMode(uint8_t key) const { return (DebounceMode)modes[key]; }
+    uint16_t getDebounceTime(uint8_t key) const { return windowMs[key]; }
+    // Time the input first moved away from its accepted state
+    uint32_t getEdgeStart(uint8_t key) const { return edgeStartUs[key]; }
+
+    static DebounceMode modeFromString(const char* name);
+    static const char* modeName(DebounceMode mode);
+
+private:
+    void cleanup();
+    void updateThreshold(uint8_t key);
+
+    uint8_t numKeys;
+    uint32_t scanPeriodUs;
+
+    // Per-key state, indexed by key index
+    uint8_t* modes;
+    uint16_t* windowMs;
+    uint32_t* lastEdgeUs;   // Time the raw input last changed
+    uint32_t* edgeStartUs;  // Time the raw input first left the accepted state
+    uint8_t* counters;      // Integrator count
+    uint8_t* thresholds;    // Integrator samples needed to flip state
+
+    uint32_t stableMask;    // Accepted (debounced) state
+    uint32_t rawMask;       // Last raw sample
+    uint32_t pendingMask;   // Raw differs from accepted, or integrator still moving
+};
+
+#endif // DEBOUNCE_ENGINE_H
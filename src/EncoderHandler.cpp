@@ -1,6 +1,10 @@
 #include "EncoderHandler.h"
 #include "HIDHandler.h"  // Include for hidHandler
 #include "ConfigManager.h"  // For loading encoder actions
+#include "KeyHandler.h"
+#include "MacroEngine.h"
+#include "MouseEngine.h"
+#include "EncoderMath.h"
 
 extern USBCDC USBSerial;
 extern HIDHandler* hidHandler;  // Access to the global HID handler
@@ -8,14 +12,13 @@ extern HIDHandler* hidHandler;  // Access to the global HID handler
 // Global encoder handler instance
 EncoderHandler* encoderHandler = nullptr;
 
-// Map to store encoder actions loaded from the config
-std::map<String, EncoderAction> encoderActions;
-
 EncoderHandler::EncoderHandler(uint8_t numEncoders) 
     : numEncoders(numEncoders), 
       mechanicalEncoders(nullptr), 
       as5600Encoders(nullptr),
-      encoderConfigs(nullptr)
+      pcntEncoders(nullptr),
+      encoderConfigs(nullptr),
+      actions(nullptr)
 {
     // Validate input parameters
     if (numEncoders > MAX_ENCODERS) {
@@ -26,10 +29,12 @@ EncoderHandler::EncoderHandler(uint8_t numEncoders)
     try {
         // Allocate configuration array
         encoderConfigs = new EncoderConfig[numEncoders];
+        actions = new EncoderAction[numEncoders];
 
         // Allocate encoders based on type
         mechanicalEncoders = new Encoder*[numEncoders]();
-        as5600Encoders = new AS5600[numEncoders]();
+        as5600Encoders = new As5600Encoder[numEncoders];
+        pcntEncoders = new PcntEncoder*[numEncoders]();
 
         USBSerial.printf("Encoder Handler initialized with %d encoders\n", numEncoders);
     }
@@ -65,11 +70,24 @@ void EncoderHandler::cleanup() {
         as5600Encoders = nullptr;
     }
 
+    if (pcntEncoders) {
+        for (uint8_t i = 0; i < numEncoders; i++) {
+            delete pcntEncoders[i];
+        }
+        delete[] pcntEncoders;
+        pcntEncoders = nullptr;
+    }
+
     // Free configuration array
     if (encoderConfigs) {
         delete[] encoderConfigs;
         encoderConfigs = nullptr;
     }
+
+    if (actions) {
+        delete[] actions;
+        actions = nullptr;
+    }
 }
 
 void EncoderHandler::configureEncoder(
@@ -90,82 +108,56 @@ void EncoderHandler::configureEncoder(
     config.zeroPosition = zeroPosition;
 }
 
-void EncoderHandler::loadEncoderActions(const std::map<String, ActionConfig>& actions) {
-    // Clear existing encoder actions
-    encoderActions.clear();
-    
-    // Process each action configuration
-    for (const auto& pair : actions) {
-        const String& id = pair.first;
-        const ActionConfig& config = pair.second;
-        
-        // Process only encoder components
-        if (id.startsWith("encoder-")) {
-            EncoderAction action;
-            action.type = config.type;
-            
-            if (config.type == "hid") {
-                // For HID type
-                action.cwHidReport.resize(HID_KEYBOARD_REPORT_SIZE, 0);
-                action.ccwHidReport.resize(HID_KEYBOARD_REPORT_SIZE, 0);
-                
-                // Load clockwise action
-                if (!config.clockwise.empty()) {
-                    uint8_t report[HID_KEYBOARD_REPORT_SIZE] = {0};
-                    if (HIDHandler::hexReportToBinary(config.clockwise, report, HID_KEYBOARD_REPORT_SIZE)) {
-                        for (int i = 0; i < HID_KEYBOARD_REPORT_SIZE; i++) {
-                            action.cwHidReport[i] = report[i];
-                        }
-                    }
-                }
-                
-                // Load counterclockwise action
-                if (!config.counterclockwise.empty()) {
-                    uint8_t report[HID_KEYBOARD_REPORT_SIZE] = {0};
-                    if (HIDHandler::hexReportToBinary(config.counterclockwise, report, HID_KEYBOARD_REPORT_SIZE)) {
-                        for (int i = 0; i < HID_KEYBOARD_REPORT_SIZE; i++) {
-                            action.ccwHidReport[i] = report[i];
-                        }
-                    }
-                }
-            }
-            else if (config.type == "multimedia") {
-                // For multimedia type
-                action.cwConsumerReport.resize(HID_CONSUMER_REPORT_SIZE, 0);
-                action.ccwConsumerReport.resize(HID_CONSUMER_REPORT_SIZE, 0);
-                
-                // Load clockwise action
-                if (!config.clockwise.empty()) {
-                    uint8_t report[HID_CONSUMER_REPORT_SIZE] = {0};
-                    if (HIDHandler::hexReportToBinary(config.clockwise, report, HID_CONSUMER_REPORT_SIZE)) {
-                        for (int i = 0; i < HID_CONSUMER_REPORT_SIZE; i++) {
-                            action.cwConsumerReport[i] = report[i];
-                        }
-                    }
-                }
-                
-                // Load counterclockwise action
-                if (!config.counterclockwise.empty()) {
-                    uint8_t report[HID_CONSUMER_REPORT_SIZE] = {0};
-                    if (HIDHandler::hexReportToBinary(config.counterclockwise, report, HID_CONSUMER_REPORT_SIZE)) {
-                        for (int i = 0; i < HID_CONSUMER_REPORT_SIZE; i++) {
-                            action.ccwConsumerReport[i] = report[i];
-                        }
-                    }
-                }
-            }
-            
-            // Store the action for this encoder ID
-            encoderActions[id] = action;
-            
-            USBSerial.printf("Loaded actions for %s, type: %s\n", id.c_str(), action.type.c_str());
-        }
-    }
-    
-    USBSerial.printf("Loaded actions for %d encoders\n", encoderActions.size());
+void EncoderHandler::configureQuadrature(uint8_t encoderIndex, uint8_t countsPerDetent, uint16_t glitchFilterNs) {
+    if (encoderIndex >= numEncoders) return;
+
+    EncoderConfig& config = encoderConfigs[encoderIndex];
+    config.countsPerDetent = countsPerDetent ? countsPerDetent : 1;
+    config.glitchFilterNs = glitchFilterNs;
+}
+
+void EncoderHandler::configureAS5600(uint8_t encoderIndex, const As5600Config& as5600, uint16_t stepsPerRevolution) {
+    if (encoderIndex >= numEncoders) return;
+
+    EncoderConfig& config = encoderConfigs[encoderIndex];
+    config.as5600 = as5600;
+    if (stepsPerRevolution == 0 || stepsPerRevolution > AS5600_COUNTS) stepsPerRevolution = AS5600_COUNTS;
+    config.countsPerDetent = AS5600_COUNTS / stepsPerRevolution;
 }
 
+// Compiles the clockwise and counterclockwise action of each "encoder-N"
+// entry through the key handler, which resolves usages, macros and layers
+void EncoderHandler::loadEncoderActions(const std::map<String, ActionConfig>& actionConfigs) {
+    if (!actions) return;
+    if (!keyHandler) {
+        USBSerial.println("ERROR: Key Handler not available for encoder actions");
+        return;
+    }
+
+    uint8_t loaded = 0;
+    for (uint8_t i = 0; i < numEncoders; i++) {
+        actions[i] = EncoderAction();
 
+        String id = "encoder-" + String(i + 1);
+        auto it = actionConfigs.find(id);
+        if (it == actionConfigs.end()) continue;
+
+        keyHandler->compileEncoderAction(id, it->second, true, actions[i].clockwise);
+        keyHandler->compileEncoderAction(id, it->second, false, actions[i].counterclockwise);
+        USBSerial.printf("Loaded actions for %s, type: %s\n", id.c_str(), it->second.type.c_str());
+        loaded++;
+    }
+
+    USBSerial.printf("Loaded actions for %d encoders\n", loaded);
+}
+
+void EncoderHandler::applySettings(const ModuleSettings& settings) {
+    acceleration = settings.encoderAcceleration;
+    if (acceleration.enabled) {
+        USBSerial.printf("Encoder acceleration: %d-%d detents/s, up to %dx\n",
+                      acceleration.startSpeed, acceleration.fullSpeed, acceleration.maxMultiplier);
+    }
+}
 
 void EncoderHandler::begin() {
     if (!encoderConfigs) {
@@ -187,17 +179,29 @@ void EncoderHandler::begin() {
                 break;
 
             case ENCODER_TYPE_AS5600:
-                // Initialize I2C for AS5600
-                Wire.begin(config.pinA, config.pinB); // SDA, SCL
-                as5600Encoders[i].begin();
-                
-                // Optional: Check magnet detection
-                if (!as5600Encoders[i].detectMagnet()) {
+                // All AS5600s share one bus (SDA, SCL), started by the first.
+                // They answer on the same address, so more than one needs a
+                // multiplexer channel each.
+                if (!i2cBus.begin(config.pinA, config.pinB, config.as5600.i2cFrequency)) {
+                    USBSerial.printf("No I2C bus for AS5600 encoder %d\n", i);
+                } else if (!as5600Encoders[i].begin(&i2cBus, config.as5600)) {
+                    USBSerial.printf("AS5600 encoder %d not found\n", i);
+                } else if (!as5600Encoders[i].isMagnetDetected()) {
                     USBSerial.printf("No magnet detected for encoder %d\n", i);
                 }
-                
-                // Configure initial state
-                config.lastRawPosition = as5600Encoders[i].rawAngle();
+                break;
+
+            case ENCODER_TYPE_PCNT:
+                if (config.pinA > 0 && config.pinB > 0) {
+                    pcntEncoders[i] = new PcntEncoder();
+                    if (!pcntEncoders[i]->begin(config.pinA, config.pinB, config.glitchFilterNs)) {
+                        // Out of PCNT units, fall back to polling
+                        delete pcntEncoders[i];
+                        pcntEncoders[i] = nullptr;
+                        config.type = ENCODER_TYPE_MECHANICAL;
+                        mechanicalEncoders[i] = new Encoder(config.pinA, config.pinB);
+                    }
+                }
                 break;
 
             default:
@@ -221,8 +225,8 @@ long EncoderHandler::getEncoderPosition(uint8_t encoderIndex) const {
 long EncoderHandler::getEncoderChange(uint8_t encoderIndex) const {
     if (encoderIndex >= numEncoders) return 0;
     
-    const EncoderConfig& config = encoderConfigs[encoderIndex];
-    return config.absolutePosition - config.lastReportedPosition;
+    // Rotation not yet dispatched
+    return encoderConfigs[encoderIndex].pendingSteps;
 }
 
 EncoderType EncoderHandler::getEncoderType(uint8_t encoderIndex) const {
@@ -239,10 +243,18 @@ void EncoderHandler::printEncoderStates() {
         if (config.type == ENCODER_TYPE_MECHANICAL) {
             USBSerial.print("Mechanical, ");
         } else if (config.type == ENCODER_TYPE_AS5600) {
-            USBSerial.print("AS5600, ");
+            const As5600Encoder& sensor = as5600Encoders[i];
+            USBSerial.printf("AS5600 (%d counts/step, fine %ld, raw %u, %s, %u errors, %u us/sample), ",
+                          config.countsPerDetent, (long)config.finePosition, sensor.getRawAngle(),
+                          !sensor.isConnected() ? "disconnected" : sensor.isMagnetDetected() ? "magnet" : "no magnet",
+                          sensor.getErrorCount(), sensor.getAvgSampleUs());
+        } else if (config.type == ENCODER_TYPE_PCNT) {
+            USBSerial.printf("PCNT (%d counts/detent), ", config.countsPerDetent);
         }
         
-        USBSerial.printf("Position: %ld\n", config.absolutePosition);
+        USBSerial.printf("Position: %ld, pending: %ld (max %ld), dispatched: %u, dropped: %u, speed: %u/s\n",
+                      config.absolutePosition, (long)config.pendingSteps, (long)config.maxPendingSteps,
+                      config.dispatchedSteps, config.droppedSteps, config.speed >> 8);
     }
     USBSerial.println("----------------------------\n");
 }
@@ -258,158 +270,177 @@ void EncoderHandler::diagnostics() {
     }
 }
 
-// Modify the executeEncoderAction function in EncoderHandler.cpp
-// to invert the clockwise parameter
+// Runs one step's action. Press and release are queued back to back, the
+// HID queue delivers them in consecutive frames. False when the step has to
+// wait for the next poll.
+bool EncoderHandler::executeEncoderAction(uint8_t encoderIndex, bool clockwise) {
+    const KeyConfig& action = clockwise ? actions[encoderIndex].clockwise : actions[encoderIndex].counterclockwise;
+    switch (action.type) {
+        case ACTION_HID:
+            hidHandler->pressKeyboardReport(action.hidReport);
+            hidHandler->flushKeyboardReport();
+            hidHandler->releaseKeyboardReport(action.hidReport);
+            hidHandler->flushKeyboardReport();
+            return true;
+
+        case ACTION_MULTIMEDIA:
+        case ACTION_SYSTEM: {
+            static const uint8_t released[HID_USAGE_REPORT_SIZE] = {0};
+            HIDReportType type = action.type == ACTION_SYSTEM ? HID_REPORT_SYSTEM : HID_REPORT_CONSUMER;
+            hidHandler->sendUsageReport(type, action.usageReport);
+            hidHandler->sendUsageReport(type, released);
+            return true;
+        }
 
-void EncoderHandler::executeEncoderAction(uint8_t encoderIndex, bool clockwise) {
-    if (!hidHandler) {
-        USBSerial.println("ERROR: HID Handler not available");
-        return;
-    }
+        case ACTION_MOUSE:
+            mouseEngine.nudge((MouseAction)action.mouseAction);
+            return true;
 
-    // Reduce the delay from 500ms to 50ms
-    delay(50);
-    
-    // Predefined volume control reports
-    const uint8_t volumeUp[4] = {0x00, 0x00, 0xE9, 0x00};
-    const uint8_t volumeDown[4] = {0x00, 0x00, 0xEA, 0x00};
-    const uint8_t emptyReport[4] = {0x00, 0x00, 0x00, 0x00};
-    
-    // INVERT the direction by toggling the clockwise parameter
-    bool actualDirection = !clockwise;  // Invert the direction
-    
-    // Select report based on INVERTED rotation direction
-    const uint8_t* report = actualDirection ? volumeUp : volumeDown;
-    const char* actionName = actualDirection ? "Volume UP" : "Volume DOWN";
-    
-    USBSerial.printf("Encoder %d Action: %s\n", encoderIndex, actionName);
-    
-    // Send consumer report with multiple error checks
-    bool reportSent = false;
-    for (int attempts = 0; attempts < 3; attempts++) {
-        if (hidHandler->sendConsumerReport(report, 4)) {
-            reportSent = true;
-            break;
-        }
-        delay(10);  // Short delay between attempts
-    }
-    
-    if (!reportSent) {
-        USBSerial.printf("FAILED to send %s command\n", actionName);
-        return;
+        case ACTION_MACRO:
+            // Steps while the macro is still playing are skipped
+            macroEngine.play(action.macroIndex);
+            return true;
+
+        case ACTION_LAYER:
+            return keyHandler && keyHandler->queueLayerStep(action);
+
+        default:
+            // Nothing configured for this direction
+            return true;
     }
-    
-    // Reduce delay from 600ms to 100ms
-    delay(100);
-    
-    // Release key
-    for (int attempts = 0; attempts < 3; attempts++) {
-        if (hidHandler->sendConsumerReport(emptyReport, 4)) {
-            break;
+}
+
+// Dispatches pending steps one at a time, round robin across encoders, for
+// as long as the HID queue has room. Whatever is left waits for the next poll.
+void EncoderHandler::dispatchSteps() {
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (uint8_t i = 0; i < numEncoders; i++) {
+            EncoderConfig& config = encoderConfigs[i];
+            if (!config.pendingSteps) continue;
+
+            bool clockwise = config.pendingSteps > 0;
+            ActionType type = clockwise ? actions[i].clockwise.type : actions[i].counterclockwise.type;
+            if (type != ACTION_LAYER) {
+                if (!hidHandler || !hidHandler->isMounted()) {
+                    // Host not listening, stale rotation must not replay later
+                    config.droppedSteps += abs(config.pendingSteps);
+                    config.pendingSteps = 0;
+                    continue;
+                }
+                if (hidHandler->getQueueBacklog() + 2 > ENCODER_QUEUE_LIMIT) return;
+            }
+
+            if (!executeEncoderAction(i, clockwise)) continue;
+            config.pendingSteps += clockwise ? -1 : 1;
+            config.dispatchedSteps++;
+            progress = true;
         }
-        delay(10);
     }
 }
 
+// Q8 steps per detent at a speed: one up to startSpeed, rising linearly to
+// maxMultiplier at fullSpeed
+uint32_t EncoderHandler::accelMultiplier(uint32_t speed) const {
+    uint32_t start = (uint32_t)acceleration.startSpeed << 8;
+    uint32_t full = (uint32_t)acceleration.fullSpeed << 8;
+    uint32_t most = (uint32_t)acceleration.maxMultiplier << 8;
+    if (speed <= start || most <= 256) return 256;
+    if (speed >= full) return most;
+    return 256 + (uint32_t)((uint64_t)(most - 256) * (speed - start) / (full - start));
+}
 
-// Improved AS5600 encoder handling with better noise filtering
-void EncoderHandler::handleAS5600Encoder(uint8_t encoderIndex) {
-    EncoderConfig& config = encoderConfigs[encoderIndex];
-    
-    // Enhanced robustness for magnetic encoder
-    static const uint16_t MAX_POSITION = 4096; // 12-bit encoder
-    static const int MAX_STEPS_PER_CYCLE = 50;  // Limit sudden movements
-    static const int MIN_STEPS_THRESHOLD = 3;  // Minimum steps to consider a movement
-    
-    // Check sensor connectivity
-    if (!as5600Encoders[encoderIndex].isConnected()) {
-        USBSerial.printf("Warning: AS5600 encoder %d disconnected\n", encoderIndex);
-        return;
-    }
-    
-    // Get current raw position with multiple readings for stability
-    uint16_t readings[3];
-    for (int i = 0; i < 3; i++) {
-        readings[i] = as5600Encoders[encoderIndex].rawAngle();
-        delayMicroseconds(200); // Short delay between readings
-    }
-    
-    // Calculate median value to filter outliers
-    uint16_t currentRawPosition;
-    
-    // Simple median calculation
-    if ((readings[0] <= readings[1] && readings[1] <= readings[2]) || 
-        (readings[2] <= readings[1] && readings[1] <= readings[0])) {
-        currentRawPosition = readings[1]; // Middle value is median
-    } else if ((readings[1] <= readings[0] && readings[0] <= readings[2]) || 
-               (readings[2] <= readings[0] && readings[0] <= readings[1])) {
-        currentRawPosition = readings[0]; // First value is median
+// Steps for the detents moved since the last poll. The speed is a running
+// average of detents per second, restarted after a pause or a reversal, and
+// the fraction of a step left over carries into the next movement.
+int32_t EncoderHandler::accelerate(EncoderConfig& config, long moved) {
+    if (!acceleration.enabled) return moved;
+
+    uint32_t now = micros();
+    int8_t direction = moved > 0 ? 1 : -1;
+    uint32_t detents = abs(moved);
+    uint32_t elapsed = now - config.lastMoveUs;
+
+    if (direction != config.lastDirection || elapsed > ENCODER_ACCEL_TIMEOUT_US) {
+        config.speed = 0;
+        config.stepCarry = 0;
     } else {
-        currentRawPosition = readings[2]; // Last value is median
+        uint64_t instant = ((uint64_t)detents << 8) * 1000000 / (elapsed ? elapsed : 1);
+        if (instant > ENCODER_MAX_SPEED_Q8) instant = ENCODER_MAX_SPEED_Q8;
+        config.speed = (config.speed * 3 + (uint32_t)instant) / 4;
     }
-    
-    // First-time initialization
-    if (config.lastRawPosition == 0) {
-        config.lastRawPosition = currentRawPosition;
-        return;
+    config.lastMoveUs = now;
+    config.lastDirection = direction;
+
+    uint32_t scaled = detents * accelMultiplier(config.speed) + config.stepCarry;
+    config.stepCarry = scaled & 0xFF;
+    return direction * (int32_t)(scaled >> 8);
+}
+
+bool EncoderHandler::hasPendingSteps() const {
+    if (!encoderConfigs) return false;
+    for (uint8_t i = 0; i < numEncoders; i++) {
+        if (encoderConfigs[i].pendingSteps) return true;
     }
-    
-    // Calculate position difference with wrap-around handling
-    int16_t rawDiff;
-    if (currentRawPosition >= config.lastRawPosition) {
-        rawDiff = currentRawPosition - config.lastRawPosition;
-        if (rawDiff > MAX_POSITION / 2) {
-            rawDiff -= MAX_POSITION;
-        }
-    } else {
-        rawDiff = -(config.lastRawPosition - currentRawPosition);
-        if (-rawDiff > MAX_POSITION / 2) {
-            rawDiff += MAX_POSITION;
+    return false;
+}
+
+
+// Magnetic encoder, one short I2C read per poll through the chip's filter
+// and the configured AngleFilter
+void EncoderHandler::handleAS5600Encoder(uint8_t encoderIndex) {
+    As5600Encoder& sensor = as5600Encoders[encoderIndex];
+    bool wasConnected = sensor.isConnected();
+    if (!sensor.update()) {
+        if (wasConnected) {
+            USBSerial.printf("Warning: AS5600 encoder %d disconnected\n", encoderIndex);
         }
-    }
-    
-    // Sanity check movement
-    if (abs(rawDiff) > MAX_STEPS_PER_CYCLE) {
-        USBSerial.printf("Warning: Excessive movement on AS5600 encoder %d\n", encoderIndex);
         return;
     }
-    
-    // Only update position if movement exceeds the threshold
-    if (abs(rawDiff) >= MIN_STEPS_THRESHOLD) {
-        // Update position with direction
-        config.absolutePosition += rawDiff * config.direction;
-        config.lastRawPosition = currentRawPosition;
-        
-        USBSerial.printf("AS5600 Encoder %d: Raw Diff = %d, Total Position = %ld\n", 
-                      encoderIndex, rawDiff, config.absolutePosition);
+
+    EncoderConfig& config = encoderConfigs[encoderIndex];
+    config.finePosition = sensor.getPosition() * config.direction;
+    long detents = EncoderMath::hysteresisDetent(config.absolutePosition, config.finePosition, config.countsPerDetent);
+
+    if (detents != config.absolutePosition) {
+#if ENCODER_EVENT_LOG
+        USBSerial.printf("AS5600 Encoder %d: Position Change = %ld, Total Position = %ld\n",
+                      encoderIndex, detents - config.absolutePosition, detents);
+#endif
+        config.absolutePosition = detents;
+    }
+}
+
+// Hardware-counted encoder, every count is kept
+void EncoderHandler::handlePcntEncoder(uint8_t encoderIndex) {
+    if (!pcntEncoders[encoderIndex]) return;
+
+    EncoderConfig& config = encoderConfigs[encoderIndex];
+    long detents = EncoderMath::nearestDetent(pcntEncoders[encoderIndex]->read() * config.direction, config.countsPerDetent);
+
+    if (detents != config.absolutePosition) {
+#if ENCODER_EVENT_LOG
+        USBSerial.printf("PCNT Encoder %d: Position Change = %ld, Total Position = %ld\n",
+                      encoderIndex, detents - config.absolutePosition, detents);
+#endif
+        config.absolutePosition = detents;
     }
 }
 
-// Improved mechanical encoder handling
+// Polled mechanical encoder, the Encoder library counts every edge
 void EncoderHandler::handleMechanicalEncoder(uint8_t encoderIndex) {
     if (!mechanicalEncoders[encoderIndex]) return;
 
     EncoderConfig& config = encoderConfigs[encoderIndex];
-    
-    // Read current position
-    long currentPosition = mechanicalEncoders[encoderIndex]->read();
-    
-    // For mechanical encoders, often they trigger multiple steps at once
-    // Use a minimum change threshold of 2 steps for better reliability
-    static const int MECHANICAL_CHANGE_THRESHOLD = 2;
-    
-    // Calculate the raw change (use absolutePosition as reference)
-    // This avoids adding a new struct member
-    long newAbsolutePosition = currentPosition * config.direction;
-    long positionChange = newAbsolutePosition - config.absolutePosition;
-    
-    // Only register a movement if it exceeds our threshold
-    if (abs(positionChange) >= MECHANICAL_CHANGE_THRESHOLD) {
-        // Update the absolute position
-        config.absolutePosition = newAbsolutePosition;
-        
+    long detents = EncoderMath::nearestDetent(mechanicalEncoders[encoderIndex]->read() * config.direction, config.countsPerDetent);
+
+    if (detents != config.absolutePosition) {
+#if ENCODER_EVENT_LOG
         USBSerial.printf("Mechanical Encoder %d: Position Change = %ld, Total Position = %ld\n", 
-                      encoderIndex, positionChange, config.absolutePosition);
+                      encoderIndex, detents - config.absolutePosition, detents);
+#endif
+        config.absolutePosition = detents;
     }
 }
 
@@ -417,39 +448,35 @@ void EncoderHandler::handleMechanicalEncoder(uint8_t encoderIndex) {
 void EncoderHandler::updateEncoders() {
     if (!encoderConfigs) return;
 
-    // Static variables to track previous positions and debounce encoders
-    static long prevPositions[MAX_ENCODERS] = {0};
-    static unsigned long lastActionTime[MAX_ENCODERS] = {0};
-    const unsigned long ENCODER_DEBOUNCE_TIME = 150; // 150ms debounce time
-    unsigned long currentTime = millis();
-
     for (uint8_t i = 0; i < numEncoders; i++) {
+        EncoderConfig& config = encoderConfigs[i];
+
         // Update encoder position based on type
-        if (encoderConfigs[i].type == ENCODER_TYPE_MECHANICAL) {
+        if (config.type == ENCODER_TYPE_MECHANICAL) {
             handleMechanicalEncoder(i);
-        } else if (encoderConfigs[i].type == ENCODER_TYPE_AS5600) {
+        } else if (config.type == ENCODER_TYPE_AS5600) {
             handleAS5600Encoder(i);
+        } else if (config.type == ENCODER_TYPE_PCNT) {
+            handlePcntEncoder(i);
         }
         
-        // Get current position
-        long currentPosition = encoderConfigs[i].absolutePosition;
-        
-        // Detect meaningful position change with debouncing
-        if (currentPosition != prevPositions[i] && 
-            (currentTime - lastActionTime[i] > ENCODER_DEBOUNCE_TIME)) {
-            
-            // Determine rotation direction
-            bool clockwise = (currentPosition > prevPositions[i]);
-            
-            USBSerial.printf("Encoder %d rotated %s (position: %ld)\n", 
-                          i, clockwise ? "clockwise" : "counterclockwise", currentPosition);
-            
-            // Send HID report for rotation
-            executeEncoderAction(i, clockwise);
-            
-            // Update previous position and action time
-            prevPositions[i] = currentPosition;
-            lastActionTime[i] = currentTime;
+        // Every detent since the last poll joins the signed backlog, scaled
+        // by the acceleration curve
+        long moved = config.absolutePosition - config.lastReportedPosition;
+        if (moved) {
+            config.lastReportedPosition = config.absolutePosition;
+            int32_t steps = accelerate(config, moved);
+            config.pendingSteps += steps;
+            if (abs(config.pendingSteps) > config.maxPendingSteps) {
+                config.maxPendingSteps = abs(config.pendingSteps);
+            }
+#if ENCODER_EVENT_LOG
+            USBSerial.printf("Encoder %d rotated %ld detents %s, %ld steps (position: %ld)\n", 
+                          i, abs(moved), moved > 0 ? "clockwise" : "counterclockwise",
+                          (long)abs(steps), config.absolutePosition);
+#endif
         }
     }
-}
\ No newline at end of file
+
+    dispatchSteps();
+}
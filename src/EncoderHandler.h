@@ -3,11 +3,13 @@
 
 #include <Arduino.h>
 #include <Wire.h>
-#include <AS5600.h>
 #include <Encoder.h>
 #include <map>
 #include <vector>
 #include "ConfigManager.h"
+#include "KeyActions.h"
+#include "PcntEncoder.h"
+#include "As5600Encoder.h"
 
 // Forward declaration:
 class EncoderHandler;
@@ -16,11 +18,26 @@ extern EncoderHandler* encoderHandler;
 
 // Maximum number of encoders supported
 #define MAX_ENCODERS 6
+// Steps are only dispatched while fewer HID reports than this are waiting,
+// leaving the rest of the transmit queue to keys and macros
+#define ENCODER_QUEUE_LIMIT 8
+// Rotation after a pause this long, or a reversal, restarts acceleration
+#define ENCODER_ACCEL_TIMEOUT_US 200000
+// Speed estimate cap, 10000 detents per second in Q8
+#define ENCODER_MAX_SPEED_Q8 (10000UL << 8)
+
+// Logs every detent. A blocked CDC write would stall the encoder task, so the
+// prints are off unless built with -DENCODER_EVENT_LOG=1; printEncoderStates()
+// shows positions and backlogs on demand
+#ifndef ENCODER_EVENT_LOG
+#define ENCODER_EVENT_LOG 0
+#endif
 
 // Encoder Types
 enum EncoderType {
     ENCODER_TYPE_MECHANICAL,  // Standard rotary encoder
-    ENCODER_TYPE_AS5600       // Magnetic encoder
+    ENCODER_TYPE_AS5600,      // Magnetic encoder
+    ENCODER_TYPE_PCNT         // Rotary encoder decoded by the PCNT peripheral
 };
 
 // Configuration for each encoder
@@ -33,26 +50,35 @@ struct EncoderConfig {
     
     // AS5600 specific configuration
     uint16_t zeroPosition = 0;  // Calibration zero point
-    uint16_t steps = 4096;      // Total steps for AS5600 (12-bit)
+    As5600Config as5600;
     int8_t direction = 1;       // 1 or -1 to invert rotation
     
+    // Quadrature edges per detent, or AS5600 counts per step
+    uint16_t countsPerDetent = 4;
+    uint16_t glitchFilterNs = PCNT_DEFAULT_FILTER_NS;  // PCNT only
+    
     // Detailed tracking
-    long absolutePosition = 0;
+    long absolutePosition = 0;     // Detents
     long lastReportedPosition = 0;
-    uint16_t lastRawPosition = 0;
+    int32_t finePosition = 0;      // AS5600 filtered counts
+    
+    // Acceleration state
+    uint32_t lastMoveUs = 0;
+    int8_t lastDirection = 0;
+    uint32_t speed = 0;            // Detents per second, Q8 running average
+    uint8_t stepCarry = 0;         // Fraction of a step left over, Q8
+    
+    // Steps not yet dispatched, positive clockwise
+    int32_t pendingSteps = 0;
+    int32_t maxPendingSteps = 0;   // Largest backlog, either direction
+    uint32_t dispatchedSteps = 0;
+    uint32_t droppedSteps = 0;     // Lost while the host was not mounted
 };
 
-// Structure to store encoder actions from configuration
+// Compiled rotation actions of one encoder, each runs once per step
 struct EncoderAction {
-    String type;  // "hid" or "multimedia"
-    
-    // HID keyboard reports
-    std::vector<uint8_t> cwHidReport;     // Clockwise HID report
-    std::vector<uint8_t> ccwHidReport;    // Counter-clockwise HID report
-    
-    // Consumer reports
-    std::vector<uint8_t> cwConsumerReport;   // Clockwise consumer report
-    std::vector<uint8_t> ccwConsumerReport;  // Counter-clockwise consumer report
+    KeyConfig clockwise;
+    KeyConfig counterclockwise;
 };
 
 class EncoderHandler {
@@ -61,7 +87,12 @@ public:
     ~EncoderHandler();
 
     void begin();
+    // defaults.encoder.acceleration
+    void applySettings(const ModuleSettings& settings);
     void updateEncoders();
+    // True while steps are waiting for the HID queue, the encoder task
+    // then polls faster to drain them
+    bool hasPendingSteps() const;
     
     // Getter methods for encoder information
     long getEncoderPosition(uint8_t encoderIndex) const;
@@ -77,6 +108,10 @@ public:
         int8_t direction = 1, 
         uint16_t zeroPosition = 0
     );
+    // Mechanical and PCNT encoders, the filter only applies to PCNT
+    void configureQuadrature(uint8_t encoderIndex, uint8_t countsPerDetent, uint16_t glitchFilterNs);
+    // AS5600 encoders, stepsPerRevolution of the 4096 counts per turn
+    void configureAS5600(uint8_t encoderIndex, const As5600Config& as5600, uint16_t stepsPerRevolution);
     
     void loadEncoderActions(const std::map<String, ActionConfig>& actions);
     
@@ -88,15 +123,22 @@ private:
     void cleanup();
     void handleMechanicalEncoder(uint8_t encoderIndex);
     void handleAS5600Encoder(uint8_t encoderIndex);
-    void executeEncoderAction(uint8_t encoderIndex, bool clockwise);
+    void handlePcntEncoder(uint8_t encoderIndex);
+    bool executeEncoderAction(uint8_t encoderIndex, bool clockwise);
+    void dispatchSteps();
+    int32_t accelerate(EncoderConfig& config, long moved);
+    uint32_t accelMultiplier(uint32_t speed) const;
 
     // Encoder tracking variables
     uint8_t numEncoders;
     Encoder** mechanicalEncoders;
-    AS5600* as5600Encoders;
+    As5600Encoder* as5600Encoders;
+    PcntEncoder** pcntEncoders;
 
     // Configuration for each encoder
     EncoderConfig* encoderConfigs;
+    EncoderAction* actions;
+    EncoderAccelConfig acceleration;
 };
 
 extern EncoderHandler* encoderHandler;
@@ -0,0 +1,30 @@
+// EncoderMath.cpp
+#include "EncoderMath.h"
+
+int32_t EncoderMath::unwrapDelta(int32_t current, int32_t last, int32_t range) {
+    int32_t delta = current - last;
+    if (delta > range / 2) {
+        delta -= range;
+    } else if (delta < -(range / 2)) {
+        delta += range;
+    }
+    return delta;
+}
+
+// Floor division keeps the detents the same size on both sides of zero
+long EncoderMath::nearestDetent(int32_t counts, uint16_t countsPerDetent) {
+    int32_t shifted = counts + countsPerDetent / 2;
+    return shifted >= 0 ? shifted / countsPerDetent
+                        : -((-shifted + countsPerDetent - 1) / countsPerDetent);
+}
+
+// The step only changes once the position is a quarter step past the edge,
+// so a knob left on the edge does not flip back and forth
+long EncoderMath::hysteresisDetent(long current, int32_t counts, uint16_t countsPerDetent) {
+    int32_t margin = countsPerDetent / 2 + countsPerDetent / 4;
+    int32_t center = current * countsPerDetent;
+    if (counts > center + margin || counts < center - margin) {
+        return nearestDetent(counts, countsPerDetent);
+    }
+    return current;
+}
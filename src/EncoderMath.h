@@ -0,0 +1,23 @@
+// EncoderMath.h
+
+#ifndef ENCODER_MATH_H
+#define ENCODER_MATH_H
+
+#include <stdint.h>
+
+// Position arithmetic shared by the encoder backends
+class EncoderMath {
+public:
+    // Change from last to current of a counter that wraps modulo range, the
+    // shortest way round. Exact while the counter moves less than half the
+    // range between reads.
+    static int32_t unwrapDelta(int32_t current, int32_t last, int32_t range);
+
+    // Nearest detent to a quadrature count, so contact chatter around a
+    // resting detent never moves the position
+    static long nearestDetent(int32_t counts, uint16_t countsPerDetent);
+    // Detent with hysteresis for encoders without a physical detent
+    static long hysteresisDetent(long current, int32_t counts, uint16_t countsPerDetent);
+};
+
+#endif // ENCODER_MATH_H
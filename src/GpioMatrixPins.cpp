@@ -0,0 +1,57 @@
+// GpioMatrixPins.cpp
+
+#include "GpioMatrixPins.h"
+
+GpioMatrixPins::GpioMatrixPins(const uint8_t* rows, uint8_t rowCount, const uint8_t* cols, uint8_t colCount)
+    : numRows(rowCount), numCols(colCount), colHighBank(0), rowHighBank(0)
+{
+    rowPins = new uint8_t[numRows];
+    colPins = new uint8_t[numCols];
+    colInputShift = new uint8_t[numCols];
+    rowBit = new uint32_t[numRows];
+    memcpy(rowPins, rows, numRows);
+    memcpy(colPins, cols, numCols);
+
+    // Where each column sits in the GPIO input registers, so a whole row
+    // can be sampled with one or two register reads
+    for (uint8_t c = 0; c < numCols; c++) {
+        colInputShift[c] = colPins[c] & 31;
+        if (colPins[c] >= 32) {
+            colHighBank |= (1 << c);
+        }
+    }
+
+    // Same for the output registers, so a row is driven with one write
+    rowBankMask[0] = 0;
+    rowBankMask[1] = 0;
+    for (uint8_t r = 0; r < numRows; r++) {
+        uint8_t bank = rowPins[r] >= 32 ? 1 : 0;
+        rowBit[r] = 1UL << (rowPins[r] & 31);
+        rowBankMask[bank] |= rowBit[r];
+        if (bank) {
+            rowHighBank |= (1 << r);
+        }
+    }
+}
+
+GpioMatrixPins::~GpioMatrixPins() {
+    delete[] rowPins;
+    delete[] colPins;
+    delete[] colInputShift;
+    delete[] rowBit;
+}
+
+bool GpioMatrixPins::isUsablePin(uint8_t pin) {
+    return pin <= 21 || (pin >= 33 && pin <= 48);
+}
+
+uint16_t GpioMatrixPins::packColumns(uint32_t bankLow, uint32_t bankHigh) const {
+    uint16_t released = 0;
+    for (uint8_t c = 0; c < numCols; c++) {
+        uint32_t bank = (colHighBank & (1 << c)) ? bankHigh : bankLow;
+        released |= ((bank >> colInputShift[c]) & 1) << c;
+    }
+
+    // Columns idle HIGH through their pull-ups, so a pressed key reads 0
+    return ~released & ((1 << numCols) - 1);
+}
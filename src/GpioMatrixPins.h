@@ -0,0 +1,52 @@
+// GpioMatrixPins.h
+
+#ifndef GPIO_MATRIX_PINS_H
+#define GPIO_MATRIX_PINS_H
+
+#include <Arduino.h>
+
+// Register masks of a GPIO key matrix, worked out once from the pin lists.
+// GPIO0-31 sit in bank 0 of the output and input registers, GPIO32+ in
+// bank 1, so a row is driven with one W1TC/W1TS write and every column is
+// sampled with one read per bank.
+class GpioMatrixPins {
+public:
+    GpioMatrixPins(const uint8_t* rowPins, uint8_t rows, const uint8_t* colPins, uint8_t cols);
+    ~GpioMatrixPins();
+
+    // GPIO that exists on the ESP32-S3 and is free on this module: 0-21 and
+    // 33-48. GPIO22-25 do not exist, GPIO26-32 are the flash and PSRAM bus
+    // of the N4R2 (quad PSRAM leaves GPIO33-37 free).
+    static bool isUsablePin(uint8_t pin);
+
+    const uint8_t* getRowPins() const { return rowPins; }
+    const uint8_t* getColPins() const { return colPins; }
+
+    // Output register bank (0 or 1) and bit of a row
+    uint8_t getRowBank(uint8_t row) const { return (rowHighBank >> row) & 1; }
+    uint32_t getRowBit(uint8_t row) const { return rowBit[row]; }
+    // Every row in one output bank
+    uint32_t getRowBankMask(uint8_t bank) const { return rowBankMask[bank]; }
+    // The upper input register only needs reading when a column is in it
+    bool hasHighBankColumns() const { return colHighBank != 0; }
+
+    // Packs the input registers into a column bitmask, bit c set when
+    // column c reads LOW (key pressed)
+    uint16_t packColumns(uint32_t bankLow, uint32_t bankHigh) const;
+
+private:
+    uint8_t numRows;
+    uint8_t numCols;
+    uint8_t* rowPins;
+    uint8_t* colPins;
+    // Column pin -> bit position within its GPIO input register
+    uint8_t* colInputShift;
+    // Bit c set when column c lives in the upper (GPIO32+) input register
+    uint16_t colHighBank;
+    // Output register bit of each row, and every row per bank
+    uint32_t* rowBit;
+    uint16_t rowHighBank;
+    uint32_t rowBankMask[2];
+};
+
+#endif // GPIO_MATRIX_PINS_H
@@ -2,7 +2,13 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include "HIDHandler.h"
+#include "LatencyStats.h"
+#include "usb_descriptors.h"
+#include "HidUsageTables.h"
+#include "RawHidHandler.h"
 #include <tusb.h>  // Include the TinyUSB header
+#include <USBHID.h>
+#include <USB.h>
 
 extern USBCDC USBSerial;
 
@@ -43,43 +49,251 @@ extern USBCDC USBSerial;
 }
 #endif
 
-#ifndef TUD_HID_REPORT_DESC_CONSUMER
-#define TUD_HID_REPORT_DESC_CONSUMER() { \
+// NKRO keyboard: modifier bits followed by one bit per key usage 0x00-0xDF
+#ifndef TUD_HID_REPORT_DESC_NKRO_KEYBOARD
+#define TUD_HID_REPORT_DESC_NKRO_KEYBOARD(report_id) { \
+  0x05, 0x01,       /* Usage Page (Generic Desktop) */ \
+  0x09, 0x06,       /* Usage (Keyboard) */ \
+  0xA1, 0x01,       /* Collection (Application) */ \
+  0x85, report_id,  /*   Report ID */ \
+  0x05, 0x07,       /*   Usage Page (Key Codes) */ \
+  0x19, 0xE0,       /*   Usage Minimum (224) */ \
+  0x29, 0xE7,       /*   Usage Maximum (231) */ \
+  0x15, 0x00,       /*   Logical Minimum (0) */ \
+  0x25, 0x01,       /*   Logical Maximum (1) */ \
+  0x75, 0x01,       /*   Report Size (1) */ \
+  0x95, 0x08,       /*   Report Count (8) */ \
+  0x81, 0x02,       /*   Input (Data, Variable, Absolute) modifiers */ \
+  0x19, 0x00,       /*   Usage Minimum (0) */ \
+  0x29, 0xDF,       /*   Usage Maximum (223) */ \
+  0x95, 0xE0,       /*   Report Count (224) */ \
+  0x81, 0x02,       /*   Input (Data, Variable, Absolute) key bitmap */ \
+  0xC0              /* End Collection */ \
+}
+#endif
+
+// Consumer control: one 16-bit usage from the whole Consumer page, 0 releases
+#ifndef TUD_HID_REPORT_DESC_CONSUMER_16BIT
+#define TUD_HID_REPORT_DESC_CONSUMER_16BIT(report_id) { \
   0x05, 0x0C,       /* Usage Page (Consumer) */ \
   0x09, 0x01,       /* Usage (Consumer Control) */ \
   0xA1, 0x01,       /* Collection (Application) */ \
-  0x15, 0x00,       /* Logical Minimum (0) */ \
-  0x25, 0x01,       /* Logical Maximum (1) */ \
-  0x75, 0x01,       /* Report Size (1) */ \
-  0x95, 0x07,       /* Report Count (7) */ \
-  0x09, 0xB5,       /* Usage (Scan Next Track) */ \
-  0x09, 0xB6,       /* Usage (Scan Previous Track) */ \
-  0x09, 0xB7,       /* Usage (Stop) */ \
-  0x09, 0xB8,       /* Usage (Play/Pause) */ \
-  0x09, 0xCD,       /* Usage (Mute) */ \
-  0x09, 0xE2,       /* Usage (Volume Up) */ \
-  0x09, 0xE9,       /* Usage (Volume Down) */ \
-  0x81, 0x02,       /* Input (Data, Variable, Absolute) */ \
-  0x95, 0x01,       /* Report Count (1) */ \
-  0x75, 0x01,       /* Report Size (1) */ \
-  0x81, 0x03,       /* Input (Constant, Variable, Absolute) */ \
+  0x85, report_id,  /*   Report ID */ \
+  0x19, 0x00,       /*   Usage Minimum (0) */ \
+  0x2A, 0xFF, 0xFF, /*   Usage Maximum (0xFFFF) */ \
+  0x15, 0x00,       /*   Logical Minimum (0) */ \
+  0x27, 0xFF, 0xFF, 0x00, 0x00, /* Logical Maximum (0xFFFF) */ \
+  0x75, 0x10,       /*   Report Size (16) */ \
+  0x95, 0x01,       /*   Report Count (1) */ \
+  0x81, 0x00,       /*   Input (Data, Array, Absolute) */ \
+  0xC0              /* End Collection */ \
+}
+#endif
+
+// System control: power down, sleep and wake up as a 16-bit usage, 0 releases
+#ifndef TUD_HID_REPORT_DESC_SYSTEM_CONTROL_16BIT
+#define TUD_HID_REPORT_DESC_SYSTEM_CONTROL_16BIT(report_id) { \
+  0x05, 0x01,       /* Usage Page (Generic Desktop) */ \
+  0x09, 0x80,       /* Usage (System Control) */ \
+  0xA1, 0x01,       /* Collection (Application) */ \
+  0x85, report_id,  /*   Report ID */ \
+  0x19, 0x81,       /*   Usage Minimum (System Power Down) */ \
+  0x29, 0xB7,       /*   Usage Maximum (System Display LCD Autoscale) */ \
+  0x16, 0x81, 0x00, /*   Logical Minimum (0x81) */ \
+  0x26, 0xB7, 0x00, /*   Logical Maximum (0xB7) */ \
+  0x75, 0x10,       /*   Report Size (16) */ \
+  0x95, 0x01,       /*   Report Count (1) */ \
+  0x81, 0x00,       /*   Input (Data, Array, Absolute) */ \
+  0xC0              /* End Collection */ \
+}
+#endif
+
+// Mouse with 16-bit motion and high-resolution wheel and pan. The host enables
+// 1/120 detent scrolling by setting the Resolution Multiplier feature report.
+#ifndef TUD_HID_REPORT_DESC_HIRES_MOUSE
+#define TUD_HID_REPORT_DESC_HIRES_MOUSE(report_id) { \
+  0x05, 0x01,       /* Usage Page (Generic Desktop) */ \
+  0x09, 0x02,       /* Usage (Mouse) */ \
+  0xA1, 0x01,       /* Collection (Application) */ \
+  0x85, report_id,  /*   Report ID */ \
+  0x09, 0x01,       /*   Usage (Pointer) */ \
+  0xA1, 0x00,       /*   Collection (Physical) */ \
+  0x05, 0x09,       /*     Usage Page (Button) */ \
+  0x19, 0x01,       /*     Usage Minimum (1) */ \
+  0x29, 0x05,       /*     Usage Maximum (5) */ \
+  0x15, 0x00,       /*     Logical Minimum (0) */ \
+  0x25, 0x01,       /*     Logical Maximum (1) */ \
+  0x95, 0x05,       /*     Report Count (5) */ \
+  0x75, 0x01,       /*     Report Size (1) */ \
+  0x81, 0x02,       /*     Input (Data, Variable, Absolute) buttons */ \
+  0x95, 0x01,       /*     Report Count (1) */ \
+  0x75, 0x03,       /*     Report Size (3) */ \
+  0x81, 0x01,       /*     Input (Constant) padding */ \
+  0x05, 0x01,       /*     Usage Page (Generic Desktop) */ \
+  0x09, 0x30,       /*     Usage (X) */ \
+  0x09, 0x31,       /*     Usage (Y) */ \
+  0x16, 0x01, 0x80, /*     Logical Minimum (-32767) */ \
+  0x26, 0xFF, 0x7F, /*     Logical Maximum (32767) */ \
+  0x75, 0x10,       /*     Report Size (16) */ \
+  0x95, 0x02,       /*     Report Count (2) */ \
+  0x81, 0x06,       /*     Input (Data, Variable, Relative) X, Y */ \
+  0xA1, 0x02,       /*     Collection (Logical) */ \
+  0x09, 0x48,       /*       Usage (Resolution Multiplier) */ \
+  0x15, 0x00,       /*       Logical Minimum (0) */ \
+  0x25, 0x01,       /*       Logical Maximum (1) */ \
+  0x35, 0x01,       /*       Physical Minimum (1) */ \
+  0x45, 0x78,       /*       Physical Maximum (120) */ \
+  0x75, 0x02,       /*       Report Size (2) */ \
+  0x95, 0x01,       /*       Report Count (1) */ \
+  0xB1, 0x02,       /*       Feature (Data, Variable, Absolute) wheel multiplier */ \
+  0x35, 0x00,       /*       Physical Minimum (0) */ \
+  0x45, 0x00,       /*       Physical Maximum (0) */ \
+  0x09, 0x38,       /*       Usage (Wheel) */ \
+  0x15, 0x81,       /*       Logical Minimum (-127) */ \
+  0x25, 0x7F,       /*       Logical Maximum (127) */ \
+  0x75, 0x08,       /*       Report Size (8) */ \
+  0x81, 0x06,       /*       Input (Data, Variable, Relative) wheel */ \
+  0xC0,             /*     End Collection */ \
+  0xA1, 0x02,       /*     Collection (Logical) */ \
+  0x09, 0x48,       /*       Usage (Resolution Multiplier) */ \
+  0x15, 0x00,       /*       Logical Minimum (0) */ \
+  0x25, 0x01,       /*       Logical Maximum (1) */ \
+  0x35, 0x01,       /*       Physical Minimum (1) */ \
+  0x45, 0x78,       /*       Physical Maximum (120) */ \
+  0x75, 0x02,       /*       Report Size (2) */ \
+  0xB1, 0x02,       /*       Feature (Data, Variable, Absolute) pan multiplier */ \
+  0x75, 0x04,       /*       Report Size (4) */ \
+  0xB1, 0x01,       /*       Feature (Constant) padding */ \
+  0x35, 0x00,       /*       Physical Minimum (0) */ \
+  0x45, 0x00,       /*       Physical Maximum (0) */ \
+  0x05, 0x0C,       /*       Usage Page (Consumer) */ \
+  0x0A, 0x38, 0x02, /*       Usage (AC Pan) */ \
+  0x15, 0x81,       /*       Logical Minimum (-127) */ \
+  0x25, 0x7F,       /*       Logical Maximum (127) */ \
+  0x75, 0x08,       /*       Report Size (8) */ \
+  0x81, 0x06,       /*       Input (Data, Variable, Relative) pan */ \
+  0xC0,             /*     End Collection */ \
+  0xC0,             /*   End Collection */ \
   0xC0              /* End Collection */ \
 }
 #endif
 
+// Vendor-defined collection carrying the raw HID protocol, one 63-byte frame
+// each way
+#ifndef TUD_HID_REPORT_DESC_RAW
+#define TUD_HID_REPORT_DESC_RAW(report_id, size) { \
+  0x06, 0x60, 0xFF, /* Usage Page (Vendor 0xFF60) */ \
+  0x09, 0x61,       /* Usage (0x61) */ \
+  0xA1, 0x01,       /* Collection (Application) */ \
+  0x85, report_id,  /*   Report ID */ \
+  0x09, 0x62,       /*   Usage (0x62) */ \
+  0x15, 0x00,       /*   Logical Minimum (0) */ \
+  0x26, 0xFF, 0x00, /*   Logical Maximum (255) */ \
+  0x75, 0x08,       /*   Report Size (8) */ \
+  0x95, size,       /*   Report Count (size) */ \
+  0x81, 0x02,       /*   Input (Data, Variable, Absolute) device -> host */ \
+  0x09, 0x63,       /*   Usage (0x63) */ \
+  0x15, 0x00,       /*   Logical Minimum (0) */ \
+  0x26, 0xFF, 0x00, /*   Logical Maximum (255) */ \
+  0x75, 0x08,       /*   Report Size (8) */ \
+  0x95, size,       /*   Report Count (size) */ \
+  0x91, 0x02,       /*   Output (Data, Variable, Absolute) host -> device */ \
+  0xC0              /* End Collection */ \
+}
+#endif
+
+static const uint8_t nkroReportDescriptor[] = TUD_HID_REPORT_DESC_NKRO_KEYBOARD(REPORT_ID_NKRO);
+static const uint8_t mouseReportDescriptor[] = TUD_HID_REPORT_DESC_HIRES_MOUSE(REPORT_ID_MOUSE);
+static const uint8_t consumerReportDescriptor[] = TUD_HID_REPORT_DESC_CONSUMER_16BIT(REPORT_ID_CONSUMER_CONTROL);
+static const uint8_t systemReportDescriptor[] = TUD_HID_REPORT_DESC_SYSTEM_CONTROL_16BIT(REPORT_ID_SYSTEM_CONTROL);
+static const uint8_t rawReportDescriptor[] = TUD_HID_REPORT_DESC_RAW(REPORT_ID_RAW, HID_RAW_REPORT_SIZE);
+
+// Registers a report descriptor with the USB HID interface. It has to exist
+// before USB.begin(), like the Arduino keyboard device in main.cpp.
+class ReportDescriptorDevice : public USBHIDDevice {
+public:
+    ReportDescriptorDevice(const uint8_t* descriptor, uint16_t length)
+        : descriptor(descriptor), length(length) {
+        hid.addDevice(this, length);
+    }
+
+    uint16_t _onGetDescriptor(uint8_t* buffer) override {
+        memcpy(buffer, descriptor, length);
+        return length;
+    }
+
+private:
+    const uint8_t* descriptor;
+    uint16_t length;
+    USBHID hid;
+};
+
+static ReportDescriptorDevice nkroKeyboard(nkroReportDescriptor, sizeof(nkroReportDescriptor));
+static ReportDescriptorDevice consumerControl(consumerReportDescriptor, sizeof(consumerReportDescriptor));
+static ReportDescriptorDevice systemControl(systemReportDescriptor, sizeof(systemReportDescriptor));
+
+// Resolution Multiplier feature report as last set by the host: bits 0-1
+// wheel, bits 2-3 pan. Zero (whole detents) until the host opts in.
+static volatile uint8_t mouseResolution = 0;
+
+class HighResMouseDevice : public ReportDescriptorDevice {
+public:
+    HighResMouseDevice() : ReportDescriptorDevice(mouseReportDescriptor, sizeof(mouseReportDescriptor)) {}
+
+    uint16_t _onGetFeature(uint8_t report_id, uint8_t* buffer, uint16_t len) override {
+        if (report_id != REPORT_ID_MOUSE || len < 1) return 0;
+        buffer[0] = mouseResolution;
+        return 1;
+    }
+
+    void _onSetFeature(uint8_t report_id, const uint8_t* buffer, uint16_t len) override {
+        if (report_id == REPORT_ID_MOUSE && len >= 1) {
+            mouseResolution = buffer[0] & 0x0F;
+        }
+    }
+};
+
+static HighResMouseDevice highResMouse;
+
+// Output reports arrive on the TinyUSB task, the raw handler queues them
+class RawReportDevice : public ReportDescriptorDevice {
+public:
+    RawReportDevice() : ReportDescriptorDevice(rawReportDescriptor, sizeof(rawReportDescriptor)) {}
+
+    void _onOutput(uint8_t report_id, const uint8_t* buffer, uint16_t len) override {
+        if (report_id == REPORT_ID_RAW) {
+            rawHidHandler.onOutput(buffer, len);
+        }
+    }
+};
+
+static RawReportDevice rawDevice;
+
 // Global HID handler instance
 HIDHandler* hidHandler = nullptr;
 
+// The Arduino core already defines tud_hid_report_complete_cb for USBHID, so
+// the link wraps it (-Wl,--wrap in platformio.ini) and chains to the original
+extern "C" void __real_tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len);
+
+extern "C" void __wrap_tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len) {
+    __real_tud_hid_report_complete_cb(instance, report, len);
+    if (hidHandler) {
+        hidHandler->onReportComplete();
+    }
+}
+
 HIDHandler::HIDHandler() {
     memset(&keyboardState, 0, sizeof(keyboardState));
     memset(&consumerState, 0, sizeof(consumerState));
+    memset(modifierCounts, 0, sizeof(modifierCounts));
+    memset(keyCounts, 0, sizeof(keyCounts));
 }
 
 HIDHandler::~HIDHandler() {
     // Nothing to free
 }
 
-// Fixed sendKeyboardReport with proper const casting
 bool HIDHandler::sendKeyboardReport(const uint8_t* report, size_t length) {
     if (!report || length != HID_KEYBOARD_REPORT_SIZE) {
         USBSerial.println("Invalid keyboard report");
@@ -89,37 +303,7 @@ bool HIDHandler::sendKeyboardReport(const uint8_t* report, size_t length) {
     // Copy report to our state
     memcpy(keyboardState.report, report, HID_KEYBOARD_REPORT_SIZE);
     
-    if (!tud_mounted()) {
-        USBSerial.println("USB device not mounted");
-        return false;
-    }
-    
-    if (tud_hid_ready()) {
-        // Extract the modifier byte from report[0]
-        uint8_t modifier = report[0];
-        
-        // Create a non-const copy of the keycodes portion of the report
-        uint8_t keycodes[6];
-        memcpy(keycodes, &report[2], 6);
-        
-        // For keyboard report, we send modifier, reserved byte, and up to 6 key codes
-        bool success = tud_hid_keyboard_report(1, modifier, keycodes);
-        
-        if (success) {
-            USBSerial.print("Keyboard report sent: ");
-            for (size_t i = 0; i < HID_KEYBOARD_REPORT_SIZE; i++) {
-                USBSerial.printf("%02X ", report[i]);
-            }
-            USBSerial.println();
-            return true;
-        } else {
-            USBSerial.println("Failed to send keyboard report");
-            return false;
-        }
-    } else {
-        USBSerial.println("HID not ready to send keyboard report");
-        return false;
-    }
+    return queueReport(HID_REPORT_KEYBOARD, report, HID_KEYBOARD_REPORT_SIZE);
 }
 
 bool HIDHandler::sendEmptyKeyboardReport() {
@@ -127,83 +311,261 @@ bool HIDHandler::sendEmptyKeyboardReport() {
     return sendKeyboardReport(emptyReport, HID_KEYBOARD_REPORT_SIZE);
 }
 
-bool HIDHandler::executeMacro(const char* macroId) {
-    if (!macroId) return false;
-    String macroKey = String(macroId);
-    auto it = macros.find(macroKey);
-    if (it == macros.end()) {
-        USBSerial.printf("Macro '%s' not found\n", macroId);
-        return false;
+void HIDHandler::pressKey(uint8_t usage) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    addUsage(usage);
+}
+
+void HIDHandler::releaseKey(uint8_t usage) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    removeUsage(usage);
+}
+
+void HIDHandler::addUsage(uint8_t usage) {
+    if (usage >= 0xE0 && usage <= 0xE7) {
+        uint8_t bit = usage - 0xE0;
+        if (modifierCounts[bit]++ == 0) keyboardDirty = true;
+    } else if (usage != 0) {
+        if (keyCounts[usage]++ == 0) keyboardDirty = true;
     }
-    if (executingMacro) {
-        USBSerial.println("Already executing a macro, ignoring request");
-        return false;
+}
+
+void HIDHandler::removeUsage(uint8_t usage) {
+    if (usage >= 0xE0 && usage <= 0xE7) {
+        uint8_t bit = usage - 0xE0;
+        if (modifierCounts[bit] && --modifierCounts[bit] == 0) keyboardDirty = true;
+    } else if (usage != 0) {
+        if (keyCounts[usage] && --keyCounts[usage] == 0) keyboardDirty = true;
     }
-    currentMacro = &(it->second);
-    currentMacroStep = 0;
-    executingMacro = true;
-    nextMacroStepTime = millis();
-    USBSerial.printf("Starting execution of macro '%s'\n", macroId);
-    return true;
 }
 
-void HIDHandler::update() {
-    std::lock_guard<std::mutex> lock(reportMutex);
-    while (!reportQueue.empty()) {
-        if (!processNextReport()) {
-            break;
+// Adds the modifiers and keys of an 8-byte boot report to the aggregate state
+void HIDHandler::pressKeyboardReport(const uint8_t* report) {
+    if (!report) return;
+    std::lock_guard<std::mutex> lock(stateMutex);
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        if (report[0] & (1 << bit)) addUsage(0xE0 + bit);
+    }
+    for (uint8_t i = 2; i < HID_KEYBOARD_REPORT_SIZE; i++) {
+        addUsage(report[i]);
+    }
+}
+
+void HIDHandler::releaseKeyboardReport(const uint8_t* report) {
+    if (!report) return;
+    std::lock_guard<std::mutex> lock(stateMutex);
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        if (report[0] & (1 << bit)) removeUsage(0xE0 + bit);
+    }
+    for (uint8_t i = 2; i < HID_KEYBOARD_REPORT_SIZE; i++) {
+        removeUsage(report[i]);
+    }
+}
+
+void HIDHandler::buildBootReport(uint8_t* report) {
+    memset(report, 0, HID_KEYBOARD_REPORT_SIZE);
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        if (modifierCounts[bit]) report[0] |= (1 << bit);
+    }
+
+    uint8_t count = 0;
+    for (uint16_t usage = 1; usage < 0xE0; usage++) {
+        if (!keyCounts[usage]) continue;
+        if (count == 6) {
+            // More than six keys: report ErrorRollOver in every slot
+            memset(&report[2], 0x01, 6);
+            return;
         }
+        report[2 + count++] = (uint8_t)usage;
     }
-    if (executingMacro && currentMacro) {
-        unsigned long currentTime = millis();
-        if (currentTime >= nextMacroStepTime) {
-            if (currentMacroStep < currentMacro->reports.size()) {
-                const HIDReport& report = currentMacro->reports[currentMacroStep];
-                bool success = false;
-                switch (report.type) {
-                    case HID_REPORT_KEYBOARD:
-                        success = sendKeyboardReport(report.data, report.length);
-                        break;
-                    case HID_REPORT_CONSUMER:
-                        success = sendConsumerReport(report.data, report.length);
-                        break;
-                    default:
-                        USBSerial.println("Unknown report type in macro");
-                        break;
-                }
-                uint16_t delayTime = (currentMacroStep < currentMacro->delays.size()) ? currentMacro->delays[currentMacroStep] : 50;
-                nextMacroStepTime = currentTime + delayTime;
-                currentMacroStep++;
-                USBSerial.printf("Executed macro step %d/%d\n", currentMacroStep, currentMacro->reports.size());
-            } else {
-                USBSerial.println("Macro execution complete");
-                executingMacro = false;
-                currentMacro = nullptr;
-                currentMacroStep = 0;
-                sendEmptyKeyboardReport();
-                sendEmptyConsumerReport();
-            }
+}
+
+void HIDHandler::buildNkroReport(uint8_t* report) {
+    memset(report, 0, HID_NKRO_REPORT_SIZE);
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        if (modifierCounts[bit]) report[0] |= (1 << bit);
+    }
+    for (uint16_t usage = 1; usage < HID_NKRO_KEY_COUNT; usage++) {
+        if (keyCounts[usage]) report[1 + usage / 8] |= (1 << (usage % 8));
+    }
+}
+
+// Sends one merged report if the aggregate state changed since the last one.
+// The state stays dirty when the report could not be sent, so the next flush retries.
+// The keyboard task and the macro player both flush, the state lock is always
+// taken before the queue lock.
+bool HIDHandler::flushKeyboardReport() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (!keyboardDirty) return true;
+
+    bool success;
+    if (keyboardMode == KEYBOARD_MODE_NKRO) {
+        uint8_t report[HID_NKRO_REPORT_SIZE];
+        buildNkroReport(report);
+        success = sendNkroReport(report);
+    } else {
+        uint8_t report[HID_KEYBOARD_REPORT_SIZE];
+        buildBootReport(report);
+        success = sendKeyboardReport(report, HID_KEYBOARD_REPORT_SIZE);
+    }
+
+    if (success) keyboardDirty = false;
+    return success;
+}
+
+bool HIDHandler::sendMouseReport(uint8_t buttons, int16_t x, int16_t y, int8_t wheel, int8_t pan) {
+    uint8_t report[HID_MOUSE_REPORT_SIZE] = {
+        buttons,
+        (uint8_t)(x & 0xFF), (uint8_t)((uint16_t)x >> 8),
+        (uint8_t)(y & 0xFF), (uint8_t)((uint16_t)y >> 8),
+        (uint8_t)wheel, (uint8_t)pan
+    };
+    return queueReport(HID_REPORT_MOUSE, report, HID_MOUSE_REPORT_SIZE);
+}
+
+bool HIDHandler::isWheelHighResolution() const {
+    return mouseResolution & 0x03;
+}
+
+bool HIDHandler::isPanHighResolution() const {
+    return mouseResolution & 0x0C;
+}
+
+bool HIDHandler::sendRawReport(const uint8_t* frame) {
+    return queueReport(HID_REPORT_RAW, frame, HID_RAW_REPORT_SIZE);
+}
+
+bool HIDHandler::sendNkroReport(const uint8_t* report) {
+    return queueReport(HID_REPORT_NKRO, report, HID_NKRO_REPORT_SIZE);
+}
+
+// Adds a report to the transmit queue and sends it straight away when the
+// endpoint is idle. Deduplication and coalescing are up to HIDReportQueue.
+bool HIDHandler::queueReport(HIDReportType type, const uint8_t* data, uint8_t length) {
+    if (!data || type >= HID_REPORT_TYPE_COUNT || length > sizeof(HIDReport::data)) {
+        return false;
+    }
+    if (!tud_mounted()) {
+        // Nobody to send to, this report and anything still queued go
+        dropQueuedReports();
+        std::lock_guard<std::mutex> lock(reportMutex);
+        reportQueue.countDropped();
+        return false;
+    }
+
+    HIDReport next;
+    memset(&next, 0, sizeof(next));
+    next.type = type;
+    next.length = length;
+    memcpy(next.data, data, length);
+
+    HIDQueueResult result;
+    {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        // The first report after a key event carries its timestamps, a
+        // duplicate leaves them for the next one
+        if (!reportQueue.matchesShadow(next)) {
+            next.keyEvent = latencyStats.takeKeyDispatch(next.detectUs, next.dispatchUs);
         }
+        result = reportQueue.push(next);
     }
+
+    if (result == HID_QUEUE_ADDED) pumpReports();
+    return result != HID_QUEUE_DROPPED;
 }
 
-bool HIDHandler::processNextReport() {
-    if (reportQueue.empty()) return false;
-    HIDReport report = reportQueue.front();
+void HIDHandler::pumpReports() {
+    std::lock_guard<std::mutex> lock(reportMutex);
+    HIDReport* front = reportQueue.front();
+    if (!front || !tud_mounted() || !tud_hid_ready()) return;
+
+    // On failure the report stays at the head for the next completion
+    if (!transmit(*front)) return;
+
+    HIDReport report = *front;
     reportQueue.pop();
-    bool success = false;
+    if (report.keyEvent) {
+        latencyStats.recordUsbSubmit(report.detectUs, report.dispatchUs);
+    }
+}
+
+bool HIDHandler::transmit(const HIDReport& report) {
     switch (report.type) {
         case HID_REPORT_KEYBOARD:
-            success = sendKeyboardReport(report.data, report.length);
-            break;
+            return tud_hid_keyboard_report(REPORT_ID_KEYBOARD, report.data[0], &report.data[2]);
+        case HID_REPORT_NKRO:
+            return tud_hid_report(REPORT_ID_NKRO, report.data, HID_NKRO_REPORT_SIZE);
         case HID_REPORT_CONSUMER:
-            success = sendConsumerReport(report.data, report.length);
-            break;
+            return tud_hid_report(REPORT_ID_CONSUMER_CONTROL, report.data, HID_USAGE_REPORT_SIZE);
+        case HID_REPORT_SYSTEM:
+            return tud_hid_report(REPORT_ID_SYSTEM_CONTROL, report.data, HID_USAGE_REPORT_SIZE);
+        case HID_REPORT_MOUSE:
+            return tud_hid_report(REPORT_ID_MOUSE, report.data, HID_MOUSE_REPORT_SIZE);
+        case HID_REPORT_RAW:
+            return tud_hid_report(REPORT_ID_RAW, report.data, HID_RAW_REPORT_SIZE);
         default:
-            USBSerial.println("Unknown report type");
-            break;
+            return false;
     }
-    return success;
+}
+
+// Stale key state must not replay on the next mount: whatever is still queued
+// is dropped and the host is assumed to start from empty reports
+void HIDHandler::dropQueuedReports() {
+    std::lock_guard<std::mutex> lock(reportMutex);
+    reportQueue.clear();
+}
+
+// Runs on the USB event loop when the host unconfigures or the bus resets
+static void onUsbStopped(void* arg, esp_event_base_t base, int32_t id, void* data) {
+    if (hidHandler) {
+        hidHandler->dropQueuedReports();
+    }
+}
+
+bool HIDHandler::isMounted() const {
+    return tud_mounted();
+}
+
+// Runs on the TinyUSB task once the endpoint has finished the last report
+void HIDHandler::onReportComplete() {
+    pumpReports();
+}
+
+void HIDHandler::printQueueStats() {
+    USBSerial.println("\n--- HID Transmit Queue ---");
+    USBSerial.printf("Backlog: %u (high water %u of %u)\n", reportQueue.size(), reportQueue.getHighWater(),
+                  HID_REPORT_QUEUE_SIZE);
+    USBSerial.printf("Sent: %u, coalesced: %u, duplicates: %u, dropped: %u\n",
+                  reportQueue.getSentReports(), reportQueue.getCoalescedReports(),
+                  reportQueue.getDuplicateReports(), reportQueue.getDroppedReports());
+    uint32_t saved = reportQueue.getCoalescedReports() + reportQueue.getDuplicateReports();
+    uint32_t total = reportQueue.getSentReports() + saved;
+    if (total) {
+        USBSerial.printf("Reports saved: %u of %u (%u%%)\n", saved, total, (uint32_t)((uint64_t)saved * 100 / total));
+    }
+    USBSerial.println("--------------------------\n");
+}
+
+void HIDHandler::setKeyboardMode(KeyboardReportMode mode) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (mode == keyboardMode) return;
+
+    // Release everything in the old format before switching
+    uint8_t emptyReport[HID_NKRO_REPORT_SIZE] = {0};
+    if (keyboardMode == KEYBOARD_MODE_NKRO) {
+        sendNkroReport(emptyReport);
+    } else {
+        sendKeyboardReport(emptyReport, HID_KEYBOARD_REPORT_SIZE);
+    }
+
+    keyboardMode = mode;
+    keyboardDirty = true;
+    USBSerial.printf("Keyboard report mode: %s\n", mode == KEYBOARD_MODE_NKRO ? "nkro" : "6kro");
+}
+
+KeyboardReportMode HIDHandler::keyboardModeFromString(const char* name) {
+    if (name && strcasecmp(name, "nkro") == 0) return KEYBOARD_MODE_NKRO;
+    return KEYBOARD_MODE_6KRO;
 }
 
 bool HIDHandler::hexReportToBinary(const char* hexReport[], size_t count, uint8_t* binaryReport, size_t maxLength) {
@@ -216,11 +578,12 @@ bool HIDHandler::hexReportToBinary(const char* hexReport[], size_t count, uint8_
             hexStr += 2;
         }
         char* endPtr;
-        binaryReport[i] = (uint8_t)strtol(hexStr, &endPtr, 16);
-        if (*endPtr != '\0') {
+        long value = strtol(hexStr, &endPtr, 16);
+        if (*endPtr != '\0' || value < 0 || value > 0xFF) {
             USBSerial.printf("Invalid hex value: %s\n", hexReport[i]);
             return false;
         }
+        binaryReport[i] = (uint8_t)value;
     }
     return true;
 }
@@ -236,7 +599,8 @@ bool HIDHandler::hexReportToBinary(const std::vector<String>& hexReport, uint8_t
         }
         char* endPtr;
         long value = strtol(hexStr, &endPtr, 16);
-        if (*endPtr != '\0') {
+        // One byte per element, a wider value would be silently truncated
+        if (*endPtr != '\0' || value < 0 || value > 0xFF) {
             USBSerial.printf("Invalid hex value: %s\n", hexReport[i].c_str());
             return false;
         }
@@ -280,82 +644,68 @@ void cleanupHIDHandler() {
 }
 
 
+// Legacy 4-byte consumer arrays from actions.json carry the usage in bytes 2-3
 bool HIDHandler::sendConsumerReport(const uint8_t* report, size_t length) {
-    // We still expect a 4-byte array from configuration, but we only use byte 2.
-    if (!report || length != 4) {
+    if (!report || length != HID_CONSUMER_REPORT_SIZE) {
         USBSerial.println("ERROR: Invalid consumer report");
         return false;
     }
-    
-    // Wait for USB to mount
-    unsigned long startTime = millis();
-    while (!tud_mounted() && (millis() - startTime < 2000)) {
-        tud_task();
-        delay(10);
-    }
-    if (!tud_mounted()) {
-        USBSerial.println("ERROR: USB not mounted");
-        return false;
-    }
-    
-    if (!tud_hid_ready()) {
-        USBSerial.println("ERROR: HID not ready");
-        return false;
-    }
-    
-    // Construct a 16-bit consumer control value.
-    uint16_t consumerCode = 0x0000;
-    if (report[2] == 0xE9) {
-        consumerCode = 0x00E9; // Volume UP
-        USBSerial.println("Preparing Volume UP Command");
-    } else if (report[2] == 0xEA) {
-        consumerCode = 0x00EA; // Volume DOWN
-        USBSerial.println("Preparing Volume DOWN Command");
-    }
-    
-    USBSerial.printf("Raw Consumer Report: %02X %02X %02X %02X\n",
-                     report[0], report[1], report[2], report[3]);
-    USBSerial.printf("Consumer Code: 0x%04X\n", consumerCode);
-    
-    bool success = false;
-    // Use Report ID 0x04 as defined in your HID descriptor.
-    for (int attempts = 0; attempts < 3; attempts++) {
-        success = tud_hid_report(0x04, reinterpret_cast<uint8_t*>(&consumerCode), sizeof(consumerCode));
-        if (success) {
-            USBSerial.printf("Consumer Report Sent Successfully (Attempt %d)\n", attempts + 1);
-            break;
-        } else {
-            USBSerial.printf("Consumer Report Send Failed (Attempt %d)\n", attempts + 1);
-            delay(10);
-        }
-    }
-    return success;
+    return sendConsumerUsage(report[2] | (report[3] << 8));
 }
 
 bool HIDHandler::sendEmptyConsumerReport() {
-    uint16_t emptyCode = 0x0000;
-    
-    if (!tud_mounted()) {
-        USBSerial.println("ERROR: Cannot send empty report - USB not mounted");
-        return false;
-    }
-    
-    if (!tud_hid_ready()) {
-        USBSerial.println("ERROR: Cannot send empty report - HID not ready");
-        return false;
+    static const uint8_t empty[HID_USAGE_REPORT_SIZE] = {0};
+    return sendUsageReport(HID_REPORT_CONSUMER, empty);
+}
+
+bool HIDHandler::sendConsumerUsage(uint16_t usage) {
+    uint8_t report[HID_USAGE_REPORT_SIZE];
+    buildUsageReport(usage, report);
+    return sendUsageReport(HID_REPORT_CONSUMER, report);
+}
+
+bool HIDHandler::sendSystemUsage(uint16_t usage) {
+    uint8_t report[HID_USAGE_REPORT_SIZE];
+    buildUsageReport(usage, report);
+    return sendUsageReport(HID_REPORT_SYSTEM, report);
+}
+
+// Consumer and system reports share the 2-byte usage layout
+bool HIDHandler::sendUsageReport(HIDReportType type, const uint8_t* report) {
+    if (type != HID_REPORT_CONSUMER && type != HID_REPORT_SYSTEM) return false;
+    return queueReport(type, report, HID_USAGE_REPORT_SIZE);
+}
+
+void HIDHandler::buildUsageReport(uint16_t usage, uint8_t* report) {
+    report[0] = usage & 0xFF;
+    report[1] = usage >> 8;
+}
+
+// Accepts a name from the generated usage tables or a number such as "0xE9"
+bool HIDHandler::usageFromString(HIDReportType type, const String& name, uint16_t& usage) {
+    const HidUsageName* table = type == HID_REPORT_SYSTEM ? SYSTEM_USAGES : CONSUMER_USAGES;
+    size_t count = type == HID_REPORT_SYSTEM ? sizeof(SYSTEM_USAGES) / sizeof(SYSTEM_USAGES[0])
+                                             : sizeof(CONSUMER_USAGES) / sizeof(CONSUMER_USAGES[0]);
+    for (size_t i = 0; i < count; i++) {
+        if (name == table[i].name) {
+            usage = table[i].usage;
+            return true;
+        }
     }
-    
-    // Send an empty 16-bit consumer report with Report ID 0x04.
-    bool success = tud_hid_report(0x04, reinterpret_cast<uint8_t*>(&emptyCode), sizeof(emptyCode));
-    USBSerial.printf("Empty Consumer Report %s\n",
-                     success ? "SENT SUCCESSFULLY" : "FAILED");
-    return success;
+
+    if (name.isEmpty()) return false;
+    char* end;
+    unsigned long value = strtoul(name.c_str(), &end, 0);
+    if (*end != '\0' || value > 0xFFFF) return false;
+    usage = value;
+    return true;
 }
 
 
 
 bool HIDHandler::begin() {
     USBSerial.println("Initializing HID Handler & Waiting for USB Stack to Initialize...");
+    USB.onEvent(ARDUINO_USB_STOPPED_EVENT, onUsbStopped);
     
     // More aggressive USB initialization
     unsigned long startTime = millis();
@@ -3,33 +3,14 @@
 
 #include <Arduino.h>
 #include <vector>
-#include <queue>
 #include <mutex>
-#include <map>
 #include <ArduinoJson.h>
+#include "HIDReportQueue.h"
 
-// HID Report Descriptors
-#define HID_KEYBOARD_REPORT_SIZE 8
-#define HID_CONSUMER_REPORT_SIZE 4
-
-// Report types
-enum HIDReportType {
-    HID_REPORT_KEYBOARD,
-    HID_REPORT_CONSUMER,
-    HID_REPORT_SYSTEM
-};
-
-// HID Report structure
-struct HIDReport {
-    HIDReportType type;
-    uint8_t data[16]; // Buffer large enough for any report type
-    uint8_t length;
-};
-
-// Macro structure
-struct MacroSequence {
-    std::vector<HIDReport> reports;
-    std::vector<uint16_t> delays;
+// Keyboard report format sent for the aggregate key state
+enum KeyboardReportMode {
+    KEYBOARD_MODE_6KRO,   // Boot-compatible report, up to 6 keys plus modifiers
+    KEYBOARD_MODE_NKRO    // Bitmap report, every key in the bitmap range
 };
 
 class HIDHandler {
@@ -40,20 +21,55 @@ public:
     // Initialize HID functionality
     bool begin();
 
-    // Send HID reports
+    // Send HID reports. Reports are queued and sent as the endpoint frees up,
+    // so these never block; false means the report was dropped.
     bool sendKeyboardReport(const uint8_t* report, size_t length = HID_KEYBOARD_REPORT_SIZE);
     bool sendConsumerReport(const uint8_t* report, size_t length = HID_CONSUMER_REPORT_SIZE);
     bool sendEmptyKeyboardReport(); // Release all keys
     bool sendEmptyConsumerReport(); // Release all consumer controls
-
-    // Macro handling
-    bool executeMacro(const char* macroId);
-    bool registerMacro(const char* macroId, const MacroSequence& sequence);
-
-    // Update function for main loop
-    void update();
-
-    // Convert hex string report to binary
+    bool sendConsumerUsage(uint16_t usage); // 0 releases
+    bool sendSystemUsage(uint16_t usage);   // 0 releases
+    // Sends a prebuilt consumer or system report as is
+    bool sendUsageReport(HIDReportType type, const uint8_t* report);
+    static void buildUsageReport(uint16_t usage, uint8_t* report);
+    static bool usageFromString(HIDReportType type, const String& name, uint16_t& usage);
+
+    // Aggregate keyboard state. Press/release only update the state, the merged
+    // report is sent by flushKeyboardReport() once per batch of key events.
+    void pressKeyboardReport(const uint8_t* report);
+    void releaseKeyboardReport(const uint8_t* report);
+    void pressKey(uint8_t usage);
+    void releaseKey(uint8_t usage);
+    bool flushKeyboardReport();
+
+    // Relative mouse report. Wheel and pan are in 1/120 detents while the host
+    // has enabled high-resolution scrolling, whole detents otherwise.
+    bool sendMouseReport(uint8_t buttons, int16_t x, int16_t y, int8_t wheel, int8_t pan);
+    bool isWheelHighResolution() const;
+    bool isPanHighResolution() const;
+
+    // Raw HID response frame, never deduplicated or merged
+    bool sendRawReport(const uint8_t* frame);
+
+    void setKeyboardMode(KeyboardReportMode mode);
+    KeyboardReportMode getKeyboardMode() const { return keyboardMode; }
+    static KeyboardReportMode keyboardModeFromString(const char* name);
+
+    // Transmit queue, drained from TinyUSB's report complete callback
+    bool queueReport(HIDReportType type, const uint8_t* data, uint8_t length);
+    void onReportComplete();
+    uint8_t getQueueBacklog() const { return reportQueue.size(); }
+    // True while the host has the device configured
+    bool isMounted() const;
+    // Empties the transmit queue on unmount, the reports count as dropped
+    void dropQueuedReports();
+    uint32_t getSentReports() const { return reportQueue.getSentReports(); }
+    uint32_t getDroppedReports() const { return reportQueue.getDroppedReports(); }
+    uint32_t getCoalescedReports() const { return reportQueue.getCoalescedReports(); }
+    uint32_t getDuplicateReports() const { return reportQueue.getDuplicateReports(); }
+    void printQueueStats();
+
+    // Convert hex string report to binary, false on an element that is not one byte
     static bool hexReportToBinary(const char* hexReport[], size_t count, uint8_t* binaryReport, size_t maxLength);
     static bool hexReportToBinary(const std::vector<String>& hexReport, uint8_t* binaryReport, size_t maxLength);
 
@@ -76,21 +92,30 @@ private:
     KeyboardReportDescriptor keyboardState;
     ConsumerReportDescriptor consumerState;
 
-    // Macro execution variables
-    bool executingMacro = false;
-    unsigned long nextMacroStepTime = 0;
-    size_t currentMacroStep = 0;
-    MacroSequence* currentMacro = nullptr;
+    // Aggregate keyboard state, reference counted so two keys mapped to the
+    // same usage do not release each other
+    uint8_t modifierCounts[8];
+    uint8_t keyCounts[256];
+    bool keyboardDirty = false;
+    KeyboardReportMode keyboardMode = KEYBOARD_MODE_6KRO;
+    // Guards the aggregate state, shared by the keyboard and macro tasks
+    std::mutex stateMutex;
 
-    // Thread safety for reports
-    std::mutex reportMutex;
-    std::queue<HIDReport> reportQueue;
+    // Unlocked state updates, callers hold stateMutex
+    void addUsage(uint8_t usage);
+    void removeUsage(uint8_t usage);
 
-    // Helper to process the next report in the queue
-    bool processNextReport();
+    void buildBootReport(uint8_t* report);
+    void buildNkroReport(uint8_t* report);
+    bool sendNkroReport(const uint8_t* report);
 
-    // Map to store registered macros
-    std::map<String, MacroSequence> macros;
+    // Sends the oldest queued report if the endpoint is free
+    void pumpReports();
+    bool transmit(const HIDReport& report);
+
+    // Transmit queue, shared by the sending tasks and the USB task
+    std::mutex reportMutex;
+    HIDReportQueue reportQueue;
 };
 
 // Global HID handler instance
@@ -98,7 +123,6 @@ extern HIDHandler* hidHandler;
 
 // Helper functions
 void initializeHIDHandler();
-void updateHIDHandler();
 void cleanupHIDHandler();
 
 #endif // HID_HANDLER_H
\ No newline at end of file
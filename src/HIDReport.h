@@ -0,0 +1,50 @@
+// HIDReport.h
+
+#ifndef HID_REPORT_H
+#define HID_REPORT_H
+
+#include <stdint.h>
+#include "raw_hid_protocol.h"
+
+// HID Report Descriptors
+#define HID_KEYBOARD_REPORT_SIZE 8
+// Legacy consumer array of actions.json and reports.json: bytes 0-1 unused,
+// the usage little-endian in bytes 2-3
+#define HID_CONSUMER_REPORT_SIZE 4
+// Consumer and system control reports: one little-endian 16-bit usage
+#define HID_USAGE_REPORT_SIZE 2
+
+// NKRO report: modifier byte followed by a bitmap of key usages 0x00-0xDF,
+// every usage below the modifiers
+#define HID_NKRO_KEY_COUNT 224
+#define HID_NKRO_REPORT_SIZE (1 + HID_NKRO_KEY_COUNT / 8)
+
+// Mouse report: buttons, 16-bit X and Y, wheel and AC pan
+#define HID_MOUSE_REPORT_SIZE 7
+
+// Vendor-defined raw report, one protocol frame (see raw_hid_protocol.h)
+#define HID_RAW_REPORT_SIZE RAW_HID_REPORT_SIZE
+
+// Report types
+enum HIDReportType {
+    HID_REPORT_KEYBOARD,
+    HID_REPORT_NKRO,
+    HID_REPORT_CONSUMER,
+    HID_REPORT_SYSTEM,
+    HID_REPORT_MOUSE,
+    HID_REPORT_RAW,
+    HID_REPORT_TYPE_COUNT
+};
+
+// HID Report structure
+struct HIDReport {
+    HIDReportType type;
+    uint8_t data[HID_RAW_REPORT_SIZE]; // Buffer large enough for any report type
+    uint8_t length;
+    // Key event the report carries, recorded in LatencyStats once it is sent
+    bool keyEvent;
+    uint32_t detectUs;
+    uint32_t dispatchUs;
+};
+
+#endif // HID_REPORT_H
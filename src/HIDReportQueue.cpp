@@ -0,0 +1,184 @@
+// HIDReportQueue.cpp
+#include "HIDReportQueue.h"
+
+HIDReportQueue::HIDReportQueue() {
+    memset(reports, 0, sizeof(reports));
+    memset(lastSubmitted, 0, sizeof(lastSubmitted));
+    for (uint8_t type = 0; type < HID_REPORT_TYPE_COUNT; type++) {
+        lastSubmitted[type].type = (HIDReportType)type;
+    }
+}
+
+void HIDReportQueue::findNewest(HIDReportType type, int8_t& newest, int8_t& older) const {
+    newest = -1;
+    older = -1;
+    for (int8_t i = count - 1; i >= 0; i--) {
+        if (at(i).type != type) continue;
+        if (newest < 0) {
+            newest = i;
+        } else {
+            older = i;
+            return;
+        }
+    }
+}
+
+// Shadow of the report's type: the newest queued report, or what the host has.
+// Raw frames are messages, each one is delivered.
+bool HIDReportQueue::matchesShadow(const HIDReport& next) const {
+    if (next.type == HID_REPORT_RAW) return false;
+    int8_t newest, older;
+    findNewest(next.type, newest, older);
+    return isDuplicate(newest < 0 ? lastSubmitted[next.type] : at(newest), next);
+}
+
+// A report identical to the state the host will end up with is dropped.
+// Otherwise it folds into the tail of the queue when the tail is of the same
+// type and merging skips no press or release, so a burst from one source
+// costs one report. A report of another type queued in between keeps them
+// apart, folding past it would change the order the host sees.
+HIDQueueResult HIDReportQueue::push(const HIDReport& next) {
+    if (matchesShadow(next)) {
+        duplicateReports++;
+        return HID_QUEUE_DUPLICATE;
+    }
+
+    int8_t newest, older;
+    findNewest(next.type, newest, older);
+    if (next.type != HID_REPORT_RAW && newest >= 0 && newest == count - 1) {
+        HIDReport& tail = at(newest);
+        const HIDReport& previous = older < 0 ? lastSubmitted[next.type] : at(older);
+        if (next.type == HID_REPORT_MOUSE) {
+            // Relative motion adds up
+            if (mergeMouseReport(tail, next)) {
+                mergeKeyEvent(tail, next);
+                coalescedReports++;
+                return HID_QUEUE_COALESCED;
+            }
+        } else if (canCoalesce(previous, tail, next)) {
+            mergeKeyEvent(tail, next);
+            memcpy(tail.data, next.data, sizeof(tail.data));
+            coalescedReports++;
+            return HID_QUEUE_COALESCED;
+        }
+    }
+
+    if (count == HID_REPORT_QUEUE_SIZE) {
+        // Full: mouse motion still adds up into the newest mouse report
+        if (next.type == HID_REPORT_MOUSE && newest >= 0 && mergeMouseReport(at(newest), next)) {
+            mergeKeyEvent(at(newest), next);
+            coalescedReports++;
+            return HID_QUEUE_COALESCED;
+        }
+        // Absolute reports keep the final state by overwriting the newest
+        // report of their type, the transitions in between are lost
+        droppedReports++;
+        if (next.type == HID_REPORT_RAW || next.type == HID_REPORT_MOUSE || newest < 0) return HID_QUEUE_DROPPED;
+        HIDReport& entry = at(newest);
+        mergeKeyEvent(entry, next);
+        memcpy(entry.data, next.data, sizeof(entry.data));
+        return HID_QUEUE_OVERWRITTEN;
+    }
+
+    at(count) = next;
+    count++;
+    if (count > highWater) highWater = count;
+    return HID_QUEUE_ADDED;
+}
+
+HIDReport* HIDReportQueue::front() {
+    return count ? &reports[head] : nullptr;
+}
+
+void HIDReportQueue::pop() {
+    if (!count) return;
+    lastSubmitted[reports[head].type] = reports[head];
+    head = (head + 1) % HID_REPORT_QUEUE_SIZE;
+    count--;
+    sentReports++;
+}
+
+void HIDReportQueue::clear() {
+    droppedReports += count;
+    head = 0;
+    count = 0;
+    for (uint8_t i = 0; i < HID_REPORT_TYPE_COUNT; i++) {
+        memset(lastSubmitted[i].data, 0, sizeof(lastSubmitted[i].data));
+    }
+}
+
+// Same state as the shadow. Mouse reports are relative, only a report without
+// motion or button changes says nothing new.
+bool HIDReportQueue::isDuplicate(const HIDReport& shadow, const HIDReport& next) {
+    if (next.type == HID_REPORT_MOUSE) {
+        static const uint8_t noMotion[HID_MOUSE_REPORT_SIZE - 1] = {0};
+        return shadow.data[0] == next.data[0] && memcmp(&next.data[1], noMotion, sizeof(noMotion)) == 0;
+    }
+    return memcmp(shadow.data, next.data, next.length) == 0;
+}
+
+// True when every usage changes at most once across previous -> tail -> next,
+// i.e. sending next in place of tail skips no press or release
+bool HIDReportQueue::canCoalesce(const HIDReport& previous, const HIDReport& tail, const HIDReport& next) {
+    if (tail.type == HID_REPORT_CONSUMER || tail.type == HID_REPORT_SYSTEM) {
+        // Single usage: the tail must lie on the way from previous to next
+        uint16_t p = previous.data[0] | (previous.data[1] << 8);
+        uint16_t t = tail.data[0] | (tail.data[1] << 8);
+        uint16_t n = next.data[0] | (next.data[1] << 8);
+        bool tailInEither = t == 0 || t == p || t == n;
+        bool keptInTail = !(p != 0 && p == n) || t == p;
+        return tailInEither && keptInTail;
+    }
+
+    // Keyboard reports as usage bitmaps: tail within (previous | next) and
+    // containing (previous & next)
+    uint8_t p[32], t[32], n[32];
+    const HIDReport* sources[3] = { &previous, &tail, &next };
+    uint8_t* sets[3] = { p, t, n };
+    for (uint8_t r = 0; r < 3; r++) {
+        const HIDReport& report = *sources[r];
+        uint8_t* set = sets[r];
+        memset(set, 0, 32);
+        set[0xE0 / 8] = report.data[0]; // Modifiers are usages 0xE0-0xE7
+        if (report.type == HID_REPORT_NKRO) {
+            memcpy(set, &report.data[1], HID_NKRO_KEY_COUNT / 8);
+        } else {
+            for (uint8_t i = 2; i < HID_KEYBOARD_REPORT_SIZE; i++) {
+                uint8_t usage = report.data[i];
+                if (usage) set[usage / 8] |= 1 << (usage % 8);
+            }
+        }
+    }
+    for (uint8_t i = 0; i < 32; i++) {
+        if (t[i] & ~(p[i] | n[i])) return false;
+        if ((p[i] & n[i]) & ~t[i]) return false;
+    }
+    return true;
+}
+
+// A report that absorbed next also carries its key event, unless it already
+// carries an older one
+void HIDReportQueue::mergeKeyEvent(HIDReport& report, const HIDReport& next) {
+    if (report.keyEvent || !next.keyEvent) return;
+    report.keyEvent = true;
+    report.detectUs = next.detectUs;
+    report.dispatchUs = next.dispatchUs;
+}
+
+// Adds next's motion to tail when the buttons match and the sums stay in range
+bool HIDReportQueue::mergeMouseReport(HIDReport& tail, const HIDReport& next) {
+    if (tail.data[0] != next.data[0]) return false;
+    int32_t x = (int16_t)(tail.data[1] | (tail.data[2] << 8)) + (int16_t)(next.data[1] | (next.data[2] << 8));
+    int32_t y = (int16_t)(tail.data[3] | (tail.data[4] << 8)) + (int16_t)(next.data[3] | (next.data[4] << 8));
+    int32_t wheel = (int8_t)tail.data[5] + (int8_t)next.data[5];
+    int32_t pan = (int8_t)tail.data[6] + (int8_t)next.data[6];
+    if (x < -32767 || x > 32767 || y < -32767 || y > 32767) return false;
+    if (wheel < -127 || wheel > 127 || pan < -127 || pan > 127) return false;
+    tail.data[1] = x & 0xFF;
+    tail.data[2] = (x >> 8) & 0xFF;
+    tail.data[3] = y & 0xFF;
+    tail.data[4] = (y >> 8) & 0xFF;
+    tail.data[5] = (uint8_t)wheel;
+    tail.data[6] = (uint8_t)pan;
+    return true;
+}
@@ -0,0 +1,70 @@
+// HIDReportQueue.h
+
+#ifndef HID_REPORT_QUEUE_H
+#define HID_REPORT_QUEUE_H
+
+#include <Arduino.h>
+#include "HIDReport.h"
+
+// Reports waiting for the HID endpoint, across all report types
+#define HID_REPORT_QUEUE_SIZE 32
+
+// What push() did with a report
+enum HIDQueueResult {
+    HID_QUEUE_ADDED,        // Appended, the endpoint has a new report to send
+    HID_QUEUE_COALESCED,    // Folded into the tail, or into the newest mouse report when full
+    HID_QUEUE_DUPLICATE,    // Same state as the shadow, nothing to send
+    HID_QUEUE_OVERWRITTEN,  // Queue full, replaced the newest report of its type
+    HID_QUEUE_DROPPED       // Queue full and nothing to replace
+};
+
+// Bounded transmit ring with a last-submitted shadow per report type.
+// Not thread safe, HIDHandler serializes access.
+class HIDReportQueue {
+public:
+    HIDReportQueue();
+
+    HIDQueueResult push(const HIDReport& next);
+    // True when push() would drop the report as a duplicate
+    bool matchesShadow(const HIDReport& next) const;
+
+    // Oldest report, nullptr when empty. pop() marks it as submitted.
+    HIDReport* front();
+    void pop();
+    // Drops everything queued, the host is assumed to start from empty reports
+    void clear();
+    void countDropped() { droppedReports++; }
+
+    uint8_t size() const { return count; }
+    uint8_t getHighWater() const { return highWater; }
+    uint32_t getSentReports() const { return sentReports; }
+    uint32_t getDroppedReports() const { return droppedReports; }
+    uint32_t getCoalescedReports() const { return coalescedReports; }
+    uint32_t getDuplicateReports() const { return duplicateReports; }
+
+    static bool canCoalesce(const HIDReport& previous, const HIDReport& tail, const HIDReport& next);
+    static bool mergeMouseReport(HIDReport& tail, const HIDReport& next);
+    static bool isDuplicate(const HIDReport& shadow, const HIDReport& next);
+    static void mergeKeyEvent(HIDReport& report, const HIDReport& next);
+
+private:
+    HIDReport& at(int8_t index) { return reports[(head + index) % HID_REPORT_QUEUE_SIZE]; }
+    const HIDReport& at(int8_t index) const { return reports[(head + index) % HID_REPORT_QUEUE_SIZE]; }
+    // Queue positions of the newest and second newest report of a type, -1 if none
+    void findNewest(HIDReportType type, int8_t& newest, int8_t& older) const;
+
+    HIDReport reports[HID_REPORT_QUEUE_SIZE];
+    uint8_t head = 0;
+    uint8_t count = 0;
+    // Last report handed to TinyUSB per type, what the host currently sees.
+    // With the queue it is the shadow that identical reports are checked against.
+    HIDReport lastSubmitted[HID_REPORT_TYPE_COUNT];
+
+    uint32_t sentReports = 0;
+    uint32_t coalescedReports = 0;
+    uint32_t duplicateReports = 0;
+    uint32_t droppedReports = 0;
+    uint8_t highWater = 0;
+};
+
+#endif // HID_REPORT_QUEUE_H
@@ -0,0 +1,44 @@
+// HidUsageTables.h
+// Generated by tools/gen_hid_usages.py from data/config/reports.json, do not edit
+
+#ifndef HID_USAGE_TABLES_H
+#define HID_USAGE_TABLES_H
+
+#include <stdint.h>
+
+struct HidUsageName {
+    const char* name;
+    uint16_t usage;
+};
+
+// Consumer page (0x0C) usages
+static const HidUsageName CONSUMER_USAGES[] = {
+    { "play_pause", 0x00CD },
+    { "stop", 0x00B7 },
+    { "mute", 0x00E2 },
+    { "volume_up", 0x00E9 },
+    { "volume_down", 0x00EA },
+    { "next_track", 0x00B5 },
+    { "prev_track", 0x00B6 },
+    { "email", 0x018A },
+    { "calculator", 0x0192 },
+    { "explorer", 0x0194 },
+    { "browser_home", 0x0223 },
+    { "browser_back", 0x0224 },
+    { "browser_forward", 0x0225 },
+    { "browser_refresh", 0x0227 },
+    { "browser_search", 0x0221 },
+    { "brightness_up", 0x006F },
+    { "brightness_down", 0x0070 },
+    { "media_player", 0x0183 },
+    { "file_browser", 0x01B4 },
+};
+
+// Generic Desktop System Control usages
+static const HidUsageName SYSTEM_USAGES[] = {
+    { "power_off", 0x0081 },
+    { "sleep", 0x0082 },
+    { "wake", 0x0083 },
+};
+
+#endif // HID_USAGE_TABLES_H
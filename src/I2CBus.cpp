@@ -0,0 +1,139 @@
+// I2CBus.cpp
+
+#include "I2CBus.h"
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+I2CBus i2cBus(&Wire);
+
+I2CBus::I2CBus(TwoWire* wire)
+    : wire(wire), started(false), sdaPin(-1), sclPin(-1), frequency(0), muxUsed(0),
+      transactionCount(0), errorCount(0), muxSwitches(0), muxSwitchesSaved(0),
+      busyUs(0), maxTransactionUs(0), statsStartMs(0)
+{
+    memset(muxState, I2C_MUX_UNKNOWN, sizeof(muxState));
+}
+
+bool I2CBus::begin(int8_t sda, int8_t scl, uint32_t clock) {
+    std::lock_guard<std::mutex> lock(busMutex);
+    if (started) {
+        if (sda != sdaPin || scl != sclPin) {
+            USBSerial.printf("I2C bus already on pins %d/%d, %d/%d ignored\n", sdaPin, sclPin, sda, scl);
+            return false;
+        }
+        // The slowest device sets the pace
+        if (clock && clock < frequency) {
+            wire->setClock(clock);
+            frequency = clock;
+        }
+        return true;
+    }
+
+    if (!wire->begin(sda, scl, clock)) {
+        USBSerial.println("I2C bus init failed");
+        return false;
+    }
+    started = true;
+    sdaPin = sda;
+    sclPin = scl;
+    frequency = clock;
+    statsStartMs = millis();
+    USBSerial.printf("I2C bus on pins %d/%d at %u Hz\n", sda, scl, clock);
+    return true;
+}
+
+bool I2CBus::transfer(const I2CDevice& device, const uint8_t* tx, uint8_t txLength, uint8_t* rx, uint8_t rxLength) {
+    if (!started) return false;
+
+    std::lock_guard<std::mutex> lock(busMutex);
+    uint32_t start = micros();
+    bool ok = selectChannel(device) && execute(device.address, tx, txLength, rx, rxLength);
+    uint32_t elapsed = micros() - start;
+
+    transactionCount++;
+    if (!ok) errorCount++;
+    busyUs += elapsed;
+    if (elapsed > maxTransactionUs) maxTransactionUs = elapsed;
+    return ok;
+}
+
+// Opens the device's channel and closes every other multiplexer in use, so
+// devices sharing an address behind different multiplexers never answer
+// together. A multiplexer already in the wanted state is not written.
+bool I2CBus::selectChannel(const I2CDevice& device) {
+    int8_t target = -1;
+    if (device.muxAddress >= I2C_MUX_BASE_ADDRESS && device.muxAddress < I2C_MUX_BASE_ADDRESS + I2C_MUX_COUNT &&
+        device.muxChannel < I2C_MUX_CHANNELS) {
+        target = device.muxAddress - I2C_MUX_BASE_ADDRESS;
+        muxUsed |= 1 << target;
+    }
+
+    for (uint8_t i = 0; i < I2C_MUX_COUNT; i++) {
+        if (!(muxUsed & (1 << i))) continue;
+
+        uint8_t mask = (int8_t)i == target ? 1 << device.muxChannel : 0;
+        if (muxState[i] == mask) {
+            if ((int8_t)i == target) muxSwitchesSaved++;
+            continue;
+        }
+        if (!execute(I2C_MUX_BASE_ADDRESS + i, &mask, 1, nullptr, 0)) {
+            muxState[i] = I2C_MUX_UNKNOWN;
+            return false;
+        }
+        muxState[i] = mask;
+        muxSwitches++;
+    }
+    return true;
+}
+
+bool I2CBus::execute(uint8_t address, const uint8_t* tx, uint8_t txLength, uint8_t* rx, uint8_t rxLength) {
+    if (txLength || !rxLength) {
+        wire->beginTransmission(address);
+        if (txLength) wire->write(tx, txLength);
+        // Repeated start when a read follows
+        if (wire->endTransmission(rxLength == 0) != 0) return false;
+    }
+    if (rxLength) {
+        if (wire->requestFrom(address, rxLength) != rxLength) return false;
+        for (uint8_t i = 0; i < rxLength; i++) {
+            rx[i] = wire->read();
+        }
+    }
+    return true;
+}
+
+void I2CBus::resetStats() {
+    std::lock_guard<std::mutex> lock(busMutex);
+    transactionCount = 0;
+    errorCount = 0;
+    muxSwitches = 0;
+    muxSwitchesSaved = 0;
+    busyUs = 0;
+    maxTransactionUs = 0;
+    statsStartMs = millis();
+}
+
+void I2CBus::print() {
+    USBSerial.println("\n--- I2C Bus ---");
+    if (!started) {
+        USBSerial.println("Not started");
+        USBSerial.println("---------------\n");
+        return;
+    }
+    uint32_t elapsedMs = millis() - statsStartMs;
+    uint32_t permille = elapsedMs ? (uint32_t)(busyUs / elapsedMs) : 0;
+    USBSerial.printf("Pins %d/%d at %u Hz\n", sdaPin, sclPin, frequency);
+    USBSerial.printf("Transactions: %u, errors: %u, avg %u us, max %u us\n", transactionCount, errorCount,
+                  transactionCount ? (uint32_t)(busyUs / transactionCount) : 0, maxTransactionUs);
+    USBSerial.printf("Utilisation: %u.%u%% over %u ms\n", permille / 10, permille % 10, elapsedMs);
+    if (muxUsed) {
+        USBSerial.printf("Multiplexer switches: %u, skipped: %u\n", muxSwitches, muxSwitchesSaved);
+        for (uint8_t i = 0; i < I2C_MUX_COUNT; i++) {
+            if (muxUsed & (1 << i)) {
+                USBSerial.printf("  0x%02X: channels 0x%02X\n", I2C_MUX_BASE_ADDRESS + i, muxState[i]);
+            }
+        }
+    }
+    USBSerial.println("---------------\n");
+}
@@ -0,0 +1,84 @@
+// I2CBus.h
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <mutex>
+
+// TCA9548A multiplexers answer on 0x70-0x77
+#define I2C_MUX_BASE_ADDRESS 0x70
+#define I2C_MUX_COUNT 8
+#define I2C_MUX_CHANNELS 8
+// Cached channel mask of a multiplexer that has not been written yet, or
+// whose last write failed
+#define I2C_MUX_UNKNOWN 0xFF
+
+// One device on the bus, optionally behind a multiplexer channel
+struct I2CDevice {
+    uint8_t address = 0;
+    uint8_t muxAddress = 0;     // 0x70-0x77, 0 = wired straight to the bus
+    uint8_t muxChannel = 0;
+
+    I2CDevice() {}
+    I2CDevice(uint8_t address, uint8_t muxAddress = 0, uint8_t muxChannel = 0)
+        : address(address), muxAddress(muxAddress), muxChannel(muxChannel) {}
+};
+
+// Owns one I2C controller for every driver that shares it. A transaction
+// holds the bus from the multiplexer switch to the last byte, callers from
+// other tasks wait their turn on the bus mutex. The channel each multiplexer
+// has open is cached, so consecutive transactions to one channel switch once.
+class I2CBus {
+public:
+    explicit I2CBus(TwoWire* wire);
+
+    // First call starts the controller, later ones must name the same pins
+    // and can only lower the clock to suit a slower device
+    bool begin(int8_t sdaPin, int8_t sclPin, uint32_t frequency);
+    bool isStarted() const { return started; }
+
+    // Writes tx, then reads rx after a repeated start. Either may be empty,
+    // a read alone continues from the device's current register pointer.
+    bool transfer(const I2CDevice& device, const uint8_t* tx, uint8_t txLength, uint8_t* rx, uint8_t rxLength);
+    bool write(const I2CDevice& device, const uint8_t* data, uint8_t length) {
+        return transfer(device, data, length, nullptr, 0);
+    }
+    bool read(const I2CDevice& device, uint8_t* data, uint8_t length) {
+        return transfer(device, nullptr, 0, data, length);
+    }
+    bool readRegisters(const I2CDevice& device, uint8_t reg, uint8_t* data, uint8_t length) {
+        return transfer(device, &reg, 1, data, length);
+    }
+
+    void resetStats();
+    void print();
+
+private:
+    bool selectChannel(const I2CDevice& device);
+    bool execute(uint8_t address, const uint8_t* tx, uint8_t txLength, uint8_t* rx, uint8_t rxLength);
+
+    TwoWire* wire;
+    std::mutex busMutex;
+    bool started;
+    int8_t sdaPin;
+    int8_t sclPin;
+    uint32_t frequency;
+
+    // Multiplexers seen so far and the channel mask each one has open
+    uint8_t muxUsed;
+    uint8_t muxState[I2C_MUX_COUNT];
+
+    uint32_t transactionCount;
+    uint32_t errorCount;
+    uint32_t muxSwitches;
+    uint32_t muxSwitchesSaved;  // Channel already open
+    uint64_t busyUs;            // Time holding the bus
+    uint32_t maxTransactionUs;
+    uint32_t statsStartMs;
+};
+
+extern I2CBus i2cBus;
+
+#endif // I2C_BUS_H
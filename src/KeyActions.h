@@ -0,0 +1,55 @@
+// KeyActions.h
+
+#ifndef KEY_ACTIONS_H
+#define KEY_ACTIONS_H
+
+#include <Arduino.h>
+
+// Action types for key events
+enum ActionType {
+    ACTION_NONE,
+    ACTION_HID,
+    ACTION_MULTIMEDIA,
+    ACTION_MACRO,
+    ACTION_LAYER,
+    ACTION_TRANSPARENT, // Falls through to the next active layer below
+    ACTION_TAP_HOLD,    // Dual-role key, resolved by the TapHoldEngine
+    ACTION_MOUSE,       // Mouse key, played by the MouseEngine
+    ACTION_SYSTEM       // System control (power down, sleep, wake)
+};
+
+// How a layer action changes the layer state
+enum LayerMode : uint8_t {
+    LAYER_MOMENTARY, // Active while the key is held
+    LAYER_TOGGLE,    // Each press flips the layer on or off
+    LAYER_ONESHOT,   // Active for the next non-layer key press only
+    LAYER_DEFAULT    // Replaces the base layer
+};
+
+// When a tap-hold key still pressed is decided as a hold
+enum TapHoldPolicy : uint8_t {
+    TAPHOLD_TAPPING_TERM,      // Only once the tapping term has elapsed
+    TAPHOLD_PERMISSIVE_HOLD,   // Also when another key is tapped (pressed and released) meanwhile
+    TAPHOLD_HOLD_ON_OTHER_KEY  // Also as soon as another key is pressed
+};
+
+// Marks an action without a compiled macro
+#define MACRO_NONE 0xFF
+
+// Compiled action, one per key per layer
+struct KeyConfig {
+    ActionType type = ACTION_NONE;
+    uint8_t hidReport[8] = {0};
+    uint8_t usageReport[2] = {0};   // Prebuilt consumer or system report
+    uint8_t macroIndex = MACRO_NONE;   // Compiled macro, resolved at load time
+    uint8_t mouseAction = 0;           // MouseAction
+    uint8_t targetLayer = 0;        // Layer index resolved at load time
+    LayerMode layerMode = LAYER_MOMENTARY;
+    // Tap-hold, the tap and hold actions live in the LayerManager action pool
+    uint16_t tappingTerm = 0;
+    TapHoldPolicy tapHoldPolicy = TAPHOLD_TAPPING_TERM;
+    uint8_t tapAction = 0;
+    uint8_t holdAction = 0;
+};
+
+#endif // KEY_ACTIONS_H
@@ -0,0 +1,49 @@
+// KeyEventQueue.cpp
+
+#include "KeyEventQueue.h"
+
+static_assert((KEY_EVENT_QUEUE_SIZE & (KEY_EVENT_QUEUE_SIZE - 1)) == 0,
+              "KEY_EVENT_QUEUE_SIZE must be a power of two");
+
+KeyEventQueue::KeyEventQueue()
+    : head(0), tail(0), overflowCount(0), highWaterMark(0)
+{
+}
+
+bool KeyEventQueue::push(const KeyEvent& event) {
+    uint32_t currentHead = head.load(std::memory_order_relaxed);
+    uint32_t used = currentHead - tail.load(std::memory_order_acquire);
+
+    if (used >= KEY_EVENT_QUEUE_SIZE) {
+        overflowCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    buffer[currentHead & (KEY_EVENT_QUEUE_SIZE - 1)] = event;
+    head.store(currentHead + 1, std::memory_order_release);
+
+    if (used + 1 > highWaterMark.load(std::memory_order_relaxed)) {
+        highWaterMark.store(used + 1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool KeyEventQueue::pop(KeyEvent& event) {
+    uint32_t currentTail = tail.load(std::memory_order_relaxed);
+    if (currentTail == head.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    event = buffer[currentTail & (KEY_EVENT_QUEUE_SIZE - 1)];
+    tail.store(currentTail + 1, std::memory_order_release);
+    return true;
+}
+
+uint32_t KeyEventQueue::size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+void KeyEventQueue::resetCounters() {
+    overflowCount.store(0, std::memory_order_relaxed);
+    highWaterMark.store(size(), std::memory_order_relaxed);
+}
@@ -0,0 +1,50 @@
+// KeyEventQueue.h
+
+#ifndef KEY_EVENT_QUEUE_H
+#define KEY_EVENT_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Capacity of each queue, must be a power of two
+#define KEY_EVENT_QUEUE_SIZE 64
+
+// Compact key event produced by the matrix scan
+struct KeyEvent {
+    uint32_t detectUs;      // Time the raw edge was first seen by the scan
+    uint32_t timestampUs;   // Time the debounced edge was accepted
+    uint8_t keyIndex;       // KeyHandler key index
+    uint8_t pressed;        // 1 = press edge, 0 = release edge
+    uint16_t reserved;
+};
+
+// Lock-free single-producer/single-consumer ring buffer. The scan task is the
+// only producer and push() never blocks; when the ring is full the event is
+// dropped and counted instead.
+class KeyEventQueue {
+public:
+    KeyEventQueue();
+
+    // Producer side
+    bool push(const KeyEvent& event);
+
+    // Consumer side
+    bool pop(KeyEvent& event);
+
+    uint32_t size() const;
+    uint32_t getOverflowCount() const { return overflowCount.load(std::memory_order_relaxed); }
+    uint32_t getHighWaterMark() const { return highWaterMark.load(std::memory_order_relaxed); }
+    void resetCounters();
+
+private:
+    KeyEvent buffer[KEY_EVENT_QUEUE_SIZE];
+
+    // Free-running indices, masked on access
+    std::atomic<uint32_t> head;   // Next slot to write, owned by the producer
+    std::atomic<uint32_t> tail;   // Next slot to read, owned by the consumer
+
+    std::atomic<uint32_t> overflowCount;
+    std::atomic<uint32_t> highWaterMark;
+};
+
+#endif // KEY_EVENT_QUEUE_H
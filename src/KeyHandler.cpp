@@ -3,6 +3,11 @@
 #include "KeyHandler.h"
 #include "HIDHandler.h"
 #include "ConfigManager.h"
+#include "LatencyStats.h"
+#include "LEDHandler.h"
+#include "MacroEngine.h"
+#include "MouseEngine.h"
+#include "ModuleSetup.h"
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
 #include <USBCDC.h>
@@ -12,34 +17,47 @@ extern USBCDC USBSerial;
 
 KeyHandler* keyHandler = nullptr;
 
-KeyHandler::KeyHandler(uint8_t rows, uint8_t cols, 
-                     const std::vector<Component>& components,
-                     uint8_t* rowsPins, uint8_t* colPins) {
+KeyHandler::KeyHandler(MatrixScanDriver* scanDriver,
+                     const std::vector<Component>& components) {
     // Initialize member variables
-    numRows = rows;
-    numCols = cols;
-    rowPins = nullptr;
-    this->colPins = nullptr;
+    driver = scanDriver;
+    numRows = driver ? driver->getRows() : 0;
+    numCols = driver ? driver->getCols() : 0;
     keypad = nullptr;
-    actionMap = nullptr;
+    pressedLayer = nullptr;
     keyStates = nullptr;
-    lastDebounceTime = nullptr;
     lastAction = nullptr;
+    matrixState = nullptr;
+    scanBuffer = nullptr;
+    portMUX_INITIALIZE(&editLock);
 
     // Validate input parameters
-    if (rows > 10 || cols > 10) {
+    if (!driver) {
+        USBSerial.println("Error: No matrix scan driver");
+        return;
+    }
+    if (numRows > MAX_MATRIX_ROWS || numCols > MAX_MATRIX_COLS) {
         USBSerial.println("Error: Matrix dimensions too large");
         return;
     }
+    
+    const uint8_t rows = numRows;
+    const uint8_t cols = numCols;
 
     try {
-        // Allocate pin arrays
-        rowPins = new uint8_t[rows];
-        this->colPins = new uint8_t[cols];
+        matrixState = new uint16_t[rows]();
+        scanBuffer = new uint16_t[rows]();
         
-        // Copy pin arrays
-        memcpy(rowPins, rowsPins, rows * sizeof(uint8_t));
-        memcpy(this->colPins, colPins, cols * sizeof(uint8_t));
+        // Record the footprint of non-key components so the scan skips it
+        keyTable.begin(rows, cols);
+        for (const Component& comp : components) {
+            if (comp.type != "display") continue;
+            for (uint8_t r = comp.startRow; r < comp.startRow + comp.rows && r < rows; r++) {
+                for (uint8_t c = comp.startCol; c < comp.startCol + comp.cols && c < cols; c++) {
+                    keyTable.reserve(r, c);
+                }
+            }
+        }
         
         // Store component positions for direct lookup
         for (const Component& comp : components) {
@@ -49,6 +67,8 @@ KeyHandler::KeyHandler(uint8_t rows, uint8_t cols,
                 pos.row = comp.startRow;
                 pos.col = comp.startCol;
                 pos.id = comp.id;
+                pos.debounceTime = comp.debounceTime;
+                pos.debounceMode = comp.debounceMode;
                 componentPositions.push_back(pos);
                 
                 USBSerial.printf("Mapped component %s to position [%d,%d]\n", 
@@ -59,15 +79,32 @@ KeyHandler::KeyHandler(uint8_t rows, uint8_t cols,
         // Sort positions for better lookup performance
         std::sort(componentPositions.begin(), componentPositions.end());
         
+        // Key states travel as uint32_t bitmasks through the scan
+        if (componentPositions.size() > KEY_LOOKUP_MAX_KEYS) {
+            USBSerial.printf("Error: too many keys (%d), at most %d supported\n",
+                          (int)componentPositions.size(), KEY_LOOKUP_MAX_KEYS);
+            cleanup();
+            return;
+        }
+        
         // Create key states array of sufficient size
         uint8_t totalKeys = componentPositions.size();
         keyStates = new bool[totalKeys]();
-        lastDebounceTime = new unsigned long[totalKeys]();
         lastAction = new KeyAction[totalKeys]();
         
-        // Create action map
-        actionMap = new KeyConfig[totalKeys];
-        memset(actionMap, 0, totalKeys * sizeof(KeyConfig));
+        // Per-key debounce, configured with module defaults until applySettings()
+        if (!debouncer.begin(totalKeys, KEY_SCAN_PERIOD_US)) {
+            USBSerial.printf("Error: too many keys for debouncer (%d)\n", totalKeys);
+            cleanup();
+            return;
+        }
+        applySettings(ModuleSettings());
+        
+        // Layer each key's press was resolved on, so the release matches it
+        pressedLayer = new uint8_t[totalKeys]();
+        
+        // Build the position -> key index table used by the scan loop
+        buildKeyLookup();
         
         USBSerial.printf("KeyHandler initialized with %d keys\n", totalKeys);
         
@@ -95,14 +132,9 @@ KeyHandler::~KeyHandler() {
 }
 
 void KeyHandler::cleanup() {
-    if (rowPins) {
-        delete[] rowPins;
-        rowPins = nullptr;
-    }
-    
-    if (colPins) {
-        delete[] colPins;
-        colPins = nullptr;
+    if (driver) {
+        delete driver;
+        driver = nullptr;
     }
     
     if (keypad) {
@@ -110,9 +142,9 @@ void KeyHandler::cleanup() {
         keypad = nullptr;
     }
     
-    if (actionMap) {
-        delete[] actionMap;
-        actionMap = nullptr;
+    if (pressedLayer) {
+        delete[] pressedLayer;
+        pressedLayer = nullptr;
     }
     
     if (keyStates) {
@@ -120,22 +152,68 @@ void KeyHandler::cleanup() {
         keyStates = nullptr;
     }
     
-    if (lastDebounceTime) {
-        delete[] lastDebounceTime;
-        lastDebounceTime = nullptr;
-    }
-    
     if (lastAction) {
         delete[] lastAction;
         lastAction = nullptr;
     }
     
+    if (matrixState) {
+        delete[] matrixState;
+        matrixState = nullptr;
+    }
+    
+    if (scanBuffer) {
+        delete[] scanBuffer;
+        scanBuffer = nullptr;
+    }
+    
     componentPositions.clear();
 }
 
+// Rebuild the dense matrix position -> key index table. Called from the
+// constructor and on every configuration load so the scan loop only does
+// constant-time lookups.
+void KeyHandler::buildKeyLookup() {
+    keyTable.clear();
+    
+    for (size_t i = 0; i < componentPositions.size(); i++) {
+        const ComponentPosition& pos = componentPositions[i];
+        KeyPlacement placement = keyTable.place(i, pos.row, pos.col);
+        if (placement == KEY_OUTSIDE_MATRIX) {
+            USBSerial.printf("Component %s at [%d,%d] is outside the matrix\n",
+                          pos.id.c_str(), pos.row, pos.col);
+        } else if (placement == KEY_INDEX_TOO_LARGE) {
+            USBSerial.printf("Component %s at [%d,%d] exceeds %d keys, ignored\n",
+                          pos.id.c_str(), pos.row, pos.col, KEY_LOOKUP_MAX_KEYS);
+        } else if (placement == KEY_ON_RESERVED_CELL) {
+            USBSerial.printf("Component %s at [%d,%d] overlaps the display, ignored\n",
+                          pos.id.c_str(), pos.row, pos.col);
+        }
+    }
+}
+
+// Resolve each key's debounce algorithm and window from its component
+// override or the module defaults in info.json
+void KeyHandler::applySettings(const ModuleSettings& settings) {
+    idleHoldoff = settings.idleHoldoff;
+    defaultTappingTerm = settings.tappingTerm;
+    combos.setWindow(settings.comboWindow);
+    
+    for (size_t i = 0; i < componentPositions.size(); i++) {
+        const ComponentPosition& pos = componentPositions[i];
+        uint16_t debounceTime = pos.debounceTime ? pos.debounceTime : settings.debounceTime;
+        const String& modeName = pos.debounceMode.isEmpty() ? settings.debounceMode : pos.debounceMode;
+        debouncer.setKeyConfig(i, DebounceEngine::modeFromString(modeName.c_str()), debounceTime);
+    }
+}
+
+void KeyHandler::setScanPeriod(uint32_t periodUs) {
+    debouncer.setScanPeriod(periodUs);
+}
+
 void KeyHandler::begin() {
     try {
-        USBSerial.println("KeyHandler initialization complete - using configuration from configurePinModes()");
+        USBSerial.println("KeyHandler initialization complete - pins configured by the scan driver");
     } 
     catch (...) {
         USBSerial.println("Error in KeyHandler::begin()");
@@ -146,238 +224,744 @@ uint8_t KeyHandler::getTotalKeys() {
     return componentPositions.size();
 }
 
-void KeyHandler::loadKeyConfiguration(const std::map<String, ActionConfig>& actions) {
+// Compile every layer of actions.json into the flat per-layer tables, and
+// the combos into the combo table
+void KeyHandler::loadKeyConfiguration(const std::vector<LayerConfig>& layerConfigs,
+                                      const std::vector<ComboConfig>& comboConfigs) {
     uint8_t totalKeys = componentPositions.size();
     
-    // Clear all configurations
-    for (uint8_t i = 0; i < totalKeys; i++) {
-        actionMap[i].type = ACTION_NONE;
-        memset(actionMap[i].hidReport, 0, sizeof(actionMap[i].hidReport));
-        memset(actionMap[i].consumerReport, 0, sizeof(actionMap[i].consumerReport));
-        actionMap[i].macroId = "";
-        actionMap[i].targetLayer = "";
+    uint8_t maxLayers = currentModule.numLayers ? min((int)currentModule.numLayers, MAX_LAYERS) : MAX_LAYERS;
+    uint8_t layerCount = max(1, min((int)layerConfigs.size(), (int)maxLayers));
+    if (layerConfigs.size() > layerCount) {
+        USBSerial.printf("Only %d of %d layers are supported, ignoring the rest\n",
+                      layerCount, layerConfigs.size());
     }
+    if (!layers.begin(layerCount, totalKeys)) return;
+    memset(pressedLayer, 0, totalKeys);
+    tapHoldHeld = 0;
+    
+    USBSerial.printf("Loading key configuration for %d keys, %d layers\n", totalKeys, layerCount);
     
-    USBSerial.printf("Loading key configuration for %d keys\n", totalKeys);
+    // Refresh the scan lookup table alongside the actions
+    buildKeyLookup();
+    
+    // Names first, layer actions refer to other layers by name
+    for (uint8_t layer = 0; layer < layerCount && layer < layerConfigs.size(); layer++) {
+        layers.setLayerName(layer, layerConfigs[layer].name);
+    }
     
-    // Load configurations for each component
-    for (uint8_t i = 0; i < totalKeys; i++) {
-        String id = componentPositions[i].id;
+    for (uint8_t layer = 0; layer < layerCount && layer < layerConfigs.size(); layer++) {
+        const std::map<String, ActionConfig>& actions = layerConfigs[layer].actions;
+        KeyConfig* table = layers.getLayerTable(layer);
         
-        // Check if we have actions for this component
-        if (actions.find(id) != actions.end()) {
-            const ActionConfig& ac = actions.at(id);
-            
-            USBSerial.printf("Configuring %s with action type: %s\n", 
-                          id.c_str(), ac.type.c_str());
+        USBSerial.printf("Layer %d: %s\n", layer, layerConfigs[layer].name.c_str());
+        
+        // Load configurations for each component
+        for (uint8_t i = 0; i < totalKeys; i++) {
+            const String& id = componentPositions[i].id;
             
-            if (ac.type == "hid") {
-                actionMap[i].type = ACTION_HID;
-                
-                if (!ac.hidReport.empty()) {
-                    if (HIDHandler::hexReportToBinary(ac.hidReport, actionMap[i].hidReport, 8)) {
-                        USBSerial.printf("HID report for %s: ", id.c_str());
-                        for (int j = 0; j < 8; j++) {
-                            USBSerial.printf("%02X ", actionMap[i].hidReport[j]);
-                        }
-                        USBSerial.println();
-                    } else {
-                        USBSerial.printf("Failed to convert HID report for %s\n", id.c_str());
-                    }
+            // Check if we have actions for this component
+            auto it = actions.find(id);
+            if (it != actions.end()) {
+                compileAction(id, it->second, table[i]);
+            } else if (layer == 0) {
+                USBSerial.printf("No action configured for %s\n", id.c_str());
+            }
+        }
+    }
+    
+    loadCombos(comboConfigs);
+    
+    USBSerial.println("Key configuration loaded successfully");
+}
+
+void KeyHandler::loadCombos(const std::vector<ComboConfig>& comboConfigs) {
+    combos.clear();
+    
+    for (const ComboConfig& cc : comboConfigs) {
+        // Resolve the key ids to a key index mask
+        uint32_t keyMask = 0;
+        bool valid = true;
+        for (const String& id : cc.keys) {
+            int8_t key = -1;
+            for (size_t i = 0; i < componentPositions.size() && i < COMBO_MAX_KEYS; i++) {
+                if (componentPositions[i].id == id) {
+                    key = i;
+                    break;
                 }
-            } 
-            else if (ac.type == "multimedia") {
-                actionMap[i].type = ACTION_MULTIMEDIA;
-                
-                if (!ac.consumerReport.empty()) {
-                    if (HIDHandler::hexReportToBinary(ac.consumerReport, actionMap[i].consumerReport, 4)) {
-                        USBSerial.printf("Consumer report for %s: ", id.c_str());
-                        for (int j = 0; j < 4; j++) {
-                            USBSerial.printf("%02X ", actionMap[i].consumerReport[j]);
-                        }
-                        USBSerial.println();
-                    } else {
-                        USBSerial.printf("Failed to convert Consumer report for %s\n", id.c_str());
-                    }
+            }
+            if (key < 0) {
+                USBSerial.printf("Unknown combo key %s\n", id.c_str());
+                valid = false;
+                break;
+            }
+            keyMask |= (1UL << key);
+        }
+        if (!valid) continue;
+        
+        KeyConfig action;
+        compileAction("combo", cc.action, action);
+        if (action.type == ACTION_TAP_HOLD) {
+            USBSerial.println("Tap-hold is not supported as a combo action");
+            continue;
+        }
+        
+        int16_t poolIndex = layers.addPooledAction(action);
+        int8_t combo = poolIndex < 0 ? -1 : combos.addCombo(keyMask);
+        if (combo < 0) {
+            USBSerial.printf("Combo 0x%08X rejected (duplicate, fewer than 2 keys or table full)\n", keyMask);
+            continue;
+        }
+        comboAction[combo] = poolIndex;
+    }
+    
+    USBSerial.printf("Compiled %d combos\n", combos.getComboCount());
+}
+
+void KeyHandler::compileAction(const String& id, const ActionConfig& ac, KeyConfig& config) {
+    USBSerial.printf("Configuring %s with action type: %s\n", 
+                  id.c_str(), ac.type.c_str());
+    
+    if (ac.type == "hid") {
+        config.type = ACTION_HID;
+        
+        if (!ac.hidReport.empty()) {
+            if (HIDHandler::hexReportToBinary(ac.hidReport, config.hidReport, 8)) {
+                USBSerial.printf("HID report for %s: ", id.c_str());
+                for (int j = 0; j < 8; j++) {
+                    USBSerial.printf("%02X ", config.hidReport[j]);
                 }
+                USBSerial.println();
+            } else {
+                USBSerial.printf("Failed to convert HID report for %s\n", id.c_str());
             }
-            else if (ac.type == "macro") {
-                actionMap[i].type = ACTION_MACRO;
-                actionMap[i].macroId = ac.macroId;
+        }
+    } 
+    else if (ac.type == "multimedia" || ac.type == "system") {
+        bool system = ac.type == "system";
+        config.type = system ? ACTION_SYSTEM : ACTION_MULTIMEDIA;
+        
+        uint16_t usage = 0;
+        if (!ac.usage.isEmpty()) {
+            if (!HIDHandler::usageFromString(system ? HID_REPORT_SYSTEM : HID_REPORT_CONSUMER, ac.usage, usage)) {
+                USBSerial.printf("Unknown %s usage '%s' for %s\n", ac.type.c_str(), ac.usage.c_str(), id.c_str());
+                config.type = ACTION_NONE;
+                return;
             }
-            else if (ac.type == "layer") {
-                actionMap[i].type = ACTION_LAYER;
-                actionMap[i].targetLayer = ac.targetLayer;
+        } else if (!ac.consumerReport.empty()) {
+            // Legacy 4-byte array, usage in bytes 2-3
+            uint8_t report[HID_CONSUMER_REPORT_SIZE] = {0};
+            if (!HIDHandler::hexReportToBinary(ac.consumerReport, report, HID_CONSUMER_REPORT_SIZE)) {
+                USBSerial.printf("Failed to convert Consumer report for %s\n", id.c_str());
+                config.type = ACTION_NONE;
+                return;
             }
+            usage = report[2] | (report[3] << 8);
+        }
+        HIDHandler::buildUsageReport(usage, config.usageReport);
+        USBSerial.printf("%s usage for %s: 0x%04X\n", system ? "System" : "Consumer", id.c_str(), usage);
+    }
+    else if (ac.type == "macro") {
+        config.type = ACTION_MACRO;
+        config.macroIndex = macroEngine.findMacro(ac.macroId);
+        if (config.macroIndex == MACRO_NONE) {
+            USBSerial.printf("Unknown macro '%s' for %s\n", ac.macroId.c_str(), id.c_str());
+            config.type = ACTION_NONE;
+            return;
+        }
+    }
+    else if (ac.type == "text") {
+        // Typed by the macro player, one report per character
+        config.type = ACTION_MACRO;
+        config.macroIndex = macroEngine.compileText(ac.text);
+        if (config.macroIndex == MACRO_NONE) {
+            config.type = ACTION_NONE;
+            return;
+        }
+    }
+    else if (ac.type == "mouse") {
+        config.type = ACTION_MOUSE;
+        config.mouseAction = MouseEngine::actionFromString(ac.mouseAction);
+        if (config.mouseAction == MOUSE_ACTION_NONE) {
+            USBSerial.printf("Unknown mouse action '%s' for %s\n", ac.mouseAction.c_str(), id.c_str());
+            config.type = ACTION_NONE;
+            return;
+        }
+    }
+    else if (ac.type == "layer") {
+        int8_t target = layers.findLayer(ac.targetLayer);
+        if (target < 0) {
+            USBSerial.printf("Unknown target layer '%s' for %s\n", ac.targetLayer.c_str(), id.c_str());
+            config.type = ACTION_NONE;
+            return;
+        }
+        config.type = ACTION_LAYER;
+        config.targetLayer = target;
+        if (ac.layerMode == "toggle") {
+            config.layerMode = LAYER_TOGGLE;
+        } else if (ac.layerMode == "oneshot") {
+            config.layerMode = LAYER_ONESHOT;
+        } else if (ac.layerMode == "default") {
+            config.layerMode = LAYER_DEFAULT;
         } else {
-            USBSerial.printf("No action configured for %s\n", id.c_str());
+            config.layerMode = LAYER_MOMENTARY;
         }
     }
-    
-    USBSerial.println("Key configuration loaded successfully");
+    else if (ac.type == "tap-hold" && ac.subActions.size() == 2) {
+        KeyConfig tap, hold;
+        compileAction(id, ac.subActions[0], tap);
+        compileAction(id, ac.subActions[1], hold);
+        if (tap.type == ACTION_TAP_HOLD || hold.type == ACTION_TAP_HOLD) {
+            USBSerial.printf("Nested tap-hold is not supported for %s\n", id.c_str());
+            return;
+        }
+        
+        int16_t tapIndex = layers.addPooledAction(tap);
+        int16_t holdIndex = layers.addPooledAction(hold);
+        if (tapIndex < 0 || holdIndex < 0) {
+            USBSerial.printf("Action pool full, tap-hold ignored for %s\n", id.c_str());
+            return;
+        }
+        
+        config.type = ACTION_TAP_HOLD;
+        config.tapAction = tapIndex;
+        config.holdAction = holdIndex;
+        config.tappingTerm = ac.tappingTerm ? ac.tappingTerm : defaultTappingTerm;
+        if (ac.tapHoldPolicy == "permissive-hold") {
+            config.tapHoldPolicy = TAPHOLD_PERMISSIVE_HOLD;
+        } else if (ac.tapHoldPolicy == "hold-on-other-key-press") {
+            config.tapHoldPolicy = TAPHOLD_HOLD_ON_OTHER_KEY;
+        } else {
+            config.tapHoldPolicy = TAPHOLD_TAPPING_TERM;
+        }
+    }
+    else if (ac.type == "transparent") {
+        config.type = ACTION_TRANSPARENT;
+    }
+    else if (ac.type == "none") {
+        // Explicitly blocks the layers below
+        config.type = ACTION_NONE;
+    }
 }
 
 void KeyHandler::updateKeys() {
-    static unsigned long lastScan = 0;
-    const unsigned long scanInterval = 20; // scan every 20ms
+    if (!driver || !matrixState) return;
+    
+    if (benchmarkRequested) {
+        benchmarkRequested = false;
+        driver->benchmark(keyTable.getRowMasks(), SCAN_BENCHMARK_ITERATIONS);
+        driver->resetScanStats();
+    }
+    
     unsigned long now = millis();
     
-    if (now - lastScan < scanInterval) return;
-    lastScan = now;
+    // Sample the whole matrix through the driver, then diff row by row
+    uint32_t scanStart = LatencyStats::now();
+    driver->scanMatrix(scanBuffer, keyTable.getRowMasks());
     
-    // Configure rows as OUTPUT and columns as INPUT_PULLUP
-    for (uint8_t r = 0; r < numRows; r++) {
-        pinMode(rowPins[r], OUTPUT);
-        digitalWrite(rowPins[r], HIGH); // Initially high (inactive)
+    // Only the changed keys go on to debounce and dispatch
+    uint32_t pressedKeys;
+    uint32_t sampledKeys = keyTable.diff(scanBuffer, matrixState, pressedKeys);
+    for (uint32_t changed = sampledKeys; changed; changed &= changed - 1) {
+        uint8_t componentIndex = __builtin_ctz(changed);
+        if (debouncer.update(componentIndex, (pressedKeys >> componentIndex) & 1, scanStart)) {
+            processKeyChange(componentIndex, debouncer.isPressed(componentIndex), scanStart);
+        }
     }
-    for (uint8_t c = 0; c < numCols; c++) {
-        pinMode(colPins[c], INPUT_PULLUP);
+    
+    // Keys still inside their debounce window need a sample without a new edge
+    for (uint32_t pending = debouncer.pendingKeys() & ~sampledKeys; pending; pending &= pending - 1) {
+        uint8_t componentIndex = __builtin_ctz(pending);
+        const ComponentPosition& pos = componentPositions[componentIndex];
+        
+        if (debouncer.update(componentIndex, (matrixState[pos.row] >> pos.col) & 1, scanStart)) {
+            processKeyChange(componentIndex, debouncer.isPressed(componentIndex), scanStart);
+        }
     }
     
-    // Scan all rows
-    for (uint8_t r = 0; r < numRows; r++) {
-        // Drive current row LOW
-        digitalWrite(rowPins[r], LOW);
-        delayMicroseconds(50); // Allow signals to stabilize
+    // Any key down or still settling keeps the matrix in active scanning
+    if (debouncer.pressedKeys() || debouncer.pendingKeys() || sampledKeys) {
+        lastActivityTime = now;
+    }
+}
+
+bool KeyHandler::readyForIdle() {
+    if (!matrixState || !driver->supportsIdleWait() || debouncer.pressedKeys() || debouncer.pendingKeys()) {
+        return false;
+    }
+    return millis() - lastActivityTime >= idleHoldoff;
+}
+
+// Block until the driver sees a key go down
+void KeyHandler::waitForKeyActivity() {
+    if (driver->waitForActivity()) {
+        idleWakeCount++;
+    }
+    
+    // Stay active for at least the hold-off
+    lastActivityTime = millis();
+}
+
+// Called from the scan loop: record the new state and hand the edge to the
+// consumers. Never blocks, a full queue only bumps its overflow counter.
+void KeyHandler::processKeyChange(uint8_t componentIndex, bool pressed, uint32_t timestampUs) {
+    keyStates[componentIndex] = pressed;
+    
+    KeyEvent event;
+    event.detectUs = debouncer.getEdgeStart(componentIndex);
+    event.timestampUs = timestampUs;
+    event.keyIndex = componentIndex;
+    event.pressed = pressed ? 1 : 0;
+    event.reserved = 0;
+    
+    latencyStats.record(LATENCY_DEBOUNCE, event.detectUs, event.timestampUs);
+    
+    dispatchQueue.push(event);
+    ledQueue.push(event);
+    
+    if (dispatchTask) {
+        xTaskNotifyGive(dispatchTask);
+    }
+}
+
+void KeyHandler::setDispatchTask(TaskHandle_t task) {
+    dispatchTask = task;
+}
+
+// Dispatch consumer: runs actions (HID sends, logging) off the scan task
+void KeyHandler::processKeyEvents() {
+    KeyEvent event;
+    bool dispatched = false;
+    applyKeyEdit();
+    applyLayerStep();
+    while (dispatchQueue.pop(event)) {
+        if (event.keyIndex >= componentPositions.size()) continue;
         
-        // Check columns
-        for (uint8_t c = 0; c < numCols; c++) {
-            // Find component at this position
-            int componentIndex = -1;
-            for (size_t i = 0; i < componentPositions.size(); i++) {
-                if (componentPositions[i].row == r && componentPositions[i].col == c) {
-                    componentIndex = i;
-                    break;
-                }
-            }
-            
-            // Skip positions without components
-            if (componentIndex == -1) continue;
-            
-            bool currentReading = (digitalRead(colPins[c]) == LOW);
-            
-            // Debouncing
-            if (now - lastDebounceTime[componentIndex] < DEBOUNCE_TIME) {
-                continue;
-            }
-            
-            // Process state change
-            if (currentReading != keyStates[componentIndex]) {
-                lastDebounceTime[componentIndex] = now;
-                keyStates[componentIndex] = currentReading;
-                
-                String componentId = componentPositions[componentIndex].id;
-                
-                // Log the event
-                USBSerial.printf("Key event: Row %d, Col %d, ID=%s, State=%s\n", 
-                              r, c, componentId.c_str(), 
-                              currentReading ? "PRESSED" : "RELEASED");
-                
-                // Sync LEDs
-                syncLEDsWithButtons(componentId.c_str(), currentReading);
-                
-                // Execute action
-                KeyAction action = currentReading ? KEY_PRESS : KEY_RELEASE;
-                if (lastAction[componentIndex] != action) {
-                    lastAction[componentIndex] = action;
-                    executeAction(componentIndex, action);
-                }
-            }
+        // Attribute the merged HID report to the oldest key event of the batch
+        uint32_t dispatchUs = LatencyStats::now();
+        latencyStats.record(LATENCY_DISPATCH, event.timestampUs, dispatchUs);
+        if (!dispatched) {
+            latencyStats.beginKeyDispatch(event.detectUs, dispatchUs);
+            dispatched = true;
         }
         
-        // Set row back to inactive
-        digitalWrite(rowPins[r], HIGH);
+#if KEY_EVENT_LOG
+        const ComponentPosition& pos = componentPositions[event.keyIndex];
+        USBSerial.printf("Key event: Row %d, Col %d, ID=%s, State=%s\n", 
+                      pos.row, pos.col, pos.id.c_str(), 
+                      event.pressed ? "PRESSED" : "RELEASED");
+#endif
+        
+        handleKeyEvent(event);
+    }
+    
+    // Combo window and tapping term expiry, the dispatch task wakes up for the deadlines
+    if (combos.isPending()) {
+        handleComboResult(combos.onTimer(LatencyStats::now()));
+    }
+    if (tapHold.isPending() && tapHold.onTimer(LatencyStats::now()) == TAPHOLD_HOLD) {
+        resolveTapHold(TAPHOLD_HOLD);
+    }
+    
+    // One keyboard report for everything that changed in this batch
+    if (hidHandler) {
+        hidHandler->flushKeyboardReport();
+    }
+    if (dispatched) {
+        latencyStats.endKeyDispatch();
+    }
+}
+
+// Combo stage: holds back keys that may form a combo
+void KeyHandler::handleKeyEvent(const KeyEvent& event) {
+    ComboResult result = combos.onEvent(event);
+    handleComboResult(result);
+    
+    if (result == COMBO_PASS) {
+        dispatchKeyEvent(event);
+    } else if (result == COMBO_FIRE && !event.pressed) {
+        // The release completed the combo, send the press before feeding it again
+        if (hidHandler) {
+            hidHandler->flushKeyboardReport();
+        }
+        handleKeyEvent(event);
+    }
+}
+
+void KeyHandler::handleComboResult(ComboResult result) {
+    switch (result) {
+        case COMBO_FIRE:
+        case COMBO_RELEASE: {
+            uint8_t combo = combos.getCombo();
+            KeyAction action = result == COMBO_FIRE ? KEY_PRESS : KEY_RELEASE;
+            uint8_t key = __builtin_ctz(combos.getKeyMask(combo));
+#if KEY_EVENT_LOG
+            USBSerial.printf("Combo %d %s\n", combo, action == KEY_PRESS ? "PRESSED" : "RELEASED");
+#endif
+            runAction(key, layers.getPooledAction(comboAction[combo]), action);
+            break;
+        }
+        default:
+            break;
+    }
+    
+    // Events held back by the combo stage continue to the tap-hold stage
+    if (result == COMBO_FIRE || result == COMBO_FLUSH) {
+        KeyEvent replay[COMBO_MAX_KEYS + 1];
+        uint8_t count = combos.takeBuffered(replay);
+        for (uint8_t i = 0; i < count; i++) {
+            dispatchKeyEvent(replay[i]);
+        }
+    }
+}
+
+// Tap-hold stage: routes a key event through the tap-hold engine before executing it
+void KeyHandler::dispatchKeyEvent(const KeyEvent& event) {
+    // Everything waits while a dual-role key is undecided
+    if (tapHold.isPending()) {
+        TapHoldDecision decision = tapHold.onEvent(event);
+        if (decision != TAPHOLD_UNDECIDED) {
+            resolveTapHold(decision);
+        }
+        return;
+    }
+    
+    uint8_t key = event.keyIndex;
+    KeyAction action = event.pressed ? KEY_PRESS : KEY_RELEASE;
+    if (lastAction[key] == action) return;
+    lastAction[key] = action;
+    
+    if (action == KEY_PRESS) {
+        uint8_t layer;
+        const KeyConfig& config = layers.resolve(key, layer);
+        if (config.type == ACTION_TAP_HOLD) {
+            pressedLayer[key] = layer;
+            tapHold.start(key, config, event.timestampUs);
+            return;
+        }
+    }
+    
+    executeAction(key, action);
+}
+
+// Runs the tap or hold action of the pending key, then replays the events
+// that arrived while it was undecided
+void KeyHandler::resolveTapHold(TapHoldDecision decision) {
+    uint8_t key = tapHold.getPendingKey();
+    const KeyConfig& config = layers.getAction(pressedLayer[key], key);
+    
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    uint8_t count = tapHold.finish(replay);
+    
+#if KEY_EVENT_LOG
+    USBSerial.printf("Tap-hold %s: %s, replaying %d events\n", 
+                  componentPositions[key].id.c_str(),
+                  decision == TAPHOLD_TAP ? "TAP" : "HOLD", count);
+#endif
+    
+    if (decision == TAPHOLD_TAP) {
+        // The key is already up: press and release the tap action, with a
+        // report in between so the host sees the keystroke
+        const KeyConfig& tap = layers.getPooledAction(config.tapAction);
+        runAction(key, tap, KEY_PRESS);
+        if (hidHandler) {
+            hidHandler->flushKeyboardReport();
+        }
+        runAction(key, tap, KEY_RELEASE);
+        lastAction[key] = KEY_RELEASE;
+    } else {
+        runAction(key, layers.getPooledAction(config.holdAction), KEY_PRESS);
+        tapHoldHeld |= (1UL << key);
+    }
+    
+    for (uint8_t i = 0; i < count; i++) {
+        dispatchKeyEvent(replay[i]);
+    }
+}
+
+bool KeyHandler::getKeyAction(uint8_t layer, uint8_t key, KeyConfig& config) {
+    if (layer >= layers.getNumLayers() || key >= componentPositions.size()) return false;
+    portENTER_CRITICAL(&editLock);
+    config = layers.getAction(layer, key);
+    portEXIT_CRITICAL(&editLock);
+    return true;
+}
+
+// Tap-hold entries reference pooled actions and are only compiled at load time
+bool KeyHandler::setKeyAction(uint8_t layer, uint8_t key, const KeyConfig& config) {
+    if (layer >= layers.getNumLayers() || key >= componentPositions.size()) return false;
+    if (config.type > ACTION_SYSTEM || config.type == ACTION_TAP_HOLD) return false;
+    if (config.type == ACTION_MACRO && config.macroIndex >= macroEngine.getMacroCount()) return false;
+    if (config.type == ACTION_LAYER &&
+        (config.targetLayer >= layers.getNumLayers() || config.layerMode > LAYER_DEFAULT)) return false;
+    if (config.type == ACTION_MOUSE &&
+        (config.mouseAction == MOUSE_ACTION_NONE || config.mouseAction > MOUSE_ACTION_BUTTON_FORWARD)) return false;
+
+    bool queued = false;
+    portENTER_CRITICAL(&editLock);
+    if (!editPending) {
+        editLayer = layer;
+        editKey = key;
+        editConfig = config;
+        editPending = true;
+        queued = true;
+    }
+    portEXIT_CRITICAL(&editLock);
+
+    if (queued && dispatchTask) {
+        xTaskNotifyGive(dispatchTask);
+    }
+    return queued;
+}
+
+void KeyHandler::applyKeyEdit() {
+    if (!editPending || lastAction[editKey] == KEY_PRESS) return;
+    portENTER_CRITICAL(&editLock);
+    uint8_t layer = editLayer;
+    uint8_t key = editKey;
+    ActionType type = editConfig.type;
+    layers.setAction(layer, key, editConfig);
+    editPending = false;
+    portEXIT_CRITICAL(&editLock);
+    USBSerial.printf("KeyHandler: %s on layer %d set to type %d\n",
+                  componentPositions[key].id.c_str(), layer, type);
+}
+
+void KeyHandler::compileEncoderAction(const String& id, const ActionConfig& ac, bool clockwise, KeyConfig& config) {
+    config = KeyConfig();
+    const std::vector<String>& values = clockwise ? ac.clockwise : ac.counterclockwise;
+    if (values.empty()) return;
+
+    // Same action with this direction's value in the field compileAction reads
+    ActionConfig step = ac;
+    step.usage = "";
+    step.consumerReport.clear();
+    if (ac.type == "hid") {
+        step.hidReport = values;
+    } else if (ac.type == "multimedia" || ac.type == "system") {
+        if (values.size() == 1) {
+            step.usage = values[0];
+        } else {
+            step.consumerReport = values;
+        }
+    } else if (ac.type == "mouse") {
+        step.mouseAction = values[0];
+    } else if (ac.type == "macro") {
+        step.macroId = values[0];
+    } else if (ac.type == "layer") {
+        step.targetLayer = values[0];
+    } else {
+        USBSerial.printf("Action type %s not supported for %s rotation\n", ac.type.c_str(), id.c_str());
+        return;
+    }
+    compileAction(id + (clockwise ? " clockwise" : " counterclockwise"), step, config);
+
+    if (config.type == ACTION_LAYER && config.layerMode == LAYER_MOMENTARY) {
+        // Released as soon as it is pressed, nothing would change
+        USBSerial.printf("Momentary layer has no effect on %s rotation\n", id.c_str());
+    }
+}
+
+bool KeyHandler::queueLayerStep(const KeyConfig& config) {
+    if (config.type != ACTION_LAYER) return false;
+
+    bool queued = false;
+    portENTER_CRITICAL(&editLock);
+    if (!layerStepPending) {
+        layerStep = config;
+        layerStepPending = true;
+        queued = true;
+    }
+    portEXIT_CRITICAL(&editLock);
+
+    if (queued && dispatchTask) {
+        xTaskNotifyGive(dispatchTask);
+    }
+    return queued;
+}
+
+void KeyHandler::applyLayerStep() {
+    if (!layerStepPending) return;
+    portENTER_CRITICAL(&editLock);
+    KeyConfig config = layerStep;
+    layerStepPending = false;
+    portEXIT_CRITICAL(&editLock);
+
+    layers.press(config);
+    layers.release(config);
+#if KEY_EVENT_LOG
+    USBSerial.printf("Active layers: 0x%04X (top %d)\n", 
+                  layers.getActiveMask(), layers.getHighestLayer());
+#endif
+}
+
+// How long the dispatch task may sleep before the next tap-hold deadline
+uint32_t KeyHandler::getDispatchTimeoutMs() {
+    uint32_t now = LatencyStats::now();
+    uint32_t timeoutMs = 100;
+    if (combos.isPending()) {
+        timeoutMs = min(timeoutMs, (uint32_t)(combos.timeUntilDeadline(now) / 1000 + 1));
+    }
+    if (tapHold.isPending()) {
+        timeoutMs = min(timeoutMs, (uint32_t)(tapHold.timeUntilDeadline(now) / 1000 + 1));
+    }
+    return timeoutMs;
+}
+
+// LED consumer: mirrors key state onto the button LEDs
+void KeyHandler::processLedEvents() {
+    KeyEvent event;
+    while (ledQueue.pop(event)) {
+        if (event.keyIndex >= componentPositions.size()) continue;
+        syncLEDsWithButtons(componentPositions[event.keyIndex].id.c_str(), event.pressed);
+    }
+    
+    // Layer changes are made by the dispatch task, the LEDs follow here
+    uint8_t layer = layers.getHighestLayer();
+    if (layer != shownLayer) {
+        shownLayer = layer;
+        showActiveLayer(layer);
     }
 }
 
 void KeyHandler::executeAction(uint8_t keyIndex, KeyAction action) {
-    if (keyIndex >= componentPositions.size() || !actionMap) {
+    if (keyIndex >= componentPositions.size() || !pressedLayer) {
         USBSerial.printf("Invalid key index: %d\n", keyIndex);
         return;
     }
     
-    const ComponentPosition& pos = componentPositions[keyIndex];
-    const KeyConfig& config = actionMap[keyIndex];
+    // A press resolves through the layer stack, the release replays the
+    // action of the layer the press landed on
+    uint8_t layer;
+    const KeyConfig* resolved;
+    if (action == KEY_PRESS) {
+        resolved = &layers.resolve(keyIndex, layer);
+        pressedLayer[keyIndex] = layer;
+    } else {
+        layer = pressedLayer[keyIndex];
+        resolved = &layers.getAction(layer, keyIndex);
+    }
+    const KeyConfig& config = *resolved;
     
-    // Print detailed action info
-    USBSerial.printf("KeyHandler: Executing action for %s at [%d,%d], type=%d (%s), action=%s\n", 
-                  pos.id.c_str(), pos.row, pos.col, config.type,
+#if KEY_EVENT_LOG
+    const ComponentPosition& pos = componentPositions[keyIndex];
+    USBSerial.printf("KeyHandler: Executing action for %s at [%d,%d] on layer %d, type=%d (%s), action=%s\n", 
+                  pos.id.c_str(), pos.row, pos.col, layer, config.type,
                   config.type == ACTION_HID ? "HID" : 
                   config.type == ACTION_MULTIMEDIA ? "MULTIMEDIA" : 
                   config.type == ACTION_MACRO ? "MACRO" : 
-                  config.type == ACTION_LAYER ? "LAYER" : "UNKNOWN",
+                  config.type == ACTION_LAYER ? "LAYER" : 
+                  config.type == ACTION_TAP_HOLD ? "TAP-HOLD" : 
+                  config.type == ACTION_MOUSE ? "MOUSE" : 
+                  config.type == ACTION_SYSTEM ? "SYSTEM" : "UNKNOWN",
                   action == KEY_PRESS ? "PRESS" : "RELEASE");
+#endif
     
+    runAction(keyIndex, config, action);
+}
+
+void KeyHandler::runAction(uint8_t keyIndex, const KeyConfig& config, KeyAction action) {
     switch (config.type) {
         case ACTION_HID:
             if (action == KEY_PRESS) {
+#if KEY_EVENT_LOG
                 USBSerial.print("HID Report: ");
                 for (int i = 0; i < 8; i++) {
                     USBSerial.printf("%02X ", config.hidReport[i]);
                 }
                 USBSerial.println();
+#endif
                 
                 if (hidHandler) {
-                    bool sent = hidHandler->sendKeyboardReport(config.hidReport);
-                    USBSerial.printf("HID report sent: %s\n", sent ? "SUCCESS" : "FAILED");
+                    hidHandler->pressKeyboardReport(config.hidReport);
                 }
             } else if (action == KEY_RELEASE) {
+                // Only this key's usages are released, other held keys stay down
                 if (hidHandler) {
-                    hidHandler->sendEmptyKeyboardReport();
+                    hidHandler->releaseKeyboardReport(config.hidReport);
                 }
             }
             break;
             
         case ACTION_MULTIMEDIA:
-            if (action == KEY_PRESS) {
-                USBSerial.print("Multimedia Report: ");
-                for (int i = 0; i < 4; i++) {
-                    USBSerial.printf("%02X ", config.consumerReport[i]);
-                }
-                USBSerial.println();
-                
-                if (hidHandler) {
-                    bool sent = hidHandler->sendConsumerReport(config.consumerReport);
-                    USBSerial.printf("Consumer report sent: %s\n", sent ? "SUCCESS" : "FAILED");
-                }
-            } else if (action == KEY_RELEASE) {
-                if (hidHandler) {
-                    hidHandler->sendEmptyConsumerReport();
-                }
+        case ACTION_SYSTEM: {
+            // Prebuilt at load, sent as is
+            static const uint8_t released[HID_USAGE_REPORT_SIZE] = {0};
+            HIDReportType type = config.type == ACTION_SYSTEM ? HID_REPORT_SYSTEM : HID_REPORT_CONSUMER;
+            if (hidHandler) {
+                hidHandler->sendUsageReport(type, action == KEY_PRESS ? config.usageReport : released);
             }
             break;
+        }
             
         case ACTION_MACRO:
-            if (action == KEY_PRESS && !config.macroId.isEmpty()) {
-                if (hidHandler) {
-                    hidHandler->executeMacro(config.macroId.c_str());
-                }
+            if (action == KEY_PRESS) {
+                macroEngine.play(config.macroIndex);
+            }
+            break;
+            
+        case ACTION_MOUSE:
+            if (action == KEY_PRESS) {
+                mouseEngine.press((MouseAction)config.mouseAction);
+            } else if (action == KEY_RELEASE) {
+                mouseEngine.release((MouseAction)config.mouseAction);
             }
             break;
             
         case ACTION_LAYER:
-            if (action == KEY_PRESS && !config.targetLayer.isEmpty()) {
-                // Layer switching code goes here
+            if (action == KEY_PRESS) {
+                layers.press(config);
+            } else if (action == KEY_RELEASE) {
+                layers.release(config);
+            }
+#if KEY_EVENT_LOG
+            USBSerial.printf("Active layers: 0x%04X (top %d)\n", 
+                          layers.getActiveMask(), layers.getHighestLayer());
+#endif
+            break;
+            
+        case ACTION_TAP_HOLD:
+            // Only reached on release, the press went through the tap-hold engine
+            if (action == KEY_RELEASE && (tapHoldHeld & (1UL << keyIndex))) {
+                tapHoldHeld &= ~(1UL << keyIndex);
+                runAction(keyIndex, layers.getPooledAction(config.holdAction), KEY_RELEASE);
             }
             break;
             
         case ACTION_NONE:
         default:
+#if KEY_EVENT_LOG
             USBSerial.printf("No action configured for key %d\n", keyIndex);
+#endif
             break;
     }
+    
+    // Any other key press ends a one-shot layer
+    if (action == KEY_PRESS && config.type != ACTION_LAYER && config.type != ACTION_TAP_HOLD) {
+        layers.consumeOneShot();
+    }
 }
 
 void KeyHandler::printKeyboardState() {
     USBSerial.println("\n--- Keyboard Matrix State ---");
     for (size_t i = 0; i < componentPositions.size(); i++) {
         const ComponentPosition& pos = componentPositions[i];
-        USBSerial.printf("%s at [%d,%d]: %s\n", 
+        USBSerial.printf("%s at [%d,%d]: %s (debounce %s %d ms)\n", 
                       pos.id.c_str(), 
                       pos.row, 
                       pos.col, 
-                      keyStates[i] ? "PRESSED" : "RELEASED");
+                      keyStates[i] ? "PRESSED" : "RELEASED",
+                      DebounceEngine::modeName(debouncer.getMode(i)),
+                      debouncer.getDebounceTime(i));
     }
+    USBSerial.printf("Scan driver %s: last %u us, avg %u us, max %u us\n", driver->name(),
+                  driver->getLastScanUs(), driver->getAvgScanUs(), driver->getMaxScanUs());
+    USBSerial.printf("Idle wake-ups: %u (hold-off %d ms)\n", idleWakeCount, idleHoldoff);
+    USBSerial.printf("Tap-hold: %u taps, %u holds\n", tapHold.getTapCount(), tapHold.getHoldCount());
+    USBSerial.printf("Combos: %d defined, %u fired\n", combos.getComboCount(), combos.getFireCount());
+    USBSerial.printf("Event queues: dispatch %u pending, %u overflows, high water %u; LED %u pending, %u overflows\n",
+                  dispatchQueue.size(), dispatchQueue.getOverflowCount(), dispatchQueue.getHighWaterMark(),
+                  ledQueue.size(), ledQueue.getOverflowCount());
     USBSerial.println("----------------------------\n");
 }
 
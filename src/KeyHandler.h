@@ -7,21 +7,30 @@
 #include <map>
 #include <vector>
 #include "ConfigManager.h"
+#include "DebounceEngine.h"
+#include "KeyEventQueue.h"
+#include "KeyLookupTable.h"
+#include "KeyActions.h"
+#include "LayerManager.h"
+#include "TapHoldEngine.h"
+#include "ComboEngine.h"
+#include "MatrixScanDriver.h"
 
 // Constants
 #define MAX_KEYS 25 // Maximum number of keys
-#define DEBOUNCE_TIME 50 // Debounce time in ms
+#define MAX_MATRIX_ROWS 10 // Largest supported matrix dimension
+#define MAX_MATRIX_COLS 10
+#define DEBOUNCE_TIME 50 // Default debounce time in ms
+#define KEY_SCAN_PERIOD_US 1000 // Default matrix scan period, see setScanPeriod()
+#define SCAN_BENCHMARK_ITERATIONS 500
 #define LIST_MAX 10 // As defined by Keypad library
 #define NO_KEY '\0' // No key pressed
 
-// Action types for key events
-enum ActionType {
-    ACTION_NONE,
-    ACTION_HID,
-    ACTION_MULTIMEDIA,
-    ACTION_MACRO,
-    ACTION_LAYER
-};
+// Logs every key, combo and tap-hold event. The prints run on the dispatch path
+// inside the measured latency, so they are off unless built with -DKEY_EVENT_LOG=1
+#ifndef KEY_EVENT_LOG
+#define KEY_EVENT_LOG 0
+#endif
 
 enum KeyAction {
     KEY_NONE,
@@ -29,25 +38,51 @@ enum KeyAction {
     KEY_RELEASE
 };
 
-struct KeyConfig {
-    ActionType type = ACTION_NONE;
-    uint8_t hidReport[8] = {0};
-    uint8_t consumerReport[4] = {0};
-    String macroId = "";
-    String targetLayer = "";
-};
-
 class KeyHandler {
 public:
-    KeyHandler(uint8_t rows, uint8_t cols, 
-              const std::vector<Component>& components,
-              uint8_t* rowPins, uint8_t* colPins);
+    // Takes ownership of the scan driver, which sets the matrix size
+    KeyHandler(MatrixScanDriver* driver, const std::vector<Component>& components);
     ~KeyHandler();
     
     void begin();
     uint8_t getTotalKeys();
     void updateKeys();
-    void loadKeyConfiguration(const std::map<String, ActionConfig>& actions);
+    void loadKeyConfiguration(const std::vector<LayerConfig>& layerConfigs,
+                              const std::vector<ComboConfig>& comboConfigs = std::vector<ComboConfig>());
+    void applySettings(const ModuleSettings& settings);
+    // Period the scan task calls updateKeys() at, used by the debouncer
+    void setScanPeriod(uint32_t periodUs);
+    // Runs the driver's scan benchmark on the next updateKeys()
+    void requestScanBenchmark() { benchmarkRequested = true; }
+    
+    // Idle scanning: once nothing has been pressed for the hold-off, the scan
+    // task can block on a column interrupt instead of polling the matrix.
+    // Only drivers that can raise an interrupt ever go idle.
+    bool readyForIdle();
+    void waitForKeyActivity();
+    
+    // Event consumers, each drains its own queue filled by the scan
+    void setDispatchTask(TaskHandle_t task);
+    void processKeyEvents();
+    uint32_t getDispatchTimeoutMs();
+    void processLedEvents();
+    
+    uint8_t getActiveLayer() const { return layers.getHighestLayer(); }
+    uint8_t getNumLayers() const { return layers.getNumLayers(); }
+    
+    // Runtime key edits (raw HID). An edit is applied on the dispatch task
+    // between events, and waits while the key is held so its release still
+    // matches the press. False while the previous edit is pending.
+    bool getKeyAction(uint8_t layer, uint8_t key, KeyConfig& config);
+    bool setKeyAction(uint8_t layer, uint8_t key, const KeyConfig& config);
+    bool isKeyEditPending() const { return editPending; }
+    
+    // Encoder rotation, compiled like a key action from the clockwise or
+    // counterclockwise entry of an encoder's action
+    void compileEncoderAction(const String& id, const ActionConfig& ac, bool clockwise, KeyConfig& config);
+    // Layer action of one encoder step, run on the dispatch task as a press
+    // and release. False while the previous step is pending.
+    bool queueLayerStep(const KeyConfig& config);
     
     // Add diagnostic methods
     void printKeyboardState();
@@ -55,20 +90,45 @@ public:
     
 private:
     void cleanup();
+    void handleKeyEvent(const KeyEvent& event);
+    void handleComboResult(ComboResult result);
+    void dispatchKeyEvent(const KeyEvent& event);
+    void loadCombos(const std::vector<ComboConfig>& comboConfigs);
+    void resolveTapHold(TapHoldDecision decision);
     void executeAction(uint8_t keyIndex, KeyAction action);
+    void runAction(uint8_t keyIndex, const KeyConfig& config, KeyAction action);
+    void compileAction(const String& id, const ActionConfig& ac, KeyConfig& config);
+    void buildKeyLookup();
+    void processKeyChange(uint8_t keyIndex, bool pressed, uint32_t timestampUs);
+    void applyKeyEdit();
+    void applyLayerStep();
     
     uint8_t numRows;
     uint8_t numCols;
-    uint8_t* rowPins;
-    uint8_t* colPins;
+    MatrixScanDriver* driver;
     Keypad* keypad;
-    KeyConfig* actionMap;
+    
+    // Compiled per-layer action tables and the active layer stack
+    LayerManager layers;
+    uint8_t* pressedLayer;
+    uint8_t shownLayer = 0;
+    
+    // Dual-role keys, decided on the dispatch task
+    TapHoldEngine tapHold;
+    uint32_t tapHoldHeld = 0;      // Tap-hold keys currently running their hold action
+    uint16_t defaultTappingTerm = 200;
+    
+    // Key combinations, matched ahead of the tap-hold stage
+    ComboEngine combos;
+    uint8_t comboAction[MAX_COMBOS]; // Pool index of each combo's action
     
     // Direct position mapping
     struct ComponentPosition {
         uint8_t row;
         uint8_t col;
         String id;
+        uint16_t debounceTime; // 0 = module default
+        String debounceMode;   // empty = module default
         bool operator<(const ComponentPosition& other) const {
             if (row != other.row) return row < other.row;
             return col < other.col;
@@ -76,11 +136,42 @@ private:
     };
     std::vector<ComponentPosition> componentPositions;
     
+    // Matrix position -> key index, with the display's cells reserved
+    KeyLookupTable keyTable;
+    
+    // Last raw sample per row, bit c set while [row, c] reads pressed
+    uint16_t* matrixState;
+    // Driver output for the current scan
+    uint16_t* scanBuffer;
+    
+    // Per-key debounce state
+    DebounceEngine debouncer;
+    
+    // Scan -> consumer event queues
+    KeyEventQueue dispatchQueue;
+    KeyEventQueue ledQueue;
+    TaskHandle_t dispatchTask = nullptr;
+    
+    // Idle scanning state
+    unsigned long lastActivityTime = 0;
+    uint16_t idleHoldoff = 2000;
+    uint32_t idleWakeCount = 0;
+    volatile bool benchmarkRequested = false;
+    
+    // Pending runtime key edit, handed from the raw HID handler to the dispatch task
+    portMUX_TYPE editLock;
+    volatile bool editPending = false;
+    uint8_t editLayer = 0;
+    uint8_t editKey = 0;
+    KeyConfig editConfig;
+    
+    // Pending encoder layer step, also guarded by editLock
+    volatile bool layerStepPending = false;
+    KeyConfig layerStep;
+    
     // Dynamic arrays for key states
     bool* keyStates;
-    unsigned long* lastDebounceTime;
     KeyAction* lastAction;
-    const unsigned long debounceDelay = 50;
 };
 
 extern KeyHandler* keyHandler;
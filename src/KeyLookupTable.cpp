@@ -0,0 +1,80 @@
+// KeyLookupTable.cpp
+
+#include "KeyLookupTable.h"
+
+KeyLookupTable::KeyLookupTable()
+    : numRows(0), numCols(0), table(nullptr), rowMask(nullptr), reservedMask(nullptr)
+{
+}
+
+KeyLookupTable::~KeyLookupTable() {
+    cleanup();
+}
+
+void KeyLookupTable::cleanup() {
+    delete[] table;
+    delete[] rowMask;
+    delete[] reservedMask;
+    table = nullptr;
+    rowMask = nullptr;
+    reservedMask = nullptr;
+    numRows = 0;
+    numCols = 0;
+}
+
+bool KeyLookupTable::begin(uint8_t rows, uint8_t cols) {
+    cleanup();
+    if (cols > 16) return false;
+
+    numRows = rows;
+    numCols = cols;
+    table = new uint8_t[rows * cols];
+    rowMask = new uint16_t[rows]();
+    reservedMask = new uint16_t[rows]();
+    memset(table, KEY_INDEX_NONE, rows * cols);
+    return true;
+}
+
+void KeyLookupTable::reserve(uint8_t row, uint8_t col) {
+    if (row >= numRows || col >= numCols) return;
+    reservedMask[row] |= (1 << col);
+}
+
+void KeyLookupTable::clear() {
+    if (!table) return;
+    memset(table, KEY_INDEX_NONE, numRows * numCols);
+    memset(rowMask, 0, numRows * sizeof(uint16_t));
+}
+
+KeyPlacement KeyLookupTable::place(uint8_t key, uint8_t row, uint8_t col) {
+    if (key >= KEY_LOOKUP_MAX_KEYS) return KEY_INDEX_TOO_LARGE;
+    if (row >= numRows || col >= numCols) return KEY_OUTSIDE_MATRIX;
+    if (reservedMask[row] & (1 << col)) return KEY_ON_RESERVED_CELL;
+
+    table[row * numCols + col] = key;
+    rowMask[row] |= (1 << col);
+    return KEY_PLACED;
+}
+
+uint32_t KeyLookupTable::diff(const uint16_t* sample, uint16_t* state, uint32_t& pressed) const {
+    uint32_t changedKeys = 0;
+    pressed = 0;
+    for (uint8_t r = 0; r < numRows; r++) {
+        // Rows without keys (e.g. fully covered by the display) are not sampled
+        if (!rowMask[r]) continue;
+
+        uint16_t bits = sample[r] & rowMask[r];
+        uint16_t changed = (bits ^ state[r]) & rowMask[r];
+        state[r] = bits;
+
+        // Only the changed cells are looked up
+        const uint8_t* rowKeys = &table[r * numCols];
+        for (; changed; changed &= changed - 1) {
+            uint8_t c = __builtin_ctz(changed);
+            uint32_t key = 1UL << rowKeys[c];
+            changedKeys |= key;
+            if (bits & (1 << c)) pressed |= key;
+        }
+    }
+    return changedKeys;
+}
@@ -0,0 +1,53 @@
+// KeyLookupTable.h
+
+#ifndef KEY_LOOKUP_TABLE_H
+#define KEY_LOOKUP_TABLE_H
+
+#include <Arduino.h>
+
+#define KEY_INDEX_NONE 0xFF // Table value for cells without a key
+#define KEY_LOOKUP_MAX_KEYS 32 // Key indices are bits of the uint32_t masks
+
+enum KeyPlacement {
+    KEY_PLACED,
+    KEY_OUTSIDE_MATRIX,
+    KEY_ON_RESERVED_CELL,  // Covered by a non-key component (display)
+    KEY_INDEX_TOO_LARGE    // Beyond KEY_LOOKUP_MAX_KEYS
+};
+
+// Dense [row * cols + col] -> key index table, plus a bitmask per row of the
+// cells that hold a key. Rebuilt on every configuration load so the scan only
+// does constant-time lookups, and empty or reserved cells are masked out
+// rather than tested. Key indices must be below KEY_LOOKUP_MAX_KEYS.
+class KeyLookupTable {
+public:
+    KeyLookupTable();
+    ~KeyLookupTable();
+
+    bool begin(uint8_t rows, uint8_t cols);
+    // Reserved cells never take a key
+    void reserve(uint8_t row, uint8_t col);
+    // Removes every key, reserved cells stay reserved
+    void clear();
+    KeyPlacement place(uint8_t key, uint8_t row, uint8_t col);
+
+    uint8_t getKey(uint8_t row, uint8_t col) const { return table[row * numCols + col]; }
+    // Bit c of row r set when [r, c] holds a key
+    const uint16_t* getRowMasks() const { return rowMask; }
+
+    // Compares a matrix sample with the previous one in state, which it then
+    // replaces. Returns a bitmask of the keys whose sample changed, pressed
+    // gets the ones among them that now read pressed.
+    uint32_t diff(const uint16_t* sample, uint16_t* state, uint32_t& pressed) const;
+
+private:
+    void cleanup();
+
+    uint8_t numRows;
+    uint8_t numCols;
+    uint8_t* table;
+    uint16_t* rowMask;
+    uint16_t* reservedMask;
+};
+
+#endif // KEY_LOOKUP_TABLE_H
@@ -22,6 +22,11 @@ uint8_t numLEDs = 0;
 // Button-LED mapping
 std::map<String, ButtonLEDMapping> buttonLEDMap;
 
+// Idle color of button LEDs per layer, index = layer. The base layer keeps
+// the per-LED colors from the config.
+std::vector<uint32_t> layerColors;
+static uint8_t indicatedLayer = 0;
+
 // Animation variables
 bool animationActive = false;
 uint8_t animationMode = 0;
@@ -188,6 +193,12 @@ void initializeLED() {
                         }
                     }
                     
+                    // Optional layer indicator colors, hex strings
+                    layerColors.clear();
+                    for (JsonVariant color : doc["leds"]["layer_colors"].as<JsonArray>()) {
+                        layerColors.push_back(strtoul(color.as<const char*>(), nullptr, 16));
+                    }
+                    
                     // Check for animation settings
                     if (doc["leds"]["animation"]["active"] | false) {
                         animationMode = doc["leds"]["animation"]["mode"] | 0;
@@ -605,6 +616,39 @@ uint32_t wheel(byte wheelPos) {
     return strip->Color(wheelPos * 3, 255 - wheelPos * 3, 0);
 }
 
+static bool layerTintActive() {
+    return indicatedLayer > 0 && indicatedLayer < layerColors.size();
+}
+
+// Writes the released color of an LED, tinted for the active layer
+static void showIdleColor(uint8_t index) {
+    uint8_t r = ledConfigs[index].r;
+    uint8_t g = ledConfigs[index].g;
+    uint8_t b = ledConfigs[index].b;
+    if (layerTintActive()) {
+        uint32_t color = layerColors[indicatedLayer];
+        r = (color >> 16) & 0xFF;
+        g = (color >> 8) & 0xFF;
+        b = color & 0xFF;
+    }
+    
+    float factor = ledConfigs[index].brightness / 255.0;
+    strip->setPixelColor(index, strip->Color(r * factor, g * factor, b * factor));
+}
+
+// Recolor the released button LEDs for the active layer
+void showActiveLayer(uint8_t layer) {
+    indicatedLayer = layer;
+    if (!strip || !ledConfigs || animationActive) return;
+    
+    for (uint8_t i = 0; i < numLEDs; i++) {
+        if (ledConfigs[i].buttonId.isEmpty() || ledConfigs[i].isActive) continue;
+        showIdleColor(i);
+    }
+    strip->show();
+    USBSerial.printf("LED layer indicator: layer %d\n", layer);
+}
+
 // Improved button-LED synchronization
 void syncLEDsWithButtons(const char* buttonId, bool pressed) {
     // Add debug output to track button events
@@ -636,6 +680,10 @@ void syncLEDsWithButtons(const char* buttonId, bool pressed) {
                         ledConfigs[index].pressedB,
                         ledConfigs[index].brightness,
                         true);
+                } else if (layerTintActive()) {
+                    // Button released on a tinted layer - restore the layer color
+                    showIdleColor(index);
+                    strip->show();
                 } else {
                     // Button released - restore default color
                     USBSerial.printf("  Setting LED %d to default color (%d,%d,%d)\n", 
@@ -672,6 +720,9 @@ void syncLEDsWithButtons(const char* buttonId, bool pressed) {
                         ledConfigs[buttonNum].pressedB,
                         ledConfigs[buttonNum].brightness,
                         true);
+                } else if (layerTintActive()) {
+                    showIdleColor(buttonNum);
+                    strip->show();
                 } else {
                     USBSerial.printf("  Setting fallback LED %d to default color\n", buttonNum);
                     setLEDColorWithBrightness(buttonNum,
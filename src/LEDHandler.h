@@ -72,6 +72,8 @@ void setGlobalBrightness(uint8_t brightness);
 
 // Button-LED sync function
 void syncLEDsWithButtons(const char* buttonId, bool pressed);
+// Layer indicator, tints released button LEDs with layer_colors[layer]
+void showActiveLayer(uint8_t layer);
 
 // Animation functions
 void startAnimation(uint8_t mode, uint16_t speed);
@@ -108,5 +110,6 @@ extern bool animationActive;
 extern uint8_t animationMode;
 extern uint16_t animationSpeed;
 extern std::map<String, ButtonLEDMapping> buttonLEDMap;
+extern std::vector<uint32_t> layerColors;
 
 #endif
\ No newline at end of file
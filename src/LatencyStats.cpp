@@ -0,0 +1,149 @@
+// LatencyStats.cpp
+
+#include "LatencyStats.h"
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+LatencyStats latencyStats;
+
+static const uint32_t bucketLimits[LATENCY_BUCKET_COUNT] = {
+    50, 100, 250, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, UINT32_MAX
+};
+
+LatencyStats::LatencyStats()
+    : dispatchOwner(nullptr), dispatchDetectUs(0), dispatchStartUs(0)
+{
+    portMUX_INITIALIZE(&lock);
+    clear();
+}
+
+void LatencyStats::record(LatencyStage stage, uint32_t startUs, uint32_t endUs) {
+    if (stage >= LATENCY_STAGE_COUNT) return;
+
+    uint32_t elapsed = endUs - startUs;
+    uint8_t bucket = 0;
+    while (elapsed > bucketLimits[bucket]) {
+        bucket++;
+    }
+
+    portENTER_CRITICAL(&lock);
+    LatencyHistogram& h = histograms[stage];
+    h.buckets[bucket]++;
+    h.count++;
+    h.sumUs += elapsed;
+    if (elapsed < h.minUs) h.minUs = elapsed;
+    if (elapsed > h.maxUs) h.maxUs = elapsed;
+    portEXIT_CRITICAL(&lock);
+}
+
+void LatencyStats::clear() {
+    memset(histograms, 0, sizeof(histograms));
+    for (uint8_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        histograms[i].minUs = UINT32_MAX;
+    }
+}
+
+void LatencyStats::reset() {
+    portENTER_CRITICAL(&lock);
+    clear();
+    portEXIT_CRITICAL(&lock);
+}
+
+void LatencyStats::beginKeyDispatch(uint32_t detectUs, uint32_t dispatchUs) {
+    dispatchDetectUs = detectUs;
+    dispatchStartUs = dispatchUs;
+    dispatchOwner = xTaskGetCurrentTaskHandle();
+}
+
+void LatencyStats::endKeyDispatch() {
+    dispatchOwner = nullptr;
+}
+
+// Hands the dispatch context to a report being queued by the dispatching
+// task. One sample per key event, further reports belong to the same action.
+bool LatencyStats::takeKeyDispatch(uint32_t& detectUs, uint32_t& dispatchUs) {
+    if (!dispatchOwner || dispatchOwner != xTaskGetCurrentTaskHandle()) return false;
+
+    detectUs = dispatchDetectUs;
+    dispatchUs = dispatchStartUs;
+    dispatchOwner = nullptr;
+    return true;
+}
+
+// Called right after a report was accepted by TinyUSB, on whichever task
+// drained it from the transmit queue
+void LatencyStats::recordUsbSubmit(uint32_t detectUs, uint32_t dispatchUs) {
+    uint32_t submitUs = now();
+    record(LATENCY_USB_SUBMIT, dispatchUs, submitUs);
+    record(LATENCY_TOTAL, detectUs, submitUs);
+}
+
+LatencyHistogram LatencyStats::getHistogram(LatencyStage stage) {
+    LatencyHistogram copy;
+    portENTER_CRITICAL(&lock);
+    copy = histograms[stage];
+    portEXIT_CRITICAL(&lock);
+    return copy;
+}
+
+void LatencyStats::toJson(JsonObject obj) {
+    for (uint8_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        LatencyHistogram h = getHistogram((LatencyStage)i);
+        JsonObject stage = obj.createNestedObject(stageName((LatencyStage)i));
+        stage["count"] = h.count;
+        stage["min_us"] = h.count ? h.minUs : 0;
+        stage["max_us"] = h.maxUs;
+        stage["avg_us"] = h.count ? (uint32_t)(h.sumUs / h.count) : 0;
+
+        JsonArray buckets = stage.createNestedArray("buckets");
+        for (uint8_t b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+            buckets.add(h.buckets[b]);
+        }
+    }
+
+    JsonArray limits = obj.createNestedArray("bucket_limits_us");
+    for (uint8_t b = 0; b < LATENCY_BUCKET_COUNT - 1; b++) {
+        limits.add(bucketLimits[b]);
+    }
+}
+
+void LatencyStats::print() {
+    USBSerial.println("\n--- Keypress Latency (us) ---");
+    for (uint8_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        LatencyHistogram h = getHistogram((LatencyStage)i);
+        USBSerial.printf("%-10s n=%u min=%u avg=%u max=%u\n",
+                      stageName((LatencyStage)i), h.count,
+                      h.count ? h.minUs : 0,
+                      h.count ? (uint32_t)(h.sumUs / h.count) : 0,
+                      h.maxUs);
+        for (uint8_t b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+            if (!h.buckets[b]) continue;
+            if (bucketLimits[b] == UINT32_MAX) {
+                USBSerial.printf("  >%6u: %u\n", bucketLimits[b - 1], h.buckets[b]);
+            } else {
+                USBSerial.printf("  <=%5u: %u\n", bucketLimits[b], h.buckets[b]);
+            }
+        }
+    }
+    USBSerial.println("-----------------------------\n");
+}
+
+const char* LatencyStats::stageName(LatencyStage stage) {
+    switch (stage) {
+        case LATENCY_DEBOUNCE:
+            return "debounce";
+        case LATENCY_DISPATCH:
+            return "dispatch";
+        case LATENCY_USB_SUBMIT:
+            return "usb_submit";
+        case LATENCY_TOTAL:
+            return "total";
+        default:
+            return "unknown";
+    }
+}
+
+uint32_t LatencyStats::bucketLimit(uint8_t bucket) {
+    return bucket < LATENCY_BUCKET_COUNT ? bucketLimits[bucket] : UINT32_MAX;
+}
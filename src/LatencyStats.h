@@ -0,0 +1,66 @@
+// LatencyStats.h
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "esp_timer.h"
+
+// Stages of the keypress path, each measured from the previous one
+enum LatencyStage {
+    LATENCY_DEBOUNCE,     // First raw edge -> debounce acceptance
+    LATENCY_DISPATCH,     // Debounce acceptance -> action dispatch
+    LATENCY_USB_SUBMIT,   // Action dispatch -> HID report handed to TinyUSB
+    LATENCY_TOTAL,        // First raw edge -> HID report handed to TinyUSB
+    LATENCY_STAGE_COUNT
+};
+
+// Fixed histogram bucket upper bounds in microseconds, last bucket is open ended
+#define LATENCY_BUCKET_COUNT 12
+
+struct LatencyHistogram {
+    uint32_t buckets[LATENCY_BUCKET_COUNT];
+    uint32_t count;
+    uint64_t sumUs;
+    uint32_t minUs;
+    uint32_t maxUs;
+};
+
+class LatencyStats {
+public:
+    LatencyStats();
+
+    static uint32_t now() { return (uint32_t)esp_timer_get_time(); }
+
+    void record(LatencyStage stage, uint32_t startUs, uint32_t endUs);
+    void reset();
+
+    // Key dispatch context. The first report the dispatching task queues takes
+    // the key event's timestamps, and records them once it is actually sent.
+    void beginKeyDispatch(uint32_t detectUs, uint32_t dispatchUs);
+    void endKeyDispatch();
+    bool takeKeyDispatch(uint32_t& detectUs, uint32_t& dispatchUs);
+    void recordUsbSubmit(uint32_t detectUs, uint32_t dispatchUs);
+
+    LatencyHistogram getHistogram(LatencyStage stage);
+    void toJson(JsonObject obj);
+    void print();
+
+    static const char* stageName(LatencyStage stage);
+    static uint32_t bucketLimit(uint8_t bucket);
+
+private:
+    void clear();
+
+    LatencyHistogram histograms[LATENCY_STAGE_COUNT];
+    portMUX_TYPE lock;
+
+    TaskHandle_t dispatchOwner;
+    uint32_t dispatchDetectUs;
+    uint32_t dispatchStartUs;
+};
+
+extern LatencyStats latencyStats;
+
+#endif // LATENCY_STATS_H
@@ -0,0 +1,173 @@
+// LayerManager.cpp
+
+#include "LayerManager.h"
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+LayerManager::LayerManager()
+    : numLayers(0), numKeys(0), tables(nullptr),
+      toggleMask(0), oneShotMask(0), defaultLayer(0), activeMask(1)
+{
+    memset(momentaryCount, 0, sizeof(momentaryCount));
+}
+
+LayerManager::~LayerManager() {
+    cleanup();
+}
+
+void LayerManager::cleanup() {
+    if (tables) {
+        delete[] tables;
+        tables = nullptr;
+    }
+    names.clear();
+    actionPool.clear();
+    numLayers = 0;
+    numKeys = 0;
+}
+
+bool LayerManager::begin(uint8_t layerCount, uint8_t keyCount) {
+    cleanup();
+    if (layerCount == 0 || layerCount > MAX_LAYERS) {
+        USBSerial.printf("Invalid layer count: %d\n", layerCount);
+        return false;
+    }
+
+    tables = new KeyConfig[layerCount * keyCount];
+    numLayers = layerCount;
+    numKeys = keyCount;
+    names.resize(layerCount);
+
+    // Keys without an entry fall through on every layer above the base
+    for (uint8_t layer = 1; layer < numLayers; layer++) {
+        for (uint8_t key = 0; key < numKeys; key++) {
+            tables[layer * numKeys + key].type = ACTION_TRANSPARENT;
+        }
+    }
+
+    reset();
+    return true;
+}
+
+KeyConfig* LayerManager::getLayerTable(uint8_t layer) {
+    if (!tables || layer >= numLayers) return nullptr;
+    return &tables[layer * numKeys];
+}
+
+void LayerManager::setLayerName(uint8_t layer, const String& name) {
+    if (layer < numLayers) names[layer] = name;
+}
+
+const String& LayerManager::getLayerName(uint8_t layer) const {
+    static const String empty;
+    return layer < numLayers ? names[layer] : empty;
+}
+
+// Accepts a layer name or a layer index
+int8_t LayerManager::findLayer(const String& name) const {
+    for (uint8_t i = 0; i < numLayers; i++) {
+        if (names[i] == name) return i;
+    }
+    if (name.length() > 0 && isDigit(name[0])) {
+        int index = name.toInt();
+        if (index >= 0 && index < numLayers) return index;
+    }
+    return -1;
+}
+
+const KeyConfig& LayerManager::resolve(uint8_t key, uint8_t& layer) const {
+    layer = defaultLayer;
+    if (!tables || key >= numKeys) return noAction;
+
+    uint16_t mask = activeMask;
+    while (mask) {
+        uint8_t l = 31 - __builtin_clz(mask);
+        const KeyConfig& config = tables[l * numKeys + key];
+        if (config.type != ACTION_TRANSPARENT) {
+            layer = l;
+            return config;
+        }
+        mask &= ~(1 << l);
+    }
+    return noAction;
+}
+
+bool LayerManager::setAction(uint8_t layer, uint8_t key, const KeyConfig& config) {
+    if (!tables || layer >= numLayers || key >= numKeys) return false;
+    tables[layer * numKeys + key] = config;
+    return true;
+}
+
+const KeyConfig& LayerManager::getAction(uint8_t layer, uint8_t key) const {
+    if (!tables || layer >= numLayers || key >= numKeys) return noAction;
+    return tables[layer * numKeys + key];
+}
+
+int16_t LayerManager::addPooledAction(const KeyConfig& config) {
+    if (actionPool.size() >= 255) return -1;
+    actionPool.push_back(config);
+    return actionPool.size() - 1;
+}
+
+const KeyConfig& LayerManager::getPooledAction(uint8_t index) const {
+    return index < actionPool.size() ? actionPool[index] : noAction;
+}
+
+void LayerManager::press(const KeyConfig& config) {
+    uint8_t layer = config.targetLayer;
+    if (config.type != ACTION_LAYER || layer >= numLayers) return;
+
+    switch (config.layerMode) {
+        case LAYER_MOMENTARY:
+            momentaryCount[layer]++;
+            break;
+        case LAYER_TOGGLE:
+            toggleMask ^= (1 << layer);
+            break;
+        case LAYER_ONESHOT:
+            oneShotMask |= (1 << layer);
+            break;
+        case LAYER_DEFAULT:
+            defaultLayer = layer;
+            break;
+    }
+    updateActiveMask();
+}
+
+void LayerManager::release(const KeyConfig& config) {
+    uint8_t layer = config.targetLayer;
+    if (config.type != ACTION_LAYER || layer >= numLayers) return;
+
+    if (config.layerMode == LAYER_MOMENTARY && momentaryCount[layer]) {
+        momentaryCount[layer]--;
+        updateActiveMask();
+    }
+}
+
+void LayerManager::consumeOneShot() {
+    if (!oneShotMask) return;
+    oneShotMask = 0;
+    updateActiveMask();
+}
+
+void LayerManager::reset() {
+    memset(momentaryCount, 0, sizeof(momentaryCount));
+    toggleMask = 0;
+    oneShotMask = 0;
+    defaultLayer = 0;
+    updateActiveMask();
+}
+
+uint8_t LayerManager::getHighestLayer() const {
+    uint16_t mask = activeMask;
+    return mask ? 31 - __builtin_clz(mask) : 0;
+}
+
+void LayerManager::updateActiveMask() {
+    uint16_t mask = (1 << defaultLayer) | toggleMask | oneShotMask;
+    for (uint8_t i = 0; i < numLayers; i++) {
+        if (momentaryCount[i]) mask |= (1 << i);
+    }
+    activeMask = mask;
+}
@@ -0,0 +1,70 @@
+// LayerManager.h
+
+#ifndef LAYER_MANAGER_H
+#define LAYER_MANAGER_H
+
+#include <Arduino.h>
+#include <vector>
+#include "KeyActions.h"
+
+// Layers are tracked in a 16-bit mask, layer 0 is the lowest
+#define MAX_LAYERS 8
+
+// Layer stack with momentary, toggle, one-shot and default layers. Each
+// layer's actions are compiled into a flat table indexed by key index, so
+// resolving a key is a walk down the active mask with one array lookup per layer.
+class LayerManager {
+public:
+    LayerManager();
+    ~LayerManager();
+
+    bool begin(uint8_t numLayers, uint8_t numKeys);
+    uint8_t getNumLayers() const { return numLayers; }
+
+    // Load time access, used to compile the tables
+    KeyConfig* getLayerTable(uint8_t layer);
+    void setLayerName(uint8_t layer, const String& name);
+    const String& getLayerName(uint8_t layer) const;
+    int8_t findLayer(const String& name) const;
+
+    // Highest active layer whose entry for the key is not transparent
+    const KeyConfig& resolve(uint8_t key, uint8_t& layer) const;
+    const KeyConfig& getAction(uint8_t layer, uint8_t key) const;
+    // Runtime edit of one entry, from the dispatch task
+    bool setAction(uint8_t layer, uint8_t key, const KeyConfig& config);
+    
+    // Secondary actions referenced by index from a KeyConfig (tap-hold)
+    int16_t addPooledAction(const KeyConfig& config);
+    const KeyConfig& getPooledAction(uint8_t index) const;
+
+    // Layer action edges
+    void press(const KeyConfig& config);
+    void release(const KeyConfig& config);
+    // Called after a non-layer key press, ends any one-shot layer
+    void consumeOneShot();
+    void reset();
+
+    uint16_t getActiveMask() const { return activeMask; }
+    uint8_t getHighestLayer() const;
+    uint8_t getDefaultLayer() const { return defaultLayer; }
+
+private:
+    void cleanup();
+    void updateActiveMask();
+
+    uint8_t numLayers;
+    uint8_t numKeys;
+    KeyConfig* tables;            // [layer * numKeys + key]
+    std::vector<String> names;
+    std::vector<KeyConfig> actionPool;
+
+    uint8_t momentaryCount[MAX_LAYERS]; // Keys currently holding each layer
+    uint16_t toggleMask;
+    uint16_t oneShotMask;
+    uint8_t defaultLayer;
+    volatile uint16_t activeMask;       // Read by the LED task
+
+    KeyConfig noAction;
+};
+
+#endif // LAYER_MANAGER_H
@@ -0,0 +1,78 @@
+// MacroCode.cpp
+
+#include "MacroCode.h"
+#include "AsciiKeymap.h"
+
+// Operand bytes per opcode, indexed by MacroOp
+static const uint8_t macroOperands[] = { 0, 1, 1, 1, 2, 2, 2 };
+
+bool MacroCode::validate(const uint8_t* code, uint16_t length) {
+    uint16_t pc = 0;
+    while (pc < length) {
+        uint8_t op = code[pc];
+        if (op >= sizeof(macroOperands)) return false;
+        if (op == MACRO_OP_END) return pc == length - 1;
+        pc += 1 + macroOperands[op];
+    }
+    return false;
+}
+
+void MacroCode::emitKeyDiff(std::vector<uint8_t>& code, const uint8_t* from, const uint8_t* to) {
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        bool was = from[0] & (1 << bit);
+        bool now = to[0] & (1 << bit);
+        if (was != now) {
+            code.push_back(now ? MACRO_OP_PRESS : MACRO_OP_RELEASE);
+            code.push_back(0xE0 + bit);
+        }
+    }
+    for (uint8_t i = 2; i < HID_KEYBOARD_REPORT_SIZE; i++) {
+        if (from[i] && !memchr(&to[2], from[i], 6)) {
+            code.push_back(MACRO_OP_RELEASE);
+            code.push_back(from[i]);
+        }
+    }
+    for (uint8_t i = 2; i < HID_KEYBOARD_REPORT_SIZE; i++) {
+        if (to[i] && !memchr(&from[2], to[i], 6)) {
+            code.push_back(MACRO_OP_PRESS);
+            code.push_back(to[i]);
+        }
+    }
+}
+
+// Characters go through ASCII_KEYMAP. A chord replaces the previous one in a
+// single report, only a repeated key needs a release in between.
+uint16_t MacroCode::emitText(std::vector<uint8_t>& code, const String& text) {
+    uint8_t lastUsage = 0;
+    uint16_t skipped = 0;
+    for (size_t i = 0; i < text.length(); i++) {
+        uint8_t c = text[i];
+        AsciiKey key = asciiToKey(c);
+        if (!key.usage) {
+            // UTF-8 continuation bytes are skipped with their lead byte
+            if ((c & 0xC0) != 0x80) skipped++;
+            continue;
+        }
+        if (key.usage == lastUsage) {
+            code.push_back(MACRO_OP_CHORD);
+            code.push_back(0);
+            code.push_back(0);
+        }
+        code.push_back(MACRO_OP_CHORD);
+        code.push_back(key.modifiers);
+        code.push_back(key.usage);
+        lastUsage = key.usage;
+    }
+    if (lastUsage) {
+        code.push_back(MACRO_OP_CHORD);
+        code.push_back(0);
+        code.push_back(0);
+    }
+    return skipped;
+}
+
+void MacroCode::emitDelay(std::vector<uint8_t>& code, uint16_t ms) {
+    code.push_back(MACRO_OP_DELAY);
+    code.push_back(ms & 0xFF);
+    code.push_back(ms >> 8);
+}
@@ -0,0 +1,45 @@
+// MacroCode.h
+
+#ifndef MACRO_CODE_H
+#define MACRO_CODE_H
+
+#include <Arduino.h>
+#include <vector>
+#include "HIDReport.h"
+
+// Bytecode, one opcode byte followed by its operands
+enum MacroOp : uint8_t {
+    MACRO_OP_END = 0x00,
+    MACRO_OP_PRESS,     // usage
+    MACRO_OP_RELEASE,   // usage
+    MACRO_OP_TAP,       // usage, pressed and released in consecutive reports
+    MACRO_OP_CONSUMER,  // usage lo, usage hi; 0 releases
+    MACRO_OP_DELAY,     // ms lo, ms hi
+    MACRO_OP_CHORD      // modifiers, usage; replaces the previous chord in one report
+};
+
+// A delay due further back than this is scheduled from the current time
+#define MACRO_RESYNC_US 10000UL
+
+// Emitters and checks for the macro bytecode, shared by the compiler, the
+// raw HID upload path and the player
+class MacroCode {
+public:
+    // Every opcode known with all of its operands, ending in exactly one END
+    static bool validate(const uint8_t* code, uint16_t length);
+
+    // Releases and presses that turn one keyboard report into the next
+    static void emitKeyDiff(std::vector<uint8_t>& code, const uint8_t* from, const uint8_t* to);
+    // One chord per character, returns how many characters have no key
+    static uint16_t emitText(std::vector<uint8_t>& code, const String& text);
+    static void emitDelay(std::vector<uint8_t>& code, uint16_t ms);
+
+    // Due time of the step after a delay. Counted from the previous due
+    // time so delays don't drift, unless playback has fallen far behind.
+    static uint32_t scheduleDelay(uint32_t dueUs, uint32_t nowUs, uint32_t delayUs) {
+        uint32_t base = (nowUs - dueUs < MACRO_RESYNC_US) ? dueUs : nowUs;
+        return base + delayUs;
+    }
+};
+
+#endif // MACRO_CODE_H
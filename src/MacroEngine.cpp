@@ -0,0 +1,493 @@
+// MacroEngine.cpp
+
+#include "MacroEngine.h"
+#include "HIDHandler.h"
+#include "LatencyStats.h"
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+MacroEngine macroEngine;
+
+MacroEngine::MacroEngine()
+    : compileUs(0), task(nullptr), timer(nullptr)
+{
+    portMUX_INITIALIZE(&lock);
+    memset(slots, 0, sizeof(slots));
+    resetStats();
+}
+
+MacroEngine::~MacroEngine() {
+}
+
+// Accepts "0x04", "4" or a single character key name is left to the caller
+bool MacroEngine::parseUsage(const String& text, uint16_t& usage) {
+    if (text.isEmpty()) return false;
+    char* end;
+    unsigned long value = strtoul(text.c_str(), &end, 0);
+    if (*end != '\0' || value > 0xFFFF) return false;
+    usage = value;
+    return true;
+}
+
+bool MacroEngine::compile(const std::vector<MacroConfig>& macros) {
+    uint32_t start = LatencyStats::now();
+    stopAll();
+
+    std::vector<uint8_t> code;
+    std::vector<String> newNames;
+    std::vector<uint16_t> newOffsets;
+    bool ok = true;
+
+    for (const MacroConfig& macro : macros) {
+        if (newNames.size() >= MAX_MACROS) {
+            USBSerial.printf("Too many macros, %s and later ignored\n", macro.name.c_str());
+            ok = false;
+            break;
+        }
+        size_t offset = code.size();
+        if (offset > 0xFFFF) {
+            USBSerial.println("Macro arena full");
+            ok = false;
+            break;
+        }
+
+        // Keyboard state left by report steps, so each report compiles to a diff
+        uint8_t current[HID_KEYBOARD_REPORT_SIZE] = {0};
+        bool valid = true;
+
+        for (const MacroStepConfig& step : macro.steps) {
+            uint16_t usage = 0;
+            if (step.op == "report") {
+                uint8_t next[HID_KEYBOARD_REPORT_SIZE] = {0};
+                if (!HIDHandler::hexReportToBinary(step.report, next, HID_KEYBOARD_REPORT_SIZE)) {
+                    valid = false;
+                    break;
+                }
+                MacroCode::emitKeyDiff(code, current, next);
+                memcpy(current, next, HID_KEYBOARD_REPORT_SIZE);
+            } else if (step.op == "text") {
+                emitText(code, step.text);
+            } else if (step.op == "delay") {
+                MacroCode::emitDelay(code, step.delayMs);
+                continue;
+            } else if (step.op == "consumer") {
+                if (!HIDHandler::usageFromString(HID_REPORT_CONSUMER, step.usage, usage)) {
+                    valid = false;
+                    break;
+                }
+                code.push_back(MACRO_OP_CONSUMER);
+                code.push_back(usage & 0xFF);
+                code.push_back(usage >> 8);
+                code.push_back(MACRO_OP_CONSUMER);
+                code.push_back(0);
+                code.push_back(0);
+            } else if (!parseUsage(step.usage, usage) || usage > 0xFF) {
+                valid = false;
+                break;
+            } else {
+                code.push_back(step.op == "press" ? MACRO_OP_PRESS :
+                               step.op == "release" ? MACRO_OP_RELEASE : MACRO_OP_TAP);
+                code.push_back(usage);
+            }
+
+            if (macro.interval) {
+                MacroCode::emitDelay(code, macro.interval);
+            }
+        }
+
+        if (!valid) {
+            USBSerial.printf("Macro %s has an invalid step, skipped\n", macro.name.c_str());
+            code.resize(offset);
+            ok = false;
+            continue;
+        }
+
+        // Report steps may leave keys down, the player releases held keys at the end
+        code.push_back(MACRO_OP_END);
+        newNames.push_back(macro.name);
+        newOffsets.push_back(offset);
+    }
+
+    arena.swap(code);
+    arena.shrink_to_fit();
+    names.swap(newNames);
+    offsets.swap(newOffsets);
+    compileUs = LatencyStats::now() - start;
+
+    USBSerial.printf("Compiled %d macros into %u bytes in %u us\n", names.size(), arena.size(), compileUs);
+    return ok;
+}
+
+// Appends a text action as an unnamed macro, after compile() at load time
+uint8_t MacroEngine::compileText(const String& text) {
+    if (names.size() >= MAX_MACROS || arena.size() > 0xFFFF) {
+        USBSerial.println("No room for text action");
+        return MACRO_NONE;
+    }
+    uint32_t start = LatencyStats::now();
+    uint16_t offset = arena.size();
+    emitText(arena, text);
+    arena.push_back(MACRO_OP_END);
+    // Quoted so no actions.json macro name can match it
+    names.push_back("\"" + text.substring(0, 16) + "\"");
+    offsets.push_back(offset);
+    compileUs += LatencyStats::now() - start;
+    return names.size() - 1;
+}
+
+void MacroEngine::emitText(std::vector<uint8_t>& code, const String& text) {
+    uint16_t skipped = MacroCode::emitText(code, text);
+    if (skipped) {
+        USBSerial.printf("Text action: %u characters have no key and are skipped\n", skipped);
+    }
+}
+
+uint8_t MacroEngine::findMacro(const String& name) const {
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name) return i;
+    }
+    return MACRO_NONE;
+}
+
+uint16_t MacroEngine::getMacroSize(uint8_t macro) const {
+    if (macro >= offsets.size()) return 0;
+    size_t end = ((size_t)macro + 1 < offsets.size()) ? offsets[macro + 1] : arena.size();
+    return end - offsets[macro];
+}
+
+uint16_t MacroEngine::readMacro(uint8_t macro, uint16_t offset, uint8_t* buffer, uint16_t length) const {
+    uint16_t size = getMacroSize(macro);
+    if (offset >= size) return 0;
+    if (length > size - offset) length = size - offset;
+    memcpy(buffer, &arena[offsets[macro] + offset], length);
+    return length;
+}
+
+// The arena is rebuilt beside the old one and swapped in under the slot lock,
+// so the player never sees it half written
+bool MacroEngine::replaceMacro(uint8_t macro, const uint8_t* code, uint16_t length) {
+    uint8_t count = offsets.size();
+    if (macro > count || macro >= MAX_MACROS || !MacroCode::validate(code, length)) return false;
+
+    std::vector<uint8_t> newArena;
+    std::vector<uint16_t> newOffsets;
+    std::vector<String> newNames(names);
+    newArena.reserve(arena.size() - getMacroSize(macro) + length);
+    for (uint8_t i = 0; i <= count; i++) {
+        if (newArena.size() > 0xFFFF) return false;
+        if (i == macro) {
+            newOffsets.push_back(newArena.size());
+            newArena.insert(newArena.end(), code, code + length);
+        } else if (i < count) {
+            newOffsets.push_back(newArena.size());
+            const uint8_t* begin = &arena[offsets[i]];
+            newArena.insert(newArena.end(), begin, begin + getMacroSize(i));
+        }
+    }
+    if (macro == count) newNames.push_back("#" + String(macro));
+
+    bool swapped = false;
+    portENTER_CRITICAL(&lock);
+    bool playing = false;
+    for (uint8_t i = 0; i < MAX_RUNNING_MACROS; i++) {
+        if (slots[i].active) playing = true;
+    }
+    if (!playing) {
+        arena.swap(newArena);
+        offsets.swap(newOffsets);
+        names.swap(newNames);
+        swapped = true;
+    }
+    portEXIT_CRITICAL(&lock);
+    return swapped;
+}
+
+bool MacroEngine::begin(UBaseType_t priority) {
+    esp_timer_create_args_t args = {};
+    args.callback = onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "macro_step";
+    if (esp_timer_create(&args, &timer) != ESP_OK) {
+        USBSerial.println("Macro timer creation failed");
+        timer = nullptr;
+        return false;
+    }
+
+    if (xTaskCreate(taskEntry, "macro_task", 4096, this, priority, &task) != pdPASS) {
+        USBSerial.println("Macro task creation failed");
+        task = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool MacroEngine::play(uint8_t macro) {
+    if (!task) return false;
+
+    bool started = false;
+    portENTER_CRITICAL(&lock);
+    // Checked under the lock, replaceMacro() swaps the tables under it
+    if (macro >= offsets.size()) {
+        portEXIT_CRITICAL(&lock);
+        return false;
+    }
+    bool running = false;
+    for (uint8_t i = 0; i < MAX_RUNNING_MACROS; i++) {
+        if (slots[i].active && slots[i].macro == macro) running = true;
+    }
+    for (uint8_t i = 0; i < MAX_RUNNING_MACROS && !running && !started; i++) {
+        MacroSlot& slot = slots[i];
+        if (slot.active) continue;
+        slot.macro = macro;
+        slot.pc = offsets[macro];
+        slot.wakeUs = LatencyStats::now();
+        slot.delayed = false;
+        slot.heldCount = 0;
+        slot.consumerHeld = false;
+        slot.chordModifiers = 0;
+        slot.chordUsage = 0;
+        slot.typedChars = 0;
+        slot.active = true;
+        started = true;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (!started) {
+        busyCount++;
+        return false;
+    }
+    playCount++;
+    xTaskNotifyGive(task);
+    return true;
+}
+
+void MacroEngine::stopAll() {
+    for (uint8_t i = 0; i < MAX_RUNNING_MACROS; i++) {
+        if (slots[i].active) finish(slots[i]);
+    }
+    if (hidHandler) hidHandler->flushKeyboardReport();
+}
+
+void MacroEngine::onTimer(void* arg) {
+    MacroEngine* engine = static_cast<MacroEngine*>(arg);
+    xTaskNotifyGive(engine->task);
+}
+
+void MacroEngine::taskEntry(void* arg) {
+    static_cast<MacroEngine*>(arg)->run();
+}
+
+void MacroEngine::run() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Run every slot that is due, as often as due slots remain
+        bool pending = true;
+        while (pending) {
+            pending = false;
+            uint32_t now = LatencyStats::now();
+            bool anyActive = false;
+            int32_t nextWait = INT32_MAX;
+
+            for (uint8_t i = 0; i < MAX_RUNNING_MACROS; i++) {
+                MacroSlot& slot = slots[i];
+                if (!slot.active) continue;
+
+                int32_t wait = (int32_t)(slot.wakeUs - now);
+                if (wait <= 0) {
+                    step(slot, now);
+                    if (!slot.active) continue;
+                    wait = (int32_t)(slot.wakeUs - now);
+                }
+                anyActive = true;
+                if (wait < nextWait) nextWait = wait;
+            }
+
+            // Everything this pass changed goes out as one merged report
+            if (hidHandler) hidHandler->flushKeyboardReport();
+
+            if (!anyActive) break;
+            if (nextWait <= 0) {
+                pending = true;
+                continue;
+            }
+            esp_timer_stop(timer);
+            esp_timer_start_once(timer, nextWait);
+        }
+    }
+}
+
+// Executes one slot until its next delay or the end of the macro
+void MacroEngine::step(MacroSlot& slot, uint32_t now) {
+    if (slot.delayed) {
+        uint32_t late = now - slot.wakeUs;
+        lateSumUs += late;
+        lateCount++;
+        if (late > lateMaxUs) lateMaxUs = late;
+        slot.delayed = false;
+    }
+    if (!hidHandler) {
+        finish(slot);
+        return;
+    }
+
+    while (true) {
+        // Let the endpoint catch up instead of overrunning the report queue
+        if (hidHandler->getQueueBacklog() >= MACRO_QUEUE_LIMIT) {
+            slot.wakeUs = now + 1000;
+            return;
+        }
+
+        const uint8_t* op = &arena[slot.pc];
+        stepCount++;
+        switch (op[0]) {
+            case MACRO_OP_PRESS:
+                hold(slot, op[1]);
+                slot.pc += 2;
+                break;
+            case MACRO_OP_RELEASE:
+                unhold(slot, op[1]);
+                slot.pc += 2;
+                break;
+            case MACRO_OP_TAP:
+                // The press has to reach the host in its own report, releasing
+                // before it is queued would lose the tap. Retry once the queue drains.
+                hidHandler->pressKey(op[1]);
+                if (!hidHandler->flushKeyboardReport()) {
+                    hidHandler->releaseKey(op[1]);
+                    if (!hidHandler->isMounted()) {
+                        finish(slot);
+                        return;
+                    }
+                    slot.wakeUs = now + 1000;
+                    return;
+                }
+                hidHandler->releaseKey(op[1]);
+                slot.pc += 2;
+                break;
+            case MACRO_OP_CHORD:
+                setChord(slot, op[1], op[2]);
+                // Every chord is its own report, sent as fast as the queue drains
+                hidHandler->flushKeyboardReport();
+                if (op[2]) {
+                    if (!slot.typedChars) slot.typeStartUs = now;
+                    slot.typedChars++;
+                }
+                slot.pc += 3;
+                break;
+            case MACRO_OP_CONSUMER: {
+                uint16_t usage = op[1] | (op[2] << 8);
+                hidHandler->flushKeyboardReport();
+                hidHandler->sendConsumerUsage(usage);
+                slot.consumerHeld = usage != 0;
+                slot.pc += 3;
+                break;
+            }
+            case MACRO_OP_DELAY: {
+                uint32_t delayUs = (uint32_t)(op[1] | (op[2] << 8)) * 1000UL;
+                slot.pc += 3;
+                if (!delayUs) break;
+                slot.wakeUs = MacroCode::scheduleDelay(slot.wakeUs, now, delayUs);
+                slot.delayed = true;
+                return;
+            }
+            case MACRO_OP_END:
+            default:
+                if (slot.typedChars) {
+                    // Typing ends once the host has taken the last report
+                    if (hidHandler->getQueueBacklog()) {
+                        slot.wakeUs = now + 1000;
+                        return;
+                    }
+                    recordTyping(slot.typedChars, now - slot.typeStartUs);
+                }
+                finish(slot);
+                return;
+        }
+    }
+}
+
+// Releases whatever the macro still holds and frees its slot
+void MacroEngine::finish(MacroSlot& slot) {
+    if (hidHandler) {
+        for (uint8_t i = 0; i < slot.heldCount; i++) {
+            hidHandler->releaseKey(slot.held[i]);
+        }
+        if (slot.consumerHeld) {
+            hidHandler->sendConsumerUsage(0);
+        }
+        setChord(slot, 0, 0);
+    }
+    slot.heldCount = 0;
+    slot.consumerHeld = false;
+    slot.active = false;
+}
+
+void MacroEngine::hold(MacroSlot& slot, uint8_t usage) {
+    if (slot.heldCount >= MACRO_MAX_HELD || memchr(slot.held, usage, slot.heldCount)) return;
+    slot.held[slot.heldCount++] = usage;
+    hidHandler->pressKey(usage);
+}
+
+void MacroEngine::unhold(MacroSlot& slot, uint8_t usage) {
+    uint8_t* entry = (uint8_t*)memchr(slot.held, usage, slot.heldCount);
+    if (!entry) return;
+    *entry = slot.held[--slot.heldCount];
+    hidHandler->releaseKey(usage);
+}
+
+// Swaps the slot's typing chord for another, the caller flushes
+void MacroEngine::setChord(MacroSlot& slot, uint8_t modifiers, uint8_t usage) {
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        if (slot.chordModifiers & (1 << bit)) hidHandler->releaseKey(0xE0 + bit);
+    }
+    if (slot.chordUsage) hidHandler->releaseKey(slot.chordUsage);
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        if (modifiers & (1 << bit)) hidHandler->pressKey(0xE0 + bit);
+    }
+    if (usage) hidHandler->pressKey(usage);
+    slot.chordModifiers = modifiers;
+    slot.chordUsage = usage;
+}
+
+void MacroEngine::recordTyping(uint32_t chars, uint32_t elapsedUs) {
+    if (!elapsedUs) return;
+    typedChars += chars;
+    typingUs += elapsedUs;
+    lastCharsPerSecond = (uint64_t)chars * 1000000ULL / elapsedUs;
+}
+
+void MacroEngine::resetStats() {
+    stepCount = 0;
+    lateSumUs = 0;
+    lateMaxUs = 0;
+    lateCount = 0;
+    playCount = 0;
+    busyCount = 0;
+    typedChars = 0;
+    typingUs = 0;
+    lastCharsPerSecond = 0;
+}
+
+void MacroEngine::print() {
+    USBSerial.println("\n--- Macros ---");
+    USBSerial.printf("%d macros, %u bytes of bytecode, compiled in %u us\n",
+                  names.size(), arena.size(), compileUs);
+    for (size_t i = 0; i < names.size(); i++) {
+        uint16_t end = (i + 1 < offsets.size()) ? offsets[i + 1] : arena.size();
+        USBSerial.printf("  %s: %u bytes\n", names[i].c_str(), end - offsets[i]);
+    }
+    USBSerial.printf("Played %u, rejected %u (busy), %u ops\n", playCount, busyCount, stepCount);
+    if (lateCount) {
+        USBSerial.printf("Step lateness: avg %u us, max %u us over %u delays\n",
+                      lateSumUs / lateCount, lateMaxUs, lateCount);
+    }
+    if (typingUs) {
+        USBSerial.printf("Typed %u chars in %u ms: %u chars/s, last run %u chars/s\n",
+                      typedChars, typingUs / 1000,
+                      (uint32_t)((uint64_t)typedChars * 1000000ULL / typingUs), lastCharsPerSecond);
+    }
+    USBSerial.println("--------------\n");
+}
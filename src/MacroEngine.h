@@ -0,0 +1,109 @@
+// MacroEngine.h
+
+#ifndef MACRO_ENGINE_H
+#define MACRO_ENGINE_H
+
+#include <Arduino.h>
+#include <vector>
+#include "esp_timer.h"
+#include "ConfigManager.h"
+#include "KeyActions.h"
+#include "MacroCode.h"
+
+#define MAX_MACROS 64
+#define MAX_RUNNING_MACROS 4
+// Keys a single macro can hold down at once
+#define MACRO_MAX_HELD 8
+// Playback pauses while this many reports are waiting for the endpoint
+#define MACRO_QUEUE_LIMIT (HID_REPORT_QUEUE_SIZE / 2)
+
+// Compiles actions.json macros into one contiguous bytecode arena and plays
+// them on a dedicated task woken by a one-shot esp_timer at each step's due
+// time. Several macros can run at once, each in its own slot.
+class MacroEngine {
+public:
+    MacroEngine();
+    ~MacroEngine();
+
+    // Replaces every macro, must not run while macros are playing
+    bool compile(const std::vector<MacroConfig>& macros);
+    // Compiles a text action into an unnamed macro, MACRO_NONE when full
+    uint8_t compileText(const String& text);
+    uint8_t findMacro(const String& name) const;
+    uint8_t getMacroCount() const { return names.size(); }
+
+    // Runtime access to the bytecode, from the raw HID handler
+    uint16_t getMacroSize(uint8_t macro) const;
+    uint16_t readMacro(uint8_t macro, uint16_t offset, uint8_t* buffer, uint16_t length) const;
+    // Replaces a macro's bytecode, or appends one when macro is the count.
+    // False when the code is malformed, the arena is full or a macro is playing.
+    bool replaceMacro(uint8_t macro, const uint8_t* code, uint16_t length);
+
+    // Starts the player task
+    bool begin(UBaseType_t priority);
+
+    // Starts a macro in a free slot. False when it is already running or all
+    // slots are busy.
+    bool play(uint8_t macro);
+    void stopAll();
+
+    void resetStats();
+    void print();
+
+private:
+    struct MacroSlot {
+        volatile bool active;
+        uint8_t macro;
+        uint16_t pc;
+        uint32_t wakeUs;
+        bool delayed;   // wakeUs is a scheduled delay, count its lateness
+        uint8_t held[MACRO_MAX_HELD];
+        uint8_t heldCount;
+        bool consumerHeld;
+        // Text typing
+        uint8_t chordModifiers;
+        uint8_t chordUsage;
+        uint32_t typedChars;
+        uint32_t typeStartUs;
+    };
+
+    static void taskEntry(void* arg);
+    static void onTimer(void* arg);
+    void run();
+    void step(MacroSlot& slot, uint32_t now);
+    void finish(MacroSlot& slot);
+    void hold(MacroSlot& slot, uint8_t usage);
+    void unhold(MacroSlot& slot, uint8_t usage);
+    void setChord(MacroSlot& slot, uint8_t modifiers, uint8_t usage);
+    void recordTyping(uint32_t chars, uint32_t elapsedUs);
+
+    // Compiler helpers
+    static bool parseUsage(const String& text, uint16_t& usage);
+    static void emitText(std::vector<uint8_t>& code, const String& text);
+
+    std::vector<uint8_t> arena;
+    std::vector<String> names;
+    std::vector<uint16_t> offsets;
+    uint32_t compileUs;
+
+    MacroSlot slots[MAX_RUNNING_MACROS];
+    portMUX_TYPE lock;
+    TaskHandle_t task;
+    esp_timer_handle_t timer;
+
+    // Step timing
+    uint32_t stepCount;
+    uint32_t lateSumUs;
+    uint32_t lateMaxUs;
+    uint32_t lateCount;
+    uint32_t playCount;
+    uint32_t busyCount;
+    // Text throughput, from the first character until the last report is taken
+    uint32_t typedChars;
+    uint32_t typingUs;
+    uint32_t lastCharsPerSecond;
+};
+
+extern MacroEngine macroEngine;
+
+#endif // MACRO_ENGINE_H
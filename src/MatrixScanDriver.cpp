@@ -0,0 +1,352 @@
+// MatrixScanDriver.cpp
+
+#include "MatrixScanDriver.h"
+#include "LatencyStats.h"
+#include <USBCDC.h>
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
+
+extern USBCDC USBSerial;
+
+// MCP23017 registers, IOCON.BANK = 0
+#define MCP23017_IODIRA 0x00
+#define MCP23017_IODIRB 0x01
+#define MCP23017_GPPUB  0x0D
+#define MCP23017_GPIOB  0x13
+#define MCP23017_OLATA  0x14
+
+MatrixScanDriver::MatrixScanDriver(uint8_t rows, uint8_t cols)
+    : numRows(rows), numCols(cols)
+{
+    resetScanStats();
+}
+
+void MatrixScanDriver::scanMatrix(uint16_t* rowState, const uint16_t* rowKeyMask) {
+    uint32_t start = LatencyStats::now();
+    scan(rowState, rowKeyMask);
+    lastScanUs = LatencyStats::now() - start;
+
+    if (lastScanUs > maxScanUs) maxScanUs = lastScanUs;
+    totalScanUs += lastScanUs;
+    scanCount++;
+}
+
+void MatrixScanDriver::resetScanStats() {
+    lastScanUs = 0;
+    maxScanUs = 0;
+    totalScanUs = 0;
+    scanCount = 0;
+}
+
+// Times scan() alone, without the per-scan bookkeeping of scanMatrix()
+uint32_t MatrixScanDriver::timeScans(const uint16_t* rowKeyMask, uint16_t iterations) {
+    uint16_t* rowState = new uint16_t[numRows]();
+    uint32_t start = LatencyStats::now();
+    for (uint16_t i = 0; i < iterations; i++) {
+        scan(rowState, rowKeyMask);
+    }
+    uint32_t elapsed = LatencyStats::now() - start;
+    delete[] rowState;
+    return iterations ? elapsed / iterations : 0;
+}
+
+void MatrixScanDriver::benchmark(const uint16_t* rowKeyMask, uint16_t iterations) {
+    USBSerial.printf("%s: %u us per scan (%u scans)\n", name(), timeScans(rowKeyMask, iterations), iterations);
+}
+
+// --- Direct GPIO ---
+
+// Valid GPIO pins for ESP32-S3 are 0-21 and 33-48, see GpioMatrixPins::isUsablePin()
+bool validateGpioPins(const uint8_t* pins, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (!GpioMatrixPins::isUsablePin(pins[i])) {
+            USBSerial.printf("Invalid GPIO pin for ESP32-S3: %d\n", pins[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+DirectGpioMatrixDriver::DirectGpioMatrixDriver(const std::vector<uint8_t>& rows,
+                                               const std::vector<uint8_t>& cols,
+                                               uint16_t settleUs)
+    : MatrixScanDriver(rows.size(), cols.size()), pins(rows.data(), rows.size(), cols.data(), cols.size()),
+      settleTimeUs(settleUs), idleWaitTask(nullptr)
+{
+}
+
+bool DirectGpioMatrixDriver::begin() {
+    if (!validateGpioPins(pins.getRowPins(), numRows) || !validateGpioPins(pins.getColPins(), numCols)) {
+        USBSerial.println("Invalid GPIO pins detected for ESP32-S3!");
+        return false;
+    }
+
+    configurePins();
+
+    USBSerial.printf("Matrix driver: direct GPIO, %dx%d, settle %d us\n", numRows, numCols, settleTimeUs);
+    for (uint8_t r = 0; r < numRows; r++) {
+        USBSerial.printf("  Row %d: GPIO %d\n", r, pins.getRowPins()[r]);
+    }
+    for (uint8_t c = 0; c < numCols; c++) {
+        USBSerial.printf("  Column %d: GPIO %d\n", c, pins.getColPins()[c]);
+    }
+    return true;
+}
+
+// Rows are outputs idling HIGH, columns inputs with pull-ups. Nothing else
+// touches these pins, so the directions hold for every later scan.
+void DirectGpioMatrixDriver::configurePins() {
+    const uint8_t* rowPins = pins.getRowPins();
+    const uint8_t* colPins = pins.getColPins();
+    for (uint8_t r = 0; r < numRows; r++) {
+        pinMode(rowPins[r], OUTPUT);
+        digitalWrite(rowPins[r], HIGH);
+    }
+    for (uint8_t c = 0; c < numCols; c++) {
+        pinMode(colPins[c], INPUT_PULLUP);
+    }
+}
+
+inline void DirectGpioMatrixDriver::driveRowLow(uint8_t row) {
+    if (pins.getRowBank(row)) {
+        REG_WRITE(GPIO_OUT1_W1TC_REG, pins.getRowBit(row));
+    } else {
+        REG_WRITE(GPIO_OUT_W1TC_REG, pins.getRowBit(row));
+    }
+}
+
+inline void DirectGpioMatrixDriver::releaseRows() {
+    if (pins.getRowBankMask(0)) REG_WRITE(GPIO_OUT_W1TS_REG, pins.getRowBankMask(0));
+    if (pins.getRowBankMask(1)) REG_WRITE(GPIO_OUT1_W1TS_REG, pins.getRowBankMask(1));
+}
+
+void DirectGpioMatrixDriver::scan(uint16_t* rowState, const uint16_t* rowKeyMask) {
+    for (uint8_t r = 0; r < numRows; r++) {
+        // Rows without keys (e.g. fully covered by the display) need no drive
+        if (!rowKeyMask[r]) continue;
+
+        driveRowLow(r);
+        // Let the previous row's columns float back up and this row's settle
+        delayMicroseconds(settleTimeUs);
+
+        // Sample every column at once
+        rowState[r] = readColumns();
+
+        releaseRows();
+    }
+}
+
+// Compares the old per-scan pin setup with a fixed 50 us settle against
+// the current scan, then sweeps the settle time
+void DirectGpioMatrixDriver::benchmark(const uint16_t* rowKeyMask, uint16_t iterations) {
+    uint16_t configured = settleTimeUs;
+
+    uint32_t start = LatencyStats::now();
+    for (uint16_t i = 0; i < iterations; i++) {
+        configurePins();
+    }
+    uint32_t configureUs = iterations ? (LatencyStats::now() - start) / iterations : 0;
+
+    settleTimeUs = 50;
+    uint32_t legacyUs = timeScans(rowKeyMask, iterations) + configureUs;
+
+    USBSerial.printf("\n--- Scan Benchmark (%u scans) ---\n", iterations);
+    USBSerial.printf("Pin setup per scan (removed): %u us\n", configureUs);
+    USBSerial.printf("Old scan (pin setup + 50 us settle): %u us\n", legacyUs);
+
+    const uint16_t settleTimes[] = { 50, 20, 10, 5, 2, 1 };
+    for (uint16_t settle : settleTimes) {
+        settleTimeUs = settle;
+        USBSerial.printf("Settle %2u us: %u us per scan\n", settle, timeScans(rowKeyMask, iterations));
+    }
+
+    settleTimeUs = configured;
+    USBSerial.printf("Configured settle %u us: %u us per scan\n", settleTimeUs, timeScans(rowKeyMask, iterations));
+    USBSerial.println("-------------------------------\n");
+}
+
+// Read all column inputs with one register read per GPIO bank and pack them
+// into a bitmask, bit c set when column c is pulled LOW (key pressed)
+uint16_t DirectGpioMatrixDriver::readColumns() {
+    uint32_t bankLow = REG_READ(GPIO_IN_REG);
+    uint32_t bankHigh = pins.hasHighBankColumns() ? REG_READ(GPIO_IN1_REG) : 0;
+    return pins.packColumns(bankLow, bankHigh);
+}
+
+void IRAM_ATTR DirectGpioMatrixDriver::onColumnEdge(void* arg) {
+    DirectGpioMatrixDriver* driver = static_cast<DirectGpioMatrixDriver*>(arg);
+    if (!driver->idleWaitTask) return;
+
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(driver->idleWaitTask, &higherPriorityTaskWoken);
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+// Drive every row LOW so any key pulls its column down, arm a falling-edge
+// interrupt on each column and block the calling task until one fires.
+bool DirectGpioMatrixDriver::waitForActivity() {
+    if (pins.getRowBankMask(0)) REG_WRITE(GPIO_OUT_W1TC_REG, pins.getRowBankMask(0));
+    if (pins.getRowBankMask(1)) REG_WRITE(GPIO_OUT1_W1TC_REG, pins.getRowBankMask(1));
+
+    // Clear any stale notification before arming
+    idleWaitTask = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);
+    for (uint8_t c = 0; c < numCols; c++) {
+        attachInterruptArg(digitalPinToInterrupt(pins.getColPins()[c]), onColumnEdge, this, FALLING);
+    }
+
+    // A key that went down while arming never produces an edge
+    delayMicroseconds(settleTimeUs);
+    bool waited = false;
+    if (readColumns() == 0) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        waited = true;
+    }
+
+    for (uint8_t c = 0; c < numCols; c++) {
+        detachInterrupt(digitalPinToInterrupt(pins.getColPins()[c]));
+    }
+    idleWaitTask = nullptr;
+
+    releaseRows();
+    return waited;
+}
+
+// --- 74HC165 shift registers ---
+
+ShiftRegisterMatrixDriver::ShiftRegisterMatrixDriver(uint8_t registers, int8_t load, int8_t clock,
+                                                     int8_t data, uint32_t frequency)
+    : MatrixScanDriver(registers, 8), loadPin(load), clockPin(clock), dataPin(data),
+      settings(frequency, MSBFIRST, SPI_MODE0), spi(nullptr)
+{
+    buffer = new uint8_t[registers];
+}
+
+ShiftRegisterMatrixDriver::~ShiftRegisterMatrixDriver() {
+    if (spi) {
+        spi->end();
+        delete spi;
+    }
+    delete[] buffer;
+}
+
+bool ShiftRegisterMatrixDriver::begin() {
+    if (loadPin < 0 || clockPin < 0 || dataPin < 0) {
+        USBSerial.println("74HC165 driver needs load, clock and data pins");
+        return false;
+    }
+
+    pinMode(loadPin, OUTPUT);
+    digitalWrite(loadPin, HIGH);
+
+    // Input only bus: SCK and MISO, no MOSI or chip select
+    spi = new SPIClass(HSPI);
+    spi->begin(clockPin, dataPin, -1, -1);
+
+    USBSerial.printf("Matrix driver: %d x 74HC165 on SCK %d, MISO %d, load %d\n",
+                  numRows, clockPin, dataPin, loadPin);
+    return true;
+}
+
+void ShiftRegisterMatrixDriver::scan(uint16_t* rowState, const uint16_t* rowKeyMask) {
+    // Latch all parallel inputs, then shift the whole chain in one transfer.
+    // The register furthest from the MCU comes out last.
+    digitalWrite(loadPin, LOW);
+    delayMicroseconds(1);
+    digitalWrite(loadPin, HIGH);
+
+    memset(buffer, 0xFF, numRows);
+    spi->beginTransaction(settings);
+    spi->transferBytes(buffer, buffer, numRows);
+    spi->endTransaction();
+
+    // Inputs are pulled up, a pressed key reads 0. Input H is shifted out first.
+    for (uint8_t r = 0; r < numRows; r++) {
+        uint8_t pressed = ~buffer[r];
+        uint16_t bits = 0;
+        for (uint8_t c = 0; c < 8; c++) {
+            bits |= ((pressed >> (7 - c)) & 1) << c;
+        }
+        rowState[r] = bits & rowKeyMask[r];
+    }
+}
+
+// --- MCP23017 I2C expander ---
+
+I2CExpanderMatrixDriver::I2CExpanderMatrixDriver(uint8_t rows, uint8_t cols, uint8_t addr,
+                                                 int8_t sda, int8_t scl, uint32_t freq)
+    : MatrixScanDriver(min((int)rows, 8), min((int)cols, 8)), address(addr),
+      sdaPin(sda), sclPin(scl), frequency(freq), wire(&Wire1), errorCount(0)
+{
+}
+
+bool I2CExpanderMatrixDriver::begin() {
+    // Second I2C controller, the first one is the encoders' shared i2cBus
+    if (!wire->begin(sdaPin, sclPin, frequency)) {
+        USBSerial.println("MCP23017 driver: I2C bus init failed");
+        return false;
+    }
+
+    // Port A rows as outputs, idle HIGH; port B columns as inputs with pull-ups
+    bool ok = writeRegister(MCP23017_OLATA, 0xFF)
+           && writeRegister(MCP23017_IODIRA, ~((1 << numRows) - 1) & 0xFF)
+           && writeRegister(MCP23017_IODIRB, 0xFF)
+           && writeRegister(MCP23017_GPPUB, 0xFF);
+    if (!ok) {
+        USBSerial.printf("MCP23017 at 0x%02X not responding\n", address);
+        return false;
+    }
+
+    USBSerial.printf("Matrix driver: MCP23017 at 0x%02X, %dx%d, %u Hz\n",
+                  address, numRows, numCols, frequency);
+    return true;
+}
+
+void I2CExpanderMatrixDriver::scan(uint16_t* rowState, const uint16_t* rowKeyMask) {
+    for (uint8_t r = 0; r < numRows; r++) {
+        if (!rowKeyMask[r]) continue;
+
+        uint8_t columns;
+        if (!writeRegister(MCP23017_OLATA, ~(1 << r) & 0xFF) ||
+            !readRegister(MCP23017_GPIOB, columns)) {
+            // Keep the last state rather than reporting phantom releases
+            errorCount++;
+            continue;
+        }
+        rowState[r] = ~columns & ((1 << numCols) - 1);
+    }
+    writeRegister(MCP23017_OLATA, 0xFF);
+}
+
+bool I2CExpanderMatrixDriver::writeRegister(uint8_t reg, uint8_t value) {
+    wire->beginTransmission(address);
+    wire->write(reg);
+    wire->write(value);
+    return wire->endTransmission() == 0;
+}
+
+bool I2CExpanderMatrixDriver::readRegister(uint8_t reg, uint8_t& value) {
+    wire->beginTransmission(address);
+    wire->write(reg);
+    if (wire->endTransmission(false) != 0) return false;
+    if (wire->requestFrom(address, (uint8_t)1) != 1) return false;
+    value = wire->read();
+    return true;
+}
+
+// --- Factory ---
+
+MatrixScanDriver* createMatrixDriver(const MatrixHardware& hardware) {
+    if (hardware.driver == "74hc165") {
+        return new ShiftRegisterMatrixDriver(hardware.rows, hardware.loadPin, hardware.clockPin,
+                                             hardware.dataPin, hardware.spiFrequency);
+    }
+    if (hardware.driver == "mcp23017") {
+        return new I2CExpanderMatrixDriver(hardware.rows, hardware.cols, hardware.i2cAddress,
+                                           hardware.sdaPin, hardware.sclPin, hardware.i2cFrequency);
+    }
+    if (hardware.driver != "gpio") {
+        USBSerial.printf("Unknown matrix driver '%s', using direct GPIO\n", hardware.driver.c_str());
+    }
+    return new DirectGpioMatrixDriver(hardware.rowPins, hardware.colPins, hardware.settleTimeUs);
+}
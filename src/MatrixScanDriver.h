@@ -0,0 +1,149 @@
+// MatrixScanDriver.h
+
+#ifndef MATRIX_SCAN_DRIVER_H
+#define MATRIX_SCAN_DRIVER_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <Wire.h>
+#include "ConfigManager.h"
+#include "GpioMatrixPins.h"
+
+// Reads the raw key matrix for KeyHandler. Every driver reports one bitmask
+// per row, bit c set while [row, c] reads pressed; debouncing and event
+// dispatch stay in KeyHandler.
+class MatrixScanDriver {
+public:
+    MatrixScanDriver(uint8_t rows, uint8_t cols);
+    virtual ~MatrixScanDriver() {}
+
+    virtual bool begin() = 0;
+    virtual const char* name() const = 0;
+
+    uint8_t getRows() const { return numRows; }
+    uint8_t getCols() const { return numCols; }
+
+    // Samples every row that has keys (rowKeyMask[r] != 0) into rowState and
+    // records the time the driver took
+    void scanMatrix(uint16_t* rowState, const uint16_t* rowKeyMask);
+
+    // Blocking wait for any key, for drivers that can raise an interrupt.
+    // Returns false straight away when a key is already down.
+    virtual bool supportsIdleWait() const { return false; }
+    virtual bool waitForActivity() { return false; }
+
+    // Per-scan cost in microseconds
+    uint32_t getLastScanUs() const { return lastScanUs; }
+    uint32_t getMaxScanUs() const { return maxScanUs; }
+    uint32_t getAvgScanUs() const { return scanCount ? (uint32_t)(totalScanUs / scanCount) : 0; }
+    void resetScanStats();
+    
+    // Times repeated scans and prints the results. Must run on the scan task.
+    virtual void benchmark(const uint16_t* rowKeyMask, uint16_t iterations);
+
+protected:
+    virtual void scan(uint16_t* rowState, const uint16_t* rowKeyMask) = 0;
+    // Average time of one scan() in microseconds
+    uint32_t timeScans(const uint16_t* rowKeyMask, uint16_t iterations);
+
+    uint8_t numRows;
+    uint8_t numCols;
+
+private:
+    uint32_t lastScanUs;
+    uint32_t maxScanUs;
+    uint64_t totalScanUs;
+    uint32_t scanCount;
+};
+
+// Rows and columns wired straight to ESP32 GPIOs. Pin directions are set
+// once in begin(); rows are driven with single W1TS/W1TC register writes
+// and columns sampled with one register read per GPIO bank.
+class DirectGpioMatrixDriver : public MatrixScanDriver {
+public:
+    DirectGpioMatrixDriver(const std::vector<uint8_t>& rowPins, const std::vector<uint8_t>& colPins,
+                           uint16_t settleTimeUs);
+
+    bool begin() override;
+    const char* name() const override { return "gpio"; }
+
+    bool supportsIdleWait() const override { return true; }
+    bool waitForActivity() override;
+
+    // Delay between driving a row and sampling the columns
+    void setSettleTime(uint16_t us) { settleTimeUs = us; }
+    uint16_t getSettleTime() const { return settleTimeUs; }
+    void benchmark(const uint16_t* rowKeyMask, uint16_t iterations) override;
+
+protected:
+    void scan(uint16_t* rowState, const uint16_t* rowKeyMask) override;
+
+private:
+    void configurePins();
+    uint16_t readColumns();
+    inline void driveRowLow(uint8_t row);
+    inline void releaseRows();
+    static void IRAM_ATTR onColumnEdge(void* arg);
+
+    GpioMatrixPins pins;
+    uint16_t settleTimeUs;
+
+    TaskHandle_t idleWaitTask;
+};
+
+// Chain of 74HC165 parallel-in shift registers read over SPI. Each register
+// is one matrix row of 8 keys wired to ground with pull-ups, so the whole
+// board is latched and shifted in a single burst.
+class ShiftRegisterMatrixDriver : public MatrixScanDriver {
+public:
+    ShiftRegisterMatrixDriver(uint8_t registers, int8_t loadPin, int8_t clockPin,
+                              int8_t dataPin, uint32_t frequency);
+    ~ShiftRegisterMatrixDriver();
+
+    bool begin() override;
+    const char* name() const override { return "74hc165"; }
+
+protected:
+    void scan(uint16_t* rowState, const uint16_t* rowKeyMask) override;
+
+private:
+    int8_t loadPin;
+    int8_t clockPin;
+    int8_t dataPin;
+    SPISettings settings;
+    SPIClass* spi;
+    uint8_t* buffer;
+};
+
+// MCP23017 I2C port expander: rows on port A driven low one at a time,
+// columns on port B with the expander's pull-ups, up to 8x8 keys.
+class I2CExpanderMatrixDriver : public MatrixScanDriver {
+public:
+    I2CExpanderMatrixDriver(uint8_t rows, uint8_t cols, uint8_t address,
+                            int8_t sdaPin, int8_t sclPin, uint32_t frequency);
+
+    bool begin() override;
+    const char* name() const override { return "mcp23017"; }
+
+protected:
+    void scan(uint16_t* rowState, const uint16_t* rowKeyMask) override;
+
+private:
+    bool writeRegister(uint8_t reg, uint8_t value);
+    bool readRegister(uint8_t reg, uint8_t& value);
+
+    uint8_t address;
+    int8_t sdaPin;
+    int8_t sclPin;
+    uint32_t frequency;
+    TwoWire* wire;
+    uint32_t errorCount;
+};
+
+// ESP32-S3 pins that are safe for the matrix
+bool validateGpioPins(const uint8_t* pins, uint8_t count);
+
+// Builds the driver selected by info.json hardware.matrix
+MatrixScanDriver* createMatrixDriver(const MatrixHardware& hardware);
+
+#endif // MATRIX_SCAN_DRIVER_H
@@ -0,0 +1,241 @@
+// MouseEngine.cpp
+
+#include "MouseEngine.h"
+#include "HIDHandler.h"
+#include "LatencyStats.h"
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+MouseEngine mouseEngine;
+
+static const char* const mouseActionNames[] = {
+    "none",
+    "move_up", "move_down", "move_left", "move_right",
+    "wheel_up", "wheel_down", "wheel_left", "wheel_right",
+    "button_left", "button_right", "button_middle", "button_back", "button_forward"
+};
+
+MouseEngine::MouseEngine()
+    : moveCurve(250, 1600, 1000, 2, 16),
+      wheelCurve(8, 40, 1500, 1, 1),
+      buttons(0), sentButtons(0), running(false), timer(nullptr)
+{
+    portMUX_INITIALIZE(&lock);
+    memset(held, 0, sizeof(held));
+    memset(pressUs, 0, sizeof(pressUs));
+    memset(carry, 0, sizeof(carry));
+    resetStats();
+}
+
+bool MouseEngine::begin(const ModuleSettings& settings) {
+    moveCurve = settings.mouseMove;
+    wheelCurve = settings.mouseWheel;
+
+    esp_timer_create_args_t args = {};
+    args.callback = onTick;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "mouse_tick";
+    if (esp_timer_create(&args, &timer) != ESP_OK) {
+        USBSerial.println("Mouse timer creation failed");
+        timer = nullptr;
+        return false;
+    }
+
+    USBSerial.printf("Mouse keys: move %u-%u px/s, wheel %u-%u detents/s\n",
+                  moveCurve.speed, moveCurve.maxSpeed, wheelCurve.speed, wheelCurve.maxSpeed);
+    return true;
+}
+
+MouseAction MouseEngine::actionFromString(const String& name) {
+    for (uint8_t i = 1; i < sizeof(mouseActionNames) / sizeof(mouseActionNames[0]); i++) {
+        if (name == mouseActionNames[i]) return (MouseAction)i;
+    }
+    return MOUSE_ACTION_NONE;
+}
+
+bool MouseEngine::actionAxis(MouseAction action, Axis& axis, int8_t& direction) {
+    switch (action) {
+        case MOUSE_ACTION_MOVE_UP:     axis = AXIS_Y;     direction = -1; return true;
+        case MOUSE_ACTION_MOVE_DOWN:   axis = AXIS_Y;     direction = 1;  return true;
+        case MOUSE_ACTION_MOVE_LEFT:   axis = AXIS_X;     direction = -1; return true;
+        case MOUSE_ACTION_MOVE_RIGHT:  axis = AXIS_X;     direction = 1;  return true;
+        case MOUSE_ACTION_WHEEL_UP:    axis = AXIS_WHEEL; direction = 1;  return true;
+        case MOUSE_ACTION_WHEEL_DOWN:  axis = AXIS_WHEEL; direction = -1; return true;
+        case MOUSE_ACTION_WHEEL_LEFT:  axis = AXIS_PAN;   direction = -1; return true;
+        case MOUSE_ACTION_WHEEL_RIGHT: axis = AXIS_PAN;   direction = 1;  return true;
+        default: return false;
+    }
+}
+
+void MouseEngine::press(MouseAction action) {
+    Axis axis;
+    int8_t direction;
+    portENTER_CRITICAL(&lock);
+    if (actionAxis(action, axis, direction)) {
+        int8_t& count = held[axis][direction > 0];
+        if (count++ == 0) {
+            // A new press restarts the ramp and moves one unit straight away
+            pressUs[axis] = LatencyStats::now();
+            carry[axis] = direction * 65536;
+        }
+    } else if (action >= MOUSE_ACTION_BUTTON_LEFT) {
+        buttons |= 1 << (action - MOUSE_ACTION_BUTTON_LEFT);
+    }
+    portEXIT_CRITICAL(&lock);
+    startTimer();
+}
+
+void MouseEngine::release(MouseAction action) {
+    Axis axis;
+    int8_t direction;
+    portENTER_CRITICAL(&lock);
+    if (actionAxis(action, axis, direction)) {
+        int8_t& count = held[axis][direction > 0];
+        if (count) count--;
+    } else if (action >= MOUSE_ACTION_BUTTON_LEFT) {
+        buttons &= ~(1 << (action - MOUSE_ACTION_BUTTON_LEFT));
+    }
+    portEXIT_CRITICAL(&lock);
+    startTimer();
+}
+
+void MouseEngine::nudge(MouseAction action) {
+    Axis axis;
+    int8_t direction;
+    if (!actionAxis(action, axis, direction)) {
+        // Buttons click once
+        press(action);
+        release(action);
+        return;
+    }
+
+    int32_t units = (axis == AXIS_X || axis == AXIS_Y) ? moveCurve.step : wheelCurve.step;
+    if (axis == AXIS_WHEEL && hidHandler && hidHandler->isWheelHighResolution()) {
+        units *= MOUSE_WHEEL_HIRES_UNITS;
+    } else if (axis == AXIS_PAN && hidHandler && hidHandler->isPanHighResolution()) {
+        units *= MOUSE_WHEEL_HIRES_UNITS;
+    }
+    portENTER_CRITICAL(&lock);
+    carry[axis] += direction * units * 65536;
+    portEXIT_CRITICAL(&lock);
+    startTimer();
+}
+
+void MouseEngine::startTimer() {
+    if (!timer) return;
+    bool start = false;
+    portENTER_CRITICAL(&lock);
+    if (!running) {
+        running = true;
+        start = true;
+    }
+    portEXIT_CRITICAL(&lock);
+    // Fails harmlessly while the last tick is still stopping the timer, the
+    // tick restarts it when it sees running again
+    if (start) esp_timer_start_periodic(timer, MOUSE_TICK_US);
+}
+
+// Speed ramps from curve.speed to curve.maxSpeed over accelTime, shaped by
+// raising the elapsed fraction to curve.curve, all in Q16
+uint32_t MouseEngine::stepAt(const MouseCurveConfig& curve, uint32_t heldUs, uint32_t unitScale) {
+    uint32_t accelUs = curve.accelTime * 1000UL;
+    uint32_t fraction = (heldUs >= accelUs || !accelUs) ? 65536 :
+                        (uint32_t)(((uint64_t)heldUs << 16) / accelUs);
+    uint32_t shaped = fraction;
+    for (uint8_t i = 1; i < curve.curve; i++) {
+        shaped = (uint32_t)(((uint64_t)shaped * fraction) >> 16);
+    }
+    uint32_t speed = curve.speed + (uint32_t)(((uint64_t)(curve.maxSpeed - curve.speed) * shaped) >> 16);
+    return (uint32_t)((((uint64_t)speed * unitScale) << 16) * MOUSE_TICK_US / 1000000ULL);
+}
+
+void MouseEngine::onTick(void* arg) {
+    static_cast<MouseEngine*>(arg)->tick();
+}
+
+void MouseEngine::tick() {
+    uint32_t start = LatencyStats::now();
+    tickCount++;
+
+    bool hiResWheel = hidHandler && hidHandler->isWheelHighResolution();
+    bool hiResPan = hidHandler && hidHandler->isPanHighResolution();
+    const int32_t limits[AXIS_COUNT] = { 32767, 32767, 127, 127 };
+    int32_t out[AXIS_COUNT];
+    bool moved = false;
+
+    portENTER_CRITICAL(&lock);
+    bool active = false;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        int8_t direction = (held[axis][1] > 0) - (held[axis][0] > 0);
+        if (held[axis][0] || held[axis][1]) active = true;
+        if (direction) {
+            const MouseCurveConfig& curve = axis < AXIS_WHEEL ? moveCurve : wheelCurve;
+            uint32_t scale = 1;
+            if ((axis == AXIS_WHEEL && hiResWheel) || (axis == AXIS_PAN && hiResPan)) {
+                scale = MOUSE_WHEEL_HIRES_UNITS;
+            }
+            carry[axis] += direction * (int32_t)stepAt(curve, start - pressUs[axis], scale);
+        }
+
+        // Whole units go out, the fraction waits for the next frame
+        int32_t whole = carry[axis] / 65536;
+        if (whole > limits[axis]) whole = limits[axis];
+        if (whole < -limits[axis]) whole = -limits[axis];
+        carry[axis] -= whole * 65536;
+        out[axis] = whole;
+        if (whole) moved = true;
+        if (carry[axis] >= 65536 || carry[axis] <= -65536) active = true;
+    }
+    uint8_t currentButtons = buttons;
+    bool idle = !active && !moved && currentButtons == sentButtons;
+    if (idle) {
+        // Nothing held, drop the sub-unit remainders and let the timer stop
+        memset(carry, 0, sizeof(carry));
+        running = false;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (moved || currentButtons != sentButtons) {
+        // A report still waiting in the HID queue absorbs this one, so the
+        // endpoint sees at most one mouse report per frame
+        if (hidHandler && hidHandler->sendMouseReport(currentButtons, out[AXIS_X], out[AXIS_Y],
+                                                      out[AXIS_WHEEL], out[AXIS_PAN])) {
+            reportCount++;
+        }
+        // A dropped report is not retried, the host is not listening
+        sentButtons = currentButtons;
+    }
+
+    if (idle) {
+        esp_timer_stop(timer);
+        // A press may have come in between deciding to stop and stopping
+        bool restart;
+        portENTER_CRITICAL(&lock);
+        restart = running;
+        portEXIT_CRITICAL(&lock);
+        if (restart) esp_timer_start_periodic(timer, MOUSE_TICK_US);
+    }
+
+    uint32_t elapsed = LatencyStats::now() - start;
+    if (elapsed > tickMaxUs) tickMaxUs = elapsed;
+}
+
+void MouseEngine::resetStats() {
+    tickCount = 0;
+    reportCount = 0;
+    tickMaxUs = 0;
+}
+
+void MouseEngine::print() {
+    USBSerial.println("\n--- Mouse Keys ---");
+    USBSerial.printf("Move: %u -> %u px/s over %u ms (curve %u), wheel: %u -> %u detents/s over %u ms (curve %u)\n",
+                  moveCurve.speed, moveCurve.maxSpeed, moveCurve.accelTime, moveCurve.curve,
+                  wheelCurve.speed, wheelCurve.maxSpeed, wheelCurve.accelTime, wheelCurve.curve);
+    USBSerial.printf("High-resolution wheel: %s, pan: %s\n",
+                  hidHandler && hidHandler->isWheelHighResolution() ? "on" : "off",
+                  hidHandler && hidHandler->isPanHighResolution() ? "on" : "off");
+    USBSerial.printf("Ticks: %u, reports: %u, slowest tick: %u us\n", tickCount, reportCount, tickMaxUs);
+    USBSerial.println("------------------\n");
+}
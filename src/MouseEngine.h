@@ -0,0 +1,84 @@
+// MouseEngine.h
+
+#ifndef MOUSE_ENGINE_H
+#define MOUSE_ENGINE_H
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "ConfigManager.h"
+
+// Mouse report emission period, one USB full-speed frame
+#define MOUSE_TICK_US 1000
+// One wheel detent in high-resolution units, the descriptor's multiplier
+#define MOUSE_WHEEL_HIRES_UNITS 120
+
+enum MouseAction : uint8_t {
+    MOUSE_ACTION_NONE,
+    MOUSE_ACTION_MOVE_UP,
+    MOUSE_ACTION_MOVE_DOWN,
+    MOUSE_ACTION_MOVE_LEFT,
+    MOUSE_ACTION_MOVE_RIGHT,
+    MOUSE_ACTION_WHEEL_UP,
+    MOUSE_ACTION_WHEEL_DOWN,
+    MOUSE_ACTION_WHEEL_LEFT,
+    MOUSE_ACTION_WHEEL_RIGHT,
+    // Buttons in report bit order
+    MOUSE_ACTION_BUTTON_LEFT,
+    MOUSE_ACTION_BUTTON_RIGHT,
+    MOUSE_ACTION_BUTTON_MIDDLE,
+    MOUSE_ACTION_BUTTON_BACK,
+    MOUSE_ACTION_BUTTON_FORWARD
+};
+
+// Mouse keys. Held move and wheel keys ramp up along a fixed-point speed
+// curve, evaluated once per USB frame on a 1 kHz esp_timer that only runs
+// while something is moving. Sub-unit motion carries over between frames.
+class MouseEngine {
+public:
+    MouseEngine();
+
+    bool begin(const ModuleSettings& settings);
+    static MouseAction actionFromString(const String& name);
+
+    // Key actions, from the key dispatch task
+    void press(MouseAction action);
+    void release(MouseAction action);
+    // One encoder detent worth of movement or scrolling
+    void nudge(MouseAction action);
+
+    void resetStats();
+    void print();
+
+private:
+    // Motion axes, each driven by a pair of opposite actions
+    enum Axis { AXIS_X, AXIS_Y, AXIS_WHEEL, AXIS_PAN, AXIS_COUNT };
+
+    static void onTick(void* arg);
+    void tick();
+    void startTimer();
+    // Q16.16 units per tick after heldUs of acceleration
+    static uint32_t stepAt(const MouseCurveConfig& curve, uint32_t heldUs, uint32_t unitScale);
+    static bool actionAxis(MouseAction action, Axis& axis, int8_t& direction);
+
+    MouseCurveConfig moveCurve;
+    MouseCurveConfig wheelCurve;
+
+    // Shared between the key tasks and the timer task, under lock
+    portMUX_TYPE lock;
+    int8_t held[AXIS_COUNT][2];      // Keys held per axis, [0] negative, [1] positive
+    uint32_t pressUs[AXIS_COUNT];    // Start of the current ramp per axis
+    int32_t carry[AXIS_COUNT];       // Q16.16 motion not yet reported
+    uint8_t buttons;
+    uint8_t sentButtons;
+    bool running;
+
+    esp_timer_handle_t timer;
+
+    uint32_t tickCount;
+    uint32_t reportCount;
+    uint32_t tickMaxUs;
+};
+
+extern MouseEngine mouseEngine;
+
+#endif // MOUSE_ENGINE_H
@@ -0,0 +1,91 @@
+// PcntEncoder.cpp
+
+#include "PcntEncoder.h"
+#include "EncoderMath.h"
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+uint8_t PcntEncoder::unitsUsed = 0;
+
+PcntEncoder::PcntEncoder()
+    : unit(PCNT_UNIT_0), started(false), lastCount(0), position(0)
+{
+}
+
+PcntEncoder::~PcntEncoder() {
+    if (started) {
+        pcnt_counter_pause(unit);
+    }
+}
+
+bool PcntEncoder::begin(uint8_t pinA, uint8_t pinB, uint16_t glitchFilterNs) {
+    if (unitsUsed >= PCNT_UNIT_MAX) {
+        USBSerial.println("No free PCNT unit for encoder");
+        return false;
+    }
+    unit = (pcnt_unit_t)unitsUsed;
+
+    // Channel 0 counts A edges and channel 1 B edges, the other pin's level
+    // decides the direction
+    pcnt_config_t config = {};
+    config.pulse_gpio_num = pinA;
+    config.ctrl_gpio_num = pinB;
+    config.channel = PCNT_CHANNEL_0;
+    config.unit = unit;
+    config.pos_mode = PCNT_COUNT_DEC;
+    config.neg_mode = PCNT_COUNT_INC;
+    config.lctrl_mode = PCNT_MODE_REVERSE;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    config.counter_h_lim = PCNT_ENCODER_RANGE;
+    config.counter_l_lim = -PCNT_ENCODER_RANGE;
+    if (pcnt_unit_config(&config) != ESP_OK) {
+        USBSerial.printf("PCNT unit %d configuration failed\n", unit);
+        return false;
+    }
+
+    config.pulse_gpio_num = pinB;
+    config.ctrl_gpio_num = pinA;
+    config.channel = PCNT_CHANNEL_1;
+    config.pos_mode = PCNT_COUNT_INC;
+    config.neg_mode = PCNT_COUNT_DEC;
+    if (pcnt_unit_config(&config) != ESP_OK) {
+        USBSerial.printf("PCNT unit %d configuration failed\n", unit);
+        return false;
+    }
+
+    // Same pull-ups the polled Encoder library sets
+    gpio_pullup_en((gpio_num_t)pinA);
+    gpio_pullup_en((gpio_num_t)pinB);
+
+    // Filter length in 80 MHz APB cycles
+    uint32_t cycles = min((uint32_t)glitchFilterNs, (uint32_t)PCNT_MAX_FILTER_NS) * 80 / 1000;
+    if (cycles) {
+        pcnt_set_filter_value(unit, cycles);
+        pcnt_filter_enable(unit);
+    } else {
+        pcnt_filter_disable(unit);
+    }
+
+    pcnt_counter_pause(unit);
+    pcnt_counter_clear(unit);
+    pcnt_counter_resume(unit);
+
+    unitsUsed++;
+    started = true;
+    lastCount = 0;
+    position = 0;
+    USBSerial.printf("PCNT unit %d on pins %d/%d, glitch filter %u cycles\n", unit, pinA, pinB, cycles);
+    return true;
+}
+
+int32_t PcntEncoder::read() {
+    if (!started) return 0;
+
+    int16_t count;
+    if (pcnt_get_counter_value(unit, &count) != ESP_OK) return position;
+
+    position += EncoderMath::unwrapDelta(count, lastCount, PCNT_ENCODER_RANGE);
+    lastCount = count;
+    return position;
+}
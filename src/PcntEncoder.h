@@ -0,0 +1,39 @@
+// PcntEncoder.h
+
+#ifndef PCNT_ENCODER_H
+#define PCNT_ENCODER_H
+
+#include <Arduino.h>
+#include "driver/pcnt.h"
+
+// Counter limit. The unit resets to 0 on reaching either limit, so its value
+// is the position modulo this range in both directions.
+#define PCNT_ENCODER_RANGE 32767
+// Longest pulse the glitch filter can reject, 1023 APB cycles
+#define PCNT_MAX_FILTER_NS 12787
+#define PCNT_DEFAULT_FILTER_NS 1000
+
+// Quadrature decoding on a PCNT unit. Both channels count both edges (x4),
+// glitches shorter than the filter are ignored in hardware and the CPU only
+// reads the counter. Polling more often than every 16383 counts loses nothing.
+class PcntEncoder {
+public:
+    PcntEncoder();
+    ~PcntEncoder();
+
+    bool begin(uint8_t pinA, uint8_t pinB, uint16_t glitchFilterNs = PCNT_DEFAULT_FILTER_NS);
+    // Counts since begin(), from a single task
+    int32_t read();
+
+    static uint8_t getUnitsUsed() { return unitsUsed; }
+
+private:
+    pcnt_unit_t unit;
+    bool started;
+    int16_t lastCount;
+    int32_t position;
+
+    static uint8_t unitsUsed;
+};
+
+#endif // PCNT_ENCODER_H
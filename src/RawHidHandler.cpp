@@ -0,0 +1,296 @@
+// RawHidHandler.cpp
+
+#include "RawHidHandler.h"
+#include "HIDHandler.h"
+#include "KeyHandler.h"
+#include "LEDHandler.h"
+#include "MacroEngine.h"
+#include "LatencyStats.h"
+#include "ScanScheduler.h"
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+RawHidHandler rawHidHandler;
+
+RawHidHandler::RawHidHandler()
+    : rxQueue(nullptr), streamIntervalMs(0), lastStreamMs(0)
+{
+    resetStats();
+}
+
+bool RawHidHandler::begin() {
+    rxQueue = xQueueCreate(RAW_HID_RX_QUEUE_SIZE, RAW_HID_REPORT_SIZE);
+    if (!rxQueue) {
+        USBSerial.println("Raw HID queue creation failed");
+        return false;
+    }
+    return true;
+}
+
+void RawHidHandler::onOutput(const uint8_t* data, uint16_t length) {
+    if (!rxQueue || length < RAW_HID_REQUEST_HEADER) {
+        rxDropped++;
+        return;
+    }
+    // Hosts may strip trailing zeros, the rest of the frame reads as zero
+    uint8_t frame[RAW_HID_REPORT_SIZE] = {0};
+    memcpy(frame, data, min((uint16_t)RAW_HID_REPORT_SIZE, length));
+    if (xQueueSend(rxQueue, frame, 0) != pdTRUE) {
+        rxDropped++;
+    }
+}
+
+void RawHidHandler::update() {
+    if (!rxQueue) return;
+
+    uint8_t frame[RAW_HID_REPORT_SIZE];
+    while (xQueueReceive(rxQueue, frame, 0) == pdTRUE) {
+        uint32_t start = LatencyStats::now();
+        handle(frame);
+        uint32_t elapsed = LatencyStats::now() - start;
+        if (elapsed > handleMaxUs) handleMaxUs = elapsed;
+    }
+
+    if (streamIntervalMs && millis() - lastStreamMs >= streamIntervalMs) {
+        lastStreamMs = millis();
+        RawCounters counters;
+        fillCounters(counters);
+        respond(RAW_CMD_GET_COUNTERS, 0, RAW_STATUS_OK, &counters, sizeof(counters));
+    }
+}
+
+bool RawHidHandler::respond(uint8_t cmd, uint8_t seq, uint8_t status, const void* payload, uint8_t length) {
+    uint8_t frame[RAW_HID_REPORT_SIZE] = {0};
+    frame[0] = cmd;
+    frame[1] = seq;
+    frame[2] = status;
+    frame[3] = length;
+    if (payload && length) memcpy(&frame[RAW_HID_RESPONSE_HEADER], payload, length);
+    if (!hidHandler || !hidHandler->sendRawReport(frame)) {
+        txDropped++;
+        return false;
+    }
+    return true;
+}
+
+void RawHidHandler::handle(const uint8_t* request) {
+    uint8_t cmd = request[0];
+    uint8_t seq = request[1];
+    uint8_t length = request[2];
+    const uint8_t* payload = &request[RAW_HID_REQUEST_HEADER];
+    uint8_t response[RAW_HID_RESPONSE_PAYLOAD];
+    uint8_t responseLength = 0;
+    uint8_t status;
+
+    requestCount++;
+    if (length > RAW_HID_REQUEST_PAYLOAD) {
+        status = RAW_STATUS_BAD_LENGTH;
+    } else {
+        switch (cmd) {
+            case RAW_CMD_PING: {
+                RawDeviceInfo info;
+                info.protocolVersion = RAW_HID_PROTOCOL_VERSION;
+                info.numLayers = keyHandler ? keyHandler->getNumLayers() : 0;
+                info.numKeys = keyHandler ? keyHandler->getTotalKeys() : 0;
+                info.numLeds = numLEDs;
+                info.numMacros = macroEngine.getMacroCount();
+                info.maxMacros = MAX_MACROS;
+                info.macroStageSize = RAW_HID_MACRO_STAGE_SIZE;
+                memcpy(response, &info, sizeof(info));
+                responseLength = sizeof(info);
+                status = RAW_STATUS_OK;
+                break;
+            }
+            case RAW_CMD_GET_KEY:
+                status = getKey(payload, length, response, responseLength);
+                break;
+            case RAW_CMD_SET_KEY:
+                status = setKey(payload, length);
+                break;
+            case RAW_CMD_GET_LED:
+                status = getLed(payload, length, response, responseLength);
+                break;
+            case RAW_CMD_SET_LED:
+                status = setLed(payload, length);
+                break;
+            case RAW_CMD_GET_MACRO:
+                status = getMacro(payload, length, response, responseLength);
+                break;
+            case RAW_CMD_WRITE_MACRO:
+                status = writeMacro(payload, length);
+                break;
+            case RAW_CMD_COMMIT_MACRO:
+                status = commitMacro(payload, length);
+                break;
+            case RAW_CMD_GET_COUNTERS: {
+                RawCounters counters;
+                fillCounters(counters);
+                memcpy(response, &counters, sizeof(counters));
+                responseLength = sizeof(counters);
+                status = RAW_STATUS_OK;
+                break;
+            }
+            case RAW_CMD_STREAM_COUNTERS:
+                if (length != 2) {
+                    status = RAW_STATUS_BAD_LENGTH;
+                    break;
+                }
+                streamIntervalMs = payload[0] | (payload[1] << 8);
+                if (streamIntervalMs && streamIntervalMs < RAW_HID_MIN_STREAM_MS) {
+                    streamIntervalMs = RAW_HID_MIN_STREAM_MS;
+                }
+                lastStreamMs = millis();
+                status = RAW_STATUS_OK;
+                break;
+            default:
+                status = RAW_STATUS_UNKNOWN_COMMAND;
+                break;
+        }
+    }
+
+    if (status != RAW_STATUS_OK) errorCount++;
+    respond(cmd, seq, status, response, responseLength);
+}
+
+uint8_t RawHidHandler::getKey(const uint8_t* payload, uint8_t length, uint8_t* response, uint8_t& responseLength) {
+    if (length != 2) return RAW_STATUS_BAD_LENGTH;
+    KeyConfig config;
+    if (!keyHandler || !keyHandler->getKeyAction(payload[0], payload[1], config)) {
+        return RAW_STATUS_OUT_OF_RANGE;
+    }
+
+    RawKeyAction action;
+    action.type = config.type;
+    memcpy(action.hidReport, config.hidReport, sizeof(action.hidReport));
+    memcpy(action.usageReport, config.usageReport, sizeof(action.usageReport));
+    action.macroIndex = config.macroIndex;
+    action.mouseAction = config.mouseAction;
+    action.targetLayer = config.targetLayer;
+    action.layerMode = config.layerMode;
+
+    response[0] = payload[0];
+    response[1] = payload[1];
+    memcpy(&response[2], &action, sizeof(action));
+    responseLength = 2 + sizeof(action);
+    return RAW_STATUS_OK;
+}
+
+uint8_t RawHidHandler::setKey(const uint8_t* payload, uint8_t length) {
+    if (length != 2 + sizeof(RawKeyAction)) return RAW_STATUS_BAD_LENGTH;
+    if (!keyHandler) return RAW_STATUS_OUT_OF_RANGE;
+
+    RawKeyAction action;
+    memcpy(&action, &payload[2], sizeof(action));
+    KeyConfig config;
+    config.type = (ActionType)action.type;
+    memcpy(config.hidReport, action.hidReport, sizeof(config.hidReport));
+    memcpy(config.usageReport, action.usageReport, sizeof(config.usageReport));
+    config.macroIndex = action.macroIndex;
+    config.mouseAction = action.mouseAction;
+    config.targetLayer = action.targetLayer;
+    config.layerMode = (LayerMode)action.layerMode;
+
+    if (payload[0] >= keyHandler->getNumLayers() || payload[1] >= keyHandler->getTotalKeys()) {
+        return RAW_STATUS_OUT_OF_RANGE;
+    }
+    if (keyHandler->isKeyEditPending()) return RAW_STATUS_BUSY;
+    if (!keyHandler->setKeyAction(payload[0], payload[1], config)) return RAW_STATUS_INVALID;
+    return RAW_STATUS_OK;
+}
+
+uint8_t RawHidHandler::getLed(const uint8_t* payload, uint8_t length, uint8_t* response, uint8_t& responseLength) {
+    if (length != 1) return RAW_STATUS_BAD_LENGTH;
+    uint8_t index = payload[0];
+    if (!ledConfigs || index >= numLEDs) return RAW_STATUS_OUT_OF_RANGE;
+
+    const LEDConfig& led = ledConfigs[index];
+    RawLedColor color = { led.r, led.g, led.b, led.brightness, led.pressedR, led.pressedG, led.pressedB };
+    response[0] = index;
+    memcpy(&response[1], &color, sizeof(color));
+    responseLength = 1 + sizeof(color);
+    return RAW_STATUS_OK;
+}
+
+uint8_t RawHidHandler::setLed(const uint8_t* payload, uint8_t length) {
+    if (length != 1 + sizeof(RawLedColor)) return RAW_STATUS_BAD_LENGTH;
+    uint8_t index = payload[0];
+    if (!ledConfigs || index >= numLEDs) return RAW_STATUS_OUT_OF_RANGE;
+
+    RawLedColor color;
+    memcpy(&color, &payload[1], sizeof(color));
+    ledConfigs[index].pressedR = color.pressedR;
+    ledConfigs[index].pressedG = color.pressedG;
+    ledConfigs[index].pressedB = color.pressedB;
+    setLEDColorWithBrightness(index, color.r, color.g, color.b, color.brightness);
+    return RAW_STATUS_OK;
+}
+
+uint8_t RawHidHandler::getMacro(const uint8_t* payload, uint8_t length, uint8_t* response, uint8_t& responseLength) {
+    if (length != 3) return RAW_STATUS_BAD_LENGTH;
+    uint8_t macro = payload[0];
+    uint16_t offset = payload[1] | (payload[2] << 8);
+    if (macro >= macroEngine.getMacroCount()) return RAW_STATUS_OUT_OF_RANGE;
+
+    uint16_t size = macroEngine.getMacroSize(macro);
+    response[0] = macro;
+    response[1] = size & 0xFF;
+    response[2] = size >> 8;
+    response[3] = payload[1];
+    response[4] = payload[2];
+    responseLength = 5 + macroEngine.readMacro(macro, offset, &response[5], RAW_HID_RESPONSE_PAYLOAD - 5);
+    return RAW_STATUS_OK;
+}
+
+uint8_t RawHidHandler::writeMacro(const uint8_t* payload, uint8_t length) {
+    if (length < 2) return RAW_STATUS_BAD_LENGTH;
+    uint16_t offset = payload[0] | (payload[1] << 8);
+    return macroStage.write(offset, &payload[2], length - 2);
+}
+
+uint8_t RawHidHandler::commitMacro(const uint8_t* payload, uint8_t length) {
+    if (length != 3) return RAW_STATUS_BAD_LENGTH;
+    uint8_t macro = payload[0];
+    uint16_t size = payload[1] | (payload[2] << 8);
+    if (macro > macroEngine.getMacroCount() || macro >= MAX_MACROS) return RAW_STATUS_OUT_OF_RANGE;
+    uint8_t status = macroStage.check(size);
+    if (status != RAW_STATUS_OK) return status;
+    // Validated, so a refusal means a macro is playing or the arena is full
+    if (!macroEngine.replaceMacro(macro, macroStage.data(), size)) return RAW_STATUS_BUSY;
+    macroStage.clear();
+    USBSerial.printf("Raw HID: macro %u replaced, %u bytes\n", macro, size);
+    return RAW_STATUS_OK;
+}
+
+void RawHidHandler::fillCounters(RawCounters& counters) {
+    LatencyHistogram total = latencyStats.getHistogram(LATENCY_TOTAL);
+    counters.uptimeMs = millis();
+    counters.hidSent = hidHandler ? hidHandler->getSentReports() : 0;
+    counters.hidCoalesced = hidHandler ? hidHandler->getCoalescedReports() : 0;
+    counters.hidDuplicates = hidHandler ? hidHandler->getDuplicateReports() : 0;
+    counters.hidDropped = hidHandler ? hidHandler->getDroppedReports() : 0;
+    counters.keyEvents = total.count;
+    counters.latencyAvgUs = total.count ? (uint32_t)(total.sumUs / total.count) : 0;
+    counters.latencyMaxUs = total.maxUs;
+    counters.scanRateHz = scanScheduler.getRateHz();
+    counters.hidBacklog = hidHandler ? hidHandler->getQueueBacklog() : 0;
+    counters.activeLayer = keyHandler ? keyHandler->getActiveLayer() : 0;
+}
+
+void RawHidHandler::resetStats() {
+    requestCount = 0;
+    errorCount = 0;
+    rxDropped = 0;
+    txDropped = 0;
+    handleMaxUs = 0;
+}
+
+void RawHidHandler::print() {
+    USBSerial.println("\n--- Raw HID ---");
+    USBSerial.printf("Requests: %u, errors: %u, slowest: %u us\n", requestCount, errorCount, handleMaxUs);
+    USBSerial.printf("Frames dropped: %u in, %u out\n", rxDropped, txDropped);
+    USBSerial.printf("Counter stream: %s", streamIntervalMs ? "" : "off\n");
+    if (streamIntervalMs) USBSerial.printf("every %u ms\n", streamIntervalMs);
+    USBSerial.printf("Staged macro bytes: %u of %u\n", macroStage.size(), RAW_HID_MACRO_STAGE_SIZE);
+    USBSerial.println("---------------\n");
+}
@@ -0,0 +1,62 @@
+// RawHidHandler.h
+
+#ifndef RAW_HID_HANDLER_H
+#define RAW_HID_HANDLER_H
+
+#include <Arduino.h>
+#include "freertos/queue.h"
+#include "raw_hid_protocol.h"
+#include "RawMacroStage.h"
+
+// Requests waiting for update(), a host is expected to wait for each response
+#define RAW_HID_RX_QUEUE_SIZE 8
+// Shortest counter stream interval
+#define RAW_HID_MIN_STREAM_MS 10
+
+// Configuration and telemetry over the vendor-defined raw HID reports.
+// Frames arrive on the TinyUSB task and are queued; update() runs them from
+// loop() against the compiled in-memory tables. Changes are not saved to
+// SPIFFS, a reboot reloads the JSON configuration.
+class RawHidHandler {
+public:
+    RawHidHandler();
+
+    bool begin();
+
+    // From the TinyUSB task, copies the frame for update()
+    void onOutput(const uint8_t* data, uint16_t length);
+    // Runs queued requests and streams counters, from loop()
+    void update();
+
+    void resetStats();
+    void print();
+
+private:
+    void handle(const uint8_t* request);
+    bool respond(uint8_t cmd, uint8_t seq, uint8_t status, const void* payload = nullptr, uint8_t length = 0);
+    uint8_t getKey(const uint8_t* payload, uint8_t length, uint8_t* response, uint8_t& responseLength);
+    uint8_t setKey(const uint8_t* payload, uint8_t length);
+    uint8_t getLed(const uint8_t* payload, uint8_t length, uint8_t* response, uint8_t& responseLength);
+    uint8_t setLed(const uint8_t* payload, uint8_t length);
+    uint8_t getMacro(const uint8_t* payload, uint8_t length, uint8_t* response, uint8_t& responseLength);
+    uint8_t writeMacro(const uint8_t* payload, uint8_t length);
+    uint8_t commitMacro(const uint8_t* payload, uint8_t length);
+    void fillCounters(RawCounters& counters);
+
+    QueueHandle_t rxQueue;
+
+    RawMacroStage macroStage;
+
+    uint16_t streamIntervalMs;  // 0 when not streaming
+    uint32_t lastStreamMs;
+
+    uint32_t requestCount;
+    uint32_t errorCount;
+    uint32_t rxDropped;         // Frames lost to a full queue or a bad length
+    uint32_t txDropped;
+    uint32_t handleMaxUs;
+};
+
+extern RawHidHandler rawHidHandler;
+
+#endif // RAW_HID_HANDLER_H
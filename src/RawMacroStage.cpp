@@ -0,0 +1,17 @@
+// RawMacroStage.cpp
+#include "RawMacroStage.h"
+#include "MacroCode.h"
+
+uint8_t RawMacroStage::write(uint16_t offset, const uint8_t* data, uint8_t count) {
+    if (offset == 0) stagedBytes = 0;
+    if (offset != stagedBytes) return RAW_STATUS_INVALID;
+    if (stagedBytes + count > RAW_HID_MACRO_STAGE_SIZE) return RAW_STATUS_OUT_OF_RANGE;
+    memcpy(&stage[stagedBytes], data, count);
+    stagedBytes += count;
+    return RAW_STATUS_OK;
+}
+
+uint8_t RawMacroStage::check(uint16_t size) const {
+    if (size != stagedBytes || !MacroCode::validate(stage, size)) return RAW_STATUS_INVALID;
+    return RAW_STATUS_OK;
+}
@@ -0,0 +1,33 @@
+// RawMacroStage.h
+
+#ifndef RAW_MACRO_STAGE_H
+#define RAW_MACRO_STAGE_H
+
+#include <Arduino.h>
+#include "raw_hid_protocol.h"
+
+// Largest macro that can be staged for RAW_CMD_COMMIT_MACRO
+#define RAW_HID_MACRO_STAGE_SIZE 1024
+
+// Macro bytecode uploaded over raw HID in RAW_CMD_WRITE_MACRO chunks,
+// held until RAW_CMD_COMMIT_MACRO. Methods return a RawHidStatus.
+class RawMacroStage {
+public:
+    RawMacroStage() : stagedBytes(0) {}
+
+    // Chunks come in order, offset 0 starts a new macro
+    uint8_t write(uint16_t offset, const uint8_t* data, uint8_t count);
+    // Whether size bytes can be committed: exactly what was staged, and
+    // well-formed bytecode
+    uint8_t check(uint16_t size) const;
+
+    const uint8_t* data() const { return stage; }
+    uint16_t size() const { return stagedBytes; }
+    void clear() { stagedBytes = 0; }
+
+private:
+    uint8_t stage[RAW_HID_MACRO_STAGE_SIZE];
+    uint16_t stagedBytes;
+};
+
+#endif // RAW_MACRO_STAGE_H
@@ -0,0 +1,112 @@
+// ScanScheduler.cpp
+
+#include "ScanScheduler.h"
+#include "LatencyStats.h"
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+ScanScheduler scanScheduler;
+
+ScanScheduler::ScanScheduler()
+    : timer(nullptr), scanTask(nullptr), rateHz(SCAN_RATE_DEFAULT_HZ),
+      periodUs(1000000UL / SCAN_RATE_DEFAULT_HZ), running(false)
+{
+    resetStats();
+}
+
+bool ScanScheduler::begin(uint16_t hz, TaskHandle_t task) {
+    if (hz == 0) hz = SCAN_RATE_DEFAULT_HZ;
+    if (hz > SCAN_RATE_MAX_HZ) hz = SCAN_RATE_MAX_HZ;
+    rateHz = hz;
+    periodUs = 1000000UL / rateHz;
+    scanTask = task;
+
+    esp_timer_create_args_t args = {};
+    args.callback = onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "matrix_scan";
+    esp_err_t err = esp_timer_create(&args, &timer);
+    if (err != ESP_OK) {
+        USBSerial.printf("Scan timer creation failed: %s\n", esp_err_to_name(err));
+        timer = nullptr;
+        return false;
+    }
+
+    USBSerial.printf("Matrix scan at %d Hz (%u us period)\n", rateHz, periodUs);
+    return true;
+}
+
+void ScanScheduler::start() {
+    if (!timer || running) return;
+    // Don't count the gap since the last stop as jitter
+    lastTickUs = 0;
+    running = esp_timer_start_periodic(timer, periodUs) == ESP_OK;
+}
+
+void ScanScheduler::stop() {
+    if (!timer || !running) return;
+    esp_timer_stop(timer);
+    running = false;
+    // Drop a tick that fired while stopping
+    ulTaskNotifyTake(pdTRUE, 0);
+}
+
+// Runs on the esp_timer task, which only wakes the scan task
+void ScanScheduler::onTimer(void* arg) {
+    ScanScheduler* scheduler = static_cast<ScanScheduler*>(arg);
+    xTaskNotifyGive(scheduler->scanTask);
+}
+
+uint32_t ScanScheduler::waitForTick() {
+    if (!running) {
+        // No timer: fall back to a plain tick delay
+        vTaskDelay(1);
+        return LatencyStats::now();
+    }
+
+    uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    uint32_t now = LatencyStats::now();
+
+    tickCount++;
+    if (pending > 1) {
+        missedTicks += pending - 1;
+    }
+    if (lastTickUs) {
+        uint32_t interval = now - lastTickUs;
+        uint32_t jitter = interval > periodUs ? interval - periodUs : periodUs - interval;
+        intervalCount++;
+        jitterSumUs += jitter;
+        if (jitter > jitterMaxUs) jitterMaxUs = jitter;
+        if (interval < intervalMinUs) intervalMinUs = interval;
+        if (interval > intervalMaxUs) intervalMaxUs = interval;
+    }
+    lastTickUs = now;
+    return now;
+}
+
+void ScanScheduler::resetStats() {
+    lastTickUs = 0;
+    tickCount = 0;
+    missedTicks = 0;
+    intervalCount = 0;
+    jitterSumUs = 0;
+    jitterMaxUs = 0;
+    intervalMinUs = UINT32_MAX;
+    intervalMaxUs = 0;
+}
+
+void ScanScheduler::print() {
+    USBSerial.println("\n--- Scan Timing ---");
+    USBSerial.printf("Rate: %d Hz, period %u us, %s\n", rateHz, periodUs, running ? "running" : "idle");
+    if (!intervalCount) {
+        USBSerial.println("No ticks recorded");
+    } else {
+        USBSerial.printf("Ticks: %u, missed %u\n", tickCount, missedTicks);
+        USBSerial.printf("Interval: min %u us, max %u us\n", intervalMinUs, intervalMaxUs);
+        USBSerial.printf("Jitter: avg %u us, max %u us\n",
+                      (uint32_t)(jitterSumUs / intervalCount), jitterMaxUs);
+    }
+    USBSerial.println("-------------------\n");
+}
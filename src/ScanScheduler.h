@@ -0,0 +1,56 @@
+// ScanScheduler.h
+
+#ifndef SCAN_SCHEDULER_H
+#define SCAN_SCHEDULER_H
+
+#include <Arduino.h>
+#include "esp_timer.h"
+
+#define SCAN_RATE_MAX_HZ 1000
+#define SCAN_RATE_DEFAULT_HZ 1000
+
+// Paces the matrix scan with a periodic esp_timer that notifies the scan
+// task, and records how far each wake-up lands from its ideal tick
+class ScanScheduler {
+public:
+    ScanScheduler();
+
+    // Creates the timer that notifies scanTask at rateHz
+    bool begin(uint16_t rateHz, TaskHandle_t scanTask);
+    // Only called from the scan task itself
+    void start();
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Blocks the scan task until the next tick, returns the tick time
+    uint32_t waitForTick();
+
+    uint32_t getPeriodUs() const { return periodUs; }
+    uint16_t getRateHz() const { return rateHz; }
+
+    void resetStats();
+    void print();
+
+private:
+    static void onTimer(void* arg);
+
+    esp_timer_handle_t timer;
+    TaskHandle_t scanTask;
+    uint16_t rateHz;
+    uint32_t periodUs;
+    bool running;
+
+    // Jitter: distance of each wake-up interval from the period
+    uint32_t lastTickUs;
+    uint32_t tickCount;
+    uint32_t missedTicks;   // Ticks that fired while the previous scan was still running
+    uint32_t intervalCount;
+    uint64_t jitterSumUs;
+    uint32_t jitterMaxUs;
+    uint32_t intervalMinUs;
+    uint32_t intervalMaxUs;
+};
+
+extern ScanScheduler scanScheduler;
+
+#endif // SCAN_SCHEDULER_H
@@ -0,0 +1,89 @@
+// TapHoldEngine.cpp
+
+#include "TapHoldEngine.h"
+
+TapHoldEngine::TapHoldEngine()
+    : pendingKey(0xFF), pressUs(0), termUs(0), policy(TAPHOLD_TAPPING_TERM),
+      pressedSince(0), eventCount(0), tapCount(0), holdCount(0)
+{
+}
+
+void TapHoldEngine::start(uint8_t key, const KeyConfig& config, uint32_t timestampUs) {
+    pendingKey = key;
+    pressUs = timestampUs;
+    termUs = (uint32_t)config.tappingTerm * 1000UL;
+    policy = config.tapHoldPolicy;
+    pressedSince = 0;
+    eventCount = 0;
+}
+
+TapHoldDecision TapHoldEngine::onEvent(const KeyEvent& event) {
+    if (!isPending()) return TAPHOLD_UNDECIDED;
+
+    bool expired = event.timestampUs - pressUs >= termUs;
+
+    if (event.keyIndex == pendingKey) {
+        if (event.pressed) return TAPHOLD_UNDECIDED;
+        if (!expired) {
+            // Released within the tapping term, the release is part of the tap
+            return decide(TAPHOLD_TAP);
+        }
+        // Released late but before the timer fired: hold, then replay the release
+        buffer(event);
+        return decide(TAPHOLD_HOLD);
+    }
+
+    bool full = !buffer(event);
+    if (expired || full) {
+        return decide(TAPHOLD_HOLD);
+    }
+
+    if (event.keyIndex < 32) {
+        uint32_t bit = 1UL << event.keyIndex;
+        if (event.pressed) {
+            pressedSince |= bit;
+            if (policy == TAPHOLD_HOLD_ON_OTHER_KEY) {
+                return decide(TAPHOLD_HOLD);
+            }
+        } else if (policy == TAPHOLD_PERMISSIVE_HOLD && (pressedSince & bit)) {
+            // Another key was tapped entirely inside the tap-hold press
+            return decide(TAPHOLD_HOLD);
+        }
+    }
+    return TAPHOLD_UNDECIDED;
+}
+
+TapHoldDecision TapHoldEngine::onTimer(uint32_t nowUs) {
+    if (!isPending() || nowUs - pressUs < termUs) return TAPHOLD_UNDECIDED;
+    return decide(TAPHOLD_HOLD);
+}
+
+uint32_t TapHoldEngine::timeUntilDeadline(uint32_t nowUs) const {
+    uint32_t elapsed = nowUs - pressUs;
+    return elapsed >= termUs ? 0 : termUs - elapsed;
+}
+
+uint8_t TapHoldEngine::finish(KeyEvent* out) {
+    uint8_t count = eventCount;
+    memcpy(out, events, count * sizeof(KeyEvent));
+    eventCount = 0;
+    pendingKey = 0xFF;
+    return count;
+}
+
+TapHoldDecision TapHoldEngine::decide(TapHoldDecision decision) {
+    if (decision == TAPHOLD_TAP) {
+        tapCount++;
+    } else {
+        holdCount++;
+    }
+    return decision;
+}
+
+// Returns false once the buffer is full, which forces a decision
+bool TapHoldEngine::buffer(const KeyEvent& event) {
+    if (eventCount < TAPHOLD_BUFFER_SIZE) {
+        events[eventCount++] = event;
+    }
+    return eventCount < TAPHOLD_BUFFER_SIZE;
+}
@@ -0,0 +1,66 @@
+// TapHoldEngine.h
+
+#ifndef TAP_HOLD_ENGINE_H
+#define TAP_HOLD_ENGINE_H
+
+#include <Arduino.h>
+#include "KeyActions.h"
+#include "KeyEventQueue.h"
+
+// Events held back while a tap-hold key is undecided. The engine decides a
+// hold once the buffer is full, so it never overflows.
+#define TAPHOLD_BUFFER_SIZE 16
+
+enum TapHoldDecision {
+    TAPHOLD_UNDECIDED,
+    TAPHOLD_TAP,
+    TAPHOLD_HOLD
+};
+
+// Decides whether a dual-role key was tapped or held. Runs on the dispatch
+// task and only looks at the scan timestamps carried by the key events, plus
+// the current time for the tapping term deadline, so the scan never waits on it.
+class TapHoldEngine {
+public:
+    TapHoldEngine();
+
+    bool isPending() const { return pendingKey != 0xFF; }
+    uint8_t getPendingKey() const { return pendingKey; }
+
+    // A tap-hold key was pressed while nothing else was pending
+    void start(uint8_t key, const KeyConfig& config, uint32_t pressUs);
+
+    // Feed the next event while a decision is pending. Every event except the
+    // tap-hold key's own release on a tap is buffered for replay.
+    TapHoldDecision onEvent(const KeyEvent& event);
+    // Tapping term check against the current time
+    TapHoldDecision onTimer(uint32_t nowUs);
+    // Microseconds until the tapping term expires, 0 when already expired
+    uint32_t timeUntilDeadline(uint32_t nowUs) const;
+
+    // Ends the pending decision and hands over the buffered events in order
+    uint8_t finish(KeyEvent* events);
+
+    uint32_t getTapCount() const { return tapCount; }
+    uint32_t getHoldCount() const { return holdCount; }
+
+private:
+    TapHoldDecision decide(TapHoldDecision decision);
+    bool buffer(const KeyEvent& event);
+
+    uint8_t pendingKey;
+    uint32_t pressUs;
+    uint32_t termUs;
+    TapHoldPolicy policy;
+
+    // Keys pressed after the tap-hold key, for permissive hold
+    uint32_t pressedSince;
+
+    KeyEvent events[TAPHOLD_BUFFER_SIZE];
+    uint8_t eventCount;
+
+    uint32_t tapCount;
+    uint32_t holdCount;
+};
+
+#endif // TAP_HOLD_ENGINE_H
@@ -2,6 +2,7 @@
 #include "LEDHandler.h"
 #include "KeyHandler.h"
 #include "DisplayHandler.h"
+#include "LatencyStats.h"
 
 extern USBCDC USBSerial;
 
@@ -176,12 +177,15 @@ void WiFiManager::setupWebServer() {
     
     // System Status
     _server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request) {
-        DynamicJsonDocument doc(1024);
+        DynamicJsonDocument doc(4096);
         doc["wifi"]["connected"] = WiFiManager::isConnected();
         doc["wifi"]["ip"] = WiFiManager::getLocalIP().toString();
         doc["wifi"]["ssid"] = WiFiManager::_ssid;
         doc["wifi"]["ap_mode"] = WiFiManager::_apMode;
         
+        // Keypress latency histograms
+        latencyStats.toJson(doc.createNestedObject("latency"));
+        
         // Add more status info here as needed
         
         String output;
@@ -189,6 +193,12 @@ void WiFiManager::setupWebServer() {
         request->send(200, "application/json", output);
     });
     
+    // Reset latency histograms
+    _server.on("/api/status/latency/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+        latencyStats.reset();
+        request->send(200, "text/plain", "Latency statistics reset");
+    });
+    
     // Reset to defaults
     _server.on("/api/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
         resetToDefaults();
@@ -20,18 +20,20 @@
 #include <USB.h>
 #include <USBHID.h>
 #include <USBHIDKeyboard.h>
-#include <USBHIDConsumerControl.h>
-#include <USBHIDMouse.h>
 #include <USBCDC.h>
 
 #include "WiFiManager.h"
+#include "LatencyStats.h"
+#include "ScanScheduler.h"
+#include "MacroEngine.h"
+#include "MouseEngine.h"
+#include "RawHidHandler.h"
+#include "I2CBus.h"
 
 // Forward declarations for Display functions
 extern void updateDisplay();
 
 USBHIDKeyboard Keyboard;
-USBHIDConsumerControl ConsumerControl;
-USBHIDMouse Mouse;  // Optional if you need mouse controls
 USBCDC USBSerial;
 
 // Flag to indicate if USB server should be initialized
@@ -39,120 +41,44 @@ USBCDC USBSerial;
 
 #define TAG "HID+CDC Esp32-s3 Macropad"
 
-//  Will be moved to info.json
-#define ROW0 3  // Kept (safe GPIO pin)
-#define ROW1 5  // Kept (safe GPIO pin)
-#define ROW2 8  // ROW2 26
-#define ROW3 9  // ROW3 47
-#define ROW4 10 // ROW4 33
-#define COL0 11 // COL0 34
-#define COL1 21 // Kept (safe GPIO pin)
-#define COL2 13 // Kept (safe GPIO pin)
-#define COL3 6  // Kept (safe GPIO pin)
-#define COL4 12 // Kept (safe GPIO pin)
-
-// Validate GPIO pins for ESP32-S3
-bool validateGpioPins(uint8_t* pins, uint8_t count) {
-    // Valid GPIO pins for ESP32-S3 are 0-21
-    const int validESP32S3Pins[] = {
-        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 
-        15, 16, 17, 18, 19, 20, 21
-    };
-    
-    for (uint8_t i = 0; i < count; i++) {
-        bool isValid = false;
-        for (int validPin : validESP32S3Pins) {
-            if (pins[i] == validPin) {
-                isValid = true;
-                break;
-            }
-        }
-        
-        if (!isValid) {
-            Serial.printf("Invalid GPIO pin for ESP32-S3: %d\n", pins[i]);
-            return false;
-        }
-    }
-    return true;
-}
-
-// Consistent pin configuration for key matrix
-void configurePinModes(uint8_t* rowPins, uint8_t* colPins, uint8_t rows, uint8_t cols) {
-    // Validate pins first with detailed ESP32-S3 validation
-    if (!validateGpioPins(rowPins, rows) || !validateGpioPins(colPins, cols)) {
-        Serial.println("Invalid GPIO pins detected for ESP32-S3!");
-        return;
-    }
-
-    // IMPORTANT: For a matrix keyboard setup:
-    // For a typical matrix keyboard setup:
-    // - Configure rows as INPUT_PULLUP (will be read)
-    // - Configure columns as OUTPUT (will be driven)
-    
-    // First, print the pin assignments for clarity
-    Serial.println("\n--- Pin Configuration ---");
-    Serial.println("Row pins (configured as INPUT_PULLUP):");
-    for (uint8_t i = 0; i < rows; i++) {
-        Serial.printf("  Row %d: GPIO %d\n", i, rowPins[i]);
-    }
-    
-    Serial.println("Column pins (configured as OUTPUT):");
-    for (uint8_t j = 0; j < cols; j++) {
-        Serial.printf("  Column %d: GPIO %d\n", j, colPins[j]);
-    }
-    
-    // Now configure the pins
-    for (uint8_t i = 0; i < rows; i++) {
-        pinMode(rowPins[i], INPUT_PULLUP);
-    }
-
-    for (uint8_t j = 0; j < cols; j++) {
-        pinMode(colPins[j], OUTPUT);
-        digitalWrite(colPins[j], HIGH);  // Start with HIGH (inactive)
-    }
-    
-    Serial.println("Pin configuration complete\n");
-}
-
-// initializeKeyHandler() using a 5x5 grid and loading actions via ConfigManager
+// initializeKeyHandler() building the scan driver from info.json hardware.matrix
+// and loading actions via ConfigManager
 void initializeKeyHandler() {
-    const uint8_t rows = 5;
-    const uint8_t cols = 5;
-    uint8_t rowPins[rows] = {ROW0, ROW1, ROW2, ROW3, ROW4};
-    uint8_t colPins[cols] = {COL0, COL1, COL2, COL3, COL4};
+    MatrixHardware hardware = ConfigManager::loadMatrixHardware("/config/info.json");
     
     USBSerial.println("\n=== Initializing Keyboard Matrix ===");
-    USBSerial.println("Matrix dimensions: 5x5");
-    
-    // Log pin assignments for clarity  
-    USBSerial.println("Row pins:");
-    for (int i = 0; i < rows; i++) {
-        USBSerial.printf("  Row %d: GPIO %d\n", i, rowPins[i]);
-    }
-    
-    USBSerial.println("Column pins:");
-    for (int i = 0; i < cols; i++) {
-        USBSerial.printf("  Column %d: GPIO %d\n", i, colPins[i]);
+    USBSerial.printf("Matrix driver: %s, dimensions: %dx%d\n",
+                  hardware.driver.c_str(), hardware.rows, hardware.cols);
+    
+    // The driver validates and configures its pins once in begin()
+    MatrixScanDriver* driver = createMatrixDriver(hardware);
+    if (!driver->begin()) {
+        USBSerial.println("ERROR: Matrix scan driver failed to start!");
+        delete driver;
+        return;
     }
     
-    // Configure pin modes
-    configurePinModes(rowPins, colPins, rows, cols);
-    
     // Load components from JSON
     USBSerial.println("Loading components from JSON...");
     std::vector<Component> components = ConfigManager::loadComponents("/config/components.json");
     
     // Create and initialize key handler with components
     USBSerial.println("Initializing key handler instance...");
-    keyHandler = new KeyHandler(rows, cols, components, rowPins, colPins);
+    keyHandler = new KeyHandler(driver, components);
     
     if (keyHandler) {
         keyHandler->begin();
         
+        // Per-key debounce from info.json defaults and component overrides
+        keyHandler->applySettings(ConfigManager::loadSettings("/config/info.json"));
+        
         // Load actions configuration
         USBSerial.println("Loading key action configuration...");
-        auto actions = ConfigManager::loadActions("/config/actions.json");
-        keyHandler->loadKeyConfiguration(actions);
+        auto layers = ConfigManager::loadLayers("/config/actions.json");
+        auto combos = ConfigManager::loadCombos("/config/actions.json");
+        // Macro actions resolve to compiled macro indices, so compile first
+        macroEngine.compile(ConfigManager::loadMacros("/config/actions.json"));
+        keyHandler->loadKeyConfiguration(layers, combos);
         
         USBSerial.println("Key handler initialization complete");
     } else {
@@ -163,6 +89,30 @@ void initializeKeyHandler() {
 }
 
 
+// components.json "as5600" object: I2C speed and multiplexer channel, the
+// chip's filter and hysteresis, and the filter applied on top
+void configureAS5600Encoder(uint8_t encoderIndex, JsonObject as5600) {
+    As5600Config config;
+    config.i2cFrequency = as5600["i2c_frequency"] | config.i2cFrequency;
+    // Same-address chips sit on their own TCA9548A channel
+    if (as5600.containsKey("mux_channel") && !as5600["mux_channel"].isNull()) {
+        config.muxAddress = as5600["mux_address"] | I2C_MUX_BASE_ADDRESS;
+        config.muxChannel = as5600["mux_channel"] | 0;
+    }
+    config.slowFilter = as5600["slow_filter"] | config.slowFilter;
+    config.fastFilterThreshold = as5600["fast_filter_threshold"] | config.fastFilterThreshold;
+    config.hysteresis = as5600["hysteresis"] | config.hysteresis;
+    config.filter.type = AngleFilter::typeFromString(as5600["filter"] | "iir");
+    // Floats only here, the filter runs in fixed point
+    if (as5600.containsKey("filter_alpha"))
+        config.filter.alpha = constrain((int)(as5600["filter_alpha"].as<float>() * 256 + 0.5f), 1, 256);
+    if (as5600.containsKey("process_noise"))
+        config.filter.processNoise = (uint32_t)(as5600["process_noise"].as<float>() * 256 + 0.5f);
+    if (as5600.containsKey("measurement_noise"))
+        config.filter.measurementNoise = (uint32_t)(as5600["measurement_noise"].as<float>() * 256 + 0.5f);
+    encoderHandler->configureAS5600(encoderIndex, config, as5600["steps_per_revolution"] | 24);
+}
+
 void initializeEncoderHandler() {
     // Read components JSON from the file
     String componentsJson = ConfigManager::readFile("/config/components.json");
@@ -184,6 +134,8 @@ void initializeEncoderHandler() {
     // Create handler if we have encoders
     if (encoderCount > 0) {
         encoderHandler = new EncoderHandler(encoderCount);
+        ModuleSettings settings = ConfigManager::loadSettings("/config/info.json");
+        encoderHandler->applySettings(settings);
         
         // Configure each encoder
         uint8_t encoderIndex = 0;
@@ -208,12 +160,13 @@ void initializeEncoderHandler() {
                 }
                 
                 if (!encoderConfig.isNull()) {
-                    // Determine encoder type (default mechanical unless configured as as5600)
+                    // Determine encoder type (default mechanical unless configured as as5600 or pcnt)
                     EncoderType type = ENCODER_TYPE_MECHANICAL;
-                    if (encoderConfig.containsKey("configuration") && 
-                        encoderConfig["configuration"].containsKey("type") &&
-                        encoderConfig["configuration"]["type"].as<String>() == "as5600") {
+                    String typeName = encoderConfig["configuration"]["type"] | "mechanical";
+                    if (typeName == "as5600") {
                         type = ENCODER_TYPE_AS5600;
+                    } else if (typeName == "pcnt") {
+                        type = ENCODER_TYPE_PCNT;
                     }
                     
                     // Get pins and configuration
@@ -224,6 +177,11 @@ void initializeEncoderHandler() {
                         pinA = encoderConfig["mechanical"]["pin_a"] | 0;
                         pinB = encoderConfig["mechanical"]["pin_b"] | 0;
                     }
+                    if (type == ENCODER_TYPE_AS5600) {
+                        // SDA and SCL
+                        pinA = encoderConfig["as5600"]["pin_sda"] | pinA;
+                        pinB = encoderConfig["as5600"]["pin_scl"] | pinB;
+                    }
                     
                     if (encoderConfig.containsKey("configuration") && 
                         encoderConfig["configuration"].containsKey("direction")) {
@@ -242,6 +200,15 @@ void initializeEncoderHandler() {
                         direction,
                         0 // zeroPosition
                     );
+                    if (type == ENCODER_TYPE_AS5600) {
+                        configureAS5600Encoder(encoderIndex - 1, encoderConfig["as5600"]);
+                    } else {
+                        encoderHandler->configureQuadrature(
+                            encoderIndex - 1,
+                            encoderConfig["configuration"]["counts_per_detent"] | settings.encoderStepSize,
+                            encoderConfig["configuration"]["glitch_filter_ns"] | PCNT_DEFAULT_FILTER_NS
+                        );
+                    }
                 }
             }
         }
@@ -276,12 +243,104 @@ void debugActionsConfig() {
     USBSerial.println("==================================\n");
 }
 
+// Matrix scan task, woken by the scan timer
+static TaskHandle_t keyboardTaskHandle = NULL;
+
+// Simple line-based commands on the CDC console
+void handleConsoleCommands() {
+    static String line;
+    
+    while (USBSerial.available() > 0) {
+        char c = USBSerial.read();
+        if (c != '\n' && c != '\r') {
+            if (line.length() < 64) {
+                line += c;
+            }
+            continue;
+        }
+        
+        line.trim();
+        if (line == "latency") {
+            latencyStats.print();
+        } else if (line == "latency reset") {
+            latencyStats.reset();
+            USBSerial.println("Latency statistics reset");
+        } else if (line == "hid") {
+            if (hidHandler) {
+                hidHandler->printQueueStats();
+            }
+        } else if (line == "scan") {
+            scanScheduler.print();
+        } else if (line == "scanbench") {
+            if (keyHandler && keyboardTaskHandle) {
+                // Runs on the scan task, the notification also ends an idle wait
+                keyHandler->requestScanBenchmark();
+                xTaskNotifyGive(keyboardTaskHandle);
+            }
+        } else if (line == "macros") {
+            macroEngine.print();
+        } else if (line == "macros reset") {
+            macroEngine.resetStats();
+            USBSerial.println("Macro statistics reset");
+        } else if (line == "mouse") {
+            mouseEngine.print();
+        } else if (line == "mouse reset") {
+            mouseEngine.resetStats();
+            USBSerial.println("Mouse statistics reset");
+        } else if (line == "raw") {
+            rawHidHandler.print();
+        } else if (line == "raw reset") {
+            rawHidHandler.resetStats();
+            USBSerial.println("Raw HID statistics reset");
+        } else if (line == "i2c") {
+            i2cBus.print();
+        } else if (line == "i2c reset") {
+            i2cBus.resetStats();
+            USBSerial.println("I2C statistics reset");
+        } else if (line == "scan reset") {
+            scanScheduler.resetStats();
+            USBSerial.println("Scan statistics reset");
+        } else if (!line.isEmpty()) {
+            USBSerial.printf("Unknown command: %s\n", line.c_str());
+            USBSerial.println("Commands: latency, latency reset, scan, scan reset, scanbench, macros, macros reset, mouse, mouse reset, raw, raw reset, i2c, i2c reset, hid");
+        }
+        line = "";
+    }
+}
+
+// Scans the matrix once per scan timer tick, pvParameters is the scan rate in Hz
 void keyboardTask(void *pvParameters) {
+    scanScheduler.begin((uint16_t)(uintptr_t)pvParameters, xTaskGetCurrentTaskHandle());
+    if (keyHandler) {
+        keyHandler->setScanPeriod(scanScheduler.getPeriodUs());
+    }
+    scanScheduler.start();
     while (true) {
+        scanScheduler.waitForTick();
         if (keyHandler) {
             keyHandler->updateKeys();
+            
+            // Nothing touched for the hold-off: stop the timer and sleep
+            // until a column interrupt
+            if (keyHandler->readyForIdle()) {
+                scanScheduler.stop();
+                keyHandler->waitForKeyActivity();
+                scanScheduler.start();
+            }
+        }
+    }
+}
+
+// Drains key events from the scan and runs their actions, so USB and
+// logging never stall the matrix scan
+void keyDispatchTask(void *pvParameters) {
+    while (true) {
+        // Wake on new events, or at the next tap-hold deadline
+        uint32_t timeoutMs = keyHandler ? keyHandler->getDispatchTimeoutMs() : 100;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+        if (keyHandler) {
+            keyHandler->processKeyEvents();
         }
-        vTaskDelay(pdMS_TO_TICKS(10));  // Scan every 10ms (adjust as needed)
     }
 }
 
@@ -290,7 +349,9 @@ void encoderTask(void *pvParameters) {
         if (encoderHandler) {
             encoderHandler->updateEncoders();
         }
-        vTaskDelay(pdMS_TO_TICKS(10));  // Adjust the delay as needed (here 10ms)
+        // Poll every 10 ms, every tick while detents wait for the HID queue
+        bool draining = encoderHandler && encoderHandler->hasPendingSteps();
+        vTaskDelay(draining ? 1 : pdMS_TO_TICKS(10));
     }
 }
 
@@ -315,10 +376,6 @@ void setup() {
     USBSerial.println(TAG);
     USBSerial.println("Starting device initialization");
     
-    // Initialize HID components
-    ConsumerControl.begin();
-    USBSerial.println("HID Consumer Control initialized");
-    
     // Mount SPIFFS for configuration files
     if (!SPIFFS.begin(true)) {
         USBSerial.println("Failed to mount SPIFFS");
@@ -360,6 +417,10 @@ void setup() {
     // Initialize HID handler before other components
     USBSerial.println("Initializing HID Handler...");
     initializeHIDHandler();
+    if (hidHandler) {
+        ModuleSettings settings = ConfigManager::loadSettings("/config/info.json");
+        hidHandler->setKeyboardMode(HIDHandler::keyboardModeFromString(settings.keyboardReportMode.c_str()));
+    }
     
     USBSerial.println("Initializing KeyHandler...");
     initializeKeyHandler();
@@ -402,8 +463,20 @@ void setup() {
     }
     
     // Create tasks for keyboard and encoder handling
-    xTaskCreate(keyboardTask, "keyboard_task", 4096, NULL, 2, NULL);
+    TaskHandle_t dispatchTaskHandle = NULL;
+    // Extra stack for the tap-hold replay, which recurses per buffered decision
+    xTaskCreate(keyDispatchTask, "key_dispatch_task", 6144, NULL, 2, &dispatchTaskHandle);
+    if (keyHandler) {
+        keyHandler->setDispatchTask(dispatchTaskHandle);
+    }
+    // Timer-paced scanning at settings.scanRate
+    ModuleSettings scanSettings = ConfigManager::loadSettings("/config/info.json");
+    xTaskCreate(keyboardTask, "keyboard_task", 4096, (void*)(uintptr_t)scanSettings.scanRate, 3, &keyboardTaskHandle);
     xTaskCreate(encoderTask, "encoder_task", 4096, NULL, 2, NULL);
+    // Macro steps are timer-woken, alongside the scan task so delays stay on time
+    macroEngine.begin(3);
+    mouseEngine.begin(scanSettings);
+    rawHidHandler.begin();
 
     USBSerial.println("Setup complete - entering main loop");
 }
@@ -411,8 +484,17 @@ void setup() {
 void loop() {
     // Update WiFi Manager
     WiFiManager::update();
+    
+    // Process CDC console commands
+    handleConsoleCommands();
 
-    // Update LEDs
+    // Raw HID configuration requests
+    rawHidHandler.update();
+
+    // Apply key state to the button LEDs, then update LEDs
+    if (keyHandler) {
+        keyHandler->processLedEvents();
+    }
     updateLEDs();
     
     // Update display
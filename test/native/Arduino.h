@@ -0,0 +1,26 @@
+// Arduino.h
+// Host stand-in for the Arduino core, just enough for the engines built by
+// [env:native] in platformio.ini. Device-only code never includes it.
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+class String : public std::string {
+public:
+    String() {}
+    String(const char* text) : std::string(text ? text : "") {}
+    String(const std::string& text) : std::string(text) {}
+
+    bool isEmpty() const { return empty(); }
+    String substring(size_t from, size_t to) const {
+        if (from >= size()) return String();
+        return String(substr(from, to > from ? to - from : 0));
+    }
+};
+
+#endif // NATIVE_ARDUINO_H
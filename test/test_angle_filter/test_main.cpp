@@ -0,0 +1,196 @@
+// test_main.cpp
+// Host tests of the AS5600 angle filter on synthetic noisy angle traces:
+// noise reduction, step settling, the 4095 -> 0 wrap, and steps that do not
+// flip on an edge. The traces are generated deterministically, not recorded.
+
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "AngleFilter.h"
+#include "EncoderMath.h"
+
+void setUp() {}
+void tearDown() {}
+
+#define AS5600_RANGE 4096
+#define COUNTS_PER_STEP (AS5600_RANGE / 24)
+
+// Sensor noise, roughly Gaussian with a sigma of about 1.7 counts
+struct Noise {
+    uint32_t seed;
+    explicit Noise(uint32_t start) : seed(start) {}
+
+    double uniform() {
+        seed = seed * 1103515245 + 12345;
+        return ((seed >> 8) & 0xFFFF) / 32768.0 - 1.0;
+    }
+    int32_t sample() {
+        return (int32_t)lround(1.5 * (uniform() + uniform() + uniform() + uniform()));
+    }
+};
+
+// Raw 12-bit readings of a true angle trace in unwrapped counts
+static std::vector<uint16_t> sensorTrace(const std::vector<double>& truth, uint32_t seed) {
+    Noise noise(seed);
+    std::vector<uint16_t> raw;
+    for (double angle : truth) {
+        int32_t reading = (int32_t)lround(angle) + noise.sample();
+        raw.push_back((uint16_t)(((reading % AS5600_RANGE) + AS5600_RANGE) % AS5600_RANGE));
+    }
+    return raw;
+}
+
+// As5600Encoder::update(): unwrap the raw angle, then filter it.
+// Returns the filtered positions in counts.
+static std::vector<double> runPipeline(AngleFilter& filter, const std::vector<uint16_t>& raw) {
+    std::vector<double> filtered;
+    uint16_t last = raw[0];
+    int32_t position = raw[0];
+    filter.reset(position);
+    for (uint16_t angle : raw) {
+        position += EncoderMath::unwrapDelta(angle, last, AS5600_RANGE);
+        last = angle;
+        filtered.push_back(filter.update(position) / 256.0);
+    }
+    return filtered;
+}
+
+static double rmsError(const std::vector<double>& values, const std::vector<double>& truth, size_t from) {
+    double sum = 0;
+    for (size_t i = from; i < values.size(); i++) sum += (values[i] - truth[i]) * (values[i] - truth[i]);
+    return sqrt(sum / (values.size() - from));
+}
+
+static AngleFilter makeFilter(AngleFilterType type) {
+    AngleFilterConfig config;
+    config.type = type;
+    AngleFilter filter;
+    filter.configure(config);
+    return filter;
+}
+
+static void test_unfiltered_passes_through() {
+    AngleFilter filter = makeFilter(ANGLE_FILTER_NONE);
+    TEST_ASSERT_EQUAL_INT32(1234 * 256, (int32_t)filter.update(1234));
+    TEST_ASSERT_EQUAL_INT32(-7 * 256, (int32_t)filter.update(-7));
+
+    // Out of range settings are clamped instead of stalling the estimate
+    AngleFilterConfig config;
+    config.alpha = 0;
+    filter.configure(config);
+    filter.reset(0);
+    for (int i = 0; i < 5000; i++) filter.update(100);
+    TEST_ASSERT_INT32_WITHIN(256, 100 * 256, (int32_t)filter.getEstimate());
+}
+
+// A knob at rest: the filtered position is much closer to the truth
+static void test_noise_reduced_at_rest() {
+    std::vector<double> truth(4000, 2000.0);
+    std::vector<uint16_t> raw = sensorTrace(truth, 1);
+    std::vector<double> rawCounts(raw.begin(), raw.end());
+    double rawRms = rmsError(rawCounts, truth, 200);
+
+    const AngleFilterType types[] = {ANGLE_FILTER_IIR, ANGLE_FILTER_KALMAN};
+    for (AngleFilterType type : types) {
+        AngleFilter filter = makeFilter(type);
+        double rms = rmsError(runPipeline(filter, raw), truth, 200);
+        TEST_ASSERT_TRUE(rms < rawRms / 2);
+
+        char line[80];
+        snprintf(line, sizeof(line), "%-6s at rest: %.2f counts rms, raw %.2f", AngleFilter::typeName(type), rms,
+                 rawRms);
+        TEST_MESSAGE(line);
+    }
+}
+
+// A quick turn of two steps: samples until the position stays within the
+// noise, 3 counts, of the new angle
+static void test_step_settles() {
+    std::vector<double> truth(600, 1000.0);
+    for (size_t i = 100; i < truth.size(); i++) truth[i] = 1000.0 + 2 * COUNTS_PER_STEP;
+    std::vector<uint16_t> raw = sensorTrace(truth, 2);
+
+    const AngleFilterType types[] = {ANGLE_FILTER_IIR, ANGLE_FILTER_KALMAN};
+    for (AngleFilterType type : types) {
+        AngleFilter filter = makeFilter(type);
+        std::vector<double> filtered = runPipeline(filter, raw);
+        size_t settled = truth.size();
+        for (size_t i = 100; i < truth.size(); i++) {
+            if (fabs(filtered[i] - truth[i]) > 3) settled = truth.size();
+            else if (settled == truth.size()) settled = i;
+        }
+        TEST_ASSERT_LESS_THAN(100 + 40, settled);
+
+        char line[80];
+        snprintf(line, sizeof(line), "%-6s settles in %u samples", AngleFilter::typeName(type),
+                 (unsigned)(settled - 100));
+        TEST_MESSAGE(line);
+    }
+}
+
+// Turning slowly through 4095 -> 0 and back, the filtered position follows
+// without a jump of a revolution
+static void test_follows_through_wrap() {
+    std::vector<double> truth;
+    for (int i = 0; i < 3000; i++) truth.push_back(4000.0 + 0.1 * i);
+    for (int i = 0; i < 3000; i++) truth.push_back(4300.0 - 0.1 * i);
+    std::vector<uint16_t> raw = sensorTrace(truth, 3);
+
+    const AngleFilterType types[] = {ANGLE_FILTER_IIR, ANGLE_FILTER_KALMAN};
+    for (AngleFilterType type : types) {
+        AngleFilter filter = makeFilter(type);
+        std::vector<double> filtered = runPipeline(filter, raw);
+        // The pipeline starts from the first reading, noise included
+        double offset = raw[0] - truth[0];
+        double worst = 0;
+        for (size_t i = 50; i < truth.size(); i++) {
+            worst = fmax(worst, fabs(filtered[i] - truth[i] - offset));
+        }
+        TEST_ASSERT_TRUE(worst < 8);
+    }
+}
+
+// A knob left on a step edge: raw readings flip the nearest step back and
+// forth, the filter plus the step hysteresis never does
+static void test_edge_does_not_flip() {
+    std::vector<double> truth(5000, 3 * COUNTS_PER_STEP + COUNTS_PER_STEP / 2);
+    std::vector<uint16_t> raw = sensorTrace(truth, 4);
+
+    uint32_t rawFlips = 0;
+    long rawStep = EncoderMath::nearestDetent(raw[0], COUNTS_PER_STEP);
+    for (uint16_t angle : raw) {
+        long step = EncoderMath::nearestDetent(angle, COUNTS_PER_STEP);
+        if (step != rawStep) rawFlips++;
+        rawStep = step;
+    }
+
+    const AngleFilterType types[] = {ANGLE_FILTER_IIR, ANGLE_FILTER_KALMAN};
+    for (AngleFilterType type : types) {
+        AngleFilter filter = makeFilter(type);
+        std::vector<double> filtered = runPipeline(filter, raw);
+        long step = EncoderMath::nearestDetent((int32_t)filtered[0], COUNTS_PER_STEP);
+        uint32_t flips = 0;
+        for (double position : filtered) {
+            long next = EncoderMath::hysteresisDetent(step, (int32_t)lround(position), COUNTS_PER_STEP);
+            if (next != step) flips++;
+            step = next;
+        }
+        TEST_ASSERT_EQUAL_UINT32(0, flips);
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32(100, rawFlips);
+
+    char line[80];
+    snprintf(line, sizeof(line), "on a step edge: %u raw flips, 0 filtered", rawFlips);
+    TEST_MESSAGE(line);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_unfiltered_passes_through);
+    RUN_TEST(test_noise_reduced_at_rest);
+    RUN_TEST(test_step_settles);
+    RUN_TEST(test_follows_through_wrap);
+    RUN_TEST(test_edge_does_not_flip);
+    return UNITY_END();
+}
@@ -0,0 +1,209 @@
+// test_main.cpp
+// Host tests of combo matching on key bitmasks, and of its cost as the
+// combo table grows.
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "ComboEngine.h"
+
+void setUp() {}
+void tearDown() {}
+
+#define WINDOW_MS 50
+
+static KeyEvent event(uint8_t key, bool pressed, uint32_t timeMs) {
+    KeyEvent e;
+    e.detectUs = timeMs * 1000;
+    e.timestampUs = timeMs * 1000;
+    e.keyIndex = key;
+    e.pressed = pressed;
+    e.reserved = 0;
+    return e;
+}
+
+static uint32_t keys(uint8_t a, uint8_t b) {
+    return (1UL << a) | (1UL << b);
+}
+
+static void test_table_rejects_invalid_combos() {
+    ComboEngine combos;
+    TEST_ASSERT_EQUAL_INT(-1, combos.addCombo(1UL << 3));
+    TEST_ASSERT_EQUAL_INT(0, combos.addCombo(keys(0, 1)));
+    TEST_ASSERT_EQUAL_INT(-1, combos.addCombo(keys(1, 0)));
+
+    for (uint8_t i = 1; i < MAX_COMBOS; i++) {
+        TEST_ASSERT_EQUAL_INT(i, combos.addCombo(keys(2 + i % 24, 26 + i / 24)));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, combos.addCombo(keys(5, 31)));
+    TEST_ASSERT_EQUAL_UINT8(MAX_COMBOS, combos.getComboCount());
+}
+
+static void test_unrelated_key_passes() {
+    ComboEngine combos;
+    combos.addCombo(keys(0, 1));
+    TEST_ASSERT_EQUAL(COMBO_PASS, combos.onEvent(event(7, true, 0)));
+    TEST_ASSERT_EQUAL(COMBO_PASS, combos.onEvent(event(7, false, 10)));
+    TEST_ASSERT_FALSE(combos.isPending());
+}
+
+static void test_two_key_combo_fires_and_releases_once() {
+    ComboEngine combos;
+    combos.setWindow(WINDOW_MS);
+    int8_t escape = combos.addCombo(keys(0, 1));
+
+    TEST_ASSERT_EQUAL(COMBO_BUFFERED, combos.onEvent(event(0, true, 100)));
+    TEST_ASSERT_TRUE(combos.isPending());
+    TEST_ASSERT_EQUAL_UINT32(30 * 1000, combos.timeUntilDeadline(120 * 1000));
+    TEST_ASSERT_EQUAL(COMBO_FIRE, combos.onEvent(event(1, true, 100 + WINDOW_MS - 1)));
+    TEST_ASSERT_EQUAL_UINT8(escape, combos.getCombo());
+
+    // Both presses were consumed by the combo
+    KeyEvent replay[COMBO_MAX_KEYS + 1];
+    TEST_ASSERT_EQUAL_UINT8(0, combos.takeBuffered(replay));
+
+    // The first release ends the action, the second is swallowed
+    TEST_ASSERT_EQUAL(COMBO_RELEASE, combos.onEvent(event(1, false, 300)));
+    TEST_ASSERT_EQUAL(COMBO_SUPPRESS, combos.onEvent(event(0, false, 310)));
+    TEST_ASSERT_EQUAL(COMBO_PASS, combos.onEvent(event(0, false, 320)));
+    TEST_ASSERT_EQUAL_UINT32(1, combos.getFireCount());
+}
+
+static void test_late_press_flushes_in_order() {
+    ComboEngine combos;
+    combos.setWindow(WINDOW_MS);
+    combos.addCombo(keys(0, 1));
+
+    TEST_ASSERT_EQUAL(COMBO_BUFFERED, combos.onEvent(event(0, true, 0)));
+    TEST_ASSERT_EQUAL(COMBO_FLUSH, combos.onEvent(event(1, true, WINDOW_MS)));
+
+    KeyEvent replay[COMBO_MAX_KEYS + 1];
+    TEST_ASSERT_EQUAL_UINT8(2, combos.takeBuffered(replay));
+    TEST_ASSERT_EQUAL_UINT8(0, replay[0].keyIndex);
+    TEST_ASSERT_EQUAL_UINT8(1, replay[1].keyIndex);
+    TEST_ASSERT_FALSE(combos.isPending());
+}
+
+static void test_key_outside_candidates_flushes() {
+    ComboEngine combos;
+    combos.addCombo(keys(0, 1));
+
+    TEST_ASSERT_EQUAL(COMBO_BUFFERED, combos.onEvent(event(0, true, 0)));
+    TEST_ASSERT_EQUAL(COMBO_FLUSH, combos.onEvent(event(5, true, 10)));
+
+    KeyEvent replay[COMBO_MAX_KEYS + 1];
+    TEST_ASSERT_EQUAL_UINT8(2, combos.takeBuffered(replay));
+    TEST_ASSERT_EQUAL_UINT8(5, replay[1].keyIndex);
+}
+
+static void test_timer_without_second_key_flushes() {
+    ComboEngine combos;
+    combos.setWindow(WINDOW_MS);
+    combos.addCombo(keys(0, 1));
+
+    combos.onEvent(event(0, true, 0));
+    TEST_ASSERT_EQUAL(COMBO_BUFFERED, combos.onTimer((WINDOW_MS - 1) * 1000));
+    TEST_ASSERT_EQUAL(COMBO_FLUSH, combos.onTimer(WINDOW_MS * 1000));
+
+    KeyEvent replay[COMBO_MAX_KEYS + 1];
+    TEST_ASSERT_EQUAL_UINT8(1, combos.takeBuffered(replay));
+}
+
+// A pair that is also part of a larger combo waits for the window
+static void test_overlapping_combos_pick_exact_match() {
+    ComboEngine combos;
+    combos.setWindow(WINDOW_MS);
+    int8_t pair = combos.addCombo(keys(0, 1));
+    int8_t triple = combos.addCombo(keys(0, 1) | (1UL << 2));
+
+    combos.onEvent(event(0, true, 0));
+    TEST_ASSERT_EQUAL(COMBO_BUFFERED, combos.onEvent(event(1, true, 5)));
+    TEST_ASSERT_EQUAL(COMBO_FIRE, combos.onEvent(event(2, true, 10)));
+    TEST_ASSERT_EQUAL_UINT8(triple, combos.getCombo());
+    TEST_ASSERT_EQUAL(COMBO_RELEASE, combos.onEvent(event(2, false, 100)));
+    combos.onEvent(event(0, false, 100));
+    combos.onEvent(event(1, false, 100));
+
+    combos.onEvent(event(0, true, 200));
+    TEST_ASSERT_EQUAL(COMBO_BUFFERED, combos.onEvent(event(1, true, 205)));
+    TEST_ASSERT_EQUAL(COMBO_FIRE, combos.onTimer((200 + WINDOW_MS) * 1000));
+    TEST_ASSERT_EQUAL_UINT8(pair, combos.getCombo());
+}
+
+// Releasing a held back key inside the window settles the match early
+static void test_release_inside_window_fires_pending_match() {
+    ComboEngine combos;
+    combos.setWindow(WINDOW_MS);
+    int8_t pair = combos.addCombo(keys(0, 1));
+    combos.addCombo(keys(0, 1) | (1UL << 2));
+
+    combos.onEvent(event(0, true, 0));
+    combos.onEvent(event(1, true, 5));
+    KeyEvent release = event(0, false, 20);
+    TEST_ASSERT_EQUAL(COMBO_FIRE, combos.onEvent(release));
+    TEST_ASSERT_EQUAL_UINT8(pair, combos.getCombo());
+    // The caller feeds the release again once the combo is pressed
+    TEST_ASSERT_EQUAL(COMBO_RELEASE, combos.onEvent(release));
+}
+
+// Release of a key held from before the attempt stays in sequence
+static void test_earlier_key_release_is_buffered() {
+    ComboEngine combos;
+    combos.addCombo(keys(0, 1));
+
+    combos.onEvent(event(0, true, 0));
+    TEST_ASSERT_EQUAL(COMBO_BUFFERED, combos.onEvent(event(9, false, 5)));
+    TEST_ASSERT_EQUAL(COMBO_FIRE, combos.onEvent(event(1, true, 10)));
+
+    KeyEvent replay[COMBO_MAX_KEYS + 1];
+    TEST_ASSERT_EQUAL_UINT8(1, combos.takeBuffered(replay));
+    TEST_ASSERT_EQUAL_UINT8(9, replay[0].keyIndex);
+}
+
+// Cost per event with 1 and with 64 combos defined, printed for reference
+static void test_benchmark_cost_against_combo_count() {
+    const uint8_t counts[] = {1, 16, 64};
+    const int iterations = 200000;
+
+    for (uint8_t count : counts) {
+        ComboEngine combos;
+        combos.setWindow(WINDOW_MS);
+        combos.addCombo(keys(0, 1));
+        for (uint8_t i = 1; i < count; i++) {
+            combos.addCombo(keys(i % 24, 24 + i / 24) | (1UL << (i % 7 + 2)));
+        }
+
+        uint32_t fired = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            uint32_t t = i * 1000;
+            if (combos.onEvent(event(0, true, t)) == COMBO_FIRE) fired++;
+            if (combos.onEvent(event(1, true, t)) == COMBO_FIRE) fired++;
+            if (combos.isPending()) combos.onTimer(t + WINDOW_MS * 1000);
+            combos.onEvent(event(0, false, t));
+            combos.onEvent(event(1, false, t));
+        }
+        auto end = std::chrono::steady_clock::now();
+        TEST_ASSERT_EQUAL_UINT32(iterations, combos.getFireCount());
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / (iterations * 4);
+        char line[80];
+        snprintf(line, sizeof(line), "%2u combos: %5.1f ns/event (%u fired)", count, ns, fired);
+        TEST_MESSAGE(line);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_table_rejects_invalid_combos);
+    RUN_TEST(test_unrelated_key_passes);
+    RUN_TEST(test_two_key_combo_fires_and_releases_once);
+    RUN_TEST(test_late_press_flushes_in_order);
+    RUN_TEST(test_key_outside_candidates_flushes);
+    RUN_TEST(test_timer_without_second_key_flushes);
+    RUN_TEST(test_overlapping_combos_pick_exact_match);
+    RUN_TEST(test_release_inside_window_fires_pending_match);
+    RUN_TEST(test_earlier_key_release_is_buffered);
+    RUN_TEST(test_benchmark_cost_against_combo_count);
+    return UNITY_END();
+}
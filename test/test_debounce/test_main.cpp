@@ -0,0 +1,196 @@
+// test_main.cpp
+// Host tests of the debounce modes against synthetic bounce waveforms, and
+// the latency each mode adds.
+
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "DebounceEngine.h"
+
+void setUp() {}
+void tearDown() {}
+
+#define SCAN_PERIOD_US 250
+#define WINDOW_MS 5
+
+// Contact waveform as the times the raw input toggles, starting released
+typedef std::vector<uint32_t> Waveform;
+
+struct Transition {
+    uint32_t timeUs;
+    bool pressed;
+};
+
+static bool rawAt(const Waveform& edges, uint32_t timeUs) {
+    bool raw = false;
+    for (uint32_t edge : edges) {
+        if (edge > timeUs) break;
+        raw = !raw;
+    }
+    return raw;
+}
+
+// Scans the way KeyHandler does, sampling the key only when its raw input
+// changed or the engine still has it pending
+static std::vector<Transition> run(DebounceEngine& engine, const Waveform& edges, uint32_t endUs) {
+    std::vector<Transition> out;
+    bool lastRaw = false;
+    for (uint32_t t = 0; t <= endUs; t += SCAN_PERIOD_US) {
+        bool raw = rawAt(edges, t);
+        if (raw == lastRaw && !(engine.pendingKeys() & 1)) continue;
+        lastRaw = raw;
+        if (engine.update(0, raw, t)) {
+            out.push_back({t, engine.isPressed(0)});
+        }
+    }
+    return out;
+}
+
+// Press bouncing for 1.8 ms from 10 ms, release bouncing for 0.9 ms from
+// 60 ms. Most bounces are shorter than the scan period.
+static Waveform bouncyTap() {
+    return {10000, 10300, 10700, 11200, 11800,
+            60000, 60400, 60900};
+}
+
+static void setupEngine(DebounceEngine& engine, DebounceMode mode) {
+    TEST_ASSERT_TRUE(engine.begin(1, SCAN_PERIOD_US));
+    engine.setKeyConfig(0, mode, WINDOW_MS);
+}
+
+static void assertOnePressOneRelease(const std::vector<Transition>& out) {
+    TEST_ASSERT_EQUAL(2, out.size());
+    TEST_ASSERT_TRUE(out[0].pressed);
+    TEST_ASSERT_FALSE(out[1].pressed);
+}
+
+static void test_eager_press_is_immediate() {
+    DebounceEngine engine;
+    setupEngine(engine, DEBOUNCE_EAGER);
+    std::vector<Transition> out = run(engine, bouncyTap(), 100000);
+    assertOnePressOneRelease(out);
+
+    // Press on the first edge, release a window after the last bounce
+    TEST_ASSERT_EQUAL_UINT32(10000, out[0].timeUs);
+    TEST_ASSERT_UINT32_WITHIN(SCAN_PERIOD_US, 60900 + WINDOW_MS * 1000, out[1].timeUs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(60900 + WINDOW_MS * 1000, out[1].timeUs);
+}
+
+static void test_deferred_waits_for_quiet_window() {
+    DebounceEngine engine;
+    setupEngine(engine, DEBOUNCE_DEFERRED);
+    std::vector<Transition> out = run(engine, bouncyTap(), 100000);
+    assertOnePressOneRelease(out);
+
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(11800 + WINDOW_MS * 1000, out[0].timeUs);
+    TEST_ASSERT_UINT32_WITHIN(SCAN_PERIOD_US, 11800 + WINDOW_MS * 1000, out[0].timeUs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(60900 + WINDOW_MS * 1000, out[1].timeUs);
+    TEST_ASSERT_UINT32_WITHIN(SCAN_PERIOD_US, 60900 + WINDOW_MS * 1000, out[1].timeUs);
+}
+
+static void test_integrator_needs_threshold_scans() {
+    DebounceEngine engine;
+    setupEngine(engine, DEBOUNCE_INTEGRATOR);
+    std::vector<Transition> out = run(engine, bouncyTap(), 100000);
+    assertOnePressOneRelease(out);
+
+    // At least threshold net samples after the first edge, at most that
+    // many after the bouncing stops
+    const uint32_t thresholdUs = WINDOW_MS * 1000;
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(10000 + thresholdUs, out[0].timeUs);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(11800 + thresholdUs, out[0].timeUs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(60000 + thresholdUs, out[1].timeUs);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(60900 + thresholdUs, out[1].timeUs);
+}
+
+// A 50 ms global window used to drop the second tap of a quick double-tap
+static void test_quick_double_tap_is_kept() {
+    const DebounceMode modes[] = {DEBOUNCE_EAGER, DEBOUNCE_DEFERRED, DEBOUNCE_INTEGRATOR};
+    Waveform doubleTap = {10000, 10400, 10800, 35000, 35300, 35600,
+                          45000, 45200, 45500, 70000, 70300, 70600};
+    for (DebounceMode mode : modes) {
+        DebounceEngine engine;
+        setupEngine(engine, mode);
+        std::vector<Transition> out = run(engine, doubleTap, 120000);
+        TEST_ASSERT_EQUAL_MESSAGE(4, out.size(), DebounceEngine::modeName(mode));
+        for (size_t i = 0; i < out.size(); i++) {
+            TEST_ASSERT_EQUAL_MESSAGE(i % 2 == 0, out[i].pressed, DebounceEngine::modeName(mode));
+        }
+    }
+}
+
+// A lone 0.5 ms spike is noise to the modes that wait for agreement
+static void test_glitch_is_rejected() {
+    Waveform spike = {20000, 20500};
+    DebounceEngine deferred;
+    setupEngine(deferred, DEBOUNCE_DEFERRED);
+    TEST_ASSERT_EQUAL(0, run(deferred, spike, 60000).size());
+
+    DebounceEngine integrator;
+    setupEngine(integrator, DEBOUNCE_INTEGRATOR);
+    TEST_ASSERT_EQUAL(0, run(integrator, spike, 60000).size());
+}
+
+static void test_keys_keep_their_own_config() {
+    DebounceEngine engine;
+    TEST_ASSERT_FALSE(engine.begin(DEBOUNCE_MAX_KEYS + 1, SCAN_PERIOD_US));
+    TEST_ASSERT_TRUE(engine.begin(3, SCAN_PERIOD_US));
+    engine.setKeyConfig(0, DEBOUNCE_EAGER, 5);
+    engine.setKeyConfig(1, DEBOUNCE_DEFERRED, 10);
+    engine.setKeyConfig(2, DEBOUNCE_INTEGRATOR, 2);
+
+    TEST_ASSERT_EQUAL(DEBOUNCE_DEFERRED, engine.getMode(1));
+    TEST_ASSERT_EQUAL_UINT16(10, engine.getDebounceTime(1));
+
+    // All three pressed cleanly at 0 ms
+    uint32_t pressedAt[3] = {0, 0, 0};
+    for (uint32_t t = 0; t <= 20000; t += SCAN_PERIOD_US) {
+        for (uint8_t key = 0; key < 3; key++) {
+            if (engine.update(key, true, t)) pressedAt[key] = t;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, pressedAt[0]);
+    TEST_ASSERT_EQUAL_UINT32(10000, pressedAt[1]);
+    TEST_ASSERT_EQUAL_UINT32(2000 - SCAN_PERIOD_US, pressedAt[2]);
+    TEST_ASSERT_EQUAL_UINT32(0x7, engine.pressedKeys());
+    TEST_ASSERT_EQUAL_UINT32(0, engine.pendingKeys());
+}
+
+static void test_mode_names_round_trip() {
+    const DebounceMode modes[] = {DEBOUNCE_EAGER, DEBOUNCE_DEFERRED, DEBOUNCE_INTEGRATOR};
+    for (DebounceMode mode : modes) {
+        TEST_ASSERT_EQUAL(mode, DebounceEngine::modeFromString(DebounceEngine::modeName(mode)));
+    }
+    TEST_ASSERT_EQUAL(DEBOUNCE_EAGER, DebounceEngine::modeFromString("unknown"));
+    TEST_ASSERT_EQUAL(DEBOUNCE_EAGER, DebounceEngine::modeFromString(nullptr));
+}
+
+// Press and release latency each mode adds to the bouncy tap, from the
+// first edge of each transition
+static void test_report_added_latency() {
+    const DebounceMode modes[] = {DEBOUNCE_EAGER, DEBOUNCE_DEFERRED, DEBOUNCE_INTEGRATOR};
+    for (DebounceMode mode : modes) {
+        DebounceEngine engine;
+        setupEngine(engine, mode);
+        std::vector<Transition> out = run(engine, bouncyTap(), 100000);
+        assertOnePressOneRelease(out);
+
+        char line[96];
+        snprintf(line, sizeof(line), "%-10s press +%5u us, release +%5u us (%d ms window)",
+                 DebounceEngine::modeName(mode), out[0].timeUs - 10000, out[1].timeUs - 60000, WINDOW_MS);
+        TEST_MESSAGE(line);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_eager_press_is_immediate);
+    RUN_TEST(test_deferred_waits_for_quiet_window);
+    RUN_TEST(test_integrator_needs_threshold_scans);
+    RUN_TEST(test_quick_double_tap_is_kept);
+    RUN_TEST(test_glitch_is_rejected);
+    RUN_TEST(test_keys_keep_their_own_config);
+    RUN_TEST(test_mode_names_round_trip);
+    RUN_TEST(test_report_added_latency);
+    return UNITY_END();
+}
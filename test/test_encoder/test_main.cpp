@@ -0,0 +1,191 @@
+// test_main.cpp
+// Host tests of the encoder position math against a simulated x4 PCNT unit:
+// counter unwrap at high rotation rates, and detents with and without
+// hysteresis.
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "EncoderMath.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Limits as configured by PcntEncoder and As5600Encoder
+#define PCNT_RANGE 32767
+#define AS5600_RANGE 4096
+#define COUNTS_PER_DETENT 4
+
+// PCNT unit with the channel setup of PcntEncoder::begin(). Each channel
+// counts the edges of one pin, the other pin's level keeps or reverses the
+// direction; the counter resets to 0 on reaching either limit.
+struct SimPcnt {
+    bool a = false;
+    bool b = false;
+    int16_t count = 0;
+
+    void add(int8_t step) {
+        count += step;
+        if (count >= PCNT_RANGE || count <= -PCNT_RANGE) count = 0;
+    }
+
+    // Channel 0: A edges, rising decrements, reversed while B is low
+    void toggleA() {
+        a = !a;
+        int8_t step = a ? -1 : 1;
+        add(b ? step : -step);
+    }
+
+    // Channel 1: B edges, rising increments, reversed while A is low
+    void toggleB() {
+        b = !b;
+        int8_t step = b ? 1 : -1;
+        add(a ? step : -step);
+    }
+
+    // One quadrature edge clockwise (A leads) or counter-clockwise
+    void edge(bool clockwise) {
+        if (clockwise == (a == b)) {
+            toggleA();
+        } else {
+            toggleB();
+        }
+    }
+};
+
+// PcntEncoder::read() without the driver
+struct Reader {
+    int16_t lastCount = 0;
+    int32_t position = 0;
+
+    int32_t read(int16_t count) {
+        position += EncoderMath::unwrapDelta(count, lastCount, PCNT_RANGE);
+        lastCount = count;
+        return position;
+    }
+};
+
+static void test_unwrap_takes_shortest_way() {
+    TEST_ASSERT_EQUAL_INT32(5, EncoderMath::unwrapDelta(5, 0, PCNT_RANGE));
+    // Through the reset at either limit
+    TEST_ASSERT_EQUAL_INT32(3, EncoderMath::unwrapDelta(2, 32766, PCNT_RANGE));
+    TEST_ASSERT_EQUAL_INT32(-3, EncoderMath::unwrapDelta(-2, -32766, PCNT_RANGE));
+    TEST_ASSERT_EQUAL_INT32(16383, EncoderMath::unwrapDelta(16383, 0, PCNT_RANGE));
+
+    // AS5600 angle across 4095 -> 0
+    TEST_ASSERT_EQUAL_INT32(1, EncoderMath::unwrapDelta(0, 4095, AS5600_RANGE));
+    TEST_ASSERT_EQUAL_INT32(-2, EncoderMath::unwrapDelta(4094, 0, AS5600_RANGE));
+    TEST_ASSERT_EQUAL_INT32(2048, EncoderMath::unwrapDelta(2048, 0, AS5600_RANGE));
+    TEST_ASSERT_EQUAL_INT32(-2047, EncoderMath::unwrapDelta(2049, 0, AS5600_RANGE));
+}
+
+// Every edge counts once, the same way for one direction: x4 decoding
+static void test_quadrature_counts_every_edge() {
+    SimPcnt pcnt;
+    for (int i = 1; i <= 40; i++) {
+        pcnt.edge(true);
+        TEST_ASSERT_EQUAL_INT16(i, pcnt.count);
+    }
+    for (int i = 39; i >= -40; i--) {
+        pcnt.edge(false);
+        TEST_ASSERT_EQUAL_INT16(i, pcnt.count);
+    }
+    // Contact bounce on one pin cancels out
+    pcnt.toggleA();
+    pcnt.toggleA();
+    TEST_ASSERT_EQUAL_INT16(-40, pcnt.count);
+}
+
+// Random spins of up to half the counter range between polls, through many
+// counter resets in both directions. The unwrapped position and the detent
+// must match the edges actually turned.
+static void test_high_rate_spins_lose_no_steps() {
+    SimPcnt pcnt;
+    Reader reader;
+    int32_t truth = 0;
+    int32_t fastest = 0;
+    uint32_t seed = 12345;
+
+    for (int poll = 0; poll < 4000; poll++) {
+        seed = seed * 1103515245 + 12345;
+        int32_t edges = (seed >> 8) % (PCNT_RANGE / 2 + 1);
+        // Mostly one direction, so the counter wraps again and again
+        bool clockwise = ((seed >> 4) & 7) != 0;
+        // Come to rest on a detent
+        edges -= edges % COUNTS_PER_DETENT;
+        for (int32_t e = 0; e < edges; e++) pcnt.edge(clockwise);
+        truth += clockwise ? edges : -edges;
+        if (edges > fastest) fastest = edges;
+
+        int32_t position = reader.read(pcnt.count);
+        TEST_ASSERT_EQUAL_INT32(truth, position);
+        TEST_ASSERT_EQUAL_INT32(truth / COUNTS_PER_DETENT, EncoderMath::nearestDetent(position, COUNTS_PER_DETENT));
+    }
+    TEST_ASSERT_GREATER_THAN(10 * PCNT_RANGE, abs(truth));
+
+    char line[96];
+    snprintf(line, sizeof(line), "%ld detents exact, up to %ld counts between polls",
+             (long)(truth / COUNTS_PER_DETENT), (long)fastest);
+    TEST_MESSAGE(line);
+}
+
+// More than half the range between polls reads as the other direction, the
+// limit PcntEncoder documents
+static void test_polling_too_slowly_misreads() {
+    SimPcnt pcnt;
+    Reader reader;
+    for (int32_t e = 0; e < PCNT_RANGE / 2 + 100; e++) pcnt.edge(true);
+    TEST_ASSERT_LESS_THAN(0, reader.read(pcnt.count));
+}
+
+// Chatter of a count either way around a resting detent does not move it,
+// and every detent is the same width on both sides of zero
+static void test_nearest_detent_absorbs_chatter() {
+    for (long detent = -50; detent <= 50; detent++) {
+        int32_t rest = detent * COUNTS_PER_DETENT;
+        TEST_ASSERT_EQUAL(detent, EncoderMath::nearestDetent(rest - 1, COUNTS_PER_DETENT));
+        TEST_ASSERT_EQUAL(detent, EncoderMath::nearestDetent(rest, COUNTS_PER_DETENT));
+        TEST_ASSERT_EQUAL(detent, EncoderMath::nearestDetent(rest + 1, COUNTS_PER_DETENT));
+    }
+
+    int widths[COUNTS_PER_DETENT * 2 + 1] = {0};
+    for (int32_t counts = -4 * COUNTS_PER_DETENT; counts < 4 * COUNTS_PER_DETENT; counts++) {
+        widths[EncoderMath::nearestDetent(counts, COUNTS_PER_DETENT) + COUNTS_PER_DETENT]++;
+    }
+    for (int i = 1; i < COUNTS_PER_DETENT * 2; i++) {
+        TEST_ASSERT_EQUAL(COUNTS_PER_DETENT, widths[i]);
+    }
+}
+
+// A magnetic knob left on a step edge, with sensor noise, keeps its step
+static void test_hysteresis_holds_on_edge() {
+    const uint16_t countsPerStep = AS5600_RANGE / 24;
+    long step = 0;
+    int32_t edge = countsPerStep / 2;
+    for (int i = 0; i < 1000; i++) {
+        int32_t noisy = edge + (i % 7) - 3;
+        step = EncoderMath::hysteresisDetent(step, noisy, countsPerStep);
+        TEST_ASSERT_EQUAL(0, step);
+    }
+
+    // A quarter step past the edge it moves, and holds on the way back
+    step = EncoderMath::hysteresisDetent(step, edge + countsPerStep / 4 + 1, countsPerStep);
+    TEST_ASSERT_EQUAL(1, step);
+    step = EncoderMath::hysteresisDetent(step, edge - 3, countsPerStep);
+    TEST_ASSERT_EQUAL(1, step);
+
+    // A large jump lands on the nearest step directly
+    step = EncoderMath::hysteresisDetent(step, -5 * countsPerStep, countsPerStep);
+    TEST_ASSERT_EQUAL(-5, step);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_unwrap_takes_shortest_way);
+    RUN_TEST(test_quadrature_counts_every_edge);
+    RUN_TEST(test_high_rate_spins_lose_no_steps);
+    RUN_TEST(test_polling_too_slowly_misreads);
+    RUN_TEST(test_nearest_detent_absorbs_chatter);
+    RUN_TEST(test_hysteresis_holds_on_edge);
+    return UNITY_END();
+}
@@ -0,0 +1,218 @@
+// test_main.cpp
+// Host tests of the precomputed GPIO matrix masks against simulated GPIO
+// registers, and a comparison with the old per-scan pin setup.
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "GpioMatrixPins.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Simulated ESP32-S3 GPIO matrix with a diode per key: a pressed key pulls
+// its column LOW only while its own row is driven LOW. Counts every
+// register access the scan makes.
+struct SimGpio {
+    uint32_t out[2];
+    uint32_t enable[2];
+    std::vector<std::pair<uint8_t, uint8_t>> pressed;   // Row pin, column pin
+    uint32_t accesses;
+
+    SimGpio() : accesses(0) {
+        out[0] = out[1] = 0xFFFFFFFF;
+        enable[0] = enable[1] = 0;
+    }
+
+    static uint8_t bank(uint8_t pin) { return pin >= 32 ? 1 : 0; }
+    static uint32_t bit(uint8_t pin) { return 1UL << (pin & 31); }
+
+    // Register writes
+    void setLow(uint8_t bankIndex, uint32_t mask) { accesses++; out[bankIndex] &= ~mask; }
+    void setHigh(uint8_t bankIndex, uint32_t mask) { accesses++; out[bankIndex] |= mask; }
+
+    // Register read, inputs idle HIGH through their pull-ups
+    uint32_t read(uint8_t bankIndex) {
+        accesses++;
+        uint32_t value = 0xFFFFFFFF;
+        for (const auto& key : pressed) {
+            bool driven = (enable[bank(key.first)] & bit(key.first)) && !(out[bank(key.first)] & bit(key.first));
+            if (driven && bank(key.second) == bankIndex) value &= ~bit(key.second);
+        }
+        return value;
+    }
+
+    // What pinMode(), digitalWrite() and digitalRead() cost: a
+    // read-modify-write of the register for each pin
+    void pinModeOutput(uint8_t pin) { accesses += 2; enable[bank(pin)] |= bit(pin); }
+    void pinModeInput(uint8_t pin) { accesses += 2; enable[bank(pin)] &= ~bit(pin); }
+    void digitalWrite(uint8_t pin, bool high) {
+        if (high) {
+            setHigh(bank(pin), bit(pin));
+        } else {
+            setLow(bank(pin), bit(pin));
+        }
+    }
+    bool digitalRead(uint8_t pin) { return (read(bank(pin)) & bit(pin)) != 0; }
+};
+
+static const uint8_t ROW_PINS[] = {4, 5, 33, 40, 6};
+static const uint8_t COL_PINS[] = {1, 2, 34, 31, 0, 47};
+#define ROWS sizeof(ROW_PINS)
+#define COLS sizeof(COL_PINS)
+
+// Directions set once, rows driven with one write from the masks
+static void scanWithMasks(SimGpio& gpio, const GpioMatrixPins& pins, uint16_t* rowState) {
+    for (uint8_t r = 0; r < ROWS; r++) {
+        gpio.setLow(pins.getRowBank(r), pins.getRowBit(r));
+        uint32_t bankLow = gpio.read(0);
+        uint32_t bankHigh = pins.hasHighBankColumns() ? gpio.read(1) : 0;
+        rowState[r] = pins.packColumns(bankLow, bankHigh);
+        if (pins.getRowBankMask(0)) gpio.setHigh(0, pins.getRowBankMask(0));
+        if (pins.getRowBankMask(1)) gpio.setHigh(1, pins.getRowBankMask(1));
+    }
+}
+
+// The scan before the change: every pin set up again, then one
+// digitalRead per column
+static void scanPerPin(SimGpio& gpio, uint16_t* rowState) {
+    for (uint8_t r = 0; r < ROWS; r++) {
+        gpio.pinModeOutput(ROW_PINS[r]);
+        gpio.digitalWrite(ROW_PINS[r], true);
+    }
+    for (uint8_t c = 0; c < COLS; c++) {
+        gpio.pinModeInput(COL_PINS[c]);
+    }
+    for (uint8_t r = 0; r < ROWS; r++) {
+        gpio.digitalWrite(ROW_PINS[r], false);
+        uint16_t bits = 0;
+        for (uint8_t c = 0; c < COLS; c++) {
+            if (!gpio.digitalRead(COL_PINS[c])) bits |= 1 << c;
+        }
+        rowState[r] = bits;
+        gpio.digitalWrite(ROW_PINS[r], true);
+    }
+}
+
+static void configureOnce(SimGpio& gpio) {
+    for (uint8_t r = 0; r < ROWS; r++) gpio.pinModeOutput(ROW_PINS[r]);
+    for (uint8_t c = 0; c < COLS; c++) gpio.pinModeInput(COL_PINS[c]);
+    gpio.accesses = 0;
+}
+
+static void test_masks_split_pins_by_bank() {
+    GpioMatrixPins pins(ROW_PINS, ROWS, COL_PINS, COLS);
+    TEST_ASSERT_EQUAL_UINT8(0, pins.getRowBank(0));
+    TEST_ASSERT_EQUAL_UINT8(1, pins.getRowBank(2));
+    TEST_ASSERT_EQUAL_UINT32(1UL << 1, pins.getRowBit(2));
+    TEST_ASSERT_EQUAL_UINT32(1UL << 8, pins.getRowBit(3));
+    TEST_ASSERT_EQUAL_UINT32((1UL << 4) | (1UL << 5) | (1UL << 6), pins.getRowBankMask(0));
+    TEST_ASSERT_EQUAL_UINT32((1UL << 1) | (1UL << 8), pins.getRowBankMask(1));
+    TEST_ASSERT_TRUE(pins.hasHighBankColumns());
+
+    const uint8_t lowRows[] = {4, 5};
+    const uint8_t lowCols[] = {1, 2, 3};
+    GpioMatrixPins lowPins(lowRows, 2, lowCols, 3);
+    TEST_ASSERT_FALSE(lowPins.hasHighBankColumns());
+    TEST_ASSERT_EQUAL_UINT32(0, lowPins.getRowBankMask(1));
+}
+
+// Bank 1 pins pass validation, the missing GPIO and the flash/PSRAM bus do not
+static void test_usable_pins_include_bank_one() {
+    TEST_ASSERT_TRUE(GpioMatrixPins::isUsablePin(0));
+    TEST_ASSERT_TRUE(GpioMatrixPins::isUsablePin(21));
+    TEST_ASSERT_TRUE(GpioMatrixPins::isUsablePin(33));
+    TEST_ASSERT_TRUE(GpioMatrixPins::isUsablePin(48));
+    for (uint8_t pin = 22; pin <= 32; pin++) {
+        TEST_ASSERT_FALSE(GpioMatrixPins::isUsablePin(pin));
+    }
+    TEST_ASSERT_FALSE(GpioMatrixPins::isUsablePin(49));
+}
+
+static void test_pack_columns_reads_low_as_pressed() {
+    GpioMatrixPins pins(ROW_PINS, ROWS, COL_PINS, COLS);
+    TEST_ASSERT_EQUAL_UINT16(0, pins.packColumns(0xFFFFFFFF, 0xFFFFFFFF));
+    TEST_ASSERT_EQUAL_UINT16((1 << COLS) - 1, pins.packColumns(0, 0));
+
+    // GPIO31 (column 3) low in bank 0, GPIO34 (column 2) low in bank 1
+    TEST_ASSERT_EQUAL_UINT16(1 << 3, pins.packColumns(0xFFFFFFFF ^ (1UL << 31), 0xFFFFFFFF));
+    TEST_ASSERT_EQUAL_UINT16(1 << 2, pins.packColumns(0xFFFFFFFF, 0xFFFFFFFF ^ (1UL << 2)));
+    // GPIO47 (column 5) is bit 15 of bank 1
+    TEST_ASSERT_EQUAL_UINT16((1 << 5) | (1 << 4), pins.packColumns(0xFFFFFFFE, 0xFFFFFFFF ^ (1UL << 15)));
+}
+
+static void test_scan_matches_pressed_keys() {
+    GpioMatrixPins pins(ROW_PINS, ROWS, COL_PINS, COLS);
+    uint32_t seed = 7;
+    for (int round = 0; round < 500; round++) {
+        SimGpio gpio;
+        configureOnce(gpio);
+        uint16_t expected[ROWS] = {0};
+        for (uint8_t r = 0; r < ROWS; r++) {
+            for (uint8_t c = 0; c < COLS; c++) {
+                seed = seed * 1103515245 + 12345;
+                if ((seed >> 16) % 5 == 0) {
+                    gpio.pressed.push_back(std::make_pair(ROW_PINS[r], COL_PINS[c]));
+                    expected[r] |= 1 << c;
+                }
+            }
+        }
+
+        uint16_t withMasks[ROWS];
+        uint16_t perPin[ROWS];
+        scanWithMasks(gpio, pins, withMasks);
+        scanPerPin(gpio, perPin);
+        for (uint8_t r = 0; r < ROWS; r++) {
+            TEST_ASSERT_EQUAL_UINT16(expected[r], withMasks[r]);
+            TEST_ASSERT_EQUAL_UINT16(expected[r], perPin[r]);
+        }
+        // Rows are released after every scan
+        TEST_ASSERT_EQUAL_UINT32(pins.getRowBankMask(0), gpio.out[0] & pins.getRowBankMask(0));
+        TEST_ASSERT_EQUAL_UINT32(pins.getRowBankMask(1), gpio.out[1] & pins.getRowBankMask(1));
+    }
+}
+
+// Register accesses and host time per scan of the simulated 5x6 matrix.
+// The settle delay is left out; on the device it is timed by the
+// scanbench console command.
+static void test_benchmark_masks_against_per_pin_setup() {
+    GpioMatrixPins pins(ROW_PINS, ROWS, COL_PINS, COLS);
+    const int iterations = 20000;
+    SimGpio gpio;
+    configureOnce(gpio);
+    gpio.pressed.push_back(std::make_pair(ROW_PINS[1], COL_PINS[2]));
+    uint16_t rowState[ROWS];
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) scanPerPin(gpio, rowState);
+    auto middle = std::chrono::steady_clock::now();
+    uint32_t perPinAccesses = gpio.accesses / iterations;
+
+    gpio.accesses = 0;
+    for (int i = 0; i < iterations; i++) scanWithMasks(gpio, pins, rowState);
+    auto end = std::chrono::steady_clock::now();
+    uint32_t maskAccesses = gpio.accesses / iterations;
+
+    // Drive, two bank reads and two bank releases per row
+    TEST_ASSERT_EQUAL_UINT32(ROWS * 5, maskAccesses);
+    TEST_ASSERT_LESS_THAN_UINT32(perPinAccesses / 2, maskAccesses);
+
+    char line[96];
+    snprintf(line, sizeof(line), "per-pin setup: %3u register accesses, %6.1f ns per scan", perPinAccesses,
+             std::chrono::duration<double, std::nano>(middle - start).count() / iterations);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "masks:         %3u register accesses, %6.1f ns per scan", maskAccesses,
+             std::chrono::duration<double, std::nano>(end - middle).count() / iterations);
+    TEST_MESSAGE(line);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_masks_split_pins_by_bank);
+    RUN_TEST(test_usable_pins_include_bank_one);
+    RUN_TEST(test_pack_columns_reads_low_as_pressed);
+    RUN_TEST(test_scan_matches_pressed_keys);
+    RUN_TEST(test_benchmark_masks_against_per_pin_setup);
+    return UNITY_END();
+}
@@ -0,0 +1,248 @@
+// test_main.cpp
+// Host tests of the HID transmit queue: deduplication against the shadow,
+// coalescing into the tail, and the report sequence an event trace produces.
+
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "HIDReportQueue.h"
+
+void setUp() {}
+void tearDown() {}
+
+static HIDReport makeReport(HIDReportType type, const uint8_t* data, uint8_t length) {
+    HIDReport report;
+    memset(&report, 0, sizeof(report));
+    report.type = type;
+    report.length = length;
+    memcpy(report.data, data, length);
+    return report;
+}
+
+static HIDReport keyboard(uint8_t modifiers, uint8_t a = 0, uint8_t b = 0) {
+    const uint8_t data[HID_KEYBOARD_REPORT_SIZE] = {modifiers, 0, a, b, 0, 0, 0, 0};
+    return makeReport(HID_REPORT_KEYBOARD, data, sizeof(data));
+}
+
+static HIDReport nkro(uint8_t modifiers, uint8_t usage = 0) {
+    uint8_t data[HID_NKRO_REPORT_SIZE] = {modifiers};
+    if (usage) data[1 + usage / 8] |= 1 << (usage % 8);
+    return makeReport(HID_REPORT_NKRO, data, sizeof(data));
+}
+
+static HIDReport consumer(uint16_t usage) {
+    const uint8_t data[HID_USAGE_REPORT_SIZE] = {(uint8_t)usage, (uint8_t)(usage >> 8)};
+    return makeReport(HID_REPORT_CONSUMER, data, sizeof(data));
+}
+
+static HIDReport mouse(uint8_t buttons, int16_t x, int8_t wheel = 0) {
+    const uint8_t data[HID_MOUSE_REPORT_SIZE] = {buttons, (uint8_t)x, (uint8_t)(x >> 8), 0, 0, (uint8_t)wheel, 0};
+    return makeReport(HID_REPORT_MOUSE, data, sizeof(data));
+}
+
+static HIDReport raw(uint8_t command) {
+    uint8_t data[HID_RAW_REPORT_SIZE] = {0};
+    data[0] = command;
+    return makeReport(HID_REPORT_RAW, data, sizeof(data));
+}
+
+static int16_t mouseX(const HIDReport& report) {
+    return (int16_t)(report.data[1] | (report.data[2] << 8));
+}
+
+static bool sameReport(const HIDReport& a, const HIDReport& b) {
+    return a.type == b.type && a.length == b.length && memcmp(a.data, b.data, a.length) == 0;
+}
+
+// What the endpoint sends: the queue drained in order
+static void drain(HIDReportQueue& queue, std::vector<HIDReport>& sent) {
+    while (HIDReport* report = queue.front()) {
+        sent.push_back(*report);
+        queue.pop();
+    }
+}
+
+static void test_identical_reports_suppressed() {
+    HIDReportQueue queue;
+    // The shadow starts as the empty report the host assumes
+    TEST_ASSERT_EQUAL(HID_QUEUE_DUPLICATE, queue.push(keyboard(0)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(keyboard(0, 0x04)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_DUPLICATE, queue.push(keyboard(0, 0x04)));
+
+    // Once sent, the same report is checked against what the host has
+    std::vector<HIDReport> sent;
+    drain(queue, sent);
+    TEST_ASSERT_EQUAL(HID_QUEUE_DUPLICATE, queue.push(keyboard(0, 0x04)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_DUPLICATE, queue.push(mouse(0, 0)));
+    TEST_ASSERT_EQUAL_UINT32(4, queue.getDuplicateReports());
+    TEST_ASSERT_EQUAL_UINT32(1, queue.getSentReports());
+}
+
+// A burst that changes each key at most once folds into one report, which
+// keeps the first key event's timestamps
+static void test_burst_coalesces_into_tail() {
+    HIDReportQueue queue;
+    HIDReport first = keyboard(0, 0x04);
+    first.keyEvent = true;
+    first.detectUs = 100;
+    HIDReport second = keyboard(0x02, 0x04, 0x05);
+    second.keyEvent = true;
+    second.detectUs = 200;
+
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(first));
+    TEST_ASSERT_EQUAL(HID_QUEUE_COALESCED, queue.push(second));
+    TEST_ASSERT_EQUAL_UINT8(1, queue.size());
+    TEST_ASSERT_TRUE(sameReport(second, *queue.front()));
+    TEST_ASSERT_EQUAL_UINT32(100, queue.front()->detectUs);
+}
+
+// A press and its release are both delivered, in either order of keys
+static void test_tap_is_not_folded_away() {
+    HIDReportQueue queue;
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(keyboard(0, 0x04)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(keyboard(0)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(consumer(0xE9)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(consumer(0)));
+    TEST_ASSERT_EQUAL_UINT8(4, queue.size());
+    TEST_ASSERT_EQUAL_UINT32(0, queue.getCoalescedReports());
+}
+
+// Folding past a report of another type would reorder what the host sees
+static void test_no_fold_past_other_type() {
+    HIDReportQueue queue;
+    queue.push(keyboard(0, 0x04));
+    queue.push(consumer(0xE9));
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(keyboard(0, 0x04, 0x05)));
+    TEST_ASSERT_EQUAL_UINT8(3, queue.size());
+
+    // The duplicate check still sees the newest keyboard report
+    TEST_ASSERT_EQUAL(HID_QUEUE_DUPLICATE, queue.push(keyboard(0, 0x04, 0x05)));
+}
+
+static void test_mouse_motion_adds_up() {
+    HIDReportQueue queue;
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(mouse(0, 10)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_COALESCED, queue.push(mouse(0, -3)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_COALESCED, queue.push(mouse(0, 5, 1)));
+    TEST_ASSERT_EQUAL_UINT8(1, queue.size());
+    TEST_ASSERT_EQUAL_INT(12, mouseX(*queue.front()));
+    TEST_ASSERT_EQUAL_INT(1, (int8_t)queue.front()->data[5]);
+
+    // A button change or an out of range sum starts a new report
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(mouse(1, 0)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(mouse(0, 32000)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(mouse(0, 1000)));
+    TEST_ASSERT_EQUAL_UINT8(4, queue.size());
+}
+
+// The bitmap reaches up to the modifiers, a tap of a high usage such as
+// Keypad Hexadecimal (0xDD) is not folded away
+static void test_nkro_tap_of_high_usage_kept() {
+    HIDReportQueue queue;
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(nkro(0, 0xDD)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(nkro(0)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_COALESCED, queue.push(nkro(0x02)));
+    TEST_ASSERT_EQUAL_UINT8(2, queue.size());
+}
+
+static void test_raw_frames_never_merged() {
+    HIDReportQueue queue;
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(raw(0x01)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(raw(0x01)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(raw(0x02)));
+    TEST_ASSERT_EQUAL_UINT8(3, queue.size());
+    TEST_ASSERT_EQUAL_UINT32(0, queue.getDuplicateReports() + queue.getCoalescedReports());
+}
+
+// A full queue keeps the final state of a type by overwriting its newest
+// report, mouse motion is added to it; raw frames and types with nothing
+// queued are dropped
+static void test_full_queue_overwrites_newest() {
+    HIDReportQueue queue;
+    queue.push(keyboard(0, 0x04));
+    queue.push(mouse(0, 10));
+    for (uint8_t i = 2; i < HID_REPORT_QUEUE_SIZE; i++) {
+        TEST_ASSERT_EQUAL(HID_QUEUE_ADDED, queue.push(raw(i)));
+    }
+    TEST_ASSERT_EQUAL_UINT8(HID_REPORT_QUEUE_SIZE, queue.size());
+
+    TEST_ASSERT_EQUAL(HID_QUEUE_OVERWRITTEN, queue.push(keyboard(0, 0x06)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_DROPPED, queue.push(raw(0x40)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_DROPPED, queue.push(consumer(0xE9)));
+    TEST_ASSERT_EQUAL(HID_QUEUE_COALESCED, queue.push(mouse(0, 5)));
+    // A button change cannot be folded into earlier motion
+    TEST_ASSERT_EQUAL(HID_QUEUE_DROPPED, queue.push(mouse(1, 0)));
+    TEST_ASSERT_EQUAL_UINT32(4, queue.getDroppedReports());
+    TEST_ASSERT_TRUE(sameReport(keyboard(0, 0x06), *queue.front()));
+    queue.pop();
+    TEST_ASSERT_EQUAL_INT(15, mouseX(*queue.front()));
+    TEST_ASSERT_EQUAL_UINT8(HID_REPORT_QUEUE_SIZE, queue.getHighWater());
+
+    // Clearing counts the queued reports as dropped and resets the shadows
+    queue.clear();
+    TEST_ASSERT_EQUAL_UINT8(0, queue.size());
+    TEST_ASSERT_NULL(queue.front());
+    TEST_ASSERT_EQUAL_UINT32(4 + HID_REPORT_QUEUE_SIZE - 1, queue.getDroppedReports());
+    TEST_ASSERT_EQUAL(HID_QUEUE_DUPLICATE, queue.push(keyboard(0)));
+}
+
+// Keys, encoder ticks and mouse motion landing in the same frames. The
+// endpoint takes one report per 1 ms frame; the trace must come out as the
+// shortest sequence that still shows the host every press and release.
+static void test_trace_replay_minimal_sequence() {
+    std::vector<std::vector<HIDReport>> frames = {
+        {keyboard(0, 0x04), keyboard(0, 0x04, 0x05), mouse(0, 3), mouse(0, 4)},
+        {mouse(0, 5), consumer(0xE9)},
+        {consumer(0), keyboard(0, 0x04, 0x05)},
+        {keyboard(0)},
+        {},
+    };
+    const HIDReport expected[] = {
+        keyboard(0, 0x04, 0x05),
+        mouse(0, 12),
+        consumer(0xE9),
+        consumer(0),
+        keyboard(0),
+    };
+
+    HIDReportQueue queue;
+    std::vector<HIDReport> sent;
+    uint32_t events = 0;
+    for (const auto& frame : frames) {
+        for (const HIDReport& report : frame) {
+            queue.push(report);
+            events++;
+        }
+        if (HIDReport* report = queue.front()) {
+            sent.push_back(*report);
+            queue.pop();
+        }
+    }
+    drain(queue, sent);
+
+    TEST_ASSERT_EQUAL(sizeof(expected) / sizeof(expected[0]), sent.size());
+    for (size_t i = 0; i < sent.size(); i++) {
+        TEST_ASSERT_TRUE(sameReport(expected[i], sent[i]));
+    }
+    TEST_ASSERT_EQUAL_UINT32(sent.size(), queue.getSentReports());
+    TEST_ASSERT_EQUAL_UINT32(3, queue.getCoalescedReports());
+    TEST_ASSERT_EQUAL_UINT32(1, queue.getDuplicateReports());
+
+    char line[64];
+    snprintf(line, sizeof(line), "%u reports from the sources, %u sent", events, (unsigned)sent.size());
+    TEST_MESSAGE(line);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_identical_reports_suppressed);
+    RUN_TEST(test_burst_coalesces_into_tail);
+    RUN_TEST(test_tap_is_not_folded_away);
+    RUN_TEST(test_no_fold_past_other_type);
+    RUN_TEST(test_mouse_motion_adds_up);
+    RUN_TEST(test_nkro_tap_of_high_usage_kept);
+    RUN_TEST(test_raw_frames_never_merged);
+    RUN_TEST(test_full_queue_overwrites_newest);
+    RUN_TEST(test_trace_replay_minimal_sequence);
+    return UNITY_END();
+}
@@ -0,0 +1,167 @@
+// test_main.cpp
+// Host tests of the scan -> dispatch event ring, including a two-thread
+// stress run of the lock-free producer and consumer.
+
+#include <unity.h>
+#include <thread>
+#include "KeyEventQueue.h"
+
+void setUp() {}
+void tearDown() {}
+
+#define STRESS_EVENTS 200000
+
+// The sequence number rides in detectUs, the key and edge are derived from it
+static KeyEvent makeEvent(uint32_t sequence) {
+    KeyEvent event;
+    event.detectUs = sequence;
+    event.timestampUs = sequence * 3;
+    event.keyIndex = sequence % 32;
+    event.pressed = sequence & 1;
+    event.reserved = 0;
+    return event;
+}
+
+static bool isIntact(const KeyEvent& event) {
+    return event.timestampUs == event.detectUs * 3 && event.keyIndex == event.detectUs % 32 &&
+           event.pressed == (event.detectUs & 1);
+}
+
+static void test_event_stays_compact() {
+    TEST_ASSERT_EQUAL(12, sizeof(KeyEvent));
+}
+
+static void test_fifo_order_and_wrap() {
+    KeyEventQueue queue;
+    KeyEvent event;
+    TEST_ASSERT_FALSE(queue.pop(event));
+
+    // Several times round the ring, a few events in flight at a time
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < KEY_EVENT_QUEUE_SIZE * 5; i++) {
+        TEST_ASSERT_TRUE(queue.push(makeEvent(i)));
+        if (i % 3 == 2) {
+            while (queue.pop(event)) {
+                TEST_ASSERT_EQUAL_UINT32(next++, event.detectUs);
+                TEST_ASSERT_TRUE(isIntact(event));
+            }
+        }
+    }
+    while (queue.pop(event)) {
+        TEST_ASSERT_EQUAL_UINT32(next++, event.detectUs);
+    }
+    TEST_ASSERT_EQUAL_UINT32(KEY_EVENT_QUEUE_SIZE * 5, next);
+    TEST_ASSERT_EQUAL_UINT32(0, queue.getOverflowCount());
+    TEST_ASSERT_EQUAL_UINT32(3, queue.getHighWaterMark());
+}
+
+static void test_full_ring_drops_and_counts() {
+    KeyEventQueue queue;
+    for (uint32_t i = 0; i < KEY_EVENT_QUEUE_SIZE; i++) {
+        TEST_ASSERT_TRUE(queue.push(makeEvent(i)));
+    }
+    TEST_ASSERT_FALSE(queue.push(makeEvent(1000)));
+    TEST_ASSERT_FALSE(queue.push(makeEvent(1001)));
+    TEST_ASSERT_EQUAL_UINT32(2, queue.getOverflowCount());
+    TEST_ASSERT_EQUAL_UINT32(KEY_EVENT_QUEUE_SIZE, queue.getHighWaterMark());
+    TEST_ASSERT_EQUAL_UINT32(KEY_EVENT_QUEUE_SIZE, queue.size());
+
+    // The dropped events never appear, the queued ones are untouched
+    KeyEvent event;
+    for (uint32_t i = 0; i < KEY_EVENT_QUEUE_SIZE; i++) {
+        TEST_ASSERT_TRUE(queue.pop(event));
+        TEST_ASSERT_EQUAL_UINT32(i, event.detectUs);
+    }
+    TEST_ASSERT_FALSE(queue.pop(event));
+
+    queue.resetCounters();
+    TEST_ASSERT_EQUAL_UINT32(0, queue.getOverflowCount());
+    TEST_ASSERT_EQUAL_UINT32(0, queue.getHighWaterMark());
+}
+
+// Producer never waits, so every event is either delivered in order or
+// counted as an overflow
+static void test_stress_non_blocking_producer() {
+    KeyEventQueue queue;
+    uint32_t received = 0;
+    uint32_t lastSequence = 0;
+    bool ordered = true;
+    bool intact = true;
+
+    std::thread consumer([&]() {
+        KeyEvent event;
+        bool done = false;
+        while (!done) {
+            if (!queue.pop(event)) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (event.detectUs == STRESS_EVENTS) {
+                done = true;
+                continue;
+            }
+            if (received && event.detectUs <= lastSequence) ordered = false;
+            if (!isIntact(event)) intact = false;
+            lastSequence = event.detectUs;
+            received++;
+        }
+    });
+
+    uint32_t pushed = 0;
+    for (uint32_t i = 0; i < STRESS_EVENTS; i++) {
+        if (queue.push(makeEvent(i))) pushed++;
+    }
+    // End marker, retried until there is room
+    while (!queue.push(makeEvent(STRESS_EVENTS))) {
+        std::this_thread::yield();
+    }
+    consumer.join();
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_TRUE(intact);
+    TEST_ASSERT_EQUAL_UINT32(pushed, received);
+    // The marker's failed attempts are overflows too, so at least N
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(STRESS_EVENTS, received + queue.getOverflowCount());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(KEY_EVENT_QUEUE_SIZE, queue.getHighWaterMark());
+    TEST_ASSERT_EQUAL_UINT32(0, queue.size());
+}
+
+// With the producer retrying on a full ring nothing may be lost
+static void test_stress_lossless_delivery() {
+    KeyEventQueue queue;
+    uint32_t expected = 0;
+    bool ordered = true;
+
+    std::thread consumer([&]() {
+        KeyEvent event;
+        while (expected < STRESS_EVENTS) {
+            if (!queue.pop(event)) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (event.detectUs != expected || !isIntact(event)) ordered = false;
+            expected++;
+        }
+    });
+
+    for (uint32_t i = 0; i < STRESS_EVENTS; i++) {
+        while (!queue.push(makeEvent(i))) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_EVENTS, expected);
+    TEST_ASSERT_EQUAL_UINT32(0, queue.size());
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_event_stays_compact);
+    RUN_TEST(test_fifo_order_and_wrap);
+    RUN_TEST(test_full_ring_drops_and_counts);
+    RUN_TEST(test_stress_non_blocking_producer);
+    RUN_TEST(test_stress_lossless_delivery);
+    return UNITY_END();
+}
@@ -0,0 +1,209 @@
+// test_main.cpp
+// Host tests of the position -> key table the matrix scan diffs through,
+// and a microbenchmark of scan cost against key count.
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "KeyLookupTable.h"
+
+void setUp() {}
+void tearDown() {}
+
+struct Position {
+    uint8_t row;
+    uint8_t col;
+};
+
+// What the scan did before the table, a search of every key for every cell
+static uint8_t linearLookup(const std::vector<Position>& keys, uint8_t row, uint8_t col) {
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i].row == row && keys[i].col == col) return i;
+    }
+    return KEY_INDEX_NONE;
+}
+
+static uint32_t linearDiff(const std::vector<Position>& keys, uint8_t rows, uint8_t cols,
+                           const uint16_t* sample, uint16_t* state, uint32_t& pressed) {
+    uint32_t changedKeys = 0;
+    pressed = 0;
+    for (uint8_t r = 0; r < rows; r++) {
+        for (uint8_t c = 0; c < cols; c++) {
+            uint8_t key = linearLookup(keys, r, c);
+            if (key == KEY_INDEX_NONE) continue;
+            uint16_t bit = 1 << c;
+            bool now = (sample[r] & bit) != 0;
+            if (now != ((state[r] & bit) != 0)) {
+                changedKeys |= 1UL << key;
+                if (now) pressed |= 1UL << key;
+            }
+            if (now) {
+                state[r] |= bit;
+            } else {
+                state[r] &= ~bit;
+            }
+        }
+    }
+    return changedKeys;
+}
+
+// Fills the matrix row by row, leaving out every third cell
+static std::vector<Position> makeKeys(uint8_t rows, uint8_t cols, size_t count) {
+    std::vector<Position> keys;
+    for (uint8_t r = 0; r < rows && keys.size() < count; r++) {
+        for (uint8_t c = 0; c < cols && keys.size() < count; c++) {
+            if ((r * cols + c) % 3 == 2) continue;
+            keys.push_back({r, c});
+        }
+    }
+    return keys;
+}
+
+static void test_lookup_matches_linear_search() {
+    const uint8_t rows = 5, cols = 6;
+    std::vector<Position> keys = makeKeys(rows, cols, 20);
+    KeyLookupTable table;
+    TEST_ASSERT_TRUE(table.begin(rows, cols));
+    for (size_t i = 0; i < keys.size(); i++) {
+        TEST_ASSERT_EQUAL(KEY_PLACED, table.place(i, keys[i].row, keys[i].col));
+    }
+
+    for (uint8_t r = 0; r < rows; r++) {
+        uint16_t mask = 0;
+        for (uint8_t c = 0; c < cols; c++) {
+            uint8_t key = linearLookup(keys, r, c);
+            TEST_ASSERT_EQUAL_UINT8(key, table.getKey(r, c));
+            if (key != KEY_INDEX_NONE) mask |= 1 << c;
+        }
+        TEST_ASSERT_EQUAL_UINT16(mask, table.getRowMasks()[r]);
+    }
+}
+
+static void test_reserved_and_outside_cells_are_rejected() {
+    KeyLookupTable table;
+    TEST_ASSERT_FALSE(table.begin(4, 17));
+    TEST_ASSERT_TRUE(table.begin(4, 4));
+    table.reserve(1, 1);
+    table.reserve(1, 2);
+
+    TEST_ASSERT_EQUAL(KEY_ON_RESERVED_CELL, table.place(0, 1, 1));
+    TEST_ASSERT_EQUAL(KEY_OUTSIDE_MATRIX, table.place(1, 4, 0));
+    TEST_ASSERT_EQUAL(KEY_OUTSIDE_MATRIX, table.place(2, 0, 4));
+    TEST_ASSERT_EQUAL(KEY_PLACED, table.place(3, 1, 3));
+    // Key indices are bits of the diff() masks
+    TEST_ASSERT_EQUAL(KEY_INDEX_TOO_LARGE, table.place(KEY_LOOKUP_MAX_KEYS, 0, 0));
+    TEST_ASSERT_EQUAL_UINT8(KEY_INDEX_NONE, table.getKey(0, 0));
+    TEST_ASSERT_EQUAL_UINT8(KEY_INDEX_NONE, table.getKey(1, 1));
+    TEST_ASSERT_EQUAL_UINT16(1 << 3, table.getRowMasks()[1]);
+
+    // A reload keeps the display's footprint
+    table.clear();
+    TEST_ASSERT_EQUAL_UINT16(0, table.getRowMasks()[1]);
+    TEST_ASSERT_EQUAL(KEY_ON_RESERVED_CELL, table.place(0, 1, 2));
+}
+
+static void test_diff_reports_only_changed_keys() {
+    KeyLookupTable table;
+    table.begin(3, 4);
+    table.reserve(2, 0);
+    table.place(0, 0, 0);
+    table.place(1, 0, 3);
+    table.place(2, 1, 1);
+    table.place(3, 2, 2);
+
+    uint16_t state[3] = {0, 0, 0};
+    uint32_t pressed;
+
+    // Empty and reserved cells read pressed are masked out
+    uint16_t sample[3] = {0x0009 | 0x0004, 0x0001, 0x0001};
+    TEST_ASSERT_EQUAL_UINT32(0x3, table.diff(sample, state, pressed));
+    TEST_ASSERT_EQUAL_UINT32(0x3, pressed);
+    TEST_ASSERT_EQUAL_UINT16(0x0009, state[0]);
+    TEST_ASSERT_EQUAL_UINT16(0, state[2]);
+
+    // Same sample, nothing changed
+    TEST_ASSERT_EQUAL_UINT32(0, table.diff(sample, state, pressed));
+
+    // Key 0 released, keys 2 and 3 pressed
+    uint16_t next[3] = {0x0008, 0x0002, 0x0004};
+    TEST_ASSERT_EQUAL_UINT32(0xD, table.diff(next, state, pressed));
+    TEST_ASSERT_EQUAL_UINT32(0xC, pressed);
+}
+
+static void test_diff_matches_linear_scan() {
+    const uint8_t rows = 6, cols = 8;
+    std::vector<Position> keys = makeKeys(rows, cols, 32);
+    KeyLookupTable table;
+    table.begin(rows, cols);
+    for (size_t i = 0; i < keys.size(); i++) table.place(i, keys[i].row, keys[i].col);
+
+    uint16_t tableState[rows] = {0};
+    uint16_t linearState[rows] = {0};
+    uint32_t seed = 12345;
+    for (int step = 0; step < 2000; step++) {
+        uint16_t sample[rows];
+        for (uint8_t r = 0; r < rows; r++) {
+            seed = seed * 1103515245 + 12345;
+            sample[r] = (seed >> 8) & ((1 << cols) - 1);
+        }
+        uint32_t tablePressed, linearPressed;
+        uint32_t tableChanged = table.diff(sample, tableState, tablePressed);
+        uint32_t linearChanged = linearDiff(keys, rows, cols, sample, linearState, linearPressed);
+        TEST_ASSERT_EQUAL_UINT32(linearChanged, tableChanged);
+        TEST_ASSERT_EQUAL_UINT32(linearPressed, tablePressed);
+    }
+}
+
+// Scan cost of the old linear search and of the table as keys are added,
+// on a 6x8 matrix with a few keys changing between samples
+static void test_benchmark_scan_cost_against_key_count() {
+    const uint8_t rows = 6, cols = 8;
+    const int iterations = 20000;
+    const size_t counts[] = {4, 8, 16, 24, 32};
+
+    for (size_t n : counts) {
+        std::vector<Position> keys = makeKeys(rows, cols, n);
+        KeyLookupTable table;
+        table.begin(rows, cols);
+        for (size_t i = 0; i < keys.size(); i++) table.place(i, keys[i].row, keys[i].col);
+
+        std::vector<uint16_t> samples(iterations * rows);
+        uint32_t seed = 1;
+        for (size_t i = 0; i < samples.size(); i++) {
+            seed = seed * 1103515245 + 12345;
+            // Mostly idle rows, as on a real keyboard
+            samples[i] = (seed >> 28) == 0 ? (seed >> 8) & 0xFF : 0;
+        }
+
+        uint16_t state[rows] = {0};
+        uint32_t pressed, sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            sink += linearDiff(keys, rows, cols, &samples[i * rows], state, pressed);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        memset(state, 0, sizeof(state));
+        for (int i = 0; i < iterations; i++) {
+            sink += table.diff(&samples[i * rows], state, pressed);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double linearNs = std::chrono::duration<double, std::nano>(middle - start).count() / iterations;
+        double tableNs = std::chrono::duration<double, std::nano>(end - middle).count() / iterations;
+        char line[128];
+        snprintf(line, sizeof(line), "%2u keys: linear %7.1f ns/scan, table %6.1f ns/scan (%u)",
+                 (unsigned)keys.size(), linearNs, tableNs, sink & 1);
+        TEST_MESSAGE(line);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lookup_matches_linear_search);
+    RUN_TEST(test_reserved_and_outside_cells_are_rejected);
+    RUN_TEST(test_diff_reports_only_changed_keys);
+    RUN_TEST(test_diff_matches_linear_scan);
+    RUN_TEST(test_benchmark_scan_cost_against_key_count);
+    return UNITY_END();
+}
@@ -0,0 +1,190 @@
+// test_main.cpp
+// Host tests of the macro bytecode: validation, report diffs, compile time,
+// and delay scheduling under simulated wake-up jitter.
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "MacroCode.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Applies PRESS and RELEASE ops to a keyboard report, as the player's held
+// keys end up in the aggregate report
+static void applyKeyOps(const std::vector<uint8_t>& code, uint8_t* report) {
+    for (size_t pc = 0; pc < code.size(); pc += 2) {
+        uint8_t usage = code[pc + 1];
+        bool press = code[pc] == MACRO_OP_PRESS;
+        TEST_ASSERT_TRUE(press || code[pc] == MACRO_OP_RELEASE);
+        if (usage >= 0xE0) {
+            uint8_t bit = 1 << (usage - 0xE0);
+            report[0] = press ? (report[0] | bit) : (report[0] & ~bit);
+            continue;
+        }
+        uint8_t* slot = (uint8_t*)memchr(&report[2], press ? 0 : usage, 6);
+        TEST_ASSERT_NOT_NULL(slot);
+        *slot = press ? usage : 0;
+    }
+}
+
+static bool sameKeys(const uint8_t* a, const uint8_t* b) {
+    if (a[0] != b[0]) return false;
+    for (uint8_t i = 2; i < HID_KEYBOARD_REPORT_SIZE; i++) {
+        if (a[i] && !memchr(&b[2], a[i], 6)) return false;
+        if (b[i] && !memchr(&a[2], b[i], 6)) return false;
+    }
+    return true;
+}
+
+static void test_validate_accepts_well_formed_code() {
+    const uint8_t code[] = {MACRO_OP_PRESS, 0xE1, MACRO_OP_TAP, 0x04, MACRO_OP_DELAY, 0x10, 0x00,
+                            MACRO_OP_CONSUMER, 0xE9, 0x00, MACRO_OP_CHORD, 0x02, 0x05,
+                            MACRO_OP_RELEASE, 0xE1, MACRO_OP_END};
+    TEST_ASSERT_TRUE(MacroCode::validate(code, sizeof(code)));
+    const uint8_t empty[] = {MACRO_OP_END};
+    TEST_ASSERT_TRUE(MacroCode::validate(empty, 1));
+}
+
+static void test_validate_rejects_malformed_code() {
+    const uint8_t noEnd[] = {MACRO_OP_TAP, 0x04};
+    const uint8_t truncated[] = {MACRO_OP_DELAY, 0x10, MACRO_OP_END};
+    const uint8_t trailing[] = {MACRO_OP_END, MACRO_OP_END};
+    const uint8_t unknown[] = {0x42, MACRO_OP_END};
+    TEST_ASSERT_FALSE(MacroCode::validate(noEnd, sizeof(noEnd)));
+    TEST_ASSERT_FALSE(MacroCode::validate(truncated, sizeof(truncated)));
+    TEST_ASSERT_FALSE(MacroCode::validate(trailing, sizeof(trailing)));
+    TEST_ASSERT_FALSE(MacroCode::validate(unknown, sizeof(unknown)));
+    TEST_ASSERT_FALSE(MacroCode::validate(noEnd, 0));
+}
+
+static void test_key_diff_reaches_next_report() {
+    uint8_t current[HID_KEYBOARD_REPORT_SIZE] = {0};
+    const uint8_t steps[][HID_KEYBOARD_REPORT_SIZE] = {
+        {0x02, 0, 0x04, 0, 0, 0, 0, 0},       // Shift+A
+        {0x02, 0, 0x05, 0x04, 0, 0, 0, 0},    // Shift+A+B, A moved slot
+        {0x01, 0, 0x05, 0, 0, 0, 0, 0},       // Ctrl+B
+        {0x00, 0, 0, 0, 0, 0, 0, 0},
+    };
+    for (const uint8_t* next : steps) {
+        std::vector<uint8_t> code;
+        MacroCode::emitKeyDiff(code, current, next);
+        applyKeyOps(code, current);
+        TEST_ASSERT_TRUE(sameKeys(next, current));
+    }
+
+    // Nothing to emit between identical reports, even with keys reordered
+    const uint8_t a[HID_KEYBOARD_REPORT_SIZE] = {0x04, 0, 0x04, 0x05, 0, 0, 0, 0};
+    const uint8_t b[HID_KEYBOARD_REPORT_SIZE] = {0x04, 0, 0x05, 0, 0x04, 0, 0, 0};
+    std::vector<uint8_t> code;
+    MacroCode::emitKeyDiff(code, a, b);
+    TEST_ASSERT_EQUAL(0, code.size());
+}
+
+static void test_delay_is_little_endian() {
+    std::vector<uint8_t> code;
+    MacroCode::emitDelay(code, 1234);
+    TEST_ASSERT_EQUAL(3, code.size());
+    TEST_ASSERT_EQUAL_UINT8(MACRO_OP_DELAY, code[0]);
+    TEST_ASSERT_EQUAL_UINT16(1234, code[1] | (code[2] << 8));
+}
+
+// Compile cost of a macro set shaped like actions.json: report steps, text
+// and delays. The device prints its own figure after every load.
+static void test_benchmark_compile_time() {
+    const int macros = 64;
+    const int steps = 32;
+    std::vector<uint8_t> arena;
+    size_t largest = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int m = 0; m < macros; m++) {
+        size_t offset = arena.size();
+        uint8_t current[HID_KEYBOARD_REPORT_SIZE] = {0};
+        for (int s = 0; s < steps; s++) {
+            uint8_t next[HID_KEYBOARD_REPORT_SIZE] = {0};
+            next[0] = s & 0x03;
+            next[2] = 0x04 + (s + m) % 26;
+            if (s % 3 == 0) next[3] = 0x1E + s % 10;
+            MacroCode::emitKeyDiff(arena, current, next);
+            memcpy(current, next, sizeof(current));
+            MacroCode::emitDelay(arena, 10);
+            if (s % 8 == 0) MacroCode::emitText(arena, "Hello, world!");
+        }
+        arena.push_back(MACRO_OP_END);
+        TEST_ASSERT_TRUE(MacroCode::validate(&arena[offset], arena.size() - offset));
+        if (arena.size() - offset > largest) largest = arena.size() - offset;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double us = std::chrono::duration<double, std::micro>(end - start).count();
+    char line[96];
+    snprintf(line, sizeof(line), "%d macros x %d steps: %u bytes (largest %u) in %.1f us",
+             macros, steps, (unsigned)arena.size(), (unsigned)largest, us);
+    TEST_MESSAGE(line);
+}
+
+// Deterministic pseudo-random wake-up lateness, 0 to maxUs
+static uint32_t lateness(uint32_t& seed, uint32_t maxUs) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % (maxUs + 1);
+}
+
+// A macro of 200 steps 10 ms apart, played by a task that wakes up to
+// 800 us late every time. Scheduling from the due time keeps every step on
+// the ideal schedule; scheduling from the wake-up time lets the lateness
+// add up.
+static void test_delays_do_not_drift_under_jitter() {
+    const uint32_t delayUs = 10000;
+    const uint32_t maxLateUs = 800;
+    const int steps = 200;
+    uint32_t seed = 99;
+
+    uint32_t due = 1000;
+    uint32_t naiveDue = 1000;
+    uint32_t worstError = 0;
+    uint32_t naiveError = 0;
+    for (int i = 1; i <= steps; i++) {
+        uint32_t now = due + lateness(seed, maxLateUs);
+        due = MacroCode::scheduleDelay(due, now, delayUs);
+        uint32_t error = due - (1000 + i * delayUs);
+        if (error > worstError) worstError = error;
+
+        uint32_t naiveNow = naiveDue + lateness(seed, maxLateUs);
+        naiveDue = naiveNow + delayUs;
+        naiveError = naiveDue - (1000 + i * delayUs);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, worstError);
+    TEST_ASSERT_GREATER_THAN_UINT32(steps * maxLateUs / 4, naiveError);
+
+    char line[96];
+    snprintf(line, sizeof(line), "after %d delays: due-time schedule off by %u us, wake-time by %u us",
+             steps, worstError, naiveError);
+    TEST_MESSAGE(line);
+}
+
+// A stall longer than the resync limit restarts the schedule from now
+// instead of firing the missed steps back to back
+static void test_long_stall_resyncs() {
+    uint32_t due = 50000;
+    TEST_ASSERT_EQUAL_UINT32(due + 10000, MacroCode::scheduleDelay(due, due + MACRO_RESYNC_US - 1, 10000));
+    TEST_ASSERT_EQUAL_UINT32(due + 60000 + 10000, MacroCode::scheduleDelay(due, due + 60000, 10000));
+
+    // Across the 32-bit microsecond wrap
+    due = 0xFFFFFF00;
+    TEST_ASSERT_EQUAL_UINT32(due + 5000, MacroCode::scheduleDelay(due, due + 300, 5000));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_validate_accepts_well_formed_code);
+    RUN_TEST(test_validate_rejects_malformed_code);
+    RUN_TEST(test_key_diff_reaches_next_report);
+    RUN_TEST(test_delay_is_little_endian);
+    RUN_TEST(test_benchmark_compile_time);
+    RUN_TEST(test_delays_do_not_drift_under_jitter);
+    RUN_TEST(test_long_stall_resyncs);
+    return UNITY_END();
+}
@@ -0,0 +1,141 @@
+// test_main.cpp
+// Host tests of the raw HID protocol: the wire layout tools/raw_hid_client.py
+// relies on, and macro upload through the staging buffer the way the client
+// chunks it.
+
+#include <unity.h>
+#include <algorithm>
+#include <vector>
+#include "RawMacroStage.h"
+#include "MacroCode.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Chunk size of raw_hid_client.py set_macro(): the payload after the offset
+#define CLIENT_CHUNK (RAW_HID_REQUEST_PAYLOAD - 2)
+
+// Sizes of the struct formats in raw_hid_client.py
+static void test_struct_layout_matches_client() {
+    TEST_ASSERT_EQUAL(8, sizeof(RawDeviceInfo));     // <BBBBBBH
+    TEST_ASSERT_EQUAL(15, sizeof(RawKeyAction));     // <B8s2sBBBB
+    TEST_ASSERT_EQUAL(7, sizeof(RawLedColor));       // <BBBBBBB
+    TEST_ASSERT_EQUAL(36, sizeof(RawCounters));      // <IIIIIIIIHBB
+    TEST_ASSERT_EQUAL(64, 1 + RAW_HID_REPORT_SIZE);  // Report ID plus frame
+}
+
+// Every request and response, header included, fits one report
+static void test_messages_fit_one_frame() {
+    TEST_ASSERT_LESS_OR_EQUAL(RAW_HID_RESPONSE_PAYLOAD, sizeof(RawDeviceInfo));
+    TEST_ASSERT_LESS_OR_EQUAL(RAW_HID_REQUEST_PAYLOAD, 2 + sizeof(RawKeyAction));
+    TEST_ASSERT_LESS_OR_EQUAL(RAW_HID_RESPONSE_PAYLOAD, 2 + sizeof(RawKeyAction));
+    TEST_ASSERT_LESS_OR_EQUAL(RAW_HID_REQUEST_PAYLOAD, 1 + sizeof(RawLedColor));
+    TEST_ASSERT_LESS_OR_EQUAL(RAW_HID_RESPONSE_PAYLOAD, sizeof(RawCounters));
+    TEST_ASSERT_EQUAL(RAW_HID_REPORT_SIZE, RAW_HID_REQUEST_HEADER + RAW_HID_REQUEST_PAYLOAD);
+    TEST_ASSERT_EQUAL(RAW_HID_REPORT_SIZE, RAW_HID_RESPONSE_HEADER + RAW_HID_RESPONSE_PAYLOAD);
+}
+
+static void test_device_info_little_endian() {
+    RawDeviceInfo info;
+    memset(&info, 0, sizeof(info));
+    info.macroStageSize = 0x0400;
+    const uint8_t* bytes = (const uint8_t*)&info;
+    TEST_ASSERT_EQUAL_UINT8(0x00, bytes[6]);
+    TEST_ASSERT_EQUAL_UINT8(0x04, bytes[7]);
+}
+
+// Uploads code in the client's chunks, returning the first failing status
+static uint8_t upload(RawMacroStage& stage, const std::vector<uint8_t>& code) {
+    size_t offset = 0;
+    do {
+        uint8_t count = (uint8_t)std::min((size_t)CLIENT_CHUNK, code.size() - offset);
+        uint8_t status = stage.write(offset, code.empty() ? nullptr : &code[offset], count);
+        if (status != RAW_STATUS_OK) return status;
+        offset += count;
+    } while (offset < code.size());
+    return stage.check(code.size());
+}
+
+static std::vector<uint8_t> sampleMacro(uint16_t characters) {
+    std::vector<uint8_t> code;
+    String text;
+    for (uint16_t i = 0; i < characters; i++) text += (char)('a' + i % 26);
+    MacroCode::emitText(code, text);
+    MacroCode::emitDelay(code, 250);
+    code.push_back(MACRO_OP_END);
+    return code;
+}
+
+static void test_chunked_upload_round_trips() {
+    RawMacroStage stage;
+    std::vector<uint8_t> code = sampleMacro(100);
+    TEST_ASSERT_GREATER_THAN(3 * CLIENT_CHUNK, code.size());
+    TEST_ASSERT_EQUAL(RAW_STATUS_OK, upload(stage, code));
+    TEST_ASSERT_EQUAL(code.size(), stage.size());
+    TEST_ASSERT_EQUAL_MEMORY(&code[0], stage.data(), code.size());
+
+    // Offset 0 starts over, a second upload replaces the first
+    std::vector<uint8_t> shorter = sampleMacro(3);
+    TEST_ASSERT_EQUAL(RAW_STATUS_OK, upload(stage, shorter));
+    TEST_ASSERT_EQUAL(shorter.size(), stage.size());
+}
+
+static void test_out_of_order_chunk_rejected() {
+    RawMacroStage stage;
+    std::vector<uint8_t> code = sampleMacro(40);
+    TEST_ASSERT_EQUAL(RAW_STATUS_OK, stage.write(0, &code[0], CLIENT_CHUNK));
+    TEST_ASSERT_EQUAL(RAW_STATUS_INVALID, stage.write(2 * CLIENT_CHUNK, &code[2 * CLIENT_CHUNK], 4));
+    TEST_ASSERT_EQUAL(RAW_STATUS_INVALID, stage.write(CLIENT_CHUNK - 1, &code[CLIENT_CHUNK - 1], 4));
+    TEST_ASSERT_EQUAL(CLIENT_CHUNK, stage.size());
+
+    // A commit of what is not staged yet is refused
+    TEST_ASSERT_EQUAL(RAW_STATUS_INVALID, stage.check(code.size()));
+}
+
+static void test_stage_overflow_rejected() {
+    RawMacroStage stage;
+    std::vector<uint8_t> filler(RAW_HID_MACRO_STAGE_SIZE, MACRO_OP_END);
+    uint16_t offset = 0;
+    while (offset + CLIENT_CHUNK <= RAW_HID_MACRO_STAGE_SIZE) {
+        TEST_ASSERT_EQUAL(RAW_STATUS_OK, stage.write(offset, &filler[offset], CLIENT_CHUNK));
+        offset += CLIENT_CHUNK;
+    }
+    TEST_ASSERT_EQUAL(RAW_STATUS_OUT_OF_RANGE, stage.write(offset, &filler[0], CLIENT_CHUNK));
+    TEST_ASSERT_EQUAL(RAW_STATUS_OK, stage.write(offset, &filler[0], RAW_HID_MACRO_STAGE_SIZE - offset));
+    TEST_ASSERT_EQUAL(RAW_HID_MACRO_STAGE_SIZE, stage.size());
+}
+
+// COMMIT_MACRO only accepts well-formed bytecode
+static void test_commit_validates_bytecode() {
+    RawMacroStage stage;
+    std::vector<uint8_t> code = sampleMacro(5);
+
+    std::vector<uint8_t> noEnd(code.begin(), code.end() - 1);
+    TEST_ASSERT_EQUAL(RAW_STATUS_INVALID, upload(stage, noEnd));
+
+    std::vector<uint8_t> unknown = code;
+    unknown[0] = 0x7F;
+    TEST_ASSERT_EQUAL(RAW_STATUS_INVALID, upload(stage, unknown));
+
+    std::vector<uint8_t> truncated = {MACRO_OP_DELAY, 0x10, MACRO_OP_END};
+    TEST_ASSERT_EQUAL(RAW_STATUS_INVALID, upload(stage, truncated));
+
+    TEST_ASSERT_EQUAL(RAW_STATUS_INVALID, upload(stage, std::vector<uint8_t>()));
+
+    TEST_ASSERT_EQUAL(RAW_STATUS_OK, upload(stage, code));
+    TEST_ASSERT_EQUAL(RAW_STATUS_INVALID, stage.check(code.size() - 1));
+    stage.clear();
+    TEST_ASSERT_EQUAL(RAW_STATUS_INVALID, stage.check(code.size()));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_struct_layout_matches_client);
+    RUN_TEST(test_messages_fit_one_frame);
+    RUN_TEST(test_device_info_little_endian);
+    RUN_TEST(test_chunked_upload_round_trips);
+    RUN_TEST(test_out_of_order_chunk_rejected);
+    RUN_TEST(test_stage_overflow_rejected);
+    RUN_TEST(test_commit_validates_bytecode);
+    return UNITY_END();
+}
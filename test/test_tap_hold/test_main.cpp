@@ -0,0 +1,197 @@
+// test_main.cpp
+// Host timing tests of the tap-hold decisions under each policy, driven by
+// event timestamps the way the dispatch task drives the engine.
+
+#include <unity.h>
+#include "TapHoldEngine.h"
+
+void setUp() {}
+void tearDown() {}
+
+#define TAPHOLD_KEY 0
+#define OTHER_KEY 1
+#define THIRD_KEY 2
+#define TERM_MS 200
+
+static KeyEvent event(uint8_t key, bool pressed, uint32_t timeMs) {
+    KeyEvent e;
+    e.detectUs = timeMs * 1000;
+    e.timestampUs = timeMs * 1000;
+    e.keyIndex = key;
+    e.pressed = pressed;
+    e.reserved = 0;
+    return e;
+}
+
+static void startAt(TapHoldEngine& engine, TapHoldPolicy policy, uint32_t timeMs) {
+    KeyConfig config;
+    config.type = ACTION_TAP_HOLD;
+    config.tappingTerm = TERM_MS;
+    config.tapHoldPolicy = policy;
+    engine.start(TAPHOLD_KEY, config, timeMs * 1000);
+    TEST_ASSERT_TRUE(engine.isPending());
+    TEST_ASSERT_EQUAL_UINT8(TAPHOLD_KEY, engine.getPendingKey());
+}
+
+static void assertReplayed(const KeyEvent& e, uint8_t key, bool pressed) {
+    TEST_ASSERT_EQUAL_UINT8(key, e.keyIndex);
+    TEST_ASSERT_EQUAL_UINT8(pressed, e.pressed);
+}
+
+static void test_release_within_term_is_tap() {
+    TapHoldEngine engine;
+    startAt(engine, TAPHOLD_TAPPING_TERM, 1000);
+    TEST_ASSERT_EQUAL(TAPHOLD_UNDECIDED, engine.onTimer((1000 + TERM_MS - 1) * 1000));
+    TEST_ASSERT_EQUAL(TAPHOLD_TAP, engine.onEvent(event(TAPHOLD_KEY, false, 1000 + TERM_MS - 1)));
+
+    // The tap-hold key's own release is consumed by the tap
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL_UINT8(0, engine.finish(replay));
+    TEST_ASSERT_FALSE(engine.isPending());
+    TEST_ASSERT_EQUAL_UINT32(1, engine.getTapCount());
+    TEST_ASSERT_EQUAL_UINT32(0, engine.getHoldCount());
+}
+
+static void test_timer_decides_hold_at_term() {
+    TapHoldEngine engine;
+    startAt(engine, TAPHOLD_TAPPING_TERM, 1000);
+    TEST_ASSERT_EQUAL_UINT32(TERM_MS * 1000, engine.timeUntilDeadline(1000 * 1000));
+    TEST_ASSERT_EQUAL_UINT32(50 * 1000, engine.timeUntilDeadline((1000 + TERM_MS - 50) * 1000));
+    TEST_ASSERT_EQUAL(TAPHOLD_UNDECIDED, engine.onTimer((1000 + TERM_MS) * 1000 - 1));
+    TEST_ASSERT_EQUAL(TAPHOLD_HOLD, engine.onTimer((1000 + TERM_MS) * 1000));
+    TEST_ASSERT_EQUAL_UINT32(0, engine.timeUntilDeadline((1000 + TERM_MS + 5) * 1000));
+
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL_UINT8(0, engine.finish(replay));
+    TEST_ASSERT_EQUAL_UINT32(1, engine.getHoldCount());
+}
+
+// The dispatch task can see a late release before its timer check runs;
+// the release timestamp, not arrival order, decides
+static void test_late_release_is_hold_and_replayed() {
+    TapHoldEngine engine;
+    startAt(engine, TAPHOLD_TAPPING_TERM, 0);
+    TEST_ASSERT_EQUAL(TAPHOLD_HOLD, engine.onEvent(event(TAPHOLD_KEY, false, TERM_MS + 30)));
+
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL_UINT8(1, engine.finish(replay));
+    assertReplayed(replay[0], TAPHOLD_KEY, false);
+}
+
+// Under the plain tapping term a roll over another key stays a tap
+static void test_tapping_term_ignores_other_keys() {
+    TapHoldEngine engine;
+    startAt(engine, TAPHOLD_TAPPING_TERM, 0);
+    TEST_ASSERT_EQUAL(TAPHOLD_UNDECIDED, engine.onEvent(event(OTHER_KEY, true, 40)));
+    TEST_ASSERT_EQUAL(TAPHOLD_UNDECIDED, engine.onEvent(event(OTHER_KEY, false, 80)));
+    TEST_ASSERT_EQUAL(TAPHOLD_TAP, engine.onEvent(event(TAPHOLD_KEY, false, 120)));
+
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL_UINT8(2, engine.finish(replay));
+    assertReplayed(replay[0], OTHER_KEY, true);
+    assertReplayed(replay[1], OTHER_KEY, false);
+}
+
+static void test_other_key_after_term_is_hold() {
+    TapHoldEngine engine;
+    startAt(engine, TAPHOLD_TAPPING_TERM, 0);
+    TEST_ASSERT_EQUAL(TAPHOLD_HOLD, engine.onEvent(event(OTHER_KEY, true, TERM_MS)));
+
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL_UINT8(1, engine.finish(replay));
+    assertReplayed(replay[0], OTHER_KEY, true);
+}
+
+static void test_permissive_hold_on_nested_tap() {
+    TapHoldEngine engine;
+    startAt(engine, TAPHOLD_PERMISSIVE_HOLD, 0);
+    TEST_ASSERT_EQUAL(TAPHOLD_UNDECIDED, engine.onEvent(event(OTHER_KEY, true, 30)));
+    TEST_ASSERT_EQUAL(TAPHOLD_HOLD, engine.onEvent(event(OTHER_KEY, false, 60)));
+
+    // Both events replay after the hold action, in order
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL_UINT8(2, engine.finish(replay));
+    assertReplayed(replay[0], OTHER_KEY, true);
+    assertReplayed(replay[1], OTHER_KEY, false);
+}
+
+// Rolling from the tap-hold key onto another key is still a tap
+static void test_permissive_hold_keeps_rolls_as_taps() {
+    TapHoldEngine engine;
+    startAt(engine, TAPHOLD_PERMISSIVE_HOLD, 0);
+    TEST_ASSERT_EQUAL(TAPHOLD_UNDECIDED, engine.onEvent(event(OTHER_KEY, true, 50)));
+    TEST_ASSERT_EQUAL(TAPHOLD_TAP, engine.onEvent(event(TAPHOLD_KEY, false, 70)));
+
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL_UINT8(1, engine.finish(replay));
+    assertReplayed(replay[0], OTHER_KEY, true);
+}
+
+// A key already down before the tap-hold press was not tapped inside it
+static void test_permissive_hold_ignores_earlier_press() {
+    TapHoldEngine engine;
+    startAt(engine, TAPHOLD_PERMISSIVE_HOLD, 0);
+    TEST_ASSERT_EQUAL(TAPHOLD_UNDECIDED, engine.onEvent(event(THIRD_KEY, false, 20)));
+    TEST_ASSERT_EQUAL(TAPHOLD_TAP, engine.onEvent(event(TAPHOLD_KEY, false, 90)));
+
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL_UINT8(1, engine.finish(replay));
+    assertReplayed(replay[0], THIRD_KEY, false);
+}
+
+static void test_hold_on_other_key_press() {
+    TapHoldEngine engine;
+    startAt(engine, TAPHOLD_HOLD_ON_OTHER_KEY, 0);
+    // Releases of keys pressed earlier do not count
+    TEST_ASSERT_EQUAL(TAPHOLD_UNDECIDED, engine.onEvent(event(THIRD_KEY, false, 10)));
+    TEST_ASSERT_EQUAL(TAPHOLD_HOLD, engine.onEvent(event(OTHER_KEY, true, 20)));
+
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL_UINT8(2, engine.finish(replay));
+    assertReplayed(replay[0], THIRD_KEY, false);
+    assertReplayed(replay[1], OTHER_KEY, true);
+}
+
+// A full buffer forces a hold instead of dropping events
+static void test_full_buffer_forces_hold() {
+    TapHoldEngine engine;
+    startAt(engine, TAPHOLD_TAPPING_TERM, 0);
+    for (uint8_t i = 0; i < TAPHOLD_BUFFER_SIZE - 1; i++) {
+        TEST_ASSERT_EQUAL(TAPHOLD_UNDECIDED, engine.onEvent(event(OTHER_KEY, i % 2 == 0, i + 1)));
+    }
+    TEST_ASSERT_EQUAL(TAPHOLD_HOLD, engine.onEvent(event(THIRD_KEY, true, TAPHOLD_BUFFER_SIZE)));
+
+    KeyEvent replay[TAPHOLD_BUFFER_SIZE];
+    TEST_ASSERT_EQUAL_UINT8(TAPHOLD_BUFFER_SIZE, engine.finish(replay));
+    for (uint8_t i = 0; i < TAPHOLD_BUFFER_SIZE - 1; i++) {
+        assertReplayed(replay[i], OTHER_KEY, i % 2 == 0);
+    }
+    assertReplayed(replay[TAPHOLD_BUFFER_SIZE - 1], THIRD_KEY, true);
+}
+
+// The microsecond clock wraps every 71 minutes
+static void test_term_across_timer_wrap() {
+    TapHoldEngine engine;
+    KeyConfig config;
+    config.tappingTerm = TERM_MS;
+    uint32_t pressUs = 0xFFFFFFFF - 50 * 1000;
+    engine.start(TAPHOLD_KEY, config, pressUs);
+    TEST_ASSERT_EQUAL(TAPHOLD_UNDECIDED, engine.onTimer(pressUs + (TERM_MS - 1) * 1000));
+    TEST_ASSERT_EQUAL(TAPHOLD_HOLD, engine.onTimer(pressUs + TERM_MS * 1000));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_release_within_term_is_tap);
+    RUN_TEST(test_timer_decides_hold_at_term);
+    RUN_TEST(test_late_release_is_hold_and_replayed);
+    RUN_TEST(test_tapping_term_ignores_other_keys);
+    RUN_TEST(test_other_key_after_term_is_hold);
+    RUN_TEST(test_permissive_hold_on_nested_tap);
+    RUN_TEST(test_permissive_hold_keeps_rolls_as_taps);
+    RUN_TEST(test_permissive_hold_ignores_earlier_press);
+    RUN_TEST(test_hold_on_other_key_press);
+    RUN_TEST(test_full_buffer_forces_hold);
+    RUN_TEST(test_term_across_timer_wrap);
+    return UNITY_END();
+}
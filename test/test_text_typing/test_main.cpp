@@ -0,0 +1,163 @@
+// test_main.cpp
+// Host tests of the text action: the generated ASCII keymap, reports per
+// character, and characters per second at the host's polling rate.
+
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "AsciiKeymap.h"
+#include "MacroCode.h"
+
+void setUp() {}
+void tearDown() {}
+
+// The table is usable at compile time
+static_assert(asciiToKey('A').modifiers == 0x02 && asciiToKey('A').usage == 0x04, "A is Shift+a");
+static_assert(asciiToKey(0xC3).usage == 0, "non-ASCII has no key");
+
+struct Chord {
+    uint8_t modifiers;
+    uint8_t usage;
+};
+
+// Decodes text bytecode, which must be nothing but chords
+static void decodeChords(const std::vector<uint8_t>& code, std::vector<Chord>& out) {
+    out.clear();
+    for (size_t pc = 0; pc + 2 < code.size(); pc += 3) {
+        if (code[pc] != MACRO_OP_CHORD) break;
+        Chord chord = {code[pc + 1], code[pc + 2]};
+        out.push_back(chord);
+    }
+    TEST_ASSERT_EQUAL(code.size(), out.size() * 3);
+}
+
+static void test_printable_ascii_all_mapped() {
+    for (uint8_t c = 0x20; c <= 0x7E; c++) {
+        TEST_ASSERT_TRUE_MESSAGE(asciiToKey(c).usage != 0, "printable character without a key");
+        uint8_t modifiers = asciiToKey(c).modifiers;
+        TEST_ASSERT_TRUE(modifiers == 0x00 || modifiers == 0x02);
+    }
+    TEST_ASSERT_EQUAL_UINT8(0x28, asciiToKey('\n').usage);
+    TEST_ASSERT_EQUAL_UINT8(0x2B, asciiToKey('\t').usage);
+    TEST_ASSERT_EQUAL_UINT8(0x2C, asciiToKey(' ').usage);
+    TEST_ASSERT_EQUAL_UINT8(0, asciiToKey(0x7F).usage);
+}
+
+// Upper case and shifted symbols share the key of their unshifted twin
+static void test_shifted_characters_carry_shift() {
+    for (char c = 'a'; c <= 'z'; c++) {
+        TEST_ASSERT_EQUAL_UINT8(asciiToKey(c).usage, asciiToKey(c - 'a' + 'A').usage);
+        TEST_ASSERT_EQUAL_UINT8(0x00, asciiToKey(c).modifiers);
+        TEST_ASSERT_EQUAL_UINT8(0x02, asciiToKey(c - 'a' + 'A').modifiers);
+    }
+    const char* pairs[] = {"1!", "2@", "3#", "-_", "=+", "[{", "]}", ";:", "'\"", ",<", ".>", "/?", "`~"};
+    for (const char* pair : pairs) {
+        TEST_ASSERT_EQUAL_UINT8(asciiToKey(pair[0]).usage, asciiToKey(pair[1]).usage);
+        TEST_ASSERT_EQUAL_UINT8(0x00, asciiToKey(pair[0]).modifiers);
+        TEST_ASSERT_EQUAL_UINT8(0x02, asciiToKey(pair[1]).modifiers);
+    }
+}
+
+// One report per character, plus a release between repeats of a key and
+// one at the end
+static void test_one_report_per_character() {
+    std::vector<uint8_t> code;
+    TEST_ASSERT_EQUAL_UINT16(0, MacroCode::emitText(code, "Hello"));
+    std::vector<Chord> out;
+    decodeChords(code, out);
+
+    // H e l <release> l o <release>
+    TEST_ASSERT_EQUAL(5 + 1 + 1, out.size());
+    TEST_ASSERT_EQUAL_UINT8(0x02, out[0].modifiers);
+    TEST_ASSERT_EQUAL_UINT8(0x0B, out[0].usage);
+    TEST_ASSERT_EQUAL_UINT8(0x0F, out[2].usage);
+    TEST_ASSERT_EQUAL_UINT8(0, out[3].usage);
+    TEST_ASSERT_EQUAL_UINT8(0x0F, out[4].usage);
+    TEST_ASSERT_EQUAL_UINT8(0, out.back().modifiers);
+    TEST_ASSERT_EQUAL_UINT8(0, out.back().usage);
+}
+
+// No empty report between different keys, and one only where the key
+// repeats, including a and A
+static void test_no_redundant_empty_reports() {
+    const char* text = "The quick brown fox jumps over the lazy dog. aA 1! see, 100%\n";
+    std::vector<uint8_t> code;
+    MacroCode::emitText(code, text);
+    std::vector<Chord> out;
+    decodeChords(code, out);
+
+    size_t length = strlen(text);
+    size_t repeats = 0;
+    for (size_t i = 1; i < length; i++) {
+        if (asciiToKey(text[i]).usage == asciiToKey(text[i - 1]).usage) repeats++;
+    }
+    TEST_ASSERT_EQUAL(length + repeats + 1, out.size());
+
+    for (size_t i = 0; i + 1 < out.size(); i++) {
+        if (out[i].usage == 0) {
+            TEST_ASSERT_TRUE(i > 0 && out[i - 1].usage == out[i + 1].usage);
+        }
+    }
+}
+
+// Characters without a key are counted once, multi-byte UTF-8 included
+static void test_unmapped_characters_skipped() {
+    std::vector<uint8_t> code;
+    // "a", e-acute (2 bytes), "b", euro sign (3 bytes), DEL
+    TEST_ASSERT_EQUAL_UINT16(3, MacroCode::emitText(code, "a\xC3\xA9" "b\xE2\x82\xAC\x7F"));
+    std::vector<Chord> out;
+    decodeChords(code, out);
+    TEST_ASSERT_EQUAL(3, out.size());
+    TEST_ASSERT_EQUAL_UINT8(0x04, out[0].usage);
+    TEST_ASSERT_EQUAL_UINT8(0x05, out[1].usage);
+
+    code.clear();
+    TEST_ASSERT_EQUAL_UINT16(0, MacroCode::emitText(code, ""));
+    TEST_ASSERT_EQUAL(0, code.size());
+}
+
+// The player sends one report per host poll. At a 1 ms polling interval
+// chords deliver close to 1000 characters per second; a press and a
+// release per character would deliver at most half that.
+static void test_benchmark_characters_per_second() {
+    const char* text = "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+                       "incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam!\n";
+    const double pollMs = 1.0;
+    size_t length = strlen(text);
+
+    std::vector<uint8_t> code;
+    MacroCode::emitText(code, text);
+    std::vector<Chord> out;
+    decodeChords(code, out);
+    size_t reports = out.size();
+
+    // Press and release per character, with a Shift report around capitals
+    size_t naiveReports = 0;
+    for (size_t i = 0; i < length; i++) {
+        naiveReports += asciiToKey(text[i]).modifiers ? 4 : 2;
+    }
+
+    double rate = length * 1000.0 / (reports * pollMs);
+    double naiveRate = length * 1000.0 / (naiveReports * pollMs);
+    TEST_ASSERT_GREATER_THAN(900, (int)rate);
+    TEST_ASSERT_GREATER_THAN((int)(naiveRate * 1.8), (int)rate);
+
+    char line[96];
+    snprintf(line, sizeof(line), "%u chars: %u reports, %.0f chars/s at 1 kHz polling", (unsigned)length,
+             (unsigned)reports, rate);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "press/release per char: %u reports, %.0f chars/s", (unsigned)naiveReports,
+             naiveRate);
+    TEST_MESSAGE(line);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_printable_ascii_all_mapped);
+    RUN_TEST(test_shifted_characters_carry_shift);
+    RUN_TEST(test_one_report_per_character);
+    RUN_TEST(test_no_redundant_empty_reports);
+    RUN_TEST(test_unmapped_characters_skipped);
+    RUN_TEST(test_benchmark_characters_per_second);
+    return UNITY_END();
+}
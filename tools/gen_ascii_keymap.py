@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Generates src/AsciiKeymap.h from the keyboard reports in data/config/reports.json.
+
+basicKeys and functionKeys give the unshifted usage of each character, the
+shifted characters follow the US layout. Run again after editing reports.json.
+"""
+
+import json
+import os
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+REPORTS = os.path.join(ROOT, "data", "config", "reports.json")
+OUTPUT = os.path.join(ROOT, "src", "AsciiKeymap.h")
+
+SHIFT = 0x02
+
+# functionKeys names typed as a character
+NAMED_KEYS = {
+    "enter": "\n", "tab": "\t", "space": " ", "minus": "-", "equals": "=",
+    "left_bracket": "[", "right_bracket": "]", "backslash": "\\",
+    "semicolon": ";", "quote": "'", "grave": "`", "comma": ",",
+    "period": ".", "slash": "/",
+}
+
+# US layout: shifted character -> unshifted character on the same key
+SHIFTED = dict(zip('!@#$%^&*()_+{}|:"~<>?', "1234567890-=[]\\;'`,./"))
+
+
+def usage_of(report):
+    return int(report[2], 16)
+
+
+def main():
+    with open(REPORTS) as f:
+        keyboard = json.load(f)["hidReports"]["keyboard"]
+
+    table = {}
+    for name, report in keyboard["basicKeys"].items():
+        table[name] = (0, usage_of(report))
+    for name, report in keyboard["functionKeys"].items():
+        if name in NAMED_KEYS:
+            table[NAMED_KEYS[name]] = (0, usage_of(report))
+    for ch in "abcdefghijklmnopqrstuvwxyz":
+        if ch in table:
+            table[ch.upper()] = (SHIFT, table[ch][1])
+    for ch, base in SHIFTED.items():
+        if base in table:
+            table[ch] = (SHIFT, table[base][1])
+    table["\r"] = table["\n"]
+
+    rows = []
+    for code in range(128):
+        ch = chr(code)
+        modifiers, usage = table.get(ch, (0, 0))
+        if ch == " ":
+            label = "space"
+        elif ch == "\\":
+            label = "backslash"
+        elif 32 < code < 127 or ch in "\t\n\r":
+            label = repr(ch)[1:-1]
+        else:
+            label = "0x%02X" % code
+        rows.append("    { 0x%02X, 0x%02X }, // %s" % (modifiers, usage, label))
+
+    with open(OUTPUT, "w", newline="\n") as f:
+        f.write("// AsciiKeymap.h\n")
+        f.write("// Generated by tools/gen_ascii_keymap.py from data/config/reports.json, do not edit\n\n")
+        f.write("#ifndef ASCII_KEYMAP_H\n#define ASCII_KEYMAP_H\n\n#include <stdint.h>\n\n")
+        f.write("// Key that types an ASCII character, usage 0 when the character has none\n")
+        f.write("struct AsciiKey {\n    uint8_t modifiers;\n    uint8_t usage;\n};\n\n")
+        f.write("static constexpr AsciiKey ASCII_KEYMAP[128] = {\n")
+        f.write("\n".join(rows))
+        f.write("\n};\n\n")
+        f.write("static constexpr AsciiKey asciiToKey(uint8_t c) {\n")
+        f.write("    return c < 128 ? ASCII_KEYMAP[c] : AsciiKey{ 0, 0 };\n}\n\n")
+        f.write("#endif // ASCII_KEYMAP_H\n")
+
+
+if __name__ == "__main__":
+    main()
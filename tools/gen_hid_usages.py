@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""Generates src/HidUsageTables.h from the consumer and system usages in data/config/reports.json.
+
+Consumer entries use the legacy 4-byte consumer report layout the firmware
+reads from actions.json: bytes 0-1 unused, the 16-bit usage little-endian in
+bytes 2-3, every element a single byte. System entries are plain usages.
+Run again after editing reports.json.
+"""
+
+import json
+import os
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+REPORTS = os.path.join(ROOT, "data", "config", "reports.json")
+OUTPUT = os.path.join(ROOT, "src", "HidUsageTables.h")
+
+
+def byte(key, text):
+    value = int(text, 16)
+    if not 0 <= value <= 0xFF:
+        raise SystemExit("%s: %s does not fit in one byte of the consumer report" % (key, text))
+    return value
+
+
+def consumer_usage(key, report):
+    if len(report) != 4:
+        raise SystemExit("%s: consumer report must have 4 bytes, got %d" % (key, len(report)))
+    data = [byte(key, text) for text in report]
+    return data[2] | (data[3] << 8)
+
+
+def system_usage(key, text):
+    value = int(text, 16)
+    if not 0 < value <= 0xFFFF:
+        raise SystemExit("%s: system usage %s out of range" % (key, text))
+    return value
+
+
+def table(name, entries):
+    lines = ["static const HidUsageName %s[] = {" % name]
+    for key, usage in entries:
+        lines.append('    { "%s", 0x%04X },' % (key, usage))
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def main():
+    with open(REPORTS) as f:
+        reports = json.load(f)["hidReports"]
+
+    consumer = []
+    for group in reports["consumer"].values():
+        for key, report in group.items():
+            consumer.append((key, consumer_usage(key, report)))
+    system = [(key, system_usage(key, usage)) for key, usage in reports["system"].items()]
+
+    with open(OUTPUT, "w", newline="\n") as f:
+        f.write("// HidUsageTables.h\n")
+        f.write("// Generated by tools/gen_hid_usages.py from data/config/reports.json, do not edit\n\n")
+        f.write("#ifndef HID_USAGE_TABLES_H\n#define HID_USAGE_TABLES_H\n\n#include <stdint.h>\n\n")
+        f.write("struct HidUsageName {\n    const char* name;\n    uint16_t usage;\n};\n\n")
+        f.write("// Consumer page (0x0C) usages\n")
+        f.write(table("CONSUMER_USAGES", consumer))
+        f.write("\n\n// Generic Desktop System Control usages\n")
+        f.write(table("SYSTEM_USAGES", system))
+        f.write("\n\n#endif // HID_USAGE_TABLES_H\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,295 @@
+#!/usr/bin/env python3
+"""Host client for the raw HID configuration endpoint, see include/raw_hid_protocol.h.
+
+Needs the hidapi bindings (pip install hidapi). Usable as a library through
+RawHidClient or from the command line:
+
+    raw_hid_client.py info
+    raw_hid_client.py get-key LAYER KEY
+    raw_hid_client.py set-key LAYER KEY TYPE [HEX_BYTES...]
+    raw_hid_client.py get-led INDEX
+    raw_hid_client.py set-led INDEX R G B BRIGHTNESS [PR PG PB]
+    raw_hid_client.py get-macro INDEX
+    raw_hid_client.py set-macro INDEX HEX_BYTES...
+    raw_hid_client.py counters
+    raw_hid_client.py stream INTERVAL_MS
+    raw_hid_client.py loopback [ROUNDS]
+
+loopback writes a different value to every key, LED and macro, waits until
+the device reads it back, then restores the original and checks that too. It
+reports round-trip times.
+"""
+
+import struct
+import sys
+import time
+
+import hid
+
+USAGE_PAGE = 0xFF60
+USAGE = 0x61
+REPORT_ID = 6
+REPORT_SIZE = 63
+REQUEST_PAYLOAD = REPORT_SIZE - 3
+
+CMD_PING = 0x01
+CMD_GET_KEY = 0x10
+CMD_SET_KEY = 0x11
+CMD_GET_LED = 0x20
+CMD_SET_LED = 0x21
+CMD_GET_MACRO = 0x30
+CMD_WRITE_MACRO = 0x31
+CMD_COMMIT_MACRO = 0x32
+CMD_GET_COUNTERS = 0x40
+CMD_STREAM_COUNTERS = 0x41
+
+STATUS_NAMES = ["ok", "unknown command", "bad length", "out of range", "invalid", "busy"]
+STATUS_BUSY = 5
+
+ACTION_NONE = 0
+ACTION_TRANSPARENT = 5
+ACTION_TAP_HOLD = 6
+MACRO_OP_DELAY = 0x05
+
+DEVICE_INFO = struct.Struct("<BBBBBBH")
+KEY_ACTION = struct.Struct("<B8s2sBBBB")
+LED_COLOR = struct.Struct("<BBBBBBB")
+COUNTERS = struct.Struct("<IIIIIIIIHBB")
+COUNTER_FIELDS = ["uptime_ms", "hid_sent", "hid_coalesced", "hid_duplicates", "hid_dropped",
+                  "key_events", "latency_avg_us", "latency_max_us", "scan_rate_hz",
+                  "hid_backlog", "active_layer"]
+
+
+class RawHidError(Exception):
+    pass
+
+
+class RawHidBusy(RawHidError):
+    """The device asked to try again, e.g. a key edit is still pending"""
+
+
+class RawHidClient:
+    def __init__(self, path=None, timeout_ms=1000):
+        if path is None:
+            path = self.find()
+        self.device = hid.device()
+        self.device.open_path(path)
+        self.timeout_ms = timeout_ms
+        self.seq = 0
+
+    @staticmethod
+    def find():
+        for info in hid.enumerate():
+            if info["usage_page"] == USAGE_PAGE and info["usage"] == USAGE:
+                return info["path"]
+        raise RawHidError("no raw HID interface found")
+
+    def close(self):
+        self.device.close()
+
+    def request(self, cmd, payload=b"", retries=20):
+        if len(payload) > REQUEST_PAYLOAD:
+            raise RawHidError("payload too long")
+        for _ in range(retries):
+            # seq 0 is reserved for streamed counters
+            self.seq = self.seq % 255 + 1
+            frame = bytes([cmd, self.seq, len(payload)]) + payload
+            self.device.write(bytes([REPORT_ID]) + frame.ljust(REPORT_SIZE, b"\0"))
+            status, data = self.read_response(cmd, self.seq)
+            if status != STATUS_BUSY:
+                break
+            time.sleep(0.01)
+        if status:
+            name = STATUS_NAMES[status] if status < len(STATUS_NAMES) else str(status)
+            error = RawHidBusy if status == STATUS_BUSY else RawHidError
+            raise error("command 0x%02X failed: %s" % (cmd, name))
+        return data
+
+    def read_response(self, cmd, seq):
+        deadline = time.monotonic() + self.timeout_ms / 1000.0
+        while time.monotonic() < deadline:
+            report = bytes(self.device.read(REPORT_SIZE + 1, self.timeout_ms))
+            if not report:
+                continue
+            # Some platforms keep the report ID in front
+            if len(report) > REPORT_SIZE:
+                report = report[1:]
+            if report[0] == cmd and report[1] == seq:
+                return report[2], report[4:4 + report[3]]
+        raise RawHidError("no response to command 0x%02X" % cmd)
+
+    def info(self):
+        fields = DEVICE_INFO.unpack(self.request(CMD_PING)[:DEVICE_INFO.size])
+        return dict(zip(["version", "layers", "keys", "leds", "macros", "max_macros", "macro_stage_size"], fields))
+
+    def get_key(self, layer, key):
+        return self.request(CMD_GET_KEY, bytes([layer, key]))[2:2 + KEY_ACTION.size]
+
+    def set_key(self, layer, key, action):
+        self.request(CMD_SET_KEY, bytes([layer, key]) + action)
+
+    def get_led(self, index):
+        return LED_COLOR.unpack(self.request(CMD_GET_LED, bytes([index]))[1:1 + LED_COLOR.size])
+
+    def set_led(self, index, color):
+        self.request(CMD_SET_LED, bytes([index]) + LED_COLOR.pack(*color))
+
+    def get_macro(self, index):
+        code = b""
+        while True:
+            data = self.request(CMD_GET_MACRO, struct.pack("<BH", index, len(code)))
+            size = struct.unpack_from("<H", data, 1)[0]
+            code += data[5:]
+            if len(code) >= size or len(data) <= 5:
+                return code
+
+    def set_macro(self, index, code):
+        for offset in range(0, max(len(code), 1), REQUEST_PAYLOAD - 2):
+            chunk = code[offset:offset + REQUEST_PAYLOAD - 2]
+            self.request(CMD_WRITE_MACRO, struct.pack("<H", offset) + chunk)
+        self.request(CMD_COMMIT_MACRO, struct.pack("<BH", index, len(code)))
+
+    def counters(self):
+        return dict(zip(COUNTER_FIELDS, COUNTERS.unpack(self.request(CMD_GET_COUNTERS)[:COUNTERS.size])))
+
+    def stream(self, interval_ms):
+        self.request(CMD_STREAM_COUNTERS, struct.pack("<H", interval_ms))
+        while True:
+            report = bytes(self.device.read(REPORT_SIZE + 1, 1000))
+            if len(report) > REPORT_SIZE:
+                report = report[1:]
+            if report and report[0] == CMD_GET_COUNTERS and report[1] == 0:
+                yield dict(zip(COUNTER_FIELDS, COUNTERS.unpack(report[4:4 + COUNTERS.size])))
+
+
+def until_not_busy(call, timeout=5.0):
+    deadline = time.monotonic() + timeout
+    while True:
+        try:
+            return call()
+        except RawHidBusy:
+            if time.monotonic() > deadline:
+                raise
+            time.sleep(0.01)
+
+
+def wait_for(read, expected, timeout=5.0):
+    """Polls until read() returns expected. Key edits are only queued by
+    SET_KEY and applied once the key is released."""
+    deadline = time.monotonic() + timeout
+    while True:
+        if read() == expected:
+            return True
+        if time.monotonic() > deadline:
+            return False
+        time.sleep(0.005)
+
+
+def write_and_restore(name, read, write, original, probe):
+    """Writes probe, checks it is applied, then puts original back"""
+    for value, what in ((probe, "change"), (original, "restore")):
+        until_not_busy(lambda: write(value))
+        if not wait_for(read, value):
+            print("%s: %s did not read back" % (name, what))
+            return False
+    return True
+
+
+def key_probe(action):
+    # No action, or transparent if that is what the key already has. Neither
+    # sends anything should the key be pressed during the test.
+    probe = bytes([ACTION_NONE]).ljust(KEY_ACTION.size, b"\0")
+    if probe == action:
+        probe = bytes([ACTION_TRANSPARENT]).ljust(KEY_ACTION.size, b"\0")
+    return probe
+
+
+def loopback(client, rounds):
+    info = client.info()
+    print("Protocol %(version)d: %(layers)d layers, %(keys)d keys, %(leds)d LEDs, %(macros)d macros" % info)
+    failures = 0
+    times = []
+    for _ in range(rounds):
+        for layer in range(info["layers"]):
+            for key in range(info["keys"]):
+                start = time.monotonic()
+                action = client.get_key(layer, key)
+                times.append(time.monotonic() - start)
+                if action[0] == ACTION_TAP_HOLD:
+                    continue  # Not writable
+                if not write_and_restore("key %d/%d" % (layer, key),
+                                         lambda: client.get_key(layer, key),
+                                         lambda value: client.set_key(layer, key, value),
+                                         action, key_probe(action)):
+                    failures += 1
+        for index in range(info["leds"]):
+            color = client.get_led(index)
+            probe = (color[0] ^ 0xFF,) + tuple(color[1:])
+            if not write_and_restore("LED %d" % index,
+                                     lambda: client.get_led(index),
+                                     lambda value: client.set_led(index, value),
+                                     color, probe):
+                failures += 1
+        for index in range(info["macros"]):
+            code = client.get_macro(index)
+            # A zero delay in front changes the bytecode, not what it types
+            probe = bytes([MACRO_OP_DELAY, 0, 0]) + code
+            if len(probe) > info["macro_stage_size"]:
+                print("macro %d: too large to change, skipped" % index)
+                continue
+            if not write_and_restore("macro %d" % index,
+                                     lambda: client.get_macro(index),
+                                     lambda value: client.set_macro(index, value),
+                                     code, probe):
+                failures += 1
+    if times:
+        times.sort()
+        print("Round trip: median %.2f ms, max %.2f ms over %d requests" %
+              (times[len(times) // 2] * 1000, times[-1] * 1000, len(times)))
+    print("%d failures" % failures)
+    return failures == 0
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__)
+        return 1
+    command, args = argv[1], [int(a, 0) for a in argv[2:]]
+    client = RawHidClient()
+    try:
+        if command == "info":
+            print(client.info())
+        elif command == "get-key":
+            print(client.get_key(args[0], args[1]).hex(" "))
+        elif command == "set-key":
+            action = bytes([args[2]]) + bytes(args[3:]).ljust(KEY_ACTION.size - 1, b"\0")
+            client.set_key(args[0], args[1], action)
+        elif command == "get-led":
+            print(client.get_led(args[0]))
+        elif command == "set-led":
+            color = list(args[1:5]) + (list(args[5:8]) if len(args) >= 8 else list(client.get_led(args[0])[4:]))
+            client.set_led(args[0], color)
+        elif command == "get-macro":
+            print(client.get_macro(args[0]).hex(" "))
+        elif command == "set-macro":
+            client.set_macro(args[0], bytes(args[1:]))
+        elif command == "counters":
+            for name, value in client.counters().items():
+                print("%s: %d" % (name, value))
+        elif command == "stream":
+            for counters in client.stream(args[0]):
+                print(counters)
+        elif command == "loopback":
+            return 0 if loopback(client, args[0] if args else 1) else 1
+        else:
+            print(__doc__)
+            return 1
+    except KeyboardInterrupt:
+        client.request(CMD_STREAM_COUNTERS, struct.pack("<H", 0))
+    finally:
+        client.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))